@@ -0,0 +1,155 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+/*
+ * Throughput benchmark for the shared memory frame rings. A writer thread writes frames as fast as possible while reader
+ * threads read them in place, like the readers of Homegear's rings do. With FPS > 0 the writer is paced like a camera,
+ * which shows the latency and losses of the readers instead of the raw throughput.
+ *
+ * Build: g++ -O2 -std=c++11 -pthread -I../../src Benchmark.cpp -o ipcam-shm-benchmark -lrt
+ * Usage: ipcam-shm-benchmark [FRAME SIZE IN KIB (default 200)] [READERS (default 2)] [SLOTS (default 8)] [SECONDS (default 5)] [FPS (default 0 = unlimited)]
+ */
+
+#include "SharedFrameRing.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+using namespace IpCam;
+
+namespace
+{
+
+struct ReaderResult
+{
+	uint64_t frames = 0;
+	uint64_t bytes = 0;
+	uint64_t invalid = 0;
+	uint64_t missed = 0;
+	uint64_t checksum = 0;
+	int64_t latency = 0;
+};
+
+std::atomic_bool stop{false};
+
+void readFrames(const std::string& name, ReaderResult* result)
+{
+	SharedFrameRing::Reader reader;
+	std::string error;
+	if(!reader.open(name, error))
+	{
+		fprintf(stderr, "%s\n", error.c_str());
+		return;
+	}
+	SharedFrameRing::Reader::Frame frame;
+	while(!stop)
+	{
+		if(!reader.next(frame))
+		{
+			std::this_thread::yield();
+			continue;
+		}
+		//Touch every cache line of the frame, like a consumer would.
+		uint64_t checksum = 0;
+		for(uint32_t i = 0; i < frame.size; i += 64) checksum += (uint8_t)frame.data[i];
+		if(!reader.valid(frame))
+		{
+			result->invalid++;
+			continue;
+		}
+		result->checksum += checksum;
+		result->frames++;
+		result->bytes += frame.size;
+		result->latency += SharedFrameRing::getTime() - frame.time;
+	}
+	result->missed = reader.missedFrames();
+}
+
+}
+
+int main(int argc, char* argv[])
+{
+	uint32_t frameSize = (argc > 1 ? strtoul(argv[1], nullptr, 10) : 200) * 1024;
+	uint32_t readerCount = argc > 2 ? strtoul(argv[2], nullptr, 10) : 2;
+	uint32_t slotCount = argc > 3 ? strtoul(argv[3], nullptr, 10) : 8;
+	uint32_t seconds = argc > 4 ? strtoul(argv[4], nullptr, 10) : 5;
+	uint32_t fps = argc > 5 ? strtoul(argv[5], nullptr, 10) : 0;
+	if(frameSize == 0 || slotCount == 0 || seconds == 0)
+	{
+		fprintf(stderr, "Invalid arguments.\n");
+		return 1;
+	}
+
+	std::string name = "/homegear-ipcam-benchmark-" + std::to_string(getpid());
+	SharedFrameRing::Writer writer;
+	std::string error;
+	if(!writer.open(name, slotCount, frameSize, error))
+	{
+		fprintf(stderr, "%s\n", error.c_str());
+		return 1;
+	}
+
+	std::vector<char> data(frameSize);
+	for(uint32_t i = 0; i < frameSize; i++) data[i] = (char)(i * 31);
+
+	std::vector<ReaderResult> results(readerCount);
+	std::vector<std::thread> readers;
+	for(uint32_t i = 0; i < readerCount; i++) readers.emplace_back(readFrames, name, &results[i]);
+
+	auto startTime = std::chrono::steady_clock::now();
+	auto endTime = startTime + std::chrono::seconds(seconds);
+	uint64_t writtenFrames = 0;
+	while(std::chrono::steady_clock::now() < endTime)
+	{
+		if(fps > 0)
+		{
+			writer.write(data.data(), frameSize, SharedFrameRing::getTime());
+			writtenFrames++;
+			std::this_thread::sleep_until(startTime + std::chrono::microseconds(writtenFrames * 1000000 / fps));
+			continue;
+		}
+		for(int32_t i = 0; i < 64; i++) writer.write(data.data(), frameSize, SharedFrameRing::getTime());
+		writtenFrames += 64;
+	}
+	double duration = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+	stop = true;
+	for(auto& reader : readers) reader.join();
+	writer.close();
+
+	printf("Frame size: %u KiB, slots: %u, readers: %u, fps: %s, duration: %.1f s\n", frameSize / 1024, slotCount, readerCount, fps > 0 ? std::to_string(fps).c_str() : "unlimited", duration);
+	printf("Writer:   %12.0f frames/s %10.1f MiB/s\n", writtenFrames / duration, (double)writtenFrames * frameSize / duration / 1048576);
+	for(uint32_t i = 0; i < readerCount; i++)
+	{
+		ReaderResult& result = results[i];
+		printf("Reader %u: %12.0f frames/s %10.1f MiB/s, %llu skipped, %llu overwritten while reading, %.2f ms average age\n", i, result.frames / duration, result.bytes / duration / 1048576, (unsigned long long)result.missed, (unsigned long long)result.invalid, result.frames ? (double)result.latency / result.frames : 0.0);
+	}
+	return 0;
+}
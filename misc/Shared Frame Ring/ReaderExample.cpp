@@ -0,0 +1,100 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+/*
+ * Example reader for the shared memory frame rings. Prints all frames of a camera and optionally stores the newest one.
+ *
+ * Build: g++ -O2 -std=c++11 -I../../src ReaderExample.cpp -o ipcam-shm-reader -lrt
+ * Usage: ipcam-shm-reader PEERID [OUTPUT FILE]
+ *
+ * Set SHARED_MEMORY_SLOTS of the camera to a value greater than 0 first. The user running the reader must be in the
+ * group Homegear runs as.
+ */
+
+#include "SharedFrameRing.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+
+using namespace IpCam;
+
+int main(int argc, char* argv[])
+{
+	if(argc < 2)
+	{
+		fprintf(stderr, "Usage: %s PEERID [OUTPUT FILE]\n", argv[0]);
+		return 1;
+	}
+	std::string name = SharedFrameRing::getName(strtoull(argv[1], nullptr, 10));
+	std::string outputFile = argc > 2 ? argv[2] : "";
+
+	SharedFrameRing::Reader reader;
+	SharedFrameRing::Reader::Frame frame;
+	std::string error;
+	while(true)
+	{
+		if(!reader.isOpen() || reader.closed())
+		{
+			if(!reader.open(name, error))
+			{
+				fprintf(stderr, "%s Retrying in 5 seconds.\n", error.c_str());
+				std::this_thread::sleep_for(std::chrono::seconds(5));
+				continue;
+			}
+			printf("Opened %s.\n", name.c_str());
+		}
+
+		if(!reader.next(frame))
+		{
+			//The stream is requested on the first call to next(). It usually takes a few hundred milliseconds until the first frame arrives.
+			std::this_thread::sleep_for(std::chrono::milliseconds(5));
+			continue;
+		}
+
+		//The frame is read in place. Copy or process it and check afterwards if it was overwritten in the meantime.
+		bool stored = false;
+		if(!outputFile.empty())
+		{
+			FILE* file = fopen(outputFile.c_str(), "wb");
+			if(file)
+			{
+				stored = fwrite(frame.data, 1, frame.size, file) == frame.size;
+				fclose(file);
+			}
+		}
+		if(!reader.valid(frame))
+		{
+			printf("Frame %llu was overwritten while it was read.\n", (unsigned long long)frame.sequence);
+			continue;
+		}
+		printf("Frame %llu: %u bytes, %lld ms old, %llu frames missed so far%s\n", (unsigned long long)frame.sequence, frame.size, (long long)(SharedFrameRing::getTime() - frame.time), (unsigned long long)reader.missedFrames(), stored ? ", stored" : "");
+	}
+	return 0;
+}
@@ -0,0 +1,362 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+#include "CameraConnection.h"
+#include "GD.h"
+
+#include <array>
+#include <cstring>
+
+#include <gnutls/crypto.h>
+#include <gnutls/x509.h>
+
+#include <arpa/inet.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace IpCam
+{
+
+CameraConnection::CameraConnection(const std::string& host, int32_t port, bool ssl, const std::string& caFile, bool verifyCertificate, const Timeouts& timeouts, const PStats& stats, const std::shared_ptr<TlsSessionCache>& tlsSessionCache) : _host(host), _port(port), _ssl(ssl), _caFile(caFile), _verifyCertificate(verifyCertificate), _timeouts(timeouts), _stats(stats), _tlsSessionCache(tlsSessionCache)
+{
+	if(_ssl && !_tlsSessionCache) _tlsSessionCache = std::make_shared<TlsSessionCache>();
+}
+
+CameraConnection::~CameraConnection()
+{
+	close();
+}
+
+void CameraConnection::open()
+{
+	close();
+	try
+	{
+		connect();
+		if(_ssl) handshake();
+	}
+	catch(const BaseLib::SocketOperationException& ex)
+	{
+		close();
+		throw;
+	}
+	_waitingForFirstByte = false;
+	_deadline = 0;
+}
+
+void CameraConnection::close()
+{
+	if(_session)
+	{
+		//Non-blocking, so this doesn't wait for the camera.
+		if(_descriptor != -1) gnutls_bye(_session, GNUTLS_SHUT_WR);
+		gnutls_deinit(_session);
+		_session = nullptr;
+	}
+	_credentials.reset();
+	if(_descriptor != -1)
+	{
+		::close(_descriptor);
+		_descriptor = -1;
+	}
+}
+
+void CameraConnection::connect()
+{
+	int64_t startTime = BaseLib::HelperFunctions::getTime();
+	int64_t deadline = startTime + _timeouts.connect;
+
+	std::vector<DnsCache::Address> addresses;
+	std::string port = std::to_string(_port);
+	//Only waits for the resolver when the host name is not cached yet.
+	if(!GD::dnsCache->resolve(_host, _port, addresses, _timeouts.connect)) throw BaseLib::SocketOperationException("Could not resolve " + _host + ".");
+
+	bool timedOut = false;
+	int lastError = 0;
+	for(std::vector<DnsCache::Address>::iterator address = addresses.begin(); address != addresses.end(); ++address)
+	{
+		_descriptor = socket(address->address.ss_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+		if(_descriptor == -1)
+		{
+			lastError = errno;
+			continue;
+		}
+		if(::connect(_descriptor, (sockaddr*)&address->address, address->length) == 0) break;
+		if(errno == EINPROGRESS)
+		{
+			if(wait(POLLOUT, deadline))
+			{
+				int error = 0;
+				socklen_t errorLength = sizeof(error);
+				if(getsockopt(_descriptor, SOL_SOCKET, SO_ERROR, &error, &errorLength) == 0 && error == 0) break;
+				lastError = error;
+			}
+			else timedOut = true;
+		}
+		else lastError = errno;
+		::close(_descriptor);
+		_descriptor = -1;
+		if(timedOut) break;
+	}
+
+	if(_descriptor == -1)
+	{
+		if(timedOut)
+		{
+			if(_stats) _stats->connect.recordTimeout();
+			throw BaseLib::SocketTimeOutException("Connecting to " + _host + ":" + port + " timed out after " + std::to_string(_timeouts.connect) + " ms.");
+		}
+		throw BaseLib::SocketOperationException("Could not connect to " + _host + ":" + port + ": " + std::string(strerror(lastError)));
+	}
+	if(_stats) _stats->connect.record(BaseLib::HelperFunctions::getTime() - startTime);
+}
+
+void CameraConnection::handshake()
+{
+	int64_t startTime = BaseLib::HelperFunctions::getTime();
+	int64_t deadline = startTime + _timeouts.connect;
+
+	_credentials = _tlsSessionCache->getCredentials(_caFile, _verifyCertificate, &CameraConnection::verifyPeer);
+
+	if(gnutls_init(&_session, GNUTLS_CLIENT | GNUTLS_NONBLOCK) != GNUTLS_E_SUCCESS)
+	{
+		_session = nullptr;
+		throw BaseLib::SocketOperationException("Could not initialize TLS session.");
+	}
+	gnutls_set_default_priority(_session);
+	gnutls_credentials_set(_session, GNUTLS_CRD_CERTIFICATE, _credentials.get());
+	//Server name indication is only allowed for host names.
+	in6_addr address;
+	if(inet_pton(AF_INET, _host.c_str(), &address) != 1 && inet_pton(AF_INET6, _host.c_str(), &address) != 1) gnutls_server_name_set(_session, GNUTLS_NAME_DNS, _host.c_str(), _host.size());
+	gnutls_session_set_ptr(_session, this);
+	std::string sessionKey = _host + ":" + std::to_string(_port);
+	_tlsSessionCache->restoreSession(sessionKey, _session);
+	gnutls_transport_set_int(_session, _descriptor);
+
+	int result = 0;
+	while((result = gnutls_handshake(_session)) < 0)
+	{
+		if(gnutls_error_is_fatal(result))
+		{
+			_tlsSessionCache->removeSession(sessionKey);
+			throw BaseLib::SocketOperationException("TLS handshake with " + _host + " failed: " + std::string(gnutls_strerror(result)));
+		}
+		if(!wait(gnutls_record_get_direction(_session) == 1 ? POLLOUT : POLLIN, deadline))
+		{
+			if(_stats) _stats->tlsHandshake.recordTimeout();
+			throw BaseLib::SocketTimeOutException("TLS handshake with " + _host + " timed out after " + std::to_string(_timeouts.connect) + " ms.");
+		}
+	}
+	if(_stats) _stats->tlsHandshake.record(BaseLib::HelperFunctions::getTime() - startTime);
+	_tlsSessionCache->onHandshake(gnutls_session_is_resumed(_session) != 0);
+	_sessionSaved = false;
+}
+
+int CameraConnection::verifyPeer(gnutls_session_t session)
+{
+	try
+	{
+		CameraConnection* connection = (CameraConnection*)gnutls_session_get_ptr(session);
+		if(!connection) return GNUTLS_E_CERTIFICATE_ERROR;
+		unsigned int certificateCount = 0;
+		const gnutls_datum_t* certificates = gnutls_certificate_get_peers(session, &certificateCount);
+		if(!certificates || certificateCount == 0) return GNUTLS_E_CERTIFICATE_ERROR;
+
+		//A chain is only trusted for the host it was verified for.
+		std::string chain = connection->_host;
+		for(unsigned int i = 0; i < certificateCount; i++)
+		{
+			chain.push_back('\0');
+			chain.append((const char*)certificates[i].data, certificates[i].size);
+		}
+		std::array<uint8_t, 32> digest;
+		if(gnutls_hash_fast(GNUTLS_DIG_SHA256, chain.data(), chain.size(), digest.data()) < 0) return GNUTLS_E_CERTIFICATE_ERROR;
+		std::string fingerprint((const char*)digest.data(), digest.size());
+		int64_t time = BaseLib::HelperFunctions::getTime();
+		if(connection->_tlsSessionCache->isVerified(fingerprint, time)) return 0;
+
+		unsigned int status = 0;
+		if(gnutls_certificate_verify_peers3(session, connection->_host.c_str(), &status) < 0) return GNUTLS_E_CERTIFICATE_ERROR;
+		if(status != 0)
+		{
+			gnutls_datum_t description{ nullptr, 0 };
+			if(gnutls_certificate_verification_status_print(status, gnutls_certificate_type_get(session), &description, 0) >= 0)
+			{
+				GD::out.printWarning("Warning: Certificate of " + connection->_host + " is not valid: " + std::string((const char*)description.data));
+				gnutls_free(description.data);
+			}
+			return GNUTLS_E_CERTIFICATE_ERROR;
+		}
+
+		//Verify again when a certificate of the chain expires.
+		int64_t notAfter = INT64_MAX;
+		for(unsigned int i = 0; i < certificateCount; i++)
+		{
+			gnutls_x509_crt_t certificate = nullptr;
+			if(gnutls_x509_crt_init(&certificate) < 0) continue;
+			if(gnutls_x509_crt_import(certificate, &certificates[i], GNUTLS_X509_FMT_DER) >= 0)
+			{
+				int64_t expirationTime = (int64_t)gnutls_x509_crt_get_expiration_time(certificate) * 1000;
+				if(expirationTime > 0 && expirationTime < notAfter) notAfter = expirationTime;
+			}
+			gnutls_x509_crt_deinit(certificate);
+		}
+		connection->_tlsSessionCache->setVerified(fingerprint, notAfter, time);
+		return 0;
+	}
+	catch(const std::exception& ex)
+	{
+		GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+	}
+	return GNUTLS_E_CERTIFICATE_ERROR;
+}
+
+bool CameraConnection::wait(short events, int64_t deadline)
+{
+	while(true)
+	{
+		int64_t timeout = deadline - BaseLib::HelperFunctions::getTime();
+		if(timeout <= 0) return false;
+		pollfd descriptor{ _descriptor, events, 0 };
+		int result = poll(&descriptor, 1, (int)timeout);
+		if(result > 0) return true;
+		if(result == -1 && errno != EINTR) throw BaseLib::SocketOperationException(std::string("poll failed: ") + strerror(errno));
+	}
+}
+
+void CameraConnection::write(const char* data, size_t size)
+{
+	if(_descriptor == -1) throw BaseLib::SocketClosedException("Connection to " + _host + " is closed.");
+	int64_t deadline = BaseLib::HelperFunctions::getTime() + _timeouts.idle;
+	size_t written = 0;
+	while(written < size)
+	{
+		ssize_t result = _session ? gnutls_record_send(_session, data + written, size - written) : send(_descriptor, data + written, size - written, MSG_NOSIGNAL);
+		if(result > 0)
+		{
+			written += result;
+			deadline = BaseLib::HelperFunctions::getTime() + _timeouts.idle;
+			continue;
+		}
+		bool again = _session ? (result == GNUTLS_E_AGAIN || result == GNUTLS_E_INTERRUPTED) : (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR);
+		if(!again) throw BaseLib::SocketOperationException("Could not write to " + _host + ": " + std::string(_session ? gnutls_strerror(result) : strerror(errno)));
+		if(!wait(POLLOUT, deadline))
+		{
+			if(_stats) _stats->idleTimeouts++;
+			throw BaseLib::SocketTimeOutException("Writing to " + _host + " timed out after " + std::to_string(_timeouts.idle) + " ms.");
+		}
+	}
+	_waitingForFirstByte = true;
+	_requestTime = BaseLib::HelperFunctions::getTime();
+	_deadline = _requestTime + _timeouts.firstByte;
+}
+
+size_t CameraConnection::read(char* buffer, size_t size, int32_t maxWait)
+{
+	if(_descriptor == -1) throw BaseLib::SocketClosedException("Connection to " + _host + " is closed.");
+	if(_deadline == 0) _deadline = BaseLib::HelperFunctions::getTime() + _timeouts.idle;
+	while(true)
+	{
+		ssize_t result = _session ? gnutls_record_recv(_session, buffer, size) : recv(_descriptor, buffer, size, 0);
+		if(result > 0)
+		{
+			int64_t time = BaseLib::HelperFunctions::getTime();
+			if(_waitingForFirstByte)
+			{
+				_waitingForFirstByte = false;
+				if(_stats) _stats->firstByte.record(time - _requestTime);
+			}
+			if(_session && !_sessionSaved)
+			{
+				//With TLS 1.3 the session ticket arrives after the handshake, so wait for the first record.
+				_sessionSaved = true;
+				_tlsSessionCache->saveSession(_host + ":" + std::to_string(_port), _session);
+			}
+			_deadline = time + _timeouts.idle;
+			return result;
+		}
+		if(result == 0 || (_session && result == GNUTLS_E_PREMATURE_TERMINATION)) throw BaseLib::SocketClosedException("Connection closed by " + _host + ".");
+		bool again = _session ? (result == GNUTLS_E_AGAIN || result == GNUTLS_E_INTERRUPTED) : (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR);
+		if(!again) throw BaseLib::SocketOperationException("Could not read from " + _host + ": " + std::string(_session ? gnutls_strerror(result) : strerror(errno)));
+
+		int64_t time = BaseLib::HelperFunctions::getTime();
+		if(time >= _deadline)
+		{
+			if(_waitingForFirstByte)
+			{
+				if(_stats) _stats->firstByte.recordTimeout();
+				throw BaseLib::SocketTimeOutException("No response from " + _host + " within " + std::to_string(_timeouts.firstByte) + " ms.");
+			}
+			if(_stats) _stats->idleTimeouts++;
+			throw BaseLib::SocketTimeOutException("No data from " + _host + " within " + std::to_string(_timeouts.idle) + " ms.");
+		}
+		int64_t deadline = (maxWait >= 0 && time + maxWait < _deadline) ? time + maxWait : _deadline;
+		if(!wait(POLLIN, deadline) && deadline != _deadline) return 0;
+	}
+}
+
+void CameraConnection::sendRequest(const std::string& request, BaseLib::Http& response)
+{
+	try
+	{
+		if(!isOpen()) open();
+		write(request);
+		std::vector<char> buffer(16384);
+		while(!response.isFinished())
+		{
+			size_t bytesRead = 0;
+			try
+			{
+				bytesRead = read(buffer.data(), buffer.size());
+			}
+			catch(const BaseLib::SocketClosedException& ex)
+			{
+				//Without Content-Length the body ends when the camera closes the connection.
+				if(!response.headerIsFinished() || (response.getHeader().contentLength > 0 && response.getContentSize() < response.getHeader().contentLength)) throw;
+				response.setFinished();
+				break;
+			}
+			if(response.getContentSize() + bytesRead > _maxResponseSize)
+			{
+				close();
+				throw BaseLib::HttpClientException("Response of " + _host + " is too large.", response.getHeader().responseCode);
+			}
+			response.process(buffer.data(), bytesRead);
+		}
+	}
+	catch(const BaseLib::SocketOperationException& ex)
+	{
+		close();
+		throw BaseLib::HttpClientException("Unable to get response from " + _host + ": " + std::string(ex.what()), -1);
+	}
+	close();
+}
+
+}
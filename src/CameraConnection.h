@@ -0,0 +1,146 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+#ifndef CAMERACONNECTION_H_
+#define CAMERACONNECTION_H_
+
+#include "LatencyHistogram.h"
+#include "TlsSessionCache.h"
+
+#include <homegear-base/BaseLib.h>
+
+#include <gnutls/gnutls.h>
+
+#include <memory>
+#include <string>
+
+namespace IpCam
+{
+
+/**
+ * Client connection to a camera using non-blocking I/O, so every phase is bounded by its own timeout: Connecting (TCP
+ * connect and TLS handshake), waiting for the first byte of the response and waiting for further data. The duration of
+ * each phase is recorded in the camera's statistics.
+ *
+ * Errors are reported with BaseLib's socket exceptions. Not thread safe.
+ */
+class CameraConnection
+{
+public:
+	/**
+	 * All values in milliseconds.
+	 */
+	struct Timeouts
+	{
+		int32_t connect = 5000;
+		int32_t firstByte = 10000;
+		int32_t idle = 30000;
+	};
+
+	struct Stats
+	{
+		LatencyHistogram connect;
+		LatencyHistogram tlsHandshake;
+		LatencyHistogram firstByte;
+		std::atomic<uint64_t> idleTimeouts{0};
+	};
+	typedef std::shared_ptr<Stats> PStats;
+
+	/**
+	 * @param stats Optional.
+	 * @param tlsSessionCache The TLS state of the camera. Optional, without it every connection does a full handshake.
+	 */
+	CameraConnection(const std::string& host, int32_t port, bool ssl, const std::string& caFile, bool verifyCertificate, const Timeouts& timeouts, const PStats& stats, const std::shared_ptr<TlsSessionCache>& tlsSessionCache);
+	virtual ~CameraConnection();
+
+	void open();
+	void close();
+	bool isOpen() { return _descriptor != -1; }
+
+	/**
+	 * Writes all data. The first-byte timeout starts when the write finished.
+	 */
+	void write(const char* data, size_t size);
+	void write(const std::string& data) { write(data.data(), data.size()); }
+
+	/**
+	 * Waits at most "maxWait" milliseconds (-1 for the full timeout) for data.
+	 *
+	 * @return The number of bytes read or 0 when "maxWait" elapsed without data.
+	 * @throws SocketTimeOutException when the first-byte or idle timeout elapsed.
+	 * @throws SocketClosedException when the camera closed the connection.
+	 */
+	size_t read(char* buffer, size_t size, int32_t maxWait = -1);
+
+	/**
+	 * Sends a request and reads the complete response. Like BaseLib::HttpClient, connection errors are reported as
+	 * HttpClientException with response code -1.
+	 */
+	void sendRequest(const std::string& request, BaseLib::Http& response);
+protected:
+	static const size_t _maxResponseSize = 10485760;
+
+	std::string _host;
+	int32_t _port = 80;
+	bool _ssl = false;
+	std::string _caFile;
+	bool _verifyCertificate = true;
+	Timeouts _timeouts;
+	PStats _stats;
+	std::shared_ptr<TlsSessionCache> _tlsSessionCache;
+
+	int _descriptor = -1;
+	TlsSessionCache::PCredentials _credentials;
+	gnutls_session_t _session = nullptr;
+	bool _sessionSaved = false;
+
+	bool _waitingForFirstByte = false;
+	int64_t _requestTime = 0;
+	int64_t _deadline = 0;
+
+	void connect();
+	void handshake();
+
+	/**
+	 * Certificate verification callback of the credentials. Chains verified for the host before are accepted without
+	 * validating them again.
+	 */
+	static int verifyPeer(gnutls_session_t session);
+
+	/**
+	 * Waits until the socket is ready for "events" or "deadline" is reached.
+	 *
+	 * @return Returns false on timeout.
+	 */
+	bool wait(short events, int64_t deadline);
+};
+
+}
+
+#endif
@@ -0,0 +1,116 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+#include "CircuitBreaker.h"
+
+namespace IpCam
+{
+
+CircuitBreaker::CircuitBreaker(StateCallback stateCallback) : _stateCallback(stateCallback)
+{
+}
+
+bool CircuitBreaker::allowRequest()
+{
+	std::lock_guard<std::mutex> breakerGuard(_mutex);
+	return !_open;
+}
+
+bool CircuitBreaker::isOpen()
+{
+	std::lock_guard<std::mutex> breakerGuard(_mutex);
+	return _open;
+}
+
+void CircuitBreaker::onSuccess()
+{
+	{
+		std::lock_guard<std::mutex> breakerGuard(_mutex);
+		_failures = 0;
+		if(!_open && _stateReported) return;
+		_open = false;
+		_stateReported = true;
+		_probeInterval = _minProbeInterval;
+	}
+	if(_stateCallback) _stateCallback(false);
+}
+
+void CircuitBreaker::onFailure()
+{
+	{
+		std::lock_guard<std::mutex> breakerGuard(_mutex);
+		if(_open || ++_failures < _failureThreshold) return;
+		_open = true;
+		_stateReported = true;
+		_probeInterval = _minProbeInterval;
+		_nextProbeTime = BaseLib::HelperFunctions::getTime() + _probeInterval;
+	}
+	if(_stateCallback) _stateCallback(true);
+}
+
+bool CircuitBreaker::probeDue(int64_t time)
+{
+	std::lock_guard<std::mutex> breakerGuard(_mutex);
+	if(!_open || _probing || time < _nextProbeTime) return false;
+	_probing = true;
+	return true;
+}
+
+void CircuitBreaker::onProbeResult(bool success)
+{
+	{
+		std::lock_guard<std::mutex> breakerGuard(_mutex);
+		_probing = false;
+		if(!success)
+		{
+			_probeInterval = _probeInterval * 2 > _maxProbeInterval ? _maxProbeInterval : _probeInterval * 2;
+			_nextProbeTime = BaseLib::HelperFunctions::getTime() + _probeInterval;
+			return;
+		}
+	}
+	onSuccess();
+}
+
+void CircuitBreaker::reset()
+{
+	std::lock_guard<std::mutex> breakerGuard(_mutex);
+	_open = false;
+	_stateReported = false;
+	_failures = 0;
+	_probeInterval = _minProbeInterval;
+}
+
+int32_t CircuitBreaker::retryAfter(int64_t time)
+{
+	std::lock_guard<std::mutex> breakerGuard(_mutex);
+	int64_t delay = _nextProbeTime - time;
+	return delay > 1000 ? (int32_t)((delay + 999) / 1000) : 1;
+}
+
+}
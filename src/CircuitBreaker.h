@@ -0,0 +1,113 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+#ifndef CIRCUITBREAKER_H_
+#define CIRCUITBREAKER_H_
+
+#include <homegear-base/BaseLib.h>
+
+#include <functional>
+#include <mutex>
+
+namespace IpCam
+{
+
+class CircuitOpenException : public BaseLib::Exception
+{
+public:
+	CircuitOpenException(const std::string& message) : BaseLib::Exception(message) {}
+};
+
+/**
+ * Tracks whether a camera is reachable. After _failureThreshold consecutive connection failures the breaker opens and
+ * requests fail immediately instead of waiting for the connection timeout. While open, the owner probes the camera in
+ * the background when probeDue() returns true. The delay between probes doubles after every failed probe. The first
+ * successful probe or request closes the breaker again.
+ */
+class CircuitBreaker
+{
+public:
+	/**
+	 * Called without holding the breaker's mutex when the breaker opens (true) or closes (false).
+	 */
+	typedef std::function<void(bool open)> StateCallback;
+
+	CircuitBreaker(StateCallback stateCallback);
+	virtual ~CircuitBreaker() {}
+
+	/**
+	 * Returns false while the breaker is open.
+	 */
+	bool allowRequest();
+	bool isOpen();
+
+	/**
+	 * Call after the camera accepted a connection and answered, regardless of the response code. The first success also
+	 * calls the state callback, so a state persisted before a restart is cleared.
+	 */
+	void onSuccess();
+
+	/**
+	 * Call when the camera could not be connected to or didn't answer.
+	 */
+	void onFailure();
+
+	/**
+	 * Returns true when the breaker is open and the next probe is due. The probe is considered started then.
+	 */
+	bool probeDue(int64_t time);
+	void onProbeResult(bool success);
+
+	/**
+	 * Returns the number of seconds until the next probe for "Retry-After" (at least 1).
+	 */
+	int32_t retryAfter(int64_t time);
+
+	/**
+	 * Closes the breaker without reporting a state, e. g. after the camera's address changed.
+	 */
+	void reset();
+protected:
+	static const uint32_t _failureThreshold = 3;
+	static const int64_t _minProbeInterval = 5000;
+	static const int64_t _maxProbeInterval = 300000;
+
+	StateCallback _stateCallback;
+	std::mutex _mutex;
+	bool _open = false;
+	bool _stateReported = false;
+	uint32_t _failures = 0;
+	bool _probing = false;
+	int64_t _probeInterval = _minProbeInterval;
+	int64_t _nextProbeTime = 0;
+};
+
+}
+
+#endif
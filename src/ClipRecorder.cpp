@@ -0,0 +1,134 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+#include "ClipRecorder.h"
+#include "GD.h"
+#include "RecordingCatalogue.h"
+#include "RecordingWriter.h"
+
+namespace IpCam
+{
+
+ClipRecorder::ClipRecorder(uint64_t peerId, const std::string& directory, uint32_t maxDuration, const ClipCallback& callback) : _peerId(peerId), _directory(directory), _maxDuration(maxDuration), _callback(callback)
+{
+}
+
+ClipRecorder::~ClipRecorder()
+{
+	stop();
+}
+
+bool ClipRecorder::isRecording()
+{
+	std::lock_guard<std::mutex> segmentGuard(_segmentMutex);
+	return (bool)_segment;
+}
+
+void ClipRecorder::write(const Frame& frame)
+{
+	if(frame.sequence() <= _lastSequence) return;
+	_lastSequence = frame.sequence();
+	GD::recordingWriter->write(_segment, frame);
+}
+
+void ClipRecorder::onFrame(const Frame& frame)
+{
+	try
+	{
+		std::lock_guard<std::mutex> segmentGuard(_segmentMutex);
+		if(!_segment) return;
+		if(frame.time() - _startTime >= _maxDuration)
+		{
+			closeSegment();
+			return;
+		}
+		write(frame);
+	}
+	catch(const std::exception& ex)
+	{
+		GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+	}
+}
+
+void ClipRecorder::start(const std::shared_ptr<FrameBuffer>& frameBuffer, int64_t preRollStartTime)
+{
+	try
+	{
+		std::lock_guard<std::mutex> segmentGuard(_segmentMutex);
+		if(_segment) return;
+		_startTime = BaseLib::HelperFunctions::getTime();
+		_segment = std::make_shared<Segment>(_directory + Segment::getTimeString(_startTime));
+		if(GD::bl->debugLevel >= 4) GD::out.printInfo("Info: Starting clip " + _segment->dataPath() + ".");
+
+		if(frameBuffer)
+		{
+			std::vector<Frame> frames;
+			frames.reserve(frameBuffer->size());
+			frameBuffer->getFrames(preRollStartTime, _startTime, frames);
+			for(std::vector<Frame>::iterator i = frames.begin(); i != frames.end(); ++i)
+			{
+				write(*i);
+			}
+		}
+	}
+	catch(const std::exception& ex)
+	{
+		GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+	}
+}
+
+void ClipRecorder::stop()
+{
+	try
+	{
+		std::lock_guard<std::mutex> segmentGuard(_segmentMutex);
+		closeSegment();
+	}
+	catch(const std::exception& ex)
+	{
+		GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+	}
+}
+
+void ClipRecorder::closeSegment()
+{
+	if(!_segment) return;
+	ClipCallback callback = _callback;
+	uint64_t peerId = _peerId;
+	GD::recordingWriter->close(_segment, [callback, peerId](const std::shared_ptr<Segment>& segment)
+	{
+		if(segment->frameCount() == 0) return;
+		if(GD::bl->debugLevel >= 4) GD::out.printInfo("Info: Clip " + segment->dataPath() + " was closed after " + std::to_string(segment->frameCount()) + " frames.");
+		if(GD::recordingCatalogue) GD::recordingCatalogue->add(peerId, *segment);
+		if(callback) callback(segment->dataPath(), segment->endTime() - segment->startTime());
+	});
+	_segment.reset();
+}
+
+}
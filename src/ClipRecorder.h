@@ -0,0 +1,86 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+#ifndef CLIPRECORDER_H_
+#define CLIPRECORDER_H_
+
+#include "FrameBuffer.h"
+#include "Segment.h"
+
+#include <functional>
+
+namespace IpCam
+{
+
+/**
+ * Records motion clips. A clip starts with the frames of the pre-motion buffer and ends when stop() is called or the
+ * maximum duration is reached.
+ */
+class ClipRecorder : public StreamHub::IConsumer
+{
+public:
+	/**
+	 * Called from the recording writer thread when a clip was closed. The duration is in milliseconds.
+	 */
+	typedef std::function<void(const std::string& path, int64_t duration)> ClipCallback;
+
+	ClipRecorder(uint64_t peerId, const std::string& directory, uint32_t maxDuration, const ClipCallback& callback);
+	virtual ~ClipRecorder();
+
+	virtual void onFrame(const Frame& frame);
+
+	const std::string& directory() { return _directory; }
+	uint32_t maxDuration() { return _maxDuration; }
+	bool isRecording();
+
+	/**
+	 * Starts a new clip unless a clip is already being recorded.
+	 *
+	 * @param frameBuffer The pre-motion buffer or nullptr.
+	 * @param preRollStartTime Frames from the buffer starting at this time are added to the clip.
+	 */
+	void start(const std::shared_ptr<FrameBuffer>& frameBuffer, int64_t preRollStartTime);
+	void stop();
+protected:
+	std::mutex _segmentMutex;
+	uint64_t _peerId = 0;
+	std::string _directory;
+	uint32_t _maxDuration = 0;
+	ClipCallback _callback;
+	std::shared_ptr<Segment> _segment;
+	int64_t _startTime = 0;
+	uint64_t _lastSequence = 0;
+
+	void write(const Frame& frame);
+	void closeSegment();
+};
+
+}
+
+#endif
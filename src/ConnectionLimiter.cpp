@@ -0,0 +1,154 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+#include "ConnectionLimiter.h"
+#include "GD.h"
+
+#include <iomanip>
+
+namespace IpCam
+{
+
+ConnectionLimiter::ConnectionLimiter(uint32_t limit) : _limit(limit)
+{
+}
+
+void ConnectionLimiter::setPeerLimit(uint64_t peerId, uint32_t limit)
+{
+	std::lock_guard<std::mutex> limiterGuard(_mutex);
+	_peers[peerId].limit = limit;
+	dispatch();
+}
+
+void ConnectionLimiter::removePeer(uint64_t peerId)
+{
+	std::lock_guard<std::mutex> limiterGuard(_mutex);
+	std::map<uint64_t, PeerState>::iterator peerIterator = _peers.find(peerId);
+	//Keep the state while it is in use. It is reused when the peer is created again.
+	if(peerIterator != _peers.end() && peerIterator->second.active == 0 && peerIterator->second.queue.empty()) _peers.erase(peerIterator);
+}
+
+ConnectionLimiter::PPermit ConnectionLimiter::acquire(uint64_t peerId, uint32_t timeout)
+{
+	std::unique_lock<std::mutex> limiterGuard(_mutex);
+	PeerState& peer = _peers[peerId];
+	//Waiting requests are admitted on every release, so free capacity means nobody else is waiting for it.
+	if(peer.queue.empty() && (peer.limit == 0 || peer.active < peer.limit) && (_limit == 0 || _active < _limit))
+	{
+		peer.active++;
+		_active++;
+		peer.granted++;
+		return PPermit(new Permit(shared_from_this(), peerId));
+	}
+
+	Waiter waiter;
+	int64_t startTime = BaseLib::HelperFunctions::getTime();
+	peer.queue.push_back(&waiter);
+	if(peer.queue.size() == 1) _rotation.push_back(peerId);
+	if(peer.queue.size() > peer.maxQueueSize) peer.maxQueueSize = peer.queue.size();
+	peer.queued++;
+	_queueSize++;
+	waiter.conditionVariable.wait_for(limiterGuard, std::chrono::milliseconds(timeout), [&] { return waiter.granted; });
+	peer.waitTime += BaseLib::HelperFunctions::getTime() - startTime;
+	if(waiter.granted) return PPermit(new Permit(shared_from_this(), peerId));
+
+	for(std::deque<Waiter*>::iterator i = peer.queue.begin(); i != peer.queue.end(); ++i)
+	{
+		if(*i == &waiter)
+		{
+			peer.queue.erase(i);
+			break;
+		}
+	}
+	if(peer.queue.empty()) _rotation.remove(peerId);
+	_queueSize--;
+	peer.rejected++;
+	_rejected++;
+	if(GD::bl->debugLevel >= 4) GD::out.printInfo("Info: Rejecting connection to camera of peer " + std::to_string(peerId) + ": " + std::to_string(peer.active) + " of " + std::to_string(peer.limit) + " connections of this camera and " + std::to_string(_active) + " of " + std::to_string(_limit) + " connections in total are in use.");
+	return PPermit();
+}
+
+void ConnectionLimiter::release(uint64_t peerId)
+{
+	std::lock_guard<std::mutex> limiterGuard(_mutex);
+	std::map<uint64_t, PeerState>::iterator peerIterator = _peers.find(peerId);
+	if(peerIterator != _peers.end() && peerIterator->second.active > 0) peerIterator->second.active--;
+	if(_active > 0) _active--;
+	dispatch();
+}
+
+void ConnectionLimiter::dispatch()
+{
+	for(std::list<uint64_t>::iterator i = _rotation.begin(); i != _rotation.end() && (_limit == 0 || _active < _limit);)
+	{
+		PeerState& peer = _peers[*i];
+		if(peer.queue.empty())
+		{
+			i = _rotation.erase(i);
+			continue;
+		}
+		if(peer.limit != 0 && peer.active >= peer.limit)
+		{
+			++i;
+			continue;
+		}
+
+		Waiter* waiter = peer.queue.front();
+		peer.queue.pop_front();
+		waiter->granted = true;
+		waiter->conditionVariable.notify_one();
+		peer.active++;
+		peer.granted++;
+		_active++;
+		_queueSize--;
+
+		//Move the camera to the end of the rotation.
+		uint64_t peerId = *i;
+		i = _rotation.erase(i);
+		if(!peer.queue.empty()) _rotation.push_back(peerId);
+	}
+}
+
+std::string ConnectionLimiter::getStats()
+{
+	std::lock_guard<std::mutex> limiterGuard(_mutex);
+	std::stringstream stringStream;
+	stringStream << "Connections: " << _active << " of " << (_limit == 0 ? std::string("unlimited") : std::to_string(_limit)) << std::endl;
+	stringStream << "Waiting: " << _queueSize << std::endl;
+	stringStream << "Rejected: " << _rejected << std::endl << std::endl;
+	stringStream << std::left << std::setw(10) << "ID" << std::setw(8) << "Active" << std::setw(8) << "Limit" << std::setw(9) << "Waiting" << std::setw(11) << "Max. wait" << std::setw(12) << "Admitted" << std::setw(12) << "Queued" << std::setw(12) << "Rejected" << "Avg. wait (ms)" << std::endl;
+	for(std::map<uint64_t, PeerState>::iterator i = _peers.begin(); i != _peers.end(); ++i)
+	{
+		PeerState& peer = i->second;
+		stringStream << std::setw(10) << i->first << std::setw(8) << peer.active << std::setw(8) << (peer.limit == 0 ? std::string("-") : std::to_string(peer.limit)) << std::setw(9) << peer.queue.size() << std::setw(11) << peer.maxQueueSize << std::setw(12) << peer.granted << std::setw(12) << peer.queued << std::setw(12) << peer.rejected << (peer.queued > 0 ? peer.waitTime / (int64_t)peer.queued : 0) << std::endl;
+	}
+	return stringStream.str();
+}
+
+}
@@ -0,0 +1,139 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+#ifndef CONNECTIONLIMITER_H_
+#define CONNECTIONLIMITER_H_
+
+#include <homegear-base/BaseLib.h>
+
+#include <condition_variable>
+#include <deque>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+namespace IpCam
+{
+
+class ConnectionLimitException : public BaseLib::Exception
+{
+public:
+	ConnectionLimitException(const std::string& message) : BaseLib::Exception(message) {}
+};
+
+/**
+ * Limits the number of concurrent upstream connections per camera and in total. Requests exceeding a limit wait in a
+ * queue per camera. Free connections are handed to the queued cameras round robin, so one busy camera can't starve the
+ * others. Requests not admitted before their deadline are rejected.
+ */
+class ConnectionLimiter : public std::enable_shared_from_this<ConnectionLimiter>
+{
+public:
+	/**
+	 * Releases the connection slot on destruction.
+	 */
+	class Permit
+	{
+	public:
+		Permit(const std::shared_ptr<ConnectionLimiter>& limiter, uint64_t peerId) : _limiter(limiter), _peerId(peerId) {}
+		virtual ~Permit() { _limiter->release(_peerId); }
+	private:
+		Permit(const Permit&) = delete;
+		Permit& operator=(const Permit&) = delete;
+
+		std::shared_ptr<ConnectionLimiter> _limiter;
+		uint64_t _peerId = 0;
+	};
+	typedef std::unique_ptr<Permit> PPermit;
+
+	/**
+	 * @param limit The maximum number of connections to all cameras. 0 disables the limit.
+	 */
+	ConnectionLimiter(uint32_t limit);
+	virtual ~ConnectionLimiter() {}
+
+	/**
+	 * Sets the maximum number of connections to one camera. 0 disables the limit.
+	 */
+	void setPeerLimit(uint64_t peerId, uint32_t limit);
+	void removePeer(uint64_t peerId);
+
+	/**
+	 * Waits until a connection to the camera is allowed.
+	 *
+	 * @param timeout The maximum time to wait in milliseconds.
+	 * @return Returns nullptr when the deadline passed.
+	 */
+	PPermit acquire(uint64_t peerId, uint32_t timeout);
+
+	std::string getStats();
+protected:
+	struct Waiter
+	{
+		bool granted = false;
+		std::condition_variable conditionVariable;
+	};
+
+	struct PeerState
+	{
+		uint32_t limit = 0;
+		uint32_t active = 0;
+		std::deque<Waiter*> queue;
+		size_t maxQueueSize = 0;
+		uint64_t granted = 0;
+		uint64_t queued = 0;
+		uint64_t rejected = 0;
+		int64_t waitTime = 0;
+	};
+
+	std::mutex _mutex;
+	uint32_t _limit = 0;
+	uint32_t _active = 0;
+	size_t _queueSize = 0;
+	uint64_t _rejected = 0;
+	std::map<uint64_t, PeerState> _peers;
+
+	/**
+	 * Cameras with waiting requests in the order they are served.
+	 */
+	std::list<uint64_t> _rotation;
+
+	void release(uint64_t peerId);
+
+	/**
+	 * Admits waiting requests while connections are free. _mutex must be locked.
+	 */
+	void dispatch();
+};
+
+}
+
+#endif
@@ -0,0 +1,100 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+#include "ContinuousRecorder.h"
+#include "FrameHash.h"
+#include "GD.h"
+#include "RecordingCatalogue.h"
+
+namespace IpCam
+{
+
+ContinuousRecorder::ContinuousRecorder(uint64_t peerId, const std::string& directory, uint32_t segmentDuration, int32_t duplicateDistance) : _peerId(peerId), _directory(directory), _segmentDuration(segmentDuration), _duplicateDistance(duplicateDistance)
+{
+}
+
+ContinuousRecorder::~ContinuousRecorder()
+{
+	stop();
+}
+
+void ContinuousRecorder::onFrame(const Frame& frame)
+{
+	try
+	{
+		std::lock_guard<std::mutex> segmentGuard(_segmentMutex);
+		if(frame.sequence() <= _lastSequence) return;
+		_lastSequence = frame.sequence();
+		if(_segment && frame.time() - _segmentStartTime >= _segmentDuration) closeSegment();
+		if(!_segment)
+		{
+			_segmentStartTime = frame.time() - (frame.time() % _segmentDuration);
+			_segment = std::make_shared<Segment>(_directory + Segment::getTimeString(frame.time()));
+			if(GD::bl->debugLevel >= 5) GD::out.printDebug("Debug: Starting segment " + _segment->dataPath() + ".");
+		}
+		else if(_duplicateDistance >= 0 && _lastRecordedFrame && frame.time() - _lastRecordedFrame.time() < _duplicateInterval && FrameHash::similar(frame, _lastRecordedFrame, _duplicateDistance))
+		{
+			_skippedFrames++;
+			return;
+		}
+		if(_duplicateDistance >= 0) _lastRecordedFrame = frame;
+		GD::recordingWriter->write(_segment, frame);
+	}
+	catch(const std::exception& ex)
+	{
+		GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+	}
+}
+
+void ContinuousRecorder::stop()
+{
+	try
+	{
+		std::lock_guard<std::mutex> segmentGuard(_segmentMutex);
+		closeSegment();
+	}
+	catch(const std::exception& ex)
+	{
+		GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+	}
+}
+
+void ContinuousRecorder::closeSegment()
+{
+	if(!_segment) return;
+	uint64_t peerId = _peerId;
+	GD::recordingWriter->close(_segment, [peerId](const std::shared_ptr<Segment>& segment)
+	{
+		if(GD::recordingCatalogue) GD::recordingCatalogue->add(peerId, *segment);
+	});
+	_segment.reset();
+	_lastRecordedFrame.reset();
+}
+
+}
@@ -0,0 +1,86 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+#ifndef CONTINUOUSRECORDER_H_
+#define CONTINUOUSRECORDER_H_
+
+#include "Segment.h"
+#include "StreamHub.h"
+
+namespace IpCam
+{
+
+/**
+ * Records all frames of a stream hub into segments of a fixed duration. Segments start at multiples of the segment duration,
+ * so recordings of different cameras are aligned. Closed segments are added to the recording catalogue.
+ */
+class ContinuousRecorder : public StreamHub::IConsumer
+{
+public:
+	/**
+	 * @param segmentDuration The duration of one segment in milliseconds.
+	 * @param duplicateDistance Frames with a perceptual hash within this distance of the last recorded frame are only
+	 * recorded once per second. -1 records all frames.
+	 */
+	ContinuousRecorder(uint64_t peerId, const std::string& directory, uint32_t segmentDuration, int32_t duplicateDistance);
+	virtual ~ContinuousRecorder();
+
+	virtual void onFrame(const Frame& frame);
+
+	uint32_t segmentDuration() { return _segmentDuration; }
+	int32_t duplicateDistance() { return _duplicateDistance; }
+	uint64_t skippedFrames() { return _skippedFrames; }
+
+	/**
+	 * Closes the current segment.
+	 */
+	void stop();
+protected:
+	/**
+	 * Record at least one frame per second of static scenes.
+	 */
+	static const int64_t _duplicateInterval = 1000;
+
+	std::mutex _segmentMutex;
+	uint64_t _peerId = 0;
+	std::string _directory;
+	uint32_t _segmentDuration = 0;
+	int32_t _duplicateDistance = -1;
+	Frame _lastRecordedFrame;
+	std::atomic<uint64_t> _skippedFrames{0};
+	std::shared_ptr<Segment> _segment;
+	int64_t _segmentStartTime = 0;
+	uint64_t _lastSequence = 0;
+
+	void closeSegment();
+};
+
+}
+
+#endif
@@ -0,0 +1,281 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+#include "DnsCache.h"
+#include "GD.h"
+
+#include <cstring>
+#include <iomanip>
+#include <sstream>
+
+#include <arpa/inet.h>
+#include <netdb.h>
+
+namespace IpCam
+{
+
+DnsCache::DnsCache(uint32_t ttl, uint32_t negativeTtl) : _ttl((int64_t)ttl * 1000), _negativeTtl((int64_t)negativeTtl * 1000)
+{
+}
+
+DnsCache::~DnsCache()
+{
+	stop();
+}
+
+int DnsCache::lookup(const std::string& host, int flags, std::vector<Address>& addresses)
+{
+	addrinfo hints{};
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+	hints.ai_flags = flags;
+	addrinfo* result = nullptr;
+	int error = getaddrinfo(host.c_str(), nullptr, &hints, &result);
+	if(error != 0) return error;
+	for(addrinfo* info = result; info; info = info->ai_next)
+	{
+		if(info->ai_addrlen > sizeof(sockaddr_storage)) continue;
+		Address address;
+		std::memcpy(&address.address, info->ai_addr, info->ai_addrlen);
+		address.length = info->ai_addrlen;
+		addresses.push_back(address);
+	}
+	freeaddrinfo(result);
+	return addresses.empty() ? EAI_NONAME : 0;
+}
+
+void DnsCache::setPort(std::vector<Address>& addresses, int32_t port)
+{
+	for(std::vector<Address>::iterator i = addresses.begin(); i != addresses.end(); ++i)
+	{
+		if(i->address.ss_family == AF_INET) ((sockaddr_in*)&i->address)->sin_port = htons((uint16_t)port);
+		else if(i->address.ss_family == AF_INET6) ((sockaddr_in6*)&i->address)->sin6_port = htons((uint16_t)port);
+	}
+}
+
+bool DnsCache::resolve(const std::string& host, int32_t port, std::vector<Address>& addresses, int64_t maxWait)
+{
+	addresses.clear();
+	//Most cameras are configured by IP address, which doesn't need a lookup.
+	if(lookup(host, AI_NUMERICHOST, addresses) == 0)
+	{
+		setPort(addresses, port);
+		return true;
+	}
+	addresses.clear();
+	if(_ttl == 0)
+	{
+		_lookups++;
+		if(lookup(host, 0, addresses) != 0)
+		{
+			_lookupFailures++;
+			return false;
+		}
+		setPort(addresses, port);
+		return true;
+	}
+
+	std::unique_lock<std::mutex> entriesGuard(_entriesMutex);
+	int64_t time = BaseLib::HelperFunctions::getTime();
+	Entry& entry = _entries[host];
+	entry.lastUsed = time;
+	if(entry.resolvedTime > 0 && (!entry.addresses.empty() || time < entry.expirationTime))
+	{
+		if(entry.addresses.empty())
+		{
+			_negativeHits++;
+			return false;
+		}
+		if(time >= entry.expirationTime)
+		{
+			_staleHits++;
+			enqueue(host, entry);
+		}
+		else _hits++;
+		addresses = entry.addresses;
+		setPort(addresses, port);
+		return true;
+	}
+
+	_misses++;
+	enqueue(host, entry);
+	if(!_lookupConditionVariable.wait_for(entriesGuard, std::chrono::milliseconds(maxWait > 0 ? maxWait : 0), [&] { return !entry.pending || _stopThreads; })) return false;
+	if(entry.pending || entry.addresses.empty()) return false;
+	addresses = entry.addresses;
+	setPort(addresses, port);
+	return true;
+}
+
+void DnsCache::prefetch(const std::string& host)
+{
+	if(host.empty() || _ttl == 0) return;
+	std::vector<Address> addresses;
+	if(lookup(host, AI_NUMERICHOST, addresses) == 0) return;
+	std::lock_guard<std::mutex> entriesGuard(_entriesMutex);
+	int64_t time = BaseLib::HelperFunctions::getTime();
+	Entry& entry = _entries[host];
+	entry.lastUsed = time;
+	if(entry.resolvedTime == 0 || time >= entry.expirationTime) enqueue(host, entry);
+}
+
+void DnsCache::enqueue(const std::string& host, Entry& entry)
+{
+	if(entry.pending || _stopThreads) return;
+	entry.pending = true;
+	_queue.push_back(host);
+	//Only start the threads when a host name is used
+	if(_threads.empty())
+	{
+		_threads.resize(_threadCount);
+		for(std::vector<std::thread>::iterator i = _threads.begin(); i != _threads.end(); ++i)
+		{
+			GD::bl->threadManager.start(*i, false, &DnsCache::worker, this);
+		}
+	}
+	_queueConditionVariable.notify_one();
+}
+
+void DnsCache::maintain(int64_t time)
+{
+	for(std::unordered_map<std::string, Entry>::iterator i = _entries.begin(); i != _entries.end();)
+	{
+		Entry& entry = i->second;
+		if(!entry.pending && time - entry.lastUsed > _ttl * _unusedEntryTtls)
+		{
+			i = _entries.erase(i);
+			continue;
+		}
+		//Refresh entries in use before they expire, so requests don't get stale addresses.
+		if(!entry.addresses.empty() && time - entry.lastUsed < _ttl && entry.expirationTime - time <= _ttl / 10) enqueue(i->first, entry);
+		++i;
+	}
+}
+
+void DnsCache::worker()
+{
+	while(true)
+	{
+		std::string host;
+		{
+			std::unique_lock<std::mutex> entriesGuard(_entriesMutex);
+			_queueConditionVariable.wait_for(entriesGuard, std::chrono::seconds(1), [&] { return !_queue.empty() || _stopThreads; });
+			if(_stopThreads) return;
+			int64_t time = BaseLib::HelperFunctions::getTime();
+			if(time - _lastMaintenance >= 1000)
+			{
+				_lastMaintenance = time;
+				maintain(time);
+			}
+			if(_queue.empty()) continue;
+			host = std::move(_queue.front());
+			_queue.pop_front();
+		}
+
+		std::vector<Address> addresses;
+		int error = lookup(host, 0, addresses);
+		_lookups++;
+		if(error != 0) _lookupFailures++;
+
+		{
+			std::lock_guard<std::mutex> entriesGuard(_entriesMutex);
+			std::unordered_map<std::string, Entry>::iterator entryIterator = _entries.find(host);
+			if(entryIterator != _entries.end())
+			{
+				Entry& entry = entryIterator->second;
+				int64_t time = BaseLib::HelperFunctions::getTime();
+				entry.pending = false;
+				entry.resolvedTime = time;
+				entry.error = error;
+				if(error == 0)
+				{
+					entry.addresses = std::move(addresses);
+					entry.expirationTime = time + _ttl;
+				}
+				else
+				{
+					entry.expirationTime = time + _negativeTtl;
+					if(entry.addresses.empty()) GD::out.printWarning("Warning: Could not resolve " + host + ": " + std::string(gai_strerror(error)));
+					else if(GD::bl->debugLevel >= 4) GD::out.printInfo("Info: Could not refresh address of " + host + ": " + std::string(gai_strerror(error)) + ". Keeping the previous addresses.");
+				}
+			}
+		}
+		_lookupConditionVariable.notify_all();
+	}
+}
+
+void DnsCache::stop()
+{
+	{
+		std::lock_guard<std::mutex> entriesGuard(_entriesMutex);
+		_stopThreads = true;
+		_queue.clear();
+	}
+	_queueConditionVariable.notify_all();
+	_lookupConditionVariable.notify_all();
+	for(std::vector<std::thread>::iterator i = _threads.begin(); i != _threads.end(); ++i)
+	{
+		GD::bl->threadManager.join(*i);
+	}
+}
+
+std::string DnsCache::getStats()
+{
+	std::ostringstream stringStream;
+	if(_ttl == 0) stringStream << "The DNS cache is disabled." << std::endl;
+	else stringStream << "TTL: " << (_ttl / 1000) << " s, failed lookups: " << (_negativeTtl / 1000) << " s" << std::endl;
+	stringStream << "Hits: " << _hits << ", stale: " << _staleHits << ", negative: " << _negativeHits << ", misses: " << _misses << std::endl;
+	stringStream << "Lookups: " << _lookups << ", failed: " << _lookupFailures << std::endl;
+
+	std::lock_guard<std::mutex> entriesGuard(_entriesMutex);
+	if(_entries.empty()) return stringStream.str();
+	stringStream << std::endl;
+	int64_t time = BaseLib::HelperFunctions::getTime();
+	for(std::unordered_map<std::string, Entry>::iterator i = _entries.begin(); i != _entries.end(); ++i)
+	{
+		const Entry& entry = i->second;
+		std::string state;
+		if(!entry.addresses.empty())
+		{
+			char address[INET6_ADDRSTRLEN] = "";
+			const sockaddr_storage& first = entry.addresses.front().address;
+			if(first.ss_family == AF_INET) inet_ntop(AF_INET, &((const sockaddr_in*)&first)->sin_addr, address, sizeof(address));
+			else if(first.ss_family == AF_INET6) inet_ntop(AF_INET6, &((const sockaddr_in6*)&first)->sin6_addr, address, sizeof(address));
+			state = std::string(address) + (entry.addresses.size() > 1 ? " (+" + std::to_string(entry.addresses.size() - 1) + ")" : "");
+		}
+		else if(entry.resolvedTime > 0) state = gai_strerror(entry.error);
+		else state = "-";
+		stringStream << std::left << std::setw(32) << i->first << std::setw(40) << state;
+		if(entry.pending) stringStream << "refreshing";
+		else if(entry.resolvedTime > 0) stringStream << (entry.expirationTime > time ? "expires in " + std::to_string((entry.expirationTime - time) / 1000) + " s" : "expired");
+		stringStream << std::endl;
+	}
+	return stringStream.str();
+}
+
+}
@@ -0,0 +1,143 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+#ifndef DNSCACHE_H_
+#define DNSCACHE_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <sys/socket.h>
+
+namespace IpCam
+{
+
+/**
+ * Host name cache shared by all cameras. Lookups run on background threads: Expired entries are still returned while
+ * they are refreshed and entries in use are refreshed shortly before they expire, so only the very first request for a
+ * host waits for the resolver. Failed lookups are cached for a shorter time. When a refresh fails, the previous addresses
+ * are kept.
+ *
+ * getaddrinfo() doesn't return the TTL of the records, so fixed TTLs are used.
+ */
+class DnsCache
+{
+public:
+	struct Address
+	{
+		sockaddr_storage address;
+		socklen_t length = 0;
+	};
+
+	/**
+	 * @param ttl Time in seconds addresses are used before they are refreshed. 0 disables the cache.
+	 * @param negativeTtl Time in seconds a failed lookup is cached.
+	 */
+	DnsCache(uint32_t ttl, uint32_t negativeTtl);
+	virtual ~DnsCache();
+
+	/**
+	 * Returns the addresses of "host" with "port" set. IP addresses are returned without lookup. On a cache miss, waits at
+	 * most "maxWait" milliseconds for the lookup.
+	 *
+	 * @return Returns false when the host could not be resolved (in time).
+	 */
+	bool resolve(const std::string& host, int32_t port, std::vector<Address>& addresses, int64_t maxWait);
+
+	/**
+	 * Starts a lookup of "host" in the background unless it is cached already.
+	 */
+	void prefetch(const std::string& host);
+
+	std::string getStats();
+	void stop();
+protected:
+	struct Entry
+	{
+		//Port 0
+		std::vector<Address> addresses;
+		int64_t resolvedTime = 0;
+		int64_t expirationTime = 0;
+		int64_t lastUsed = 0;
+		bool pending = false;
+		int error = 0;
+	};
+
+	static const uint32_t _threadCount = 2;
+
+	/**
+	 * Entries not used for this many TTLs are removed.
+	 */
+	static const int64_t _unusedEntryTtls = 2;
+	int64_t _ttl = 300000;
+	int64_t _negativeTtl = 30000;
+
+	std::mutex _entriesMutex;
+	std::condition_variable _queueConditionVariable;
+	std::condition_variable _lookupConditionVariable;
+	std::unordered_map<std::string, Entry> _entries;
+	std::deque<std::string> _queue;
+	std::vector<std::thread> _threads;
+	bool _stopThreads = false;
+	int64_t _lastMaintenance = 0;
+
+	std::atomic<uint64_t> _hits{0};
+	std::atomic<uint64_t> _staleHits{0};
+	std::atomic<uint64_t> _negativeHits{0};
+	std::atomic<uint64_t> _misses{0};
+	std::atomic<uint64_t> _lookups{0};
+	std::atomic<uint64_t> _lookupFailures{0};
+
+	/**
+	 * @return Returns 0 on success or the error code of getaddrinfo().
+	 */
+	static int lookup(const std::string& host, int flags, std::vector<Address>& addresses);
+	static void setPort(std::vector<Address>& addresses, int32_t port);
+
+	/**
+	 * _entriesMutex must be locked.
+	 */
+	void enqueue(const std::string& host, Entry& entry);
+
+	/**
+	 * Queues the refresh of entries expiring soon and removes unused ones. _entriesMutex must be locked.
+	 */
+	void maintain(int64_t time);
+	void worker();
+};
+
+}
+
+#endif
@@ -0,0 +1,118 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+#include "FrameBuffer.h"
+#include "GD.h"
+
+namespace IpCam
+{
+
+FrameBuffer::FrameBuffer(uint64_t peerId, uint32_t duration, uint32_t maxFrames) : _peerId(peerId), _duration(duration)
+{
+	_frames.resize(maxFrames > 0 ? maxFrames : 1);
+	GD::framePool->addBuffer();
+}
+
+FrameBuffer::~FrameBuffer()
+{
+	GD::framePool->removeBuffer();
+}
+
+size_t FrameBuffer::size()
+{
+	std::lock_guard<std::mutex> framesGuard(_framesMutex);
+	return _count;
+}
+
+void FrameBuffer::onFrame(const Frame& frame)
+{
+	std::lock_guard<std::mutex> framesGuard(_framesMutex);
+	if(_count == _frames.size()) popFront();
+	_frames[(_head + _count) % _frames.size()] = frame;
+	_bytes += frame.capacity();
+	_count++;
+
+	int64_t minTime = frame.time() - _duration;
+	while(_count > 0 && _frames[_head].time() < minTime) popFront();
+
+	size_t share = GD::framePool->bufferShare();
+	if(_bytes > share)
+	{
+		while(_count > 1 && _bytes > share) popFront();
+		if(frame.time() - _lastShareWarningTime >= 60000)
+		{
+			_lastShareWarningTime = frame.time();
+			GD::out.printWarning("Warning: Pre-motion buffer of peer " + std::to_string(_peerId) + " only holds " + std::to_string((frame.time() - _frames[_head].time()) / 1000) + " of " + std::to_string(_duration / 1000) + " seconds, because its share of the frame pool is " + std::to_string(share / 1048576) + " MiB. Consider increasing \"frameMemory\" in ipcam.conf or decreasing PRE_MOTION_BUFFER.");
+		}
+	}
+}
+
+void FrameBuffer::popFront()
+{
+	_bytes -= _frames[_head].capacity();
+	_frames[_head].reset();
+	_head = (_head + 1) % _frames.size();
+	_count--;
+}
+
+size_t FrameBuffer::lowerBound(int64_t time)
+{
+	size_t first = 0;
+	size_t count = _count;
+	while(count > 0)
+	{
+		size_t step = count / 2;
+		if(at(first + step).time() < time)
+		{
+			first += step + 1;
+			count -= step + 1;
+		}
+		else count = step;
+	}
+	return first;
+}
+
+void FrameBuffer::getFrames(int64_t startTime, int64_t endTime, std::vector<Frame>& frames)
+{
+	std::lock_guard<std::mutex> framesGuard(_framesMutex);
+	for(size_t i = lowerBound(startTime); i < _count && at(i).time() <= endTime; i++)
+	{
+		frames.push_back(at(i));
+	}
+}
+
+Frame FrameBuffer::getFrame(int64_t time)
+{
+	std::lock_guard<std::mutex> framesGuard(_framesMutex);
+	size_t index = lowerBound(time + 1);
+	if(index == 0) return Frame();
+	return at(index - 1);
+}
+
+}
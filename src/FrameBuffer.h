@@ -0,0 +1,88 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+#ifndef FRAMEBUFFER_H_
+#define FRAMEBUFFER_H_
+
+#include "StreamHub.h"
+
+namespace IpCam
+{
+
+/**
+ * Ring buffer holding the frames of the last few seconds of a stream, e. g. to include the time before a motion event
+ * in recordings. Frames are only referenced, but they pin their pool blocks. So the buffer is also limited to its share
+ * of the frame pool (see FramePool::bufferShare()) and drops its oldest frames when the share is used up.
+ */
+class FrameBuffer : public StreamHub::IConsumer
+{
+public:
+	/**
+	 * @param peerId The ID of the peer the buffer belongs to. Only used for logging.
+	 * @param duration The time span to keep in milliseconds.
+	 * @param maxFrames The maximum number of frames to keep.
+	 */
+	FrameBuffer(uint64_t peerId, uint32_t duration, uint32_t maxFrames);
+	virtual ~FrameBuffer();
+
+	virtual void onFrame(const Frame& frame);
+
+	uint32_t duration() { return _duration; }
+	size_t size();
+
+	/**
+	 * Returns all frames with a timestamp in the range [startTime, endTime] in chronological order.
+	 */
+	void getFrames(int64_t startTime, int64_t endTime, std::vector<Frame>& frames);
+
+	/**
+	 * Returns the newest frame with a timestamp smaller than or equal to "time".
+	 */
+	Frame getFrame(int64_t time);
+protected:
+	std::mutex _framesMutex;
+	uint64_t _peerId = 0;
+	uint32_t _duration = 0;
+	size_t _bytes = 0;
+	int64_t _lastShareWarningTime = 0;
+	std::vector<Frame> _frames;
+	size_t _head = 0;
+	size_t _count = 0;
+
+	/**
+	 * Removes the oldest frame. _framesMutex must be locked.
+	 */
+	void popFront();
+	size_t lowerBound(int64_t time);
+	Frame& at(size_t index) { return _frames[(_head + index) % _frames.size()]; }
+};
+
+}
+
+#endif
@@ -0,0 +1,140 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+#include "FrameHash.h"
+#include "GD.h"
+#include "JpegDecoder.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+namespace IpCam
+{
+
+namespace
+{
+
+uint32_t sumBytes(const uint8_t* data, size_t size)
+{
+	size_t i = 0;
+	uint32_t sum = 0;
+#if defined(__SSE2__)
+	__m128i sums = _mm_setzero_si128();
+	for(; i + 16 <= size; i += 16)
+	{
+		sums = _mm_add_epi64(sums, _mm_sad_epu8(_mm_loadu_si128((const __m128i*)(data + i)), _mm_setzero_si128()));
+	}
+	sum = _mm_cvtsi128_si32(sums) + _mm_cvtsi128_si32(_mm_srli_si128(sums, 8));
+#elif defined(__ARM_NEON)
+	uint64x2_t sums = vdupq_n_u64(0);
+	for(; i + 16 <= size; i += 16)
+	{
+		sums = vaddq_u64(sums, vpaddlq_u32(vpaddlq_u16(vpaddlq_u8(vld1q_u8(data + i)))));
+	}
+	sum = (uint32_t)(vgetq_lane_u64(sums, 0) + vgetq_lane_u64(sums, 1));
+#endif
+	for(; i < size; i++)
+	{
+		sum += data[i];
+	}
+	return sum;
+}
+
+}
+
+bool FrameHash::compute(const char* data, size_t size, uint64_t& hash)
+{
+	static const uint32_t columns = 9;
+	static const uint32_t rows = 8;
+
+	//Decoders are reused, so hashing doesn't allocate in steady state.
+	thread_local JpegDecoder decoder;
+	thread_local JpegDecoder::Image image;
+	if(!decoder.decode(data, size, true, 1, image) || image.width < columns || image.height < rows) return false;
+
+	uint32_t cells[rows][columns] = {};
+	uint32_t cellBoundaries[columns + 1];
+	for(uint32_t column = 0; column <= columns; column++)
+	{
+		cellBoundaries[column] = column * image.width / columns;
+	}
+	for(uint32_t y = 0; y < image.height; y++)
+	{
+		const uint8_t* row = image.pixels.data() + (size_t)y * image.width;
+		uint32_t cellRow = y * rows / image.height;
+		for(uint32_t column = 0; column < columns; column++)
+		{
+			cells[cellRow][column] += sumBytes(row + cellBoundaries[column], cellBoundaries[column + 1] - cellBoundaries[column]);
+		}
+	}
+
+	//Neighboring cells have the same height, but their widths can differ by one pixel. Compare the means.
+	hash = 0;
+	for(uint32_t row = 0; row < rows; row++)
+	{
+		for(uint32_t column = 0; column < columns - 1; column++)
+		{
+			uint64_t left = (uint64_t)cells[row][column] * (cellBoundaries[column + 2] - cellBoundaries[column + 1]);
+			uint64_t right = (uint64_t)cells[row][column + 1] * (cellBoundaries[column + 1] - cellBoundaries[column]);
+			hash <<= 1;
+			if(left > right) hash |= 1;
+		}
+	}
+	return true;
+}
+
+bool FrameHash::get(const Frame& frame, uint64_t& hash)
+{
+	try
+	{
+		int32_t state = frame.getCachedHash(hash);
+		if(state != 0) return state == 1;
+		bool valid = compute(frame.data(), frame.size(), hash);
+		frame.setCachedHash(valid ? hash : 0, valid);
+		return valid;
+	}
+	catch(const std::exception& ex)
+	{
+		GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+	}
+	return false;
+}
+
+bool FrameHash::similar(const Frame& frame1, const Frame& frame2, uint32_t maxDistance)
+{
+	uint64_t hash1 = 0;
+	uint64_t hash2 = 0;
+	if(!get(frame1, hash1) || !get(frame2, hash2)) return false;
+	return distance(hash1, hash2) <= maxDistance;
+}
+
+}
@@ -0,0 +1,70 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+#ifndef FRAMEHASH_H_
+#define FRAMEHASH_H_
+
+#include "FramePool.h"
+
+namespace IpCam
+{
+
+/**
+ * 64 bit perceptual hash (difference hash) of a frame. The frame is decoded at 1/8 scale (only the DC coefficients of the
+ * luma channel), averaged down to 9x8 cells and each bit is set when a cell is brighter than its right neighbor. Similar
+ * images have hashes with a small Hamming distance. The hash is computed once per frame and cached in the frame.
+ */
+class FrameHash
+{
+public:
+	/**
+	 * Returns the hash of the frame, computing it in the calling thread if necessary.
+	 *
+	 * @return Returns false when the frame could not be decoded.
+	 */
+	static bool get(const Frame& frame, uint64_t& hash);
+
+	static bool compute(const char* data, size_t size, uint64_t& hash);
+
+	/**
+	 * Returns the number of different bits.
+	 */
+	static uint32_t distance(uint64_t hash1, uint64_t hash2) { return __builtin_popcountll(hash1 ^ hash2); }
+
+	/**
+	 * Returns true when both frames have a hash and the distance is at most "maxDistance".
+	 */
+	static bool similar(const Frame& frame1, const Frame& frame2, uint32_t maxDistance);
+private:
+	FrameHash() = delete;
+};
+
+}
+
+#endif
@@ -0,0 +1,185 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+#include "FramePool.h"
+#include "GD.h"
+
+namespace IpCam
+{
+
+Frame::Frame(FrameBlock* block) : _block(block)
+{
+	if(_block) _block->refCount++;
+}
+
+Frame::Frame(const Frame& other) : _block(other._block)
+{
+	if(_block) _block->refCount++;
+}
+
+Frame::Frame(Frame&& other) noexcept : _block(other._block)
+{
+	other._block = nullptr;
+}
+
+Frame::~Frame()
+{
+	reset();
+}
+
+Frame& Frame::operator=(const Frame& other)
+{
+	if(_block == other._block) return *this;
+	if(other._block) other._block->refCount++;
+	reset();
+	_block = other._block;
+	return *this;
+}
+
+Frame& Frame::operator=(Frame&& other) noexcept
+{
+	if(this == &other) return *this;
+	reset();
+	_block = other._block;
+	other._block = nullptr;
+	return *this;
+}
+
+void Frame::reset()
+{
+	if(!_block) return;
+	if(--_block->refCount == 0) _block->pool->release(_block);
+	_block = nullptr;
+}
+
+int32_t Frame::getCachedHash(uint64_t& hash) const
+{
+	if(!_block) return 2;
+	int32_t state = _block->hashState.load(std::memory_order_acquire);
+	if(state == 1) hash = _block->hash.load(std::memory_order_relaxed);
+	return state;
+}
+
+void Frame::setCachedHash(uint64_t hash, bool valid) const
+{
+	if(!_block) return;
+	//Two threads might compute the hash at the same time. Both get the same result, so this is harmless.
+	_block->hash.store(hash, std::memory_order_relaxed);
+	_block->hashState.store(valid ? 1 : 2, std::memory_order_release);
+}
+
+FramePool::FramePool(size_t maxMemory) : _maxMemory(maxMemory)
+{
+	_freeLists.fill(nullptr);
+}
+
+FramePool::~FramePool()
+{
+}
+
+size_t FramePool::reservedMemory()
+{
+	std::lock_guard<std::mutex> poolGuard(_mutex);
+	return _reservedMemory;
+}
+
+size_t FramePool::bufferShare()
+{
+	uint32_t bufferCount = _bufferCount;
+	return _maxMemory / 2 / (bufferCount > 0 ? bufferCount : 1);
+}
+
+bool FramePool::addSlab(int32_t sizeClass)
+{
+	uint32_t blockSize = _minClassSize << sizeClass;
+	size_t slabSize = blockSize > _slabSize ? blockSize : _slabSize;
+	if(_reservedMemory + slabSize > _maxMemory) return false;
+	uint32_t blockCount = slabSize / blockSize;
+
+	Slab slab;
+	slab.memory.reset(new char[slabSize]);
+	slab.blocks.reset(new FrameBlock[blockCount]);
+	for(uint32_t i = 0; i < blockCount; i++)
+	{
+		FrameBlock& block = slab.blocks[i];
+		block.pool = this;
+		block.sizeClass = sizeClass;
+		block.data = slab.memory.get() + (size_t)i * blockSize;
+		block.capacity = blockSize;
+		block.nextFree = _freeLists[sizeClass];
+		_freeLists[sizeClass] = &block;
+	}
+	_slabs.push_back(std::move(slab));
+	_reservedMemory += slabSize;
+	return true;
+}
+
+Frame FramePool::allocate(uint32_t size, int64_t time, uint64_t sequence)
+{
+	try
+	{
+		int32_t sizeClass = 0;
+		while(sizeClass < _sizeClassCount && (_minClassSize << sizeClass) < size) sizeClass++;
+		if(sizeClass == _sizeClassCount)
+		{
+			_exhaustedCount++;
+			return Frame();
+		}
+
+		std::lock_guard<std::mutex> poolGuard(_mutex);
+		if(!_freeLists[sizeClass] && !addSlab(sizeClass))
+		{
+			_exhaustedCount++;
+			return Frame();
+		}
+		FrameBlock* block = _freeLists[sizeClass];
+		_freeLists[sizeClass] = block->nextFree;
+		block->nextFree = nullptr;
+		block->size = size;
+		block->time = time;
+		block->sequence = sequence;
+		block->hashState = 0;
+		return Frame(block);
+	}
+	catch(const std::exception& ex)
+	{
+		GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+	}
+	return Frame();
+}
+
+void FramePool::release(FrameBlock* block)
+{
+	std::lock_guard<std::mutex> poolGuard(_mutex);
+	block->size = 0;
+	block->nextFree = _freeLists[block->sizeClass];
+	_freeLists[block->sizeClass] = block;
+}
+
+}
@@ -0,0 +1,159 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+#ifndef FRAMEPOOL_H_
+#define FRAMEPOOL_H_
+
+#include <array>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace IpCam
+{
+class FramePool;
+
+struct FrameBlock
+{
+	std::atomic<int32_t> refCount{0};
+	FramePool* pool = nullptr;
+	FrameBlock* nextFree = nullptr;
+	int32_t sizeClass = -1;
+	char* data = nullptr;
+	uint32_t capacity = 0;
+	uint32_t size = 0;
+	int64_t time = 0;
+	uint64_t sequence = 0;
+
+	/**
+	 * Perceptual hash cache, see FrameHash. 0 = not computed, 1 = valid, 2 = the frame could not be decoded.
+	 */
+	std::atomic<int32_t> hashState{0};
+	std::atomic<uint64_t> hash{0};
+};
+
+/**
+ * Reference counted handle to a JPEG frame stored in a FramePool. Copying a Frame never copies the image data.
+ */
+class Frame
+{
+public:
+	Frame() {}
+	explicit Frame(FrameBlock* block);
+	Frame(const Frame& other);
+	Frame(Frame&& other) noexcept;
+	~Frame();
+	Frame& operator=(const Frame& other);
+	Frame& operator=(Frame&& other) noexcept;
+
+	explicit operator bool() const { return _block != nullptr; }
+	void reset();
+
+	const char* data() const { return _block ? _block->data : nullptr; }
+	char* writableData() { return _block ? _block->data : nullptr; }
+	uint32_t size() const { return _block ? _block->size : 0; }
+
+	/**
+	 * The size of the pool block the frame occupies.
+	 */
+	uint32_t capacity() const { return _block ? _block->capacity : 0; }
+	int64_t time() const { return _block ? _block->time : 0; }
+	uint64_t sequence() const { return _block ? _block->sequence : 0; }
+
+	/**
+	 * Returns the cached perceptual hash. Use FrameHash::get() to compute it.
+	 *
+	 * @return 0 when the hash was not computed yet, 1 when "hash" was set and 2 when the frame could not be hashed.
+	 */
+	int32_t getCachedHash(uint64_t& hash) const;
+	void setCachedHash(uint64_t hash, bool valid) const;
+private:
+	FrameBlock* _block = nullptr;
+};
+
+/**
+ * Slab allocator for frames. Memory is reserved in slabs per size class up to a global limit and recycled through free
+ * lists, so steady state streaming does not allocate. allocate() returns an empty Frame when the limit is reached or the
+ * frame is larger than maxFrameSize.
+ */
+class FramePool
+{
+public:
+	/**
+	 * The size of the largest size class. Matches the default frame size limit of MjpegParser.
+	 */
+	static const uint32_t maxFrameSize = 8388608;
+
+	FramePool(size_t maxMemory);
+	virtual ~FramePool();
+
+	Frame allocate(uint32_t size, int64_t time, uint64_t sequence);
+	void release(FrameBlock* block);
+
+	size_t maxMemory() { return _maxMemory; }
+	size_t reservedMemory();
+	uint64_t exhaustedCount() { return _exhaustedCount; }
+
+	/**
+	 * Frame buffers holding frames for a longer time (the pre-motion buffers) register here. Together they may use half
+	 * of the pool, split evenly between them, so the rest is left for live delivery.
+	 */
+	void addBuffer() { _bufferCount++; }
+	void removeBuffer() { _bufferCount--; }
+
+	/**
+	 * The number of bytes of the pool one registered frame buffer may occupy.
+	 */
+	size_t bufferShare();
+protected:
+	static const int32_t _sizeClassCount = 10;
+	static const uint32_t _minClassSize = 16384;
+	static const uint32_t _slabSize = 1048576;
+
+	struct Slab
+	{
+		std::unique_ptr<char[]> memory;
+		std::unique_ptr<FrameBlock[]> blocks;
+	};
+
+	std::mutex _mutex;
+	size_t _maxMemory = 0;
+	size_t _reservedMemory = 0;
+	std::atomic<uint64_t> _exhaustedCount{0};
+	std::atomic<uint32_t> _bufferCount{0};
+	std::array<FrameBlock*, _sizeClassCount> _freeLists;
+	std::vector<Slab> _slabs;
+
+	bool addSlab(int32_t sizeClass);
+};
+
+}
+
+#endif
@@ -35,4 +35,16 @@ namespace IpCam
 	IpCam* GD::family = nullptr;
 	std::shared_ptr<IIpCamInterface> GD::physicalInterface;
 	BaseLib::Output GD::out;
+	std::shared_ptr<FramePool> GD::framePool;
+	std::string GD::recordingPath;
+	std::shared_ptr<RecordingWriter> GD::recordingWriter;
+	std::shared_ptr<RecordingCatalogue> GD::recordingCatalogue;
+	std::shared_ptr<MotionDetectorPool> GD::motionDetectorPool;
+	uint32_t GD::snapshotPrefetchConcurrency = 2;
+	uint32_t GD::healthCheckInterval = 60;
+	uint32_t GD::healthCheckConcurrency = 128;
+	std::shared_ptr<RelayClient> GD::relayClient;
+	std::shared_ptr<ConnectionLimiter> GD::connectionLimiter;
+	std::shared_ptr<TokenBucket> GD::bandwidthBudget;
+	std::shared_ptr<DnsCache> GD::dnsCache;
 }
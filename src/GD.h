@@ -35,7 +35,15 @@
 
 #include <homegear-base/BaseLib.h>
 #include "IpCam.h"
+#include "ConnectionLimiter.h"
+#include "DnsCache.h"
 #include "PhysicalInterfaces/IIpCamInterface.h"
+#include "FramePool.h"
+#include "MotionDetectorPool.h"
+#include "RecordingCatalogue.h"
+#include "RecordingWriter.h"
+#include "RelayClient.h"
+#include "TokenBucket.h"
 
 namespace IpCam
 {
@@ -49,6 +57,18 @@ public:
 	static IpCam* family;
 	static std::shared_ptr<IIpCamInterface> physicalInterface;
 	static BaseLib::Output out;
+	static std::shared_ptr<FramePool> framePool;
+	static std::string recordingPath;
+	static std::shared_ptr<RecordingWriter> recordingWriter;
+	static std::shared_ptr<RecordingCatalogue> recordingCatalogue;
+	static std::shared_ptr<MotionDetectorPool> motionDetectorPool;
+	static uint32_t snapshotPrefetchConcurrency;
+	static uint32_t healthCheckInterval;
+	static uint32_t healthCheckConcurrency;
+	static std::shared_ptr<RelayClient> relayClient;
+	static std::shared_ptr<ConnectionLimiter> connectionLimiter;
+	static std::shared_ptr<TokenBucket> bandwidthBudget;
+	static std::shared_ptr<DnsCache> dnsCache;
 private:
 	GD();
 };
@@ -0,0 +1,139 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+#include "HealthChecker.h"
+#include "GD.h"
+
+#include <cstring>
+
+#include <poll.h>
+#include <unistd.h>
+
+namespace IpCam
+{
+
+HealthChecker::HealthChecker(uint32_t concurrency, int32_t timeout) : _concurrency(concurrency > 0 ? concurrency : 1), _timeout(timeout)
+{
+}
+
+int32_t HealthChecker::connectNext(Probe& probe)
+{
+	if(probe.descriptor != -1)
+	{
+		close(probe.descriptor);
+		probe.descriptor = -1;
+	}
+	while(probe.nextAddress < probe.addresses.size())
+	{
+		DnsCache::Address& address = probe.addresses.at(probe.nextAddress++);
+		probe.descriptor = socket(address.address.ss_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+		if(probe.descriptor == -1) continue;
+		if(connect(probe.descriptor, (sockaddr*)&address.address, address.length) == 0) return 1;
+		if(errno == EINPROGRESS) return 0;
+		close(probe.descriptor);
+		probe.descriptor = -1;
+	}
+	return -1;
+}
+
+std::vector<bool> HealthChecker::probe(const std::vector<Target>& targets, const std::function<bool()>& cancelled)
+{
+	std::vector<bool> results(targets.size(), false);
+	std::vector<Probe> probes;
+	probes.reserve(_concurrency);
+	std::vector<pollfd> pollDescriptors;
+	pollDescriptors.reserve(_concurrency);
+	size_t nextTarget = 0;
+	try
+	{
+		while((nextTarget < targets.size() || !probes.empty()) && !cancelled())
+		{
+			while(probes.size() < _concurrency && nextTarget < targets.size())
+			{
+				Probe probe;
+				probe.index = nextTarget++;
+				const Target& target = targets.at(probe.index);
+				if(!GD::dnsCache->resolve(target.host, target.port, probe.addresses, _timeout)) continue;
+				probe.deadline = BaseLib::HelperFunctions::getTime() + _timeout;
+				int32_t result = connectNext(probe);
+				if(result == 0)
+				{
+					probes.push_back(std::move(probe));
+					continue;
+				}
+				results.at(probe.index) = (result == 1);
+				if(probe.descriptor != -1) close(probe.descriptor);
+			}
+			if(probes.empty()) continue;
+
+			int64_t time = BaseLib::HelperFunctions::getTime();
+			int64_t timeout = 100;
+			pollDescriptors.clear();
+			for(std::vector<Probe>::iterator i = probes.begin(); i != probes.end(); ++i)
+			{
+				pollDescriptors.push_back(pollfd{ i->descriptor, POLLOUT, 0 });
+				if(i->deadline - time < timeout) timeout = i->deadline - time;
+			}
+			if(timeout < 0) timeout = 0;
+			if(poll(pollDescriptors.data(), pollDescriptors.size(), (int)timeout) == -1 && errno != EINTR) throw BaseLib::Exception(std::string("poll failed: ") + strerror(errno));
+
+			time = BaseLib::HelperFunctions::getTime();
+			//Iterate backwards, so removing a probe doesn't affect the unprocessed ones.
+			for(size_t i = probes.size(); i-- > 0;)
+			{
+				Probe& probe = probes.at(i);
+				int32_t result = 0;
+				if(pollDescriptors.at(i).revents)
+				{
+					int error = 0;
+					socklen_t errorLength = sizeof(error);
+					if(getsockopt(probe.descriptor, SOL_SOCKET, SO_ERROR, &error, &errorLength) == 0 && error == 0) result = 1;
+					else result = connectNext(probe);
+				}
+				if(result == 0 && time >= probe.deadline) result = -1;
+				if(result == 0) continue;
+				results.at(probe.index) = (result == 1);
+				if(probe.descriptor != -1) close(probe.descriptor);
+				if(i != probes.size() - 1) probes.at(i) = std::move(probes.back());
+				probes.pop_back();
+			}
+		}
+	}
+	catch(const std::exception& ex)
+	{
+		GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+	}
+	for(std::vector<Probe>::iterator i = probes.begin(); i != probes.end(); ++i)
+	{
+		if(i->descriptor != -1) close(i->descriptor);
+	}
+	return results;
+}
+
+}
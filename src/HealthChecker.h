@@ -0,0 +1,91 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+#ifndef HEALTHCHECKER_H_
+#define HEALTHCHECKER_H_
+
+#include "DnsCache.h"
+
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace IpCam
+{
+
+/**
+ * Checks whether hosts accept TCP connections. All probes run on the calling thread: Up to "concurrency" non-blocking
+ * connects are in flight at once and a new one is started as soon as one finishes, so thousands of hosts are checked
+ * within a few seconds. Connections are closed right after they were established.
+ */
+class HealthChecker
+{
+public:
+	struct Target
+	{
+		std::string host;
+		int32_t port = 80;
+	};
+
+	/**
+	 * @param timeout Maximum time in milliseconds for one probe including all addresses of the host.
+	 */
+	HealthChecker(uint32_t concurrency, int32_t timeout);
+	virtual ~HealthChecker() {}
+
+	/**
+	 * Probes all targets. Returns when all probes finished or "cancelled" returns true.
+	 *
+	 * @return The result of each target in the order of "targets". Cancelled probes count as failed.
+	 */
+	std::vector<bool> probe(const std::vector<Target>& targets, const std::function<bool()>& cancelled);
+protected:
+	struct Probe
+	{
+		size_t index = 0;
+		std::vector<DnsCache::Address> addresses;
+		size_t nextAddress = 0;
+		int descriptor = -1;
+		int64_t deadline = 0;
+	};
+
+	uint32_t _concurrency = 1;
+	int32_t _timeout = 5000;
+
+	/**
+	 * Closes the current socket and connects to the next address.
+	 *
+	 * @return Returns 1 when connected, 0 while the connection is in progress and -1 when no address is left.
+	 */
+	static int32_t connectNext(Probe& probe);
+};
+
+}
+
+#endif
@@ -0,0 +1,105 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+#include "HttpHelper.h"
+
+#include <cerrno>
+#include <cstring>
+#include <poll.h>
+#include <unistd.h>
+#ifdef LINUXSYSTEM
+#include <sys/sendfile.h>
+#endif
+
+namespace IpCam
+{
+
+std::map<std::string, std::string> HttpHelper::getArguments(const std::string& query)
+{
+	std::map<std::string, std::string> arguments;
+	std::vector<std::string> elements = BaseLib::HelperFunctions::splitAll(query, '&');
+	for(std::vector<std::string>::iterator i = elements.begin(); i != elements.end(); ++i)
+	{
+		if(i->empty()) continue;
+		std::pair<std::string, std::string> argument = BaseLib::HelperFunctions::splitFirst(*i, '=');
+		arguments[BaseLib::Http::decodeURL(argument.first)] = BaseLib::Http::decodeURL(argument.second);
+	}
+	return arguments;
+}
+
+std::string HttpHelper::getResponse(int32_t code, const std::string& reason, const std::string& additionalHeaders)
+{
+	return "HTTP/1.1 " + std::to_string(code) + " " + reason + "\r\n" + additionalHeaders + "Content-Length: 0\r\nConnection: close\r\n\r\n";
+}
+
+uint64_t HttpHelper::sendFile(std::shared_ptr<BaseLib::TcpSocket>& socket, bool ssl, int fileDescriptor, uint64_t offset, uint64_t length)
+{
+	uint64_t bytesSent = 0;
+#ifndef LINUXSYSTEM
+	ssl = true;
+#endif
+	if(ssl)
+	{
+		std::vector<char> buffer(65536);
+		while(bytesSent < length)
+		{
+			size_t bytesToRead = length - bytesSent > buffer.size() ? buffer.size() : length - bytesSent;
+			ssize_t bytesRead = pread(fileDescriptor, buffer.data(), bytesToRead, offset + bytesSent);
+			if(bytesRead <= 0) break;
+			socket->proofwrite(buffer.data(), bytesRead);
+			bytesSent += bytesRead;
+		}
+		return bytesSent;
+	}
+
+#ifdef LINUXSYSTEM
+	int clientDescriptor = socket->getFileDescriptor()->descriptor;
+	off_t fileOffset = offset;
+	while(bytesSent < length)
+	{
+		size_t bytesToSend = length - bytesSent > 1048576 ? 1048576 : length - bytesSent;
+		ssize_t result = sendfile(clientDescriptor, fileDescriptor, &fileOffset, bytesToSend);
+		if(result == -1)
+		{
+			if(errno == EINTR) continue;
+			if(errno != EAGAIN) throw BaseLib::SocketOperationException(std::string("Could not send file: ") + strerror(errno));
+			struct pollfd pollInfo{ clientDescriptor, POLLOUT, 0 };
+			int pollResult = poll(&pollInfo, 1, 30000);
+			if(pollResult == 0) throw BaseLib::SocketTimeOutException("Writing to socket timed out.");
+			if(pollResult == -1 && errno != EINTR) throw BaseLib::SocketOperationException(std::string("Could not poll socket: ") + strerror(errno));
+			continue;
+		}
+		if(result == 0) break;
+		bytesSent += result;
+	}
+#endif
+	return bytesSent;
+}
+
+}
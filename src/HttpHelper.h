@@ -0,0 +1,67 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+#ifndef HTTPHELPER_H_
+#define HTTPHELPER_H_
+
+#include <homegear-base/BaseLib.h>
+
+#include <map>
+#include <string>
+
+namespace IpCam
+{
+
+class HttpHelper
+{
+public:
+	/**
+	 * Splits a query string like "a=1&b=2" into its arguments. Keys and values are URL decoded.
+	 */
+	static std::map<std::string, std::string> getArguments(const std::string& query);
+
+	/**
+	 * Returns a complete response without body, e. g. for errors.
+	 */
+	static std::string getResponse(int32_t code, const std::string& reason, const std::string& additionalHeaders = "");
+
+	/**
+	 * Sends "length" bytes starting at "offset" of a file to a client. On plain TCP connections sendfile() is used, so the
+	 * file content is never copied to user space (Linux only).
+	 *
+	 * @return Returns the number of bytes sent.
+	 */
+	static uint64_t sendFile(std::shared_ptr<BaseLib::TcpSocket>& socket, bool ssl, int fileDescriptor, uint64_t offset, uint64_t length);
+private:
+	HttpHelper() = delete;
+};
+
+}
+
+#endif
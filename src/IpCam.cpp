@@ -43,6 +43,56 @@ IpCam::IpCam(BaseLib::SharedObjects* bl, BaseLib::Systems::IFamilyEventSink* eve
 	GD::out.setPrefix("Module IpCam: ");
 	GD::out.printDebug("Debug: Loading module...");
 	_physicalInterfaces.reset(new Interfaces(bl, _settings->getPhysicalInterfaceSettings()));
+
+	int32_t frameMemory = _settings->getNumber("framememory");
+	if(frameMemory <= 0) frameMemory = 64;
+	GD::framePool.reset(new FramePool((size_t)frameMemory * 1048576));
+
+	GD::recordingPath = _settings->getString("recordingpath");
+	if(GD::recordingPath.empty()) GD::recordingPath = bl->settings.familyDataPath() + "ipcam/recordings/";
+	if(GD::recordingPath.back() != '/') GD::recordingPath.push_back('/');
+	int32_t recordingQueueSize = _settings->getNumber("recordingqueuesize");
+	if(recordingQueueSize <= 0) recordingQueueSize = 1000;
+	//Pre-motion buffers may use half of the frame pool. A quarter is left for live delivery.
+	GD::recordingWriter.reset(new RecordingWriter(recordingQueueSize, GD::framePool->maxMemory() / 4));
+
+	int32_t recordingQuota = _settings->getNumber("recordingquota");
+	if(recordingQuota < 0) recordingQuota = 0;
+	int32_t recordingRetention = _settings->getNumber("recordingretention");
+	if(recordingRetention < 0) recordingRetention = 0;
+	GD::recordingCatalogue.reset(new RecordingCatalogue(GD::recordingPath, (uint64_t)recordingQuota * 1048576, (int64_t)recordingRetention * 3600000));
+	//Scanning the recording directory might take a while, so don't block module loading.
+	GD::recordingWriter->post([]() { if(Segment::createDirectory(GD::recordingPath)) GD::recordingCatalogue->load(); });
+
+	int32_t motionDetectionThreads = _settings->getNumber("motiondetectionthreads");
+	if(motionDetectionThreads <= 0) motionDetectionThreads = std::thread::hardware_concurrency() / 2;
+	if(motionDetectionThreads <= 0) motionDetectionThreads = 1;
+	GD::motionDetectorPool.reset(new MotionDetectorPool(motionDetectionThreads));
+
+	int32_t snapshotPrefetchConcurrency = _settings->getNumber("snapshotprefetchconcurrency");
+	if(snapshotPrefetchConcurrency > 0) GD::snapshotPrefetchConcurrency = snapshotPrefetchConcurrency;
+
+	//0 is a valid value, so check whether the setting exists.
+	std::string healthCheckInterval = _settings->getString("healthcheckinterval");
+	if(!healthCheckInterval.empty()) GD::healthCheckInterval = std::max(0, BaseLib::Math::getNumber(healthCheckInterval));
+	int32_t healthCheckConcurrency = _settings->getNumber("healthcheckconcurrency");
+	if(healthCheckConcurrency > 0) GD::healthCheckConcurrency = healthCheckConcurrency;
+
+	int32_t maxConnections = _settings->getNumber("maxconnections");
+	if(maxConnections < 0) maxConnections = 0;
+	GD::connectionLimiter = std::make_shared<ConnectionLimiter>(maxConnections);
+
+	int32_t bandwidthLimit = _settings->getNumber("bandwidthlimit");
+	GD::bandwidthBudget = std::make_shared<TokenBucket>();
+	if(bandwidthLimit > 0) GD::bandwidthBudget->setRate((uint64_t)bandwidthLimit * 125);
+
+	//0 disables the cache, so check whether the setting exists.
+	std::string dnsCacheTtl = _settings->getString("dnscachettl");
+	int32_t dnsNegativeTtl = _settings->getNumber("dnsnegativettl");
+	GD::dnsCache = std::make_shared<DnsCache>(dnsCacheTtl.empty() ? 300 : std::max(0, BaseLib::Math::getNumber(dnsCacheTtl)), dnsNegativeTtl > 0 ? dnsNegativeTtl : 30);
+
+	std::string relaySocket = _settings->getString("relaysocket");
+	if(!relaySocket.empty()) GD::relayClient.reset(new RelayClient(relaySocket));
 }
 
 IpCam::~IpCam()
@@ -56,6 +106,10 @@ void IpCam::dispose()
 	DeviceFamily::dispose();
 
 	_central.reset();
+	if(GD::relayClient) GD::relayClient->stop();
+	GD::motionDetectorPool->stop();
+	GD::dnsCache->stop();
+	GD::recordingWriter->stop();
 }
 
 void IpCam::createCentral()
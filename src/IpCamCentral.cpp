@@ -29,8 +29,11 @@
 
 #include "IpCamCentral.h"
 #include "GD.h"
+#include "HttpHelper.h"
+#include "SnapshotBundle.h"
 
 #include <iomanip>
+#include <set>
 
 namespace IpCam {
 
@@ -56,8 +59,12 @@ void IpCamCentral::dispose(bool wait)
 		if(_disposing) return;
 		_disposing = true;
 
+		raiseRemoveWebserverEventHandler(_webserverEventHandlers);
+
 		_stopWorkerThread = true;
 		GD::bl->threadManager.join(_workerThread);
+		GD::bl->threadManager.join(_healthCheckThread);
+		if(_snapshotPrefetcher) _snapshotPrefetcher->stop();
 	}
     catch(const std::exception& ex)
     {
@@ -73,8 +80,15 @@ void IpCamCentral::init()
 		_initialized = true;
 
 		_stopWorkerThread = false;
+		_snapshotPrefetcher = std::make_shared<SnapshotPrefetcher>(GD::snapshotPrefetchConcurrency);
+		_motionEventLog = std::make_shared<MotionEventLog>(GD::recordingPath + "motionevents");
+
+		_localRpcMethods.emplace("getMotionEvents", std::bind(&IpCamCentral::getMotionEvents, this, std::placeholders::_1, std::placeholders::_2));
+
+		raiseAddWebserverEventHandler(this, _webserverEventHandlers);
 
 		_bl->threadManager.start(_workerThread, true, _bl->settings.workerThreadPriority(), _bl->settings.workerThreadPolicy(), &IpCamCentral::worker, this);
+		_bl->threadManager.start(_healthCheckThread, true, &IpCamCentral::healthCheckWorker, this);
 	}
 	catch(const std::exception& ex)
 	{
@@ -89,6 +103,7 @@ void IpCamCentral::worker()
 		std::chrono::milliseconds sleepingTime(10);
 		uint32_t counter = 0;
 		uint64_t lastPeer = 0;
+		int64_t lastRecordingMaintenance = 0;
 		//One loop on the Raspberry Pi takes about 30Âµs
 		while(!_stopWorkerThread)
 		{
@@ -124,6 +139,15 @@ void IpCamCentral::worker()
 				std::shared_ptr<IpCamPeer> peer(getPeer(lastPeer));
 				if(peer && !peer->deleting) peer->worker();
 				counter++;
+
+				if(BaseLib::HelperFunctions::getTime() - lastRecordingMaintenance >= 60000)
+				{
+					//Deleting files is slow, so let the recording writer do it.
+					lastRecordingMaintenance = BaseLib::HelperFunctions::getTime();
+					GD::recordingWriter->post([]() { GD::recordingCatalogue->enforceLimits(); });
+				}
+
+				_snapshotPrefetcher->schedule();
 			}
 			catch(const std::exception& ex)
 			{
@@ -138,6 +162,65 @@ void IpCamCentral::worker()
     }
 }
 
+void IpCamCentral::healthCheckWorker()
+{
+	HealthChecker healthChecker(GD::healthCheckConcurrency, _healthCheckTimeout);
+	std::vector<std::shared_ptr<IpCamPeer>> peers;
+	std::vector<std::shared_ptr<IpCamPeer>> checkedPeers;
+	std::vector<HealthChecker::Target> targets;
+	while(!_stopWorkerThread)
+	{
+		try
+		{
+			for(int32_t i = 0; i < 10 && !_stopWorkerThread; i++)
+			{
+				std::this_thread::sleep_for(std::chrono::milliseconds(100));
+			}
+			if(_stopWorkerThread) return;
+
+			peers.clear();
+			{
+				std::lock_guard<std::mutex> peersGuard(_peersMutex);
+				for(std::map<uint64_t, std::shared_ptr<BaseLib::Systems::Peer>>::iterator i = _peersById.begin(); i != _peersById.end(); ++i)
+				{
+					std::shared_ptr<IpCamPeer> peer = std::dynamic_pointer_cast<IpCamPeer>(i->second);
+					if(peer) peers.push_back(peer);
+				}
+			}
+
+			int64_t time = BaseLib::HelperFunctions::getTime();
+			checkedPeers.clear();
+			targets.clear();
+			for(std::vector<std::shared_ptr<IpCamPeer>>::iterator i = peers.begin(); i != peers.end(); ++i)
+			{
+				HealthChecker::Target target;
+				if(!(*i)->healthCheckDue(time, target.host, target.port)) continue;
+				checkedPeers.push_back(*i);
+				targets.push_back(target);
+			}
+			if(targets.empty()) continue;
+
+			std::vector<bool> results = healthChecker.probe(targets, [this]() { return (bool)_stopWorkerThread; });
+			if(_stopWorkerThread) return;
+			uint64_t failures = 0;
+			for(size_t i = 0; i < checkedPeers.size(); i++)
+			{
+				if(!results.at(i)) failures++;
+				checkedPeers.at(i)->onHealthCheckResult(results.at(i));
+			}
+			_lastHealthCheckTime = time;
+			_lastHealthCheckDuration = BaseLib::HelperFunctions::getTime() - time;
+			_lastHealthCheckTargets = targets.size();
+			_lastHealthCheckFailures = failures;
+			if(_bl->debugLevel >= 5) GD::out.printDebug("Debug: Checked " + std::to_string(targets.size()) + " cameras in " + std::to_string(_lastHealthCheckDuration) + " ms. " + std::to_string(failures) + " didn't answer.");
+		}
+		catch(const std::exception& ex)
+		{
+			GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+		}
+	}
+}
+
 void IpCamCentral::loadPeers()
 {
 	try
@@ -254,6 +337,8 @@ void IpCamCentral::deletePeer(uint64_t id)
 			if(_peersBySerial.find(peer->getSerialNumber()) != _peersBySerial.end()) _peersBySerial.erase(peer->getSerialNumber());
 			if(_peersById.find(id) != _peersById.end()) _peersById.erase(id);
 		}
+		_snapshotPrefetcher->removePeer(id);
+		GD::connectionLimiter->removePeer(id);
 
 		int32_t i = 0;
 		while(peer.use_count() > 1 && i < 600)
@@ -287,6 +372,16 @@ std::string IpCamCentral::handleCliCommand(std::string command)
 			stringStream << "peers remove (pr)\tRemove a peer" << std::endl;
 			stringStream << "peers select (ps)\tSelect a peer" << std::endl;
 			stringStream << "peers setname (pn)\tName a peer" << std::endl;
+			stringStream << "recording stats (rs)\tShow recording statistics" << std::endl;
+			stringStream << "motion events (me)\tList motion events" << std::endl;
+			stringStream << "snapshot prefetch (sp)\tShow snapshot prefetch statistics" << std::endl;
+			stringStream << "relay stats (rls)\tShow statistics of the stream relay" << std::endl;
+			stringStream << "connection stats (cs)\tShow connection limits and queues" << std::endl;
+			stringStream << "bandwidth stats (bs)\tShow delivered and dropped frames per priority" << std::endl;
+			stringStream << "stream stats (ss)\tShow the traffic of each camera stream and its clients" << std::endl;
+			stringStream << "health status (hs)\tShow the health checks and all unreachable cameras" << std::endl;
+			stringStream << "latency stats (lt)\tShow connect and response times of the cameras" << std::endl;
+			stringStream << "dns cache (dc)\t\tShow the cached camera host names" << std::endl;
 			stringStream << "unselect (u)\t\tUnselect this device" << std::endl;
 			return stringStream.str();
 		}
@@ -593,6 +688,409 @@ std::string IpCamCentral::handleCliCommand(std::string command)
 			}
 			return stringStream.str();
 		}
+		else if(command.compare(0, 15, "recording stats") == 0 || command.compare(0, 2, "rs") == 0)
+		{
+			std::stringstream stream(command);
+			std::string element;
+			int32_t offset = (command.at(1) == 'e') ? 1 : 0;
+			int32_t index = 0;
+			while(std::getline(stream, element, ' '))
+			{
+				if(index < 1 + offset)
+				{
+					index++;
+					continue;
+				}
+				if(element == "help")
+				{
+					stringStream << "Description: This command shows statistics of the recording writer and the recording catalogue." << std::endl;
+					stringStream << "Usage: recording stats" << std::endl;
+					return stringStream.str();
+				}
+				index++;
+			}
+
+			std::shared_ptr<RecordingWriter> writer = GD::recordingWriter;
+			std::shared_ptr<RecordingCatalogue> catalogue = GD::recordingCatalogue;
+			stringStream << "Writer:" << std::endl;
+			stringStream << "  Queue depth:\t\t" << writer->queueSize() << " / " << writer->maxQueueSize() << " (peak " << writer->peakQueueSize() << ")" << std::endl;
+			stringStream << "  Queue memory:\t\t" << (writer->queueBytes() / 1048576) << " / " << (writer->maxQueueBytes() / 1048576) << " MiB" << std::endl;
+			stringStream << "  Throughput:\t\t" << (writer->throughput() / 1024) << " KiB/s" << std::endl;
+			stringStream << "  Frames written:\t" << writer->framesWritten() << std::endl;
+			stringStream << "  Bytes written:\t" << writer->bytesWritten() << std::endl;
+			stringStream << "  Frames dropped:\t" << writer->droppedFrames() << std::endl;
+			stringStream << "Catalogue:" << std::endl;
+			stringStream << "  Segments:\t\t" << catalogue->segmentCount() << std::endl;
+			stringStream << "  Size:\t\t\t" << (catalogue->totalSize() / 1048576) << " MiB" << std::endl;
+			stringStream << "  Quota:\t\t" << (catalogue->quota() == 0 ? std::string("unlimited") : std::to_string(catalogue->quota() / 1048576) + " MiB") << std::endl;
+			stringStream << "  Retention:\t\t" << (catalogue->retention() == 0 ? std::string("unlimited") : std::to_string(catalogue->retention() / 3600000) + " h") << std::endl;
+			stringStream << "  Evicted segments:\t" << catalogue->evictedSegments() << std::endl;
+			return stringStream.str();
+		}
+		else if(command.compare(0, 13, "motion events") == 0 || command.compare(0, 2, "me") == 0)
+		{
+			uint64_t peerId = 0;
+			int64_t to = BaseLib::HelperFunctions::getTime();
+			int64_t from = to - 86400000;
+
+			std::stringstream stream(command);
+			std::string element;
+			int32_t offset = (command.at(1) == 'o') ? 1 : 0;
+			int32_t index = 0;
+			while(std::getline(stream, element, ' '))
+			{
+				if(index < 1 + offset)
+				{
+					index++;
+					continue;
+				}
+				else if(index == 1 + offset)
+				{
+					if(element == "help")
+					{
+						index = -1;
+						break;
+					}
+					peerId = BaseLib::Math::getNumber64(element);
+				}
+				else if(index == 2 + offset) from = BaseLib::Math::getNumber64(element) * 1000;
+				else if(index == 3 + offset) to = BaseLib::Math::getNumber64(element) * 1000;
+				index++;
+			}
+			if(index == -1)
+			{
+				stringStream << "Description: This command lists the motion events of a peer (at most 100)." << std::endl;
+				stringStream << "Usage: motion events [PEERID] [FROM] [TO]" << std::endl << std::endl;
+				stringStream << "Parameters:" << std::endl;
+				stringStream << "  PEERID:\tThe id of the peer or 0 for all peers. Default: 0" << std::endl;
+				stringStream << "  FROM:\t\tUnix time in seconds. Default: 24 hours ago" << std::endl;
+				stringStream << "  TO:\t\tUnix time in seconds. Default: now" << std::endl;
+				return stringStream.str();
+			}
+
+			std::vector<MotionEventLog::Event> events = _motionEventLog->query(peerId, from, to, 100);
+			stringStream << "Events in log: " << _motionEventLog->count() << std::endl << std::endl;
+			stringStream << std::left << std::setfill(' ') << std::setw(10) << "Peer ID" << std::setw(22) << "Start" << std::setw(22) << "End" << std::setw(10) << "Source" << "Intensity" << std::endl;
+			for(std::vector<MotionEventLog::Event>::iterator i = events.begin(); i != events.end(); ++i)
+			{
+				bool detector = i->source == (uint8_t)MotionEventLog::Source::detector;
+				stringStream << std::setw(10) << i->peerId << std::setw(22) << Segment::getTimeString(i->start) << std::setw(22) << (i->end == 0 ? std::string("-") : Segment::getTimeString(i->end)) << std::setw(10) << (detector ? "detector" : "camera") << (detector ? std::to_string(i->intensity) : std::string("-")) << std::endl;
+			}
+			return stringStream.str();
+		}
+		else if(command.compare(0, 17, "snapshot prefetch") == 0 || command.compare(0, 2, "sp") == 0)
+		{
+			std::stringstream stream(command);
+			std::string element;
+			int32_t offset = (command.at(1) == 'n') ? 1 : 0;
+			int32_t index = 0;
+			while(std::getline(stream, element, ' '))
+			{
+				if(index < 1 + offset)
+				{
+					index++;
+					continue;
+				}
+				if(element == "help")
+				{
+					stringStream << "Description: This command shows how often the snapshots of each peer are requested and how often they were prefetched." << std::endl;
+					stringStream << "Usage: snapshot prefetch" << std::endl;
+					return stringStream.str();
+				}
+				index++;
+			}
+
+			return _snapshotPrefetcher->getStats();
+		}
+		else if(command.compare(0, 11, "relay stats") == 0 || command.compare(0, 3, "rls") == 0)
+		{
+			std::stringstream stream(command);
+			std::string element;
+			int32_t offset = (command.at(1) == 'e') ? 1 : 0;
+			int32_t index = 0;
+			while(std::getline(stream, element, ' '))
+			{
+				if(index < 1 + offset)
+				{
+					index++;
+					continue;
+				}
+				if(element == "help")
+				{
+					stringStream << "Description: This command shows the streams relayed by homegear-ipcam-relay. The statistics are updated every 10 seconds." << std::endl;
+					stringStream << "Usage: relay stats" << std::endl;
+					return stringStream.str();
+				}
+				index++;
+			}
+
+			if(!GD::relayClient) return "The stream relay is disabled. Set \"relaySocket\" in ipcam.conf to enable it.\n";
+			stringStream << "Connected: " << (GD::relayClient->connected() ? "yes" : "no") << std::endl;
+			stringStream << "Clients: " << GD::relayClient->clientCount() << std::endl;
+			std::vector<RelayProtocol::PeerStats> stats = GD::relayClient->getStats();
+			if(stats.empty()) return stringStream.str();
+			stringStream << std::endl << std::left << std::setw(10) << "ID" << std::setw(9) << "Clients" << std::setw(10) << "Upstream" << std::setw(12) << "Frames" << std::setw(12) << "Dropped" << std::setw(16) << "Received (MiB)" << "Sent (MiB)" << std::endl;
+			for(std::vector<RelayProtocol::PeerStats>::iterator i = stats.begin(); i != stats.end(); ++i)
+			{
+				stringStream << std::setw(10) << i->peerId << std::setw(9) << i->clients << std::setw(10) << (i->upstreamConnected ? "yes" : "no") << std::setw(12) << i->frames << std::setw(12) << i->droppedFrames << std::setw(16) << (i->bytesReceived / 1048576) << (i->bytesSent / 1048576) << std::endl;
+			}
+			return stringStream.str();
+		}
+		else if(command.compare(0, 15, "bandwidth stats") == 0 || command.compare(0, 2, "bs") == 0)
+		{
+			std::stringstream stream(command);
+			std::string element;
+			int32_t offset = (command.at(1) == 'a') ? 1 : 0;
+			int32_t index = 0;
+			while(std::getline(stream, element, ' '))
+			{
+				if(index < 1 + offset)
+				{
+					index++;
+					continue;
+				}
+				if(element == "help")
+				{
+					stringStream << "Description: This command shows the frames delivered to and dropped for the consumers of each camera's stream by priority. Frames are only dropped while a bandwidth limit is exceeded." << std::endl;
+					stringStream << "Usage: bandwidth stats" << std::endl;
+					return stringStream.str();
+				}
+				index++;
+			}
+
+			std::vector<std::shared_ptr<IpCamPeer>> peers;
+			{
+				std::lock_guard<std::mutex> peersGuard(_peersMutex);
+				for(std::map<uint64_t, std::shared_ptr<BaseLib::Systems::Peer>>::iterator i = _peersById.begin(); i != _peersById.end(); ++i)
+				{
+					std::shared_ptr<IpCamPeer> peer = std::dynamic_pointer_cast<IpCamPeer>(i->second);
+					if(peer) peers.push_back(peer);
+				}
+			}
+
+			uint64_t globalLimit = GD::bandwidthBudget->getRate();
+			stringStream << "Global limit: " << (globalLimit > 0 ? std::to_string(globalLimit / 125) + " kbit/s" : "none") << std::endl << std::endl;
+			stringStream << std::left << std::setw(10) << "ID" << std::setw(12) << "Priority" << std::setw(11) << "Consumers" << std::setw(12) << "Frames" << std::setw(12) << "Dropped" << "Sent (MiB)" << std::endl;
+			for(std::vector<std::shared_ptr<IpCamPeer>>::iterator i = peers.begin(); i != peers.end(); ++i)
+			{
+				std::array<StreamHub::PriorityStats, StreamHub::priorityCount> stats = (*i)->getStreamHub()->getPriorityStats();
+				for(size_t j = 0; j < stats.size(); j++)
+				{
+					if(stats[j].consumers == 0 && stats[j].frames == 0 && stats[j].droppedFrames == 0) continue;
+					stringStream << std::setw(10) << (*i)->getID() << std::setw(12) << StreamHub::getPriorityName((StreamHub::Priority)j) << std::setw(11) << stats[j].consumers << std::setw(12) << stats[j].frames << std::setw(12) << stats[j].droppedFrames << (stats[j].bytes / 1048576) << std::endl;
+				}
+			}
+			return stringStream.str();
+		}
+		else if(command.compare(0, 13, "health status") == 0 || command.compare(0, 2, "hs") == 0)
+		{
+			std::stringstream stream(command);
+			std::string element;
+			int32_t offset = (command.at(1) == 'e') ? 1 : 0;
+			int32_t index = 0;
+			while(std::getline(stream, element, ' '))
+			{
+				if(index < 1 + offset)
+				{
+					index++;
+					continue;
+				}
+				if(element == "help")
+				{
+					stringStream << "Description: This command shows the result of the last health check run and lists all cameras currently marked as unreachable." << std::endl;
+					stringStream << "Usage: health status" << std::endl;
+					return stringStream.str();
+				}
+				index++;
+			}
+
+			if(GD::healthCheckInterval == 0) stringStream << "Regular health checks are disabled. Only unreachable cameras are checked." << std::endl;
+			else stringStream << "Interval: " << GD::healthCheckInterval << " s" << std::endl;
+			int64_t lastHealthCheckTime = _lastHealthCheckTime;
+			if(lastHealthCheckTime > 0) stringStream << "Last run: " << ((BaseLib::HelperFunctions::getTime() - lastHealthCheckTime) / 1000) << " s ago, " << _lastHealthCheckTargets << " cameras checked in " << _lastHealthCheckDuration << " ms, " << _lastHealthCheckFailures << " failed" << std::endl;
+
+			std::vector<uint64_t> unreachablePeers;
+			{
+				std::lock_guard<std::mutex> peersGuard(_peersMutex);
+				for(std::map<uint64_t, std::shared_ptr<BaseLib::Systems::Peer>>::iterator i = _peersById.begin(); i != _peersById.end(); ++i)
+				{
+					std::shared_ptr<IpCamPeer> peer = std::dynamic_pointer_cast<IpCamPeer>(i->second);
+					if(peer && peer->unreachable()) unreachablePeers.push_back(i->first);
+				}
+			}
+			stringStream << "Unreachable cameras: " << unreachablePeers.size() << std::endl;
+			for(std::vector<uint64_t>::iterator i = unreachablePeers.begin(); i != unreachablePeers.end(); ++i)
+			{
+				stringStream << "  " << *i << std::endl;
+			}
+			return stringStream.str();
+		}
+		else if(command.compare(0, 13, "latency stats") == 0 || command.compare(0, 2, "lt") == 0)
+		{
+			uint64_t peerId = 0;
+
+			std::stringstream stream(command);
+			std::string element;
+			int32_t offset = (command.at(1) == 'a') ? 1 : 0;
+			int32_t index = 0;
+			while(std::getline(stream, element, ' '))
+			{
+				if(index < 1 + offset)
+				{
+					index++;
+					continue;
+				}
+				else if(index == 1 + offset)
+				{
+					if(element == "help")
+					{
+						stringStream << "Description: This command shows how long connecting to the cameras, the TLS handshake and waiting for the first byte of a response took and how often each phase timed out. For HTTPS cameras, the number of resumed TLS sessions and cached certificate checks is shown as well. With a peer ID, the full histograms of the peer are shown." << std::endl;
+						stringStream << "Usage: latency stats [PEERID]" << std::endl << std::endl;
+						stringStream << "Parameters:" << std::endl;
+						stringStream << "  PEERID:\tThe ID of the peer to show the histograms for. Optional." << std::endl;
+						return stringStream.str();
+					}
+					peerId = BaseLib::Math::getNumber64(element);
+				}
+				index++;
+			}
+
+			std::vector<std::shared_ptr<IpCamPeer>> peers;
+			{
+				std::lock_guard<std::mutex> peersGuard(_peersMutex);
+				for(std::map<uint64_t, std::shared_ptr<BaseLib::Systems::Peer>>::iterator i = _peersById.begin(); i != _peersById.end(); ++i)
+				{
+					if(peerId != 0 && i->first != peerId) continue;
+					std::shared_ptr<IpCamPeer> peer = std::dynamic_pointer_cast<IpCamPeer>(i->second);
+					if(peer) peers.push_back(peer);
+				}
+			}
+			if(peerId != 0 && peers.empty()) return "This peer does not exist.\n";
+
+			for(std::vector<std::shared_ptr<IpCamPeer>>::iterator i = peers.begin(); i != peers.end(); ++i)
+			{
+				CameraConnection::PStats stats = (*i)->getConnectionStats();
+				std::array<std::pair<std::string, LatencyHistogram::Snapshot>, 3> phases{ { { "connect", stats->connect.snapshot() }, { "TLS handshake", stats->tlsHandshake.snapshot() }, { "first byte", stats->firstByte.snapshot() } } };
+				if(peerId == 0 && phases[0].second.count == 0 && phases[0].second.timeouts == 0) continue;
+				stringStream << "Peer " << (*i)->getID() << ": " << stats->idleTimeouts << " idle timeouts" << std::endl;
+				TlsSessionCache::Stats tlsStats = (*i)->getTlsSessionCache()->getStats();
+				if(tlsStats.fullHandshakes + tlsStats.resumedHandshakes > 0) stringStream << "  TLS: " << tlsStats.resumedHandshakes << " of " << (tlsStats.fullHandshakes + tlsStats.resumedHandshakes) << " handshakes resumed, " << tlsStats.verificationCacheHits << " of " << (tlsStats.verifications + tlsStats.verificationCacheHits) << " certificate checks cached" << std::endl;
+				stringStream << "  " << std::left << std::setw(15) << "Phase" << std::right << std::setw(8) << "Count" << std::setw(10) << "Timeouts" << std::setw(10) << "Avg (ms)" << std::setw(8) << "p50" << std::setw(8) << "p90" << std::setw(8) << "p99" << std::setw(8) << "Max" << std::endl;
+				for(std::array<std::pair<std::string, LatencyHistogram::Snapshot>, 3>::iterator j = phases.begin(); j != phases.end(); ++j)
+				{
+					const LatencyHistogram::Snapshot& snapshot = j->second;
+					stringStream << "  " << std::left << std::setw(15) << j->first << std::right << std::setw(8) << snapshot.count << std::setw(10) << snapshot.timeouts << std::setw(10) << snapshot.average() << std::setw(8) << snapshot.percentile(0.5) << std::setw(8) << snapshot.percentile(0.9) << std::setw(8) << snapshot.percentile(0.99) << std::setw(8) << snapshot.max << std::endl;
+				}
+				if(peerId == 0) continue;
+
+				const std::array<int64_t, LatencyHistogram::bucketCount - 1>& bounds = LatencyHistogram::bounds();
+				for(std::array<std::pair<std::string, LatencyHistogram::Snapshot>, 3>::iterator j = phases.begin(); j != phases.end(); ++j)
+				{
+					stringStream << std::endl << "  " << j->first << ":" << std::endl;
+					for(size_t k = 0; k < LatencyHistogram::bucketCount; k++)
+					{
+						std::string bucket = k < bounds.size() ? "<= " + std::to_string(bounds[k]) + " ms" : "> " + std::to_string(bounds.back()) + " ms";
+						stringStream << "    " << std::left << std::setw(12) << bucket << std::right << std::setw(8) << j->second.counts[k] << std::endl;
+					}
+				}
+			}
+			return stringStream.str();
+		}
+		else if(command.compare(0, 9, "dns cache") == 0 || command.compare(0, 2, "dc") == 0)
+		{
+			std::stringstream stream(command);
+			std::string element;
+			int32_t offset = (command.at(1) == 'n') ? 1 : 0;
+			int32_t index = 0;
+			while(std::getline(stream, element, ' '))
+			{
+				if(index < 1 + offset)
+				{
+					index++;
+					continue;
+				}
+				if(element == "help")
+				{
+					stringStream << "Description: This command shows the hit rate of the DNS cache and all cached camera host names with their first address." << std::endl;
+					stringStream << "Usage: dns cache" << std::endl;
+					return stringStream.str();
+				}
+				index++;
+			}
+
+			return GD::dnsCache->getStats();
+		}
+		else if(command.compare(0, 12, "stream stats") == 0 || command.compare(0, 2, "ss") == 0)
+		{
+			std::stringstream stream(command);
+			std::string element;
+			int32_t offset = (command.at(1) == 't') ? 1 : 0;
+			int32_t index = 0;
+			while(std::getline(stream, element, ' '))
+			{
+				if(index < 1 + offset)
+				{
+					index++;
+					continue;
+				}
+				if(element == "help")
+				{
+					stringStream << "Description: This command shows the frames and bytes received from each camera and delivered to each client of its stream. Streams served by the stream relay are listed by \"relay stats\"." << std::endl;
+					stringStream << "Usage: stream stats" << std::endl;
+					return stringStream.str();
+				}
+				index++;
+			}
+
+			std::vector<std::shared_ptr<IpCamPeer>> peers;
+			{
+				std::lock_guard<std::mutex> peersGuard(_peersMutex);
+				for(std::map<uint64_t, std::shared_ptr<BaseLib::Systems::Peer>>::iterator i = _peersById.begin(); i != _peersById.end(); ++i)
+				{
+					std::shared_ptr<IpCamPeer> peer = std::dynamic_pointer_cast<IpCamPeer>(i->second);
+					if(peer) peers.push_back(peer);
+				}
+			}
+
+			int64_t time = BaseLib::HelperFunctions::getTime();
+			for(std::vector<std::shared_ptr<IpCamPeer>>::iterator i = peers.begin(); i != peers.end(); ++i)
+			{
+				std::shared_ptr<StreamHub> hub = (*i)->getStreamHub();
+				StreamHub::UpstreamStats upstreamStats = hub->getUpstreamStats();
+				std::vector<StreamHub::ConsumerStats> consumerStats = hub->getConsumerStats();
+				if(upstreamStats.frames == 0 && consumerStats.empty()) continue;
+				stringStream << "Peer " << (*i)->getID() << ": " << (upstreamStats.connected ? "connected" : "disconnected") << ", " << upstreamStats.frames << " frames, " << (upstreamStats.bytesReceived / 1048576) << " MiB received" << std::endl;
+				for(std::vector<StreamHub::ConsumerStats>::iterator j = consumerStats.begin(); j != consumerStats.end(); ++j)
+				{
+					stringStream << "  " << std::left << std::setw(12) << StreamHub::getPriorityName(j->priority) << std::setw(10) << (std::to_string((time - j->addedTime) / 1000) + " s") << std::setw(14) << (std::to_string(j->frames) + " frames") << std::setw(14) << (std::to_string(j->droppedFrames) + " dropped") << (j->bytes / 1048576) << " MiB" << std::endl;
+				}
+			}
+			return stringStream.str();
+		}
+		else if(command.compare(0, 16, "connection stats") == 0 || command.compare(0, 2, "cs") == 0)
+		{
+			std::stringstream stream(command);
+			std::string element;
+			int32_t offset = (command.at(1) == 'o') ? 1 : 0;
+			int32_t index = 0;
+			while(std::getline(stream, element, ' '))
+			{
+				if(index < 1 + offset)
+				{
+					index++;
+					continue;
+				}
+				if(element == "help")
+				{
+					stringStream << "Description: This command shows the connections to the cameras, the requests waiting for a free connection and the number of rejected requests." << std::endl;
+					stringStream << "Usage: connection stats" << std::endl;
+					return stringStream.str();
+				}
+				index++;
+			}
+
+			return GD::connectionLimiter->getStats();
+		}
 		else return "Unknown command.\n";
 	}
 	catch(const std::exception& ex)
@@ -602,6 +1100,159 @@ std::string IpCamCentral::handleCliCommand(std::string command)
     return "Error executing command. See log file for more details.\n";
 }
 
+std::shared_ptr<Mosaic> IpCamCentral::getMosaic(const Mosaic::Definition& definition)
+{
+	try
+	{
+		std::string key = definition.key();
+		std::lock_guard<std::mutex> mosaicsGuard(_mosaicsMutex);
+		std::map<std::string, std::weak_ptr<Mosaic>>::iterator mosaicIterator = _mosaics.find(key);
+		if(mosaicIterator != _mosaics.end())
+		{
+			std::shared_ptr<Mosaic> mosaic = mosaicIterator->second.lock();
+			if(mosaic) return mosaic;
+		}
+
+		std::vector<std::shared_ptr<StreamHub>> hubs;
+		hubs.reserve(definition.peerIds.size());
+		for(std::vector<uint64_t>::const_iterator i = definition.peerIds.begin(); i != definition.peerIds.end(); ++i)
+		{
+			if(*i == 0)
+			{
+				hubs.push_back(std::shared_ptr<StreamHub>());
+				continue;
+			}
+			std::shared_ptr<IpCamPeer> peer = getPeer(*i);
+			if(!peer || peer->deleting) return std::shared_ptr<Mosaic>();
+			hubs.push_back(peer->getStreamHub());
+		}
+
+		for(std::map<std::string, std::weak_ptr<Mosaic>>::iterator i = _mosaics.begin(); i != _mosaics.end();)
+		{
+			if(i->second.expired()) i = _mosaics.erase(i);
+			else ++i;
+		}
+		std::shared_ptr<Mosaic> mosaic = std::make_shared<Mosaic>(definition, hubs);
+		_mosaics[key] = mosaic;
+		return mosaic;
+	}
+	catch(const std::exception& ex)
+	{
+		GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+	}
+	return std::shared_ptr<Mosaic>();
+}
+
+bool IpCamCentral::onGet(BaseLib::Rpc::PServerInfo& serverInfo, BaseLib::Http& httpRequest, std::shared_ptr<BaseLib::TcpSocket>& socket, std::string& path)
+{
+	try
+	{
+		if(path == "/ipcam/snapshots")
+		{
+			//"ids" is a comma separated list of peer IDs, "timeout" the deadline in milliseconds.
+			std::map<std::string, std::string> arguments = HttpHelper::getArguments(httpRequest.getHeader().args);
+			uint32_t timeout = 5000;
+			if(arguments.find("timeout") != arguments.end())
+			{
+				int32_t value = BaseLib::Math::getNumber(arguments.at("timeout"));
+				if(value > 0) timeout = value > 30000 ? 30000 : value;
+			}
+			std::vector<std::shared_ptr<IpCamPeer>> peers;
+			std::set<uint64_t> peerIds;
+			std::vector<std::string> ids = BaseLib::HelperFunctions::splitAll(arguments["ids"], ',');
+			for(std::vector<std::string>::iterator i = ids.begin(); i != ids.end(); ++i)
+			{
+				uint64_t peerId = BaseLib::Math::getNumber64(BaseLib::HelperFunctions::trim(*i));
+				if(peerId == 0 || !peerIds.insert(peerId).second) continue;
+				std::shared_ptr<IpCamPeer> peer = getPeer(peerId);
+				if(!peer || peer->deleting) continue;
+				peers.push_back(peer);
+			}
+			if(peers.empty() || peers.size() > SnapshotBundle::maxPeers)
+			{
+				socket->proofwrite(HttpHelper::getResponse(400, "Bad Request"));
+				socket->close();
+				return true;
+			}
+			for(std::vector<std::shared_ptr<IpCamPeer>>::iterator i = peers.begin(); i != peers.end(); ++i)
+			{
+				onSnapshotRequest((*i)->getID());
+			}
+			SnapshotBundle::send(socket, peers, timeout);
+			return true;
+		}
+		else if(path == "/ipcam/mosaic.mjpeg")
+		{
+			//Arguments: "ids" (comma separated, 0 for an empty cell), "layout" (e. g. "3x3"), "width", "height" and "fps".
+			std::map<std::string, std::string> arguments = HttpHelper::getArguments(httpRequest.getHeader().args);
+			Mosaic::Definition definition;
+			std::pair<std::string, std::string> layout = BaseLib::HelperFunctions::splitFirst(arguments["layout"], 'x');
+			definition.columns = BaseLib::Math::getNumber(layout.first);
+			definition.rows = BaseLib::Math::getNumber(layout.second);
+			std::vector<std::string> ids = BaseLib::HelperFunctions::splitAll(arguments["ids"], ',');
+			for(std::vector<std::string>::iterator i = ids.begin(); i != ids.end(); ++i)
+			{
+				definition.peerIds.push_back(BaseLib::Math::getNumber64(BaseLib::HelperFunctions::trim(*i)));
+			}
+			if(arguments.find("width") != arguments.end()) definition.width = BaseLib::Math::getNumber(arguments.at("width"));
+			if(arguments.find("height") != arguments.end()) definition.height = BaseLib::Math::getNumber(arguments.at("height"));
+			if(arguments.find("fps") != arguments.end()) definition.fps = BaseLib::Math::getNumber(arguments.at("fps"));
+			if(definition.columns < 1 || definition.columns > 8 || definition.rows < 1 || definition.rows > 8 || definition.peerIds.empty() || definition.peerIds.size() > definition.columns * definition.rows ||
+				definition.width < 160 || definition.width > 3840 || definition.height < 120 || definition.height > 2160 || definition.fps < 1 || definition.fps > 15)
+			{
+				socket->proofwrite(HttpHelper::getResponse(400, "Bad Request"));
+				socket->close();
+				return true;
+			}
+
+			std::shared_ptr<Mosaic> mosaic = getMosaic(definition);
+			if(!mosaic)
+			{
+				socket->proofwrite(HttpHelper::getResponse(404, "Not Found"));
+				socket->close();
+				return true;
+			}
+			std::shared_ptr<FrameQueue> frameQueue = std::make_shared<FrameQueue>(2);
+			mosaic->addConsumer(frameQueue);
+			try
+			{
+				socket->proofwrite(StreamHub::getMultipartHeader());
+				int64_t lastFrameTime = BaseLib::HelperFunctions::getTime();
+				while(!_disposing)
+				{
+					Frame frame = frameQueue->pop(1000);
+					if(!frame)
+					{
+						if(BaseLib::HelperFunctions::getTime() - lastFrameTime >= 30000) break;
+						continue;
+					}
+					lastFrameTime = BaseLib::HelperFunctions::getTime();
+					socket->proofwrite(StreamHub::getPartHeader(frame.size()));
+					socket->proofwrite(frame.data(), frame.size());
+					socket->proofwrite("\r\n", 2);
+				}
+				socket->close();
+			}
+			catch(const BaseLib::SocketOperationException& ex)
+			{
+				GD::out.printInfo("Info: " + std::string(ex.what()));
+			}
+			mosaic->removeConsumer(frameQueue);
+			return true;
+		}
+	}
+	catch(const BaseLib::SocketOperationException& ex)
+	{
+		GD::out.printInfo("Info: " + std::string(ex.what()));
+		return true;
+	}
+	catch(const std::exception& ex)
+	{
+		GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+	}
+	return false;
+}
+
 std::shared_ptr<IpCamPeer> IpCamCentral::createPeer(uint32_t deviceType, std::string serialNumber, bool save)
 {
 	try
@@ -710,4 +1361,41 @@ PVariable IpCamCentral::deleteDevice(BaseLib::PRpcClientInfo clientInfo, uint64_
     return Variable::createError(-32500, "Unknown application error.");
 }
 
+BaseLib::PVariable IpCamCentral::getMotionEvents(const BaseLib::PRpcClientInfo& clientInfo, const BaseLib::PArray& parameters)
+{
+	try
+	{
+		if(parameters->size() != 3 && parameters->size() != 4) return Variable::createError(-1, "Wrong parameter count.");
+		for(BaseLib::Array::iterator i = parameters->begin(); i != parameters->end(); ++i)
+		{
+			if((*i)->type != VariableType::tInteger && (*i)->type != VariableType::tInteger64) return Variable::createError(-1, "All parameters need to be integers.");
+		}
+		uint64_t peerId = parameters->at(0)->integerValue64;
+		int64_t from = parameters->at(1)->integerValue64;
+		int64_t to = parameters->at(2)->integerValue64;
+		int64_t limit = parameters->size() == 4 ? parameters->at(3)->integerValue64 : 1000;
+		if(limit <= 0 || limit > 100000) return Variable::createError(-1, "LIMIT needs to be between 1 and 100000.");
+
+		std::vector<MotionEventLog::Event> events = _motionEventLog->query(peerId, from, to, limit);
+		PVariable result = std::make_shared<Variable>(VariableType::tArray);
+		result->arrayValue->reserve(events.size());
+		for(std::vector<MotionEventLog::Event>::iterator i = events.begin(); i != events.end(); ++i)
+		{
+			PVariable event = std::make_shared<Variable>(VariableType::tStruct);
+			event->structValue->emplace("PEER_ID", std::make_shared<Variable>(i->peerId));
+			event->structValue->emplace("START", std::make_shared<Variable>(i->start));
+			if(i->end != 0) event->structValue->emplace("END", std::make_shared<Variable>(i->end));
+			event->structValue->emplace("SOURCE", std::make_shared<Variable>(i->source == (uint8_t)MotionEventLog::Source::detector ? "detector" : "camera"));
+			if(i->source == (uint8_t)MotionEventLog::Source::detector) event->structValue->emplace("INTENSITY", std::make_shared<Variable>((int32_t)i->intensity));
+			result->arrayValue->push_back(event);
+		}
+		return result;
+	}
+	catch(const std::exception& ex)
+	{
+		GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+	}
+	return Variable::createError(-32500, "Unknown application error.");
+}
+
 }
@@ -31,7 +31,11 @@
 #define IPCAMCENTRAL_H_
 
 #include <homegear-base/BaseLib.h>
+#include "HealthChecker.h"
 #include "IpCamPeer.h"
+#include "Mosaic.h"
+#include "MotionEventLog.h"
+#include "SnapshotPrefetcher.h"
 
 #include <memory>
 #include <mutex>
@@ -40,7 +44,7 @@
 namespace IpCam
 {
 
-class IpCamCentral : public BaseLib::Systems::ICentral
+class IpCamCentral : public BaseLib::Systems::ICentral, public BaseLib::Rpc::IWebserverEventSink
 {
 public:
 	IpCamCentral(ICentralEventSink* eventHandler);
@@ -55,12 +59,38 @@ public:
 	std::shared_ptr<IpCamPeer> getPeer(uint64_t id);
 	std::shared_ptr<IpCamPeer> getPeer(std::string serialNumber);
 
+	/**
+	 * Records a client request of a snapshot for the prefetcher.
+	 */
+	void onSnapshotRequest(uint64_t peerId) { if(_snapshotPrefetcher) _snapshotPrefetcher->onRequest(peerId); }
+
+	std::shared_ptr<MotionEventLog> getMotionEventLog() { return _motionEventLog; }
+
+	// {{{ Webserver events
+		bool onGet(BaseLib::Rpc::PServerInfo& serverInfo, BaseLib::Http& httpRequest, std::shared_ptr<BaseLib::TcpSocket>& socket, std::string& path);
+	// }}}
+
 	virtual PVariable createDevice(BaseLib::PRpcClientInfo clientInfo, int32_t deviceType, std::string serialNumber, int32_t address, int32_t firmwareVersion, std::string interfaceId);
 	virtual PVariable deleteDevice(BaseLib::PRpcClientInfo clientInfo, std::string serialNumber, int32_t flags);
 	virtual PVariable deleteDevice(BaseLib::PRpcClientInfo clientInfo, uint64_t peerID, int32_t flags);
 protected:
 	std::atomic_bool _stopWorkerThread;
 	std::thread _workerThread;
+	std::map<int32_t, BaseLib::PEventHandler> _webserverEventHandlers;
+	std::shared_ptr<SnapshotPrefetcher> _snapshotPrefetcher;
+	std::shared_ptr<MotionEventLog> _motionEventLog;
+	std::mutex _mosaicsMutex;
+	std::map<std::string, std::weak_ptr<Mosaic>> _mosaics;
+
+	/**
+	 * Connection timeout of the health checks in milliseconds.
+	 */
+	static const int32_t _healthCheckTimeout = 5000;
+	std::thread _healthCheckThread;
+	std::atomic<int64_t> _lastHealthCheckTime{0};
+	std::atomic<int64_t> _lastHealthCheckDuration{0};
+	std::atomic<uint64_t> _lastHealthCheckTargets{0};
+	std::atomic<uint64_t> _lastHealthCheckFailures{0};
 
 	virtual void loadPeers();
 	virtual void savePeers(bool full);
@@ -68,8 +98,30 @@ protected:
 	virtual void saveVariables() {}
 	std::shared_ptr<IpCamPeer> createPeer(uint32_t deviceType, std::string serialNumber, bool save = true);
 	void deletePeer(uint64_t id);
+
+	/**
+	 * Returns the running mosaic with the same definition or creates a new one. The mosaic stops when the last viewer
+	 * releases it.
+	 *
+	 * @return Returns nullptr when a peer doesn't exist.
+	 */
+	std::shared_ptr<Mosaic> getMosaic(const Mosaic::Definition& definition);
 	virtual void worker();
+
+	/**
+	 * Checks all cameras whose health check is due once per second.
+	 */
+	void healthCheckWorker();
 	virtual void init();
+
+	// {{{ Family RPC methods
+		/**
+		 * Returns the motion events of a peer in a time range.
+		 *
+		 * Parameters: PEER_ID (0 for all peers), FROM and TO (Unix time in milliseconds), optionally LIMIT (default 1000).
+		 */
+		BaseLib::PVariable getMotionEvents(const BaseLib::PRpcClientInfo& clientInfo, const BaseLib::PArray& parameters);
+	// }}}
 };
 
 }
@@ -32,6 +32,11 @@
 #include "GD.h"
 #include "IpCamPacket.h"
 #include "IpCamCentral.h"
+#include "FrameHash.h"
+#include "HttpHelper.h"
+#include "SegmentPlayer.h"
+#include "SnapshotProxy.h"
+#include "WebSocketStream.h"
 
 #include <iomanip>
 
@@ -97,7 +102,33 @@ void IpCamPeer::worker()
 				raiseEvent(eventSource, _peerID, 1, valueKeys, values);
 				raiseRPCEvent(eventSource, _peerID, 1, address, valueKeys, values);
 			}
+			endMotionEvent(_motionTime);
+			stopClipRecording();
 		}
+		else
+		{
+			//Clips closed after CLIP_MAX_DURATION don't need the stream anymore.
+			std::lock_guard<std::mutex> clipRecorderGuard(_clipRecorderMutex);
+			if(_clipRecorder && !_clipRecorder->isRecording()) _streamHub->removeConsumer(_clipRecorder);
+		}
+		resetMotionZones();
+
+		if(_timelapseInterval > 0 && !_timelapseSampling)
+		{
+			int64_t time = BaseLib::HelperFunctions::getTime();
+			int64_t interval = (int64_t)_timelapseInterval * 1000;
+			if(time - _lastTimelapseSample >= interval)
+			{
+				//Align samples to multiples of the interval
+				_lastTimelapseSample = time - time % interval;
+				_timelapseSampling = true;
+				GD::bl->threadManager.join(_timelapseThread);
+				GD::bl->threadManager.start(_timelapseThread, false, &IpCamPeer::sampleTimelapse, this);
+			}
+		}
+
+		updateSharedFrameRing();
+		updateUpstreamStats();
 	}
 	catch(const std::exception& ex)
 	{
@@ -109,7 +140,9 @@ void IpCamPeer::init()
 {
 	_binaryEncoder.reset(new BaseLib::Rpc::RpcEncoder(_bl));
 	_binaryDecoder.reset(new BaseLib::Rpc::RpcDecoder(_bl));
-	_httpClient.reset(new BaseLib::HttpClient(_bl, "ipcam", 65635, false));
+	_streamHub = std::make_shared<StreamHub>();
+	_circuitBreaker = std::make_shared<CircuitBreaker>([this](bool open) { onReachabilityChanged(open); });
+	_streamHub->setCircuitBreaker(_circuitBreaker);
 	raiseAddWebserverEventHandler(this);
 	std::string httpOkHeader("HTTP/1.1 200 OK\r\nConnection: close\r\n\r\n");
 	_httpOkHeader.insert(_httpOkHeader.end(), httpOkHeader.begin(), httpOkHeader.end());
@@ -119,6 +152,13 @@ void IpCamPeer::dispose()
 {
 	if(_disposing) return;
 	Peer::dispose();
+	stopMotionDetection();
+	stopClipRecording();
+	stopContinuousRecording();
+	stopTimelapse();
+	stopSharedFrameRing();
+	if(_motion) endMotionEvent(_motionTime);
+	_streamHub->stop();
 	GD::out.printInfo("Info: Removing Webserver hooks. If Homegear hangs here, Sockets are still open.");
 	removeHooks();
 }
@@ -149,6 +189,622 @@ void IpCamPeer::homegearShuttingDown()
 		_shuttingDown = true;
 		Peer::homegearShuttingDown();
 		removeHooks();
+		stopMotionDetection();
+		stopClipRecording();
+		stopContinuousRecording();
+		stopTimelapse();
+		stopSharedFrameRing();
+		if(_motion) endMotionEvent(_motionTime);
+		_streamHub->stop();
+	}
+	catch(const std::exception& ex)
+	{
+		GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+	}
+}
+
+std::shared_ptr<FrameBuffer> IpCamPeer::getFrameBuffer()
+{
+	std::lock_guard<std::mutex> frameBufferGuard(_frameBufferMutex);
+	return _frameBuffer;
+}
+
+SnapshotCache::PSnapshot IpCamPeer::getSnapshot(bool* rejected)
+{
+	try
+	{
+		if(_snapshotUrlInfo.ip.empty()) return SnapshotCache::PSnapshot();
+		int64_t requestTime = BaseLib::HelperFunctions::getTime();
+		SnapshotCache::PSnapshot snapshot = _snapshotCache.get();
+		if(snapshot && requestTime - snapshot->time < _snapshotCacheTime) return snapshot;
+
+		//Only one request per camera at a time. Requests waiting here use the snapshot fetched in the meantime.
+		std::lock_guard<std::mutex> snapshotFetchGuard(_snapshotFetchMutex);
+		snapshot = _snapshotCache.get();
+		if(snapshot && (snapshot->time >= requestTime || BaseLib::HelperFunctions::getTime() - snapshot->time < _snapshotCacheTime)) return snapshot;
+		return fetchSnapshot();
+	}
+	catch(const ConnectionLimitException& ex)
+	{
+		if(rejected) *rejected = true;
+		if(_bl->debugLevel >= 4) GD::out.printInfo("Info: Could not get snapshot from camera of peer " + std::to_string(_peerID) + ": " + std::string(ex.what()));
+	}
+	catch(const CircuitOpenException& ex)
+	{
+		if(rejected) *rejected = true;
+		if(_bl->debugLevel >= 5) GD::out.printDebug("Debug: Could not get snapshot from camera of peer " + std::to_string(_peerID) + ": " + std::string(ex.what()));
+	}
+	catch(const BaseLib::HttpClientException& ex)
+	{
+		GD::out.printWarning("Warning: Could not get snapshot from camera of peer " + std::to_string(_peerID) + ": " + std::string(ex.what()));
+	}
+	catch(const std::exception& ex)
+	{
+		GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+	}
+	return SnapshotCache::PSnapshot();
+}
+
+SnapshotCache::PSnapshot IpCamPeer::refreshSnapshot()
+{
+	try
+	{
+		if(_snapshotUrlInfo.ip.empty()) return SnapshotCache::PSnapshot();
+		int64_t requestTime = BaseLib::HelperFunctions::getTime();
+		std::lock_guard<std::mutex> snapshotFetchGuard(_snapshotFetchMutex);
+		SnapshotCache::PSnapshot snapshot = _snapshotCache.get();
+		if(snapshot && snapshot->time >= requestTime) return snapshot;
+		return fetchSnapshot();
+	}
+	catch(const ConnectionLimitException& ex)
+	{
+		if(_bl->debugLevel >= 4) GD::out.printInfo("Info: Could not prefetch snapshot from camera of peer " + std::to_string(_peerID) + ": " + std::string(ex.what()));
+	}
+	catch(const CircuitOpenException& ex)
+	{
+	}
+	catch(const BaseLib::HttpClientException& ex)
+	{
+		GD::out.printWarning("Warning: Could not get snapshot from camera of peer " + std::to_string(_peerID) + ": " + std::string(ex.what()));
+	}
+	catch(const std::exception& ex)
+	{
+		GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+	}
+	return SnapshotCache::PSnapshot();
+}
+
+bool IpCamPeer::snapshotStaleAt(int64_t time)
+{
+	if(_snapshotUrlInfo.ip.empty() || _snapshotCacheTime == 0) return false;
+	SnapshotCache::PSnapshot snapshot = _snapshotCache.get();
+	return !snapshot || time - snapshot->time >= _snapshotCacheTime;
+}
+
+SnapshotCache::PSnapshot IpCamPeer::fetchSnapshot()
+{
+	UrlInfo urlInfo = _snapshotUrlInfo;
+	if(!_circuitBreaker->allowRequest()) throw CircuitOpenException("Camera is unreachable.");
+	ConnectionLimiter::PPermit permit = GD::connectionLimiter->acquire(_peerID, _snapshotAdmissionTimeout);
+	if(!permit) throw ConnectionLimitException("Too many connections to the camera.");
+	CameraConnection connection(urlInfo.ip, urlInfo.port, urlInfo.ssl, _caFile, _verifyCertificate, _connectionTimeouts, _connectionStats, _tlsSessionCache);
+	std::string getRequest = "GET " + urlInfo.path + " HTTP/1.1\r\nUser-Agent: Homegear\r\nHost: " + urlInfo.ip + ":" + std::to_string(urlInfo.port) + "\r\n" + (urlInfo.authorization.empty() ? "" : "Authorization: " + urlInfo.authorization + "\r\n") + "Connection: Close\r\n\r\n";
+	Http response;
+	try
+	{
+		connection.sendRequest(getRequest, response);
+	}
+	catch(const BaseLib::HttpClientException& ex)
+	{
+		if(ex.responseCode() == -1) _circuitBreaker->onFailure();
+		throw;
+	}
+	_circuitBreaker->onSuccess();
+	if(response.getHeader().responseCode != 200)
+	{
+		GD::out.printWarning("Warning: Camera of peer " + std::to_string(_peerID) + " responded to snapshot request with code " + std::to_string(response.getHeader().responseCode) + ".");
+		return SnapshotCache::PSnapshot();
+	}
+	std::string contentType = response.getHeader().contentType.empty() ? std::string("image/jpeg") : response.getHeader().contentType;
+	std::string content(response.getContent().data(), response.getContentSize());
+	_snapshotTooLarge = content.size() > _maxCachedSnapshotSize;
+	return _snapshotCache.set(contentType, std::move(content), BaseLib::HelperFunctions::getTime(), _duplicateFrameDistance);
+}
+
+void IpCamPeer::startClipRecording()
+{
+	try
+	{
+		//Held while starting, so the worker doesn't remove the recorder from the stream before it records.
+		std::lock_guard<std::mutex> clipRecorderGuard(_clipRecorderMutex);
+		std::shared_ptr<ClipRecorder> clipRecorder = _clipRecorder;
+		if(!clipRecorder || clipRecorder->isRecording()) return;
+		std::shared_ptr<FrameBuffer> frameBuffer = getFrameBuffer();
+		_streamHub->addConsumer(clipRecorder, StreamHub::Priority::recording);
+		clipRecorder->start(frameBuffer, BaseLib::HelperFunctions::getTime() - (frameBuffer ? frameBuffer->duration() : 0));
+	}
+	catch(const std::exception& ex)
+	{
+		GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+	}
+}
+
+void IpCamPeer::stopClipRecording()
+{
+	try
+	{
+		std::shared_ptr<ClipRecorder> clipRecorder;
+		{
+			std::lock_guard<std::mutex> clipRecorderGuard(_clipRecorderMutex);
+			clipRecorder = _clipRecorder;
+		}
+		if(!clipRecorder) return;
+		clipRecorder->stop();
+		_streamHub->removeConsumer(clipRecorder);
+	}
+	catch(const std::exception& ex)
+	{
+		GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+	}
+}
+
+void IpCamPeer::triggerMotion(bool raiseEventWhenActive, MotionEventLog::Source source)
+{
+	try
+	{
+		beginMotionEvent(source, BaseLib::HelperFunctions::getTime());
+		if(_motion && !raiseEventWhenActive)
+		{
+			_motionTime = BaseLib::HelperFunctions::getTime();
+			startClipRecording();
+			return;
+		}
+
+		BaseLib::Systems::RpcConfigurationParameter& parameter = valuesCentral[1]["MOTION"];
+		if(!parameter.rpcParameter) return;
+		std::vector<uint8_t> parameterData{ 1 };
+		parameter.setBinaryData(parameterData);
+		if(parameter.databaseId > 0) saveParameter(parameter.databaseId, parameterData);
+		else saveParameter(0, ParameterGroup::Type::Enum::variables, 1, "MOTION", parameterData);
+		if(_bl->debugLevel >= 4) GD::out.printInfo("Info: MOTION of peer " + std::to_string(_peerID) + " with serial number " + _serialNumber + ":1 was set to true.");
+		std::shared_ptr<std::vector<std::string>> valueKeys(new std::vector<std::string>{ "MOTION" });
+		std::shared_ptr<std::vector<PVariable>> values(new std::vector<PVariable> { parameter.rpcParameter->convertFromPacket(parameterData, parameter.mainRole(), true) });
+		_motion = true;
+		_motionTime = BaseLib::HelperFunctions::getTime();
+		std::string eventSource = "device-" + std::to_string(_peerID);
+		std::string address(_serialNumber + ":1");
+		raiseEvent(eventSource, _peerID, 1, valueKeys, values);
+		raiseRPCEvent(eventSource, _peerID, 1, address, valueKeys, values);
+		BaseLib::Systems::RpcConfigurationParameter& parameter2 = configCentral[0]["RESET_MOTION_AFTER"];
+		if(parameter2.rpcParameter)
+		{
+			parameterData = parameter2.getBinaryData();
+			_resetMotionAfter = parameter2.rpcParameter->convertFromPacket(parameterData, parameter2.mainRole(), false)->integerValue * 1000;
+			if(_resetMotionAfter < 5000) _resetMotionAfter = 5000;
+			else if(_resetMotionAfter > MotionEventLog::maxResetTime) _resetMotionAfter = MotionEventLog::maxResetTime;
+		}
+		startClipRecording();
+	}
+	catch(const std::exception& ex)
+	{
+		GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+	}
+}
+
+void IpCamPeer::beginMotionEvent(MotionEventLog::Source source, int64_t time)
+{
+	try
+	{
+		std::shared_ptr<IpCamCentral> central = std::dynamic_pointer_cast<IpCamCentral>(getCentral());
+		if(!central) return;
+		std::lock_guard<std::mutex> motionEventGuard(_motionEventMutex);
+		if(_motionEventHandle)
+		{
+			if(time - _motionEvent.start < MotionEventLog::maxEventDuration) return;
+			_motionEvent.end = time;
+			central->getMotionEventLog()->update(_motionEventHandle, _motionEvent);
+		}
+		_motionEvent = MotionEventLog::Event{};
+		_motionEvent.peerId = _peerID;
+		_motionEvent.start = time;
+		_motionEvent.source = (uint8_t)source;
+		_motionEventHandle = central->getMotionEventLog()->add(_motionEvent);
+	}
+	catch(const std::exception& ex)
+	{
+		GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+	}
+}
+
+void IpCamPeer::endMotionEvent(int64_t time)
+{
+	try
+	{
+		std::shared_ptr<IpCamCentral> central = std::dynamic_pointer_cast<IpCamCentral>(getCentral());
+		if(!central) return;
+		std::lock_guard<std::mutex> motionEventGuard(_motionEventMutex);
+		if(!_motionEventHandle) return;
+		_motionEvent.end = time > _motionEvent.start ? time : _motionEvent.start;
+		central->getMotionEventLog()->update(_motionEventHandle, _motionEvent);
+		_motionEventHandle.reset();
+	}
+	catch(const std::exception& ex)
+	{
+		GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+	}
+}
+
+void IpCamPeer::onMotionDetected(const MotionDetector::Result& result)
+{
+	try
+	{
+		if(result.motion)
+		{
+			triggerMotion(false, MotionEventLog::Source::detector);
+			std::lock_guard<std::mutex> motionEventGuard(_motionEventMutex);
+			if(result.intensity > _motionEvent.intensity) _motionEvent.intensity = result.intensity > 255 ? 255 : result.intensity;
+		}
+
+		int64_t time = BaseLib::HelperFunctions::getTime();
+		std::shared_ptr<std::vector<std::string>> valueKeys = std::make_shared<std::vector<std::string>>();
+		std::shared_ptr<std::vector<PVariable>> values = std::make_shared<std::vector<PVariable>>();
+		{
+			std::lock_guard<std::mutex> motionZonesGuard(_motionZonesMutex);
+			for(uint32_t i = 0; i < MotionDetector::maxZones; i++)
+			{
+				if(!(result.zones & (1 << i))) continue;
+				_motionZoneTimes[i] = time;
+				if(_motionZones & (1 << i)) continue;
+				_motionZones |= 1 << i;
+				valueKeys->push_back("MOTION_ZONE_" + std::to_string(i + 1));
+				values->push_back(std::make_shared<Variable>(true));
+			}
+
+			//The intensity changes with every sample, so publish it at most once per second.
+			if(result.motion && result.intensity != _motionIntensity && time - _motionIntensityTime >= 1000)
+			{
+				_motionIntensity = result.intensity;
+				_motionIntensityTime = time;
+				valueKeys->push_back("MOTION_INTENSITY");
+				values->push_back(std::make_shared<Variable>((int32_t)result.intensity));
+			}
+		}
+		if(!valueKeys->empty()) setVariables(1, valueKeys, values);
+	}
+	catch(const std::exception& ex)
+	{
+		GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+	}
+}
+
+void IpCamPeer::resetMotionZones()
+{
+	try
+	{
+		int64_t time = BaseLib::HelperFunctions::getTime();
+		std::shared_ptr<std::vector<std::string>> valueKeys;
+		std::shared_ptr<std::vector<PVariable>> values;
+		{
+			std::lock_guard<std::mutex> motionZonesGuard(_motionZonesMutex);
+			if(_motionZones == 0 && (_motionIntensity == 0 || _motion)) return;
+			valueKeys = std::make_shared<std::vector<std::string>>();
+			values = std::make_shared<std::vector<PVariable>>();
+			for(uint32_t i = 0; i < MotionDetector::maxZones; i++)
+			{
+				if(!(_motionZones & (1 << i)) || _motionZoneTimes[i] + _resetMotionAfter > time) continue;
+				_motionZones &= ~(1 << i);
+				valueKeys->push_back("MOTION_ZONE_" + std::to_string(i + 1));
+				values->push_back(std::make_shared<Variable>(false));
+			}
+			if(_motionIntensity != 0 && !_motion)
+			{
+				_motionIntensity = 0;
+				valueKeys->push_back("MOTION_INTENSITY");
+				values->push_back(std::make_shared<Variable>(0));
+			}
+		}
+		if(!valueKeys->empty()) setVariables(1, valueKeys, values);
+	}
+	catch(const std::exception& ex)
+	{
+		GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+	}
+}
+
+void IpCamPeer::stopMotionDetection()
+{
+	try
+	{
+		std::lock_guard<std::mutex> motionDetectorGuard(_motionDetectorMutex);
+		if(!_motionDetector) return;
+		_streamHub->removeConsumer(_motionDetector);
+		_motionDetector.reset();
+	}
+	catch(const std::exception& ex)
+	{
+		GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+	}
+}
+
+void IpCamPeer::stopContinuousRecording()
+{
+	try
+	{
+		std::lock_guard<std::mutex> continuousRecorderGuard(_continuousRecorderMutex);
+		if(!_continuousRecorder) return;
+		_streamHub->removeConsumer(_continuousRecorder);
+		_continuousRecorder->stop();
+		_continuousRecorder.reset();
+	}
+	catch(const std::exception& ex)
+	{
+		GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+	}
+}
+
+void IpCamPeer::stopTimelapse()
+{
+	try
+	{
+		{
+			std::lock_guard<std::mutex> timelapseGuard(_timelapseMutex);
+			_timelapseInterval = 0;
+			_timelapseArchive.reset();
+		}
+		GD::bl->threadManager.join(_timelapseThread);
+	}
+	catch(const std::exception& ex)
+	{
+		GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+	}
+}
+
+void IpCamPeer::stopSharedFrameRing()
+{
+	try
+	{
+		std::lock_guard<std::mutex> sharedFrameRingGuard(_sharedFrameRingMutex);
+		if(!_sharedFrameRing) return;
+		if(_sharedFrameRingConsumer) _streamHub->removeConsumer(_sharedFrameRing);
+		_sharedFrameRingConsumer = false;
+		_sharedFrameRing.reset();
+	}
+	catch(const std::exception& ex)
+	{
+		GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+	}
+}
+
+void IpCamPeer::updateSharedFrameRing()
+{
+	try
+	{
+		std::lock_guard<std::mutex> sharedFrameRingGuard(_sharedFrameRingMutex);
+		if(!_sharedFrameRing) return;
+		bool readerActive = _sharedFrameRing->readerActive();
+		if(readerActive == _sharedFrameRingConsumer) return;
+		if(readerActive)
+		{
+			if(_bl->debugLevel >= 4) GD::out.printInfo("Info: Shared memory reader of peer " + std::to_string(_peerID) + " is active. Starting stream.");
+			_streamHub->addConsumer(_sharedFrameRing, StreamHub::Priority::detection);
+		}
+		else
+		{
+			if(_bl->debugLevel >= 4) GD::out.printInfo("Info: No shared memory reader of peer " + std::to_string(_peerID) + " is active anymore.");
+			_streamHub->removeConsumer(_sharedFrameRing);
+		}
+		_sharedFrameRingConsumer = readerActive;
+	}
+	catch(const std::exception& ex)
+	{
+		GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+	}
+}
+
+void IpCamPeer::sampleTimelapse()
+{
+	try
+	{
+		std::shared_ptr<TimelapseArchive> archive;
+		{
+			std::lock_guard<std::mutex> timelapseGuard(_timelapseMutex);
+			archive = _timelapseArchive;
+		}
+		if(archive && !_disposing && !deleting)
+		{
+			int32_t duplicateDistance = _duplicateFrameDistance;
+			Frame frame = _streamHub->latestFrame();
+			if(frame && BaseLib::HelperFunctions::getTime() - frame.time() < 2000)
+			{
+				GD::recordingWriter->post([archive, frame, duplicateDistance]() { archive->append(frame.time(), frame.data(), frame.size(), duplicateDistance); });
+			}
+			else
+			{
+				SnapshotCache::PSnapshot snapshot = getSnapshot();
+				if(snapshot) GD::recordingWriter->post([archive, snapshot, duplicateDistance]() { archive->append(snapshot->time, snapshot->content.data(), snapshot->content.size(), duplicateDistance); });
+				else if(_bl->debugLevel >= 4) GD::out.printInfo("Info: Skipping time-lapse image of peer " + std::to_string(_peerID) + ": No image available.");
+			}
+		}
+	}
+	catch(const std::exception& ex)
+	{
+		GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+	}
+	_timelapseSampling = false;
+}
+
+void IpCamPeer::updateUpstreamStats()
+{
+	try
+	{
+		int64_t time = BaseLib::HelperFunctions::getTime();
+		if(time - _lastUpstreamStatsTime < _upstreamStatsInterval) return;
+		_lastUpstreamStatsTime = time;
+
+		StreamHub::UpstreamStats hubStats = _streamHub->getUpstreamStats();
+		if(GD::relayClient)
+		{
+			uint64_t relayBytesReceived = 0;
+			uint64_t relayFrames = 0;
+			std::vector<RelayProtocol::PeerStats> relayStats = GD::relayClient->getStats();
+			for(std::vector<RelayProtocol::PeerStats>::iterator i = relayStats.begin(); i != relayStats.end(); ++i)
+			{
+				if(i->peerId != _peerID) continue;
+				relayBytesReceived = i->bytesReceived;
+				relayFrames = i->frames;
+				break;
+			}
+			//The relay's counters start at 0 again when it removes an idle upstream.
+			_relayBytesReceived += relayBytesReceived >= _lastRelayBytesReceived ? relayBytesReceived - _lastRelayBytesReceived : relayBytesReceived;
+			_relayFrames += relayFrames >= _lastRelayFrames ? relayFrames - _lastRelayFrames : relayFrames;
+			_lastRelayBytesReceived = relayBytesReceived;
+			_lastRelayFrames = relayFrames;
+		}
+
+		UpstreamSample sample;
+		sample.time = time;
+		sample.bytes = hubStats.bytesReceived + _relayBytesReceived;
+		sample.frames = hubStats.frames + _relayFrames;
+		_upstreamSamples.push_back(sample);
+		while(_upstreamSamples.size() > 2 && time - _upstreamSamples.at(1).time >= _upstreamStatsWindow) _upstreamSamples.pop_front();
+		if(_upstreamSamples.size() < 2) return;
+
+		const UpstreamSample& first = _upstreamSamples.front();
+		int64_t duration = time - first.time;
+		if(duration <= 0) return;
+		int32_t bitrate = (int32_t)((sample.bytes - first.bytes) * 8 / duration);
+		//In hundredths of frames per second
+		int32_t fps = (int32_t)((sample.frames - first.frames) * 100000 / duration);
+		if(bitrate == _upstreamBitrate && fps == _upstreamFps) return;
+		_upstreamBitrate = bitrate;
+		_upstreamFps = fps;
+
+		std::shared_ptr<std::vector<std::string>> valueKeys(new std::vector<std::string>{ "UPSTREAM_BITRATE", "UPSTREAM_FPS" });
+		std::shared_ptr<std::vector<PVariable>> values(new std::vector<PVariable>{ std::make_shared<Variable>(bitrate), std::make_shared<Variable>((double)fps / 100.0) });
+		setVariables(1, valueKeys, values);
+	}
+	catch(const std::exception& ex)
+	{
+		GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+	}
+}
+
+void IpCamPeer::onReachabilityChanged(bool unreachable)
+{
+	try
+	{
+		if(_disposing || deleting) return;
+		if(unreachable) GD::out.printWarning("Warning: Camera of peer " + std::to_string(_peerID) + " is unreachable. Requests fail immediately until it answers again.");
+		else GD::out.printInfo("Info: Camera of peer " + std::to_string(_peerID) + " is reachable again.");
+		if(serviceMessages) serviceMessages->setUnreach(unreachable, false);
+	}
+	catch(const std::exception& ex)
+	{
+		GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+	}
+}
+
+bool IpCamPeer::healthCheckDue(int64_t time, std::string& host, int32_t& port)
+{
+	try
+	{
+		if(_disposing || deleting) return false;
+		UrlInfo urlInfo = _streamUrlInfo.ip.empty() ? _snapshotUrlInfo : _streamUrlInfo;
+		if(urlInfo.ip.empty()) return false;
+		if(_circuitBreaker->isOpen())
+		{
+			if(!_circuitBreaker->probeDue(time)) return false;
+			_breakerProbe = true;
+		}
+		else
+		{
+			if(GD::healthCheckInterval == 0) return false;
+			//A running stream proves that the camera is reachable.
+			if(_streamHub->getUpstreamStats().connected)
+			{
+				_lastHealthCheck = time;
+				_lastHealthCheckFailed = false;
+				return false;
+			}
+			int64_t interval = _lastHealthCheckFailed ? _healthCheckRetryInterval : (int64_t)GD::healthCheckInterval * 1000;
+			if(time - _lastHealthCheck < interval) return false;
+			_breakerProbe = false;
+		}
+		_lastHealthCheck = time;
+		host = urlInfo.ip;
+		port = urlInfo.port;
+		return true;
+	}
+	catch(const std::exception& ex)
+	{
+		GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+	}
+	return false;
+}
+
+void IpCamPeer::onHealthCheckResult(bool reachable)
+{
+	try
+	{
+		if(_bl->debugLevel >= 5) GD::out.printDebug("Debug: Health check of peer " + std::to_string(_peerID) + (reachable ? " succeeded." : " failed."));
+		_lastHealthCheckFailed = !reachable;
+		if(_breakerProbe)
+		{
+			_breakerProbe = false;
+			_circuitBreaker->onProbeResult(reachable);
+		}
+		else if(reachable) _circuitBreaker->onSuccess();
+		else _circuitBreaker->onFailure();
+	}
+	catch(const std::exception& ex)
+	{
+		GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+	}
+}
+
+bool IpCamPeer::rejectUnreachable(std::shared_ptr<BaseLib::TcpSocket>& socket)
+{
+	if(!_circuitBreaker->isOpen()) return false;
+	socket->proofwrite(HttpHelper::getResponse(503, "Service Unavailable", "Retry-After: " + std::to_string(_circuitBreaker->retryAfter(BaseLib::HelperFunctions::getTime())) + "\r\n"));
+	socket->close();
+	return true;
+}
+
+void IpCamPeer::onClipClosed(const std::string& path, int64_t duration)
+{
+	try
+	{
+		if(_disposing || deleting) return;
+		std::shared_ptr<std::vector<std::string>> valueKeys(new std::vector<std::string>{ "LAST_CLIP", "LAST_CLIP_DURATION" });
+		std::shared_ptr<std::vector<PVariable>> values(new std::vector<PVariable>{ std::make_shared<Variable>(path), std::make_shared<Variable>((int32_t)((duration + 500) / 1000)) });
+		setVariables(1, valueKeys, values);
+	}
+	catch(const std::exception& ex)
+	{
+		GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+	}
+}
+
+void IpCamPeer::setVariables(uint32_t channel, std::shared_ptr<std::vector<std::string>> valueKeys, std::shared_ptr<std::vector<PVariable>> values)
+{
+	try
+	{
+		for(size_t i = 0; i < valueKeys->size(); i++)
+		{
+			BaseLib::Systems::RpcConfigurationParameter& parameter = valuesCentral[channel][valueKeys->at(i)];
+			if(!parameter.rpcParameter) continue;
+			std::vector<uint8_t> parameterData;
+			parameter.rpcParameter->convertToPacket(values->at(i), parameter.mainRole(), parameterData);
+			parameter.setBinaryData(parameterData);
+			if(parameter.databaseId > 0) saveParameter(parameter.databaseId, parameterData);
+			else saveParameter(0, ParameterGroup::Type::Enum::variables, channel, valueKeys->at(i), parameterData);
+			if(_bl->debugLevel >= 4) GD::out.printInfo("Info: " + valueKeys->at(i) + " of peer " + std::to_string(_peerID) + " with serial number " + _serialNumber + ":" + std::to_string(channel) + " was updated.");
+		}
+
+		std::string eventSource = "device-" + std::to_string(_peerID);
+		std::string address(_serialNumber + ":" + std::to_string(channel));
+		raiseEvent(eventSource, _peerID, channel, valueKeys, values);
+		raiseRPCEvent(eventSource, _peerID, channel, address, valueKeys, values);
 	}
 	catch(const std::exception& ex)
 	{
@@ -341,13 +997,30 @@ bool IpCamPeer::load(BaseLib::Systems::ICentral* central)
 				else saveParameter(0, ParameterGroup::Type::Enum::variables, 1, "MOTION", parameterData);
 			}
 		}
+		//Make sure zones and intensity are reset when the module was stopped during motion
+		for(uint32_t i = 0; i < MotionDetector::maxZones; i++)
+		{
+			BaseLib::Systems::RpcConfigurationParameter& zoneParameter = valuesCentral[1]["MOTION_ZONE_" + std::to_string(i + 1)];
+			if(!zoneParameter.rpcParameter) continue;
+			std::vector<uint8_t> parameterData = zoneParameter.getBinaryData();
+			if(parameterData.empty() || !parameterData.at(0)) continue;
+			_motionZones |= 1 << i;
+			_motionZoneTimes[i] = BaseLib::HelperFunctions::getTime();
+		}
+		BaseLib::Systems::RpcConfigurationParameter& intensityParameter = valuesCentral[1]["MOTION_INTENSITY"];
+		if(intensityParameter.rpcParameter)
+		{
+			std::vector<uint8_t> parameterData = intensityParameter.getBinaryData();
+			_motionIntensity = intensityParameter.rpcParameter->convertFromPacket(parameterData, intensityParameter.mainRole(), false)->integerValue;
+		}
+
         BaseLib::Systems::RpcConfigurationParameter& parameter2 = configCentral[0]["RESET_MOTION_AFTER"];
 		if(parameter2.rpcParameter)
 		{
 			std::vector<uint8_t> parameterData = parameter2.getBinaryData();
 			_resetMotionAfter = parameter2.rpcParameter->convertFromPacket(parameterData, parameter2.mainRole(), false)->integerValue * 1000;
 			if(_resetMotionAfter < 5000) _resetMotionAfter = 5000;
-			else if(_resetMotionAfter > 3600000) _resetMotionAfter = 3600000;
+			else if(_resetMotionAfter > MotionEventLog::maxResetTime) _resetMotionAfter = MotionEventLog::maxResetTime;
 		}
 
 		return true;
@@ -391,6 +1064,7 @@ PParameterGroup IpCamPeer::getParameterSet(int32_t channel, ParameterGroup::Type
 // {{{ Webserver events
 	bool IpCamPeer::onGet(BaseLib::Rpc::PServerInfo& serverInfo, BaseLib::Http& httpRequest, std::shared_ptr<BaseLib::TcpSocket>& socket, std::string& path)
 	{
+		std::string clipsPrefix("/ipcam/" + std::to_string(_peerID) + "/clips/");
 		if(path == "/ipcam/" + std::to_string(_peerID) + "/stream.mjpeg")
 		{
 			if(_streamUrlInfo.ip.empty())
@@ -398,29 +1072,94 @@ PParameterGroup IpCamPeer::getParameterSet(int32_t channel, ParameterGroup::Type
 				GD::out.printWarning("Warning: Can't open stream for peer with id " + std::to_string(_peerID) + ": IP address is empty.");
 				return false;
 			}
-			BaseLib::TcpSocket cameraSocket(_bl, _streamUrlInfo.ip, std::to_string(_streamUrlInfo.port), _streamUrlInfo.ssl, _caFile, _verifyCertificate);
-			try
+			if(rejectUnreachable(socket)) return true;
+			//"fps" limits the frame rate. Decimated viewers also skip unchanged frames (see DUPLICATE_FRAME_DISTANCE).
+			std::map<std::string, std::string> arguments = HttpHelper::getArguments(httpRequest.getHeader().args);
+			int64_t minFrameInterval = 0;
+			if(arguments.find("fps") != arguments.end())
 			{
-				std::string response;
-				cameraSocket.open();
-				cameraSocket.setReadTimeout(30000000);
-				int32_t bufferMax = 2048;
-				char buffer[bufferMax + 1];
-				ssize_t receivedBytes;
-				std::string getRequest = "GET " + _streamUrlInfo.path + " HTTP/1.1\r\nUser-Agent: Homegear\r\nHost: " + _streamUrlInfo.ip + ":" + std::to_string(_streamUrlInfo.port) + "\r\nConnection: " + "Close" + "\r\n";
-				for(std::map<std::string, std::string>::iterator i = httpRequest.getHeader().fields.begin(); i != httpRequest.getHeader().fields.end(); ++i)
+				double fps = BaseLib::Math::getDouble(arguments.at("fps"));
+				if(fps > 0) minFrameInterval = 1000.0 / fps;
+			}
+			int32_t duplicateFrameDistance = minFrameInterval > 0 ? _duplicateFrameDistance : -1;
+
+			//The relay only handles plain TCP connections and doesn't decode frames.
+			if(GD::relayClient && !serverInfo->ssl && !_streamUrlInfo.ssl && duplicateFrameDistance == -1)
+			{
+				RelayProtocol::StreamRequest request;
+				request.host = _streamUrlInfo.ip;
+				request.port = _streamUrlInfo.port;
+				request.path = _streamUrlInfo.path;
+				request.authorization = _streamUrlInfo.authorization;
+				request.minFrameInterval = minFrameInterval;
+				request.maxRate = _upstreamRateLimit;
+				BaseLib::PFileDescriptor fileDescriptor = socket->getFileDescriptor();
+				bool rejected = false;
+				if(fileDescriptor && GD::relayClient->relay(_peerID, request, fileDescriptor->descriptor, [this]() { return _disposing || deleting || _shuttingDown; }, &rejected))
 				{
-					if(i->first == "user-agent" || i->first == "host" || i->first == "connection") continue;
-					getRequest += i->first + ": " + i->second + "\r\n";
+					socket->close();
+					return true;
 				}
-				getRequest += "\r\n";
-				cameraSocket.proofwrite(getRequest);
+				else if(rejected)
+				{
+					socket->proofwrite(HttpHelper::getResponse(503, "Service Unavailable", "Retry-After: 5\r\n"));
+					socket->close();
+					return true;
+				}
+			}
+
+			std::shared_ptr<FrameQueue> frameQueue = std::make_shared<FrameQueue>(2);
+			_streamHub->addConsumer(frameQueue, minFrameInterval > 0 ? StreamHub::Priority::decimated : StreamHub::Priority::live, minFrameInterval);
+			try
+			{
+				//The response header is sent with the first frame, so "503" can still be sent when the connection limits
+				//don't allow to open the stream.
+				int64_t startTime = BaseLib::HelperFunctions::getTime();
+				bool headerSent = false;
+				int64_t lastFrameTime = startTime;
+				Frame lastSentFrame;
 				while(!_disposing && !deleting && !_shuttingDown)
 				{
-					receivedBytes = cameraSocket.proofread(buffer, bufferMax);
-					socket->proofwrite(buffer, receivedBytes);
+					Frame frame = frameQueue->pop(1000);
+					if(!frame)
+					{
+						if(!headerSent)
+						{
+							if(_streamHub->lastRejectionTime() >= startTime)
+							{
+								socket->proofwrite(HttpHelper::getResponse(503, "Service Unavailable", "Retry-After: 5\r\n"));
+								break;
+							}
+							if(BaseLib::HelperFunctions::getTime() - startTime >= 10000)
+							{
+								socket->proofwrite(StreamHub::getMultipartHeader());
+								headerSent = true;
+							}
+						}
+						if(BaseLib::HelperFunctions::getTime() - lastFrameTime >= 30000)
+						{
+							GD::out.printWarning("Warning: No frames received from camera of peer " + std::to_string(_peerID) + " for 30 seconds. Closing stream.");
+							break;
+						}
+						continue;
+					}
+					lastFrameTime = BaseLib::HelperFunctions::getTime();
+					if(!headerSent)
+					{
+						socket->proofwrite(StreamHub::getMultipartHeader());
+						headerSent = true;
+					}
+					if(lastSentFrame)
+					{
+						if(frame.time() - lastSentFrame.time() < minFrameInterval) continue;
+						//Send unchanged frames every 10 seconds, so clients don't time out.
+						if(duplicateFrameDistance >= 0 && frame.time() - lastSentFrame.time() < 10000 && FrameHash::similar(frame, lastSentFrame, duplicateFrameDistance)) continue;
+					}
+					if(minFrameInterval > 0) lastSentFrame = frame;
+					socket->proofwrite(StreamHub::getPartHeader(frame.size()));
+					socket->proofwrite(frame.data(), frame.size());
+					socket->proofwrite("\r\n", 2);
 				}
-				cameraSocket.close();
 				socket->close();
 			}
 			catch(BaseLib::SocketDataLimitException& ex)
@@ -435,6 +1174,33 @@ PParameterGroup IpCamPeer::getParameterSet(int32_t channel, ParameterGroup::Type
 			{
 				GD::out.printError("Error: " + std::string(ex.what()));
 			}
+			_streamHub->removeConsumer(frameQueue);
+			return true;
+		}
+		else if(path == "/ipcam/" + std::to_string(_peerID) + "/ws")
+		{
+			if(_streamUrlInfo.ip.empty())
+			{
+				GD::out.printWarning("Warning: Can't open stream for peer with id " + std::to_string(_peerID) + ": IP address is empty.");
+				return false;
+			}
+			if(rejectUnreachable(socket)) return true;
+			//"fps" sets the initial frame rate. The client can change it later (see WebSocketStream).
+			std::map<std::string, std::string> arguments = HttpHelper::getArguments(httpRequest.getHeader().args);
+			double fps = arguments["fps"].empty() ? 0 : BaseLib::Math::getDouble(arguments["fps"]);
+			try
+			{
+				WebSocketStream webSocketStream(_peerID, socket, serverInfo->ssl);
+				if(webSocketStream.handshake(httpRequest)) webSocketStream.run(_streamHub, fps, [this]() { return _disposing || deleting || _shuttingDown; });
+			}
+			catch(const BaseLib::SocketOperationException& ex)
+			{
+				GD::out.printInfo("Info: WebSocket of peer " + std::to_string(_peerID) + " closed: " + ex.what());
+			}
+			catch(const std::exception& ex)
+			{
+				GD::out.printWarning("Warning: " + std::string(ex.what()));
+			}
 			return true;
 		}
 		else if(path == "/ipcam/" + std::to_string(_peerID) + "/snapshot.jpg")
@@ -446,20 +1212,71 @@ PParameterGroup IpCamPeer::getParameterSet(int32_t channel, ParameterGroup::Type
 			}
 			try
 			{
-				_httpClient.reset(new BaseLib::HttpClient(_bl, _snapshotUrlInfo.ip, _snapshotUrlInfo.port, false, _snapshotUrlInfo.ssl, _caFile, _verifyCertificate));
-				std::string getRequest = "GET " + _snapshotUrlInfo.path + " HTTP/1.1\r\nUser-Agent: Homegear\r\nHost: " + _snapshotUrlInfo.ip + ":" + std::to_string(_snapshotUrlInfo.port) + "\r\nConnection: " + "Close" + "\r\n\r\n";
-				Http response;
-				_httpClient->sendRequest(getRequest, response, false);
-				socket->proofwrite(response.getRawHeader());
-				socket->proofwrite(response.getContent());
+				std::shared_ptr<IpCamCentral> central = std::dynamic_pointer_cast<IpCamCentral>(getCentral());
+				if(central) central->onSnapshotRequest(_peerID);
+				if(rejectUnreachable(socket)) return true;
+
+				SnapshotCache::PSnapshot snapshot = _snapshotCache.get();
+				std::string ifNoneMatch = httpRequest.getHeader().fields["if-none-match"];
+				if((_snapshotCacheTime == 0 || _snapshotTooLarge) && (!snapshot || BaseLib::HelperFunctions::getTime() - snapshot->time >= _snapshotCacheTime) && ifNoneMatch.empty())
+				{
+					//Nothing to revalidate and nothing to cache: Pass the response of the camera through while it is received. All
+					//other requests go through getSnapshot(), which coalesces concurrent fetches and sets the ETag.
+					UrlInfo urlInfo = _snapshotUrlInfo;
+					SnapshotProxy::Upstream upstream;
+					upstream.host = urlInfo.ip;
+					upstream.port = urlInfo.port;
+					upstream.path = urlInfo.path;
+					upstream.ssl = urlInfo.ssl;
+					upstream.caFile = _caFile;
+					upstream.verifyCertificate = _verifyCertificate;
+					upstream.authorization = urlInfo.authorization;
+					upstream.timeouts = _connectionTimeouts;
+					upstream.stats = _connectionStats;
+					upstream.tlsSessionCache = _tlsSessionCache;
+					ConnectionLimiter::PPermit permit = GD::connectionLimiter->acquire(_peerID, _snapshotAdmissionTimeout);
+					if(!permit)
+					{
+						socket->proofwrite(HttpHelper::getResponse(503, "Service Unavailable", "Retry-After: 2\r\n"));
+						socket->close();
+						return true;
+					}
+					SnapshotProxy::Result result = SnapshotProxy::forward(upstream, socket, _snapshotCacheTime > 0 ? _maxCachedSnapshotSize : 0);
+					if(result.responseCode == -1) _circuitBreaker->onFailure();
+					else _circuitBreaker->onSuccess();
+					if(result.responseCode == -1) socket->proofwrite(HttpHelper::getResponse(502, "Bad Gateway"));
+					else if(result.responseCode != 200) GD::out.printWarning("Warning: Camera of peer " + std::to_string(_peerID) + " responded to snapshot request with code " + std::to_string(result.responseCode) + ".");
+					else
+					{
+						_snapshotTooLarge = result.bodySize > _maxCachedSnapshotSize;
+						if(result.contentComplete) _snapshotCache.set(result.contentType.empty() ? std::string("image/jpeg") : result.contentType, std::move(result.content), BaseLib::HelperFunctions::getTime(), _duplicateFrameDistance);
+					}
+					socket->close();
+					return true;
+				}
+
+				bool rejected = false;
+				snapshot = getSnapshot(&rejected);
+				if(!snapshot && rejected && _circuitBreaker->isOpen()) socket->proofwrite(HttpHelper::getResponse(503, "Service Unavailable", "Retry-After: " + std::to_string(_circuitBreaker->retryAfter(BaseLib::HelperFunctions::getTime())) + "\r\n"));
+				else if(!snapshot) socket->proofwrite(rejected ? HttpHelper::getResponse(503, "Service Unavailable", "Retry-After: 2\r\n") : HttpHelper::getResponse(502, "Bad Gateway"));
+				else if(SnapshotCache::matches(httpRequest.getHeader().fields["if-none-match"], snapshot->etag))
+				{
+					socket->proofwrite("HTTP/1.1 304 Not Modified\r\nETag: " + snapshot->etag + "\r\nCache-Control: no-cache\r\nConnection: close\r\n\r\n");
+				}
+				else
+				{
+					socket->proofwrite("HTTP/1.1 200 OK\r\nContent-Type: " + snapshot->contentType + "\r\nContent-Length: " + std::to_string(snapshot->content.size()) + "\r\nETag: " + snapshot->etag + "\r\nCache-Control: no-cache\r\nConnection: close\r\n\r\n");
+					socket->proofwrite(snapshot->content);
+				}
+				socket->close();
 			}
-			catch(const BaseLib::HttpClientException& ex)
+			catch(const BaseLib::SocketOperationException& ex)
 			{
-				GD::out.printWarning("Warning" + std::string(ex.what()));
+				GD::out.printInfo("Info: " + std::string(ex.what()));
 			}
 			catch(const std::exception& ex)
 			{
-				GD::out.printWarning("Warning" + std::string(ex.what()));
+				GD::out.printWarning("Warning: " + std::string(ex.what()));
 			}
 			return true;
 		}
@@ -478,31 +1295,57 @@ PParameterGroup IpCamPeer::getParameterSet(int32_t channel, ParameterGroup::Type
 			{
 				GD::out.printError("Error: " + std::string(ex.what()));
 			}
-			BaseLib::Systems::RpcConfigurationParameter& parameter = valuesCentral[1]["MOTION"];
-			if(!parameter.rpcParameter) return true;
-			std::vector<uint8_t> parameterData{ 1 };
-			parameter.setBinaryData(parameterData);
-			if(parameter.databaseId > 0) saveParameter(parameter.databaseId, parameterData);
-			else saveParameter(0, ParameterGroup::Type::Enum::variables, 1, "MOTION", parameterData);
-			if(_bl->debugLevel >= 4) GD::out.printInfo("Info: MOTION of peer " + std::to_string(_peerID) + " with serial number " + _serialNumber + ":1 was set to true.");
-			std::shared_ptr<std::vector<std::string>> valueKeys(new std::vector<std::string>{ "MOTION" });
-			std::shared_ptr<std::vector<PVariable>> values(new std::vector<PVariable> { parameter.rpcParameter->convertFromPacket(parameterData, parameter.mainRole(), true) });
-			_motion = true;
-			_motionTime = BaseLib::HelperFunctions::getTime();
-			std::string eventSource = "device-" + std::to_string(_peerID);
-			std::string address(_serialNumber + ":1");
-			raiseEvent(eventSource, _peerID, 1, valueKeys, values);
-			raiseRPCEvent(eventSource, _peerID, 1, address, valueKeys, values);
-            BaseLib::Systems::RpcConfigurationParameter& parameter2 = configCentral[0]["RESET_MOTION_AFTER"];
-			if(parameter2.rpcParameter)
-			{
-				parameterData = parameter2.getBinaryData();
-				_resetMotionAfter = parameter2.rpcParameter->convertFromPacket(parameterData, parameter2.mainRole(), false)->integerValue * 1000;
-				if(_resetMotionAfter < 5000) _resetMotionAfter = 5000;
-				else if(_resetMotionAfter > 3600000) _resetMotionAfter = 3600000;
+			triggerMotion(true, MotionEventLog::Source::camera);
+			return true;
+		}
+		else if(path == "/ipcam/" + std::to_string(_peerID) + "/timelapse.mjpeg")
+		{
+			//"from" and "to" are Unix timestamps in seconds (default: the last 24 hours), "speed" the ratio of recorded time to
+			//playback time (default: 3600, i. e. one hour per second).
+			std::map<std::string, std::string> arguments = HttpHelper::getArguments(httpRequest.getHeader().args);
+			int64_t to = arguments["to"].empty() ? BaseLib::HelperFunctions::getTime() : BaseLib::Math::getNumber64(arguments["to"]) * 1000;
+			int64_t from = arguments["from"].empty() ? to - 86400000 : BaseLib::Math::getNumber64(arguments["from"]) * 1000;
+			double speed = arguments["speed"].empty() ? 3600.0 : BaseLib::Math::getDouble(arguments["speed"]);
+			if(speed < 1) speed = 1;
+			else if(speed > 1000000) speed = 1000000;
+			try
+			{
+				if(from > to || to - from > 366ll * 86400000)
+				{
+					socket->proofwrite(HttpHelper::getResponse(400, "Bad Request"));
+					socket->close();
+					return true;
+				}
+				TimelapseArchive::play(socket, GD::recordingPath + std::to_string(_peerID) + "/timelapse/", from, to, speed, [this]() { return _disposing || deleting || _shuttingDown; });
+			}
+			catch(const BaseLib::SocketOperationException& ex)
+			{
+				GD::out.printInfo("Info: Time-lapse playback of peer " + std::to_string(_peerID) + " stopped: " + ex.what());
 			}
 			return true;
 		}
+		else if(path.compare(0, clipsPrefix.size(), clipsPrefix) == 0)
+		{
+			std::string directory = GD::recordingPath + std::to_string(_peerID) + "/clips/";
+			std::string name = path.substr(clipsPrefix.size());
+			if(name.empty())
+			{
+				try
+				{
+					std::string json = SegmentPlayer::list(directory);
+					socket->proofwrite("HTTP/1.1 200 OK\r\nContent-Type: application/json\r\nContent-Length: " + std::to_string(json.size()) + "\r\nConnection: close\r\n\r\n" + json);
+					socket->close();
+				}
+				catch(const BaseLib::SocketOperationException& ex)
+				{
+					GD::out.printInfo("Info: " + std::string(ex.what()));
+				}
+				return true;
+			}
+			if(name.find('/') != std::string::npos || name.front() == '.') return false;
+			if(name.size() > 6 && name.compare(name.size() - 6, 6, ".mjpeg") == 0) name.resize(name.size() - 6);
+			return SegmentPlayer::serve(serverInfo, httpRequest, socket, directory + name, [this]() { return _disposing || deleting || _shuttingDown; });
+		}
 		return false;
 	}
 // }}}
@@ -531,6 +1374,14 @@ IpCamPeer::UrlInfo IpCamPeer::getUrlInfo(std::string url)
 				GD::out.printWarning("Warning: STREAM_URL does not start with \"http\" or \"https\".");
 				return urlInfo;
 			}
+			std::string::size_type atPosition = url.rfind('@', url.find('/'));
+			if(atPosition != std::string::npos)
+			{
+				std::string credentials = BaseLib::Http::decodeURL(url.substr(0, atPosition));
+				BaseLib::Base64::encode(credentials, urlInfo.authorization);
+				urlInfo.authorization = "Basic " + urlInfo.authorization;
+				url = url.substr(atPosition + 1);
+			}
 			std::pair<std::string, std::string> parts = _bl->hf.splitFirst(url, ':');
 			if(parts.second.empty() || (!parts.second.empty() && parts.first.find('/') != std::string::npos))
 			{
@@ -560,6 +1411,7 @@ void IpCamPeer::initHttpClient()
 {
 	try
 	{
+		std::string previousHosts = _streamUrlInfo.ip + ":" + std::to_string(_streamUrlInfo.port) + " " + _snapshotUrlInfo.ip + ":" + std::to_string(_snapshotUrlInfo.port);
 		{
 			BaseLib::Systems::RpcConfigurationParameter& parameter = configCentral[0]["STREAM_URL"];
 			if(parameter.rpcParameter)
@@ -579,6 +1431,19 @@ void IpCamPeer::initHttpClient()
 				_snapshotUrlInfo = getUrlInfo(streamUrl);
 			}
 		}
+		//Resolve host names in the background, so the first request doesn't have to wait.
+		GD::dnsCache->prefetch(_streamUrlInfo.ip);
+		GD::dnsCache->prefetch(_snapshotUrlInfo.ip);
+		//Give a new address a chance immediately.
+		if(_streamUrlInfo.ip + ":" + std::to_string(_streamUrlInfo.port) + " " + _snapshotUrlInfo.ip + ":" + std::to_string(_snapshotUrlInfo.port) != previousHosts) _circuitBreaker->reset();
+
+		{
+			BaseLib::Systems::RpcConfigurationParameter& parameter = configCentral[0]["SNAPSHOT_CACHE_TIME"];
+			std::vector<uint8_t> parameterData = parameter.getBinaryData();
+			if(parameter.rpcParameter) _snapshotCacheTime = parameter.rpcParameter->convertFromPacket(parameterData, parameter.mainRole(), false)->integerValue;
+			if(_snapshotCacheTime > 60000) _snapshotCacheTime = 60000;
+			_snapshotCache.clear();
+		}
 
 		{
 			BaseLib::Systems::RpcConfigurationParameter& parameter = configCentral[0]["CA_FILE"];
@@ -589,6 +1454,247 @@ void IpCamPeer::initHttpClient()
 			if(parameter.rpcParameter) _verifyCertificate = parameter.rpcParameter->convertFromPacket(parameterData, parameter.mainRole(), false)->booleanValue;
 		}
 
+		{
+			BaseLib::Systems::RpcConfigurationParameter& connectParameter = configCentral[0]["CONNECT_TIMEOUT"];
+			std::vector<uint8_t> parameterData = connectParameter.getBinaryData();
+			if(connectParameter.rpcParameter) _connectionTimeouts.connect = connectParameter.rpcParameter->convertFromPacket(parameterData, connectParameter.mainRole(), false)->integerValue;
+			BaseLib::Systems::RpcConfigurationParameter& firstByteParameter = configCentral[0]["FIRST_BYTE_TIMEOUT"];
+			parameterData = firstByteParameter.getBinaryData();
+			if(firstByteParameter.rpcParameter) _connectionTimeouts.firstByte = firstByteParameter.rpcParameter->convertFromPacket(parameterData, firstByteParameter.mainRole(), false)->integerValue;
+			BaseLib::Systems::RpcConfigurationParameter& idleParameter = configCentral[0]["IDLE_TIMEOUT"];
+			parameterData = idleParameter.getBinaryData();
+			if(idleParameter.rpcParameter) _connectionTimeouts.idle = idleParameter.rpcParameter->convertFromPacket(parameterData, idleParameter.mainRole(), false)->integerValue;
+			if(_connectionTimeouts.connect < 100) _connectionTimeouts.connect = 100;
+			if(_connectionTimeouts.firstByte < 100) _connectionTimeouts.firstByte = 100;
+			if(_connectionTimeouts.idle < 1000) _connectionTimeouts.idle = 1000;
+		}
+
+		_streamHub->setPeerId(_peerID);
+		_streamHub->setConnectionOptions(_connectionTimeouts, _connectionStats, _tlsSessionCache);
+		_streamHub->setUpstream(_streamUrlInfo.ip, _streamUrlInfo.port, _streamUrlInfo.path, _streamUrlInfo.ssl, _caFile, _verifyCertificate, _streamUrlInfo.authorization);
+
+		{
+			uint32_t maxConnections = 2;
+			BaseLib::Systems::RpcConfigurationParameter& parameter = configCentral[0]["MAX_CONNECTIONS"];
+			std::vector<uint8_t> parameterData = parameter.getBinaryData();
+			if(parameter.rpcParameter) maxConnections = parameter.rpcParameter->convertFromPacket(parameterData, parameter.mainRole(), false)->integerValue;
+			if(maxConnections > 16) maxConnections = 16;
+			GD::connectionLimiter->setPeerLimit(_peerID, maxConnections);
+		}
+
+		{
+			uint32_t bandwidthLimit = 0;
+			BaseLib::Systems::RpcConfigurationParameter& parameter = configCentral[0]["BANDWIDTH_LIMIT"];
+			std::vector<uint8_t> parameterData = parameter.getBinaryData();
+			if(parameter.rpcParameter) bandwidthLimit = parameter.rpcParameter->convertFromPacket(parameterData, parameter.mainRole(), false)->integerValue;
+			_streamHub->setBandwidthLimit((uint64_t)bandwidthLimit * 125);
+		}
+
+		{
+			uint32_t upstreamRateLimit = 0;
+			BaseLib::Systems::RpcConfigurationParameter& parameter = configCentral[0]["UPSTREAM_RATE_LIMIT"];
+			std::vector<uint8_t> parameterData = parameter.getBinaryData();
+			if(parameter.rpcParameter) upstreamRateLimit = parameter.rpcParameter->convertFromPacket(parameterData, parameter.mainRole(), false)->integerValue;
+			_upstreamRateLimit = (uint64_t)upstreamRateLimit * 125;
+			_streamHub->setUpstreamRateLimit(_upstreamRateLimit);
+		}
+
+		{
+			uint32_t preMotionBuffer = 0;
+			BaseLib::Systems::RpcConfigurationParameter& parameter = configCentral[0]["PRE_MOTION_BUFFER"];
+			if(parameter.rpcParameter)
+			{
+				std::vector<uint8_t> parameterData = parameter.getBinaryData();
+				preMotionBuffer = parameter.rpcParameter->convertFromPacket(parameterData, parameter.mainRole(), false)->integerValue;
+				if(preMotionBuffer > 60) preMotionBuffer = 60;
+			}
+
+			std::lock_guard<std::mutex> frameBufferGuard(_frameBufferMutex);
+			if(_frameBuffer && (preMotionBuffer == 0 || _frameBuffer->duration() != preMotionBuffer * 1000 || _streamUrlInfo.ip.empty()))
+			{
+				_streamHub->removeConsumer(_frameBuffer);
+				_frameBuffer.reset();
+			}
+			if(preMotionBuffer > 0 && !_frameBuffer && !_streamUrlInfo.ip.empty())
+			{
+				//Limit the buffer to 30 frames per second
+				_frameBuffer = std::make_shared<FrameBuffer>(_peerID, preMotionBuffer * 1000, preMotionBuffer * 30);
+				_streamHub->addConsumer(_frameBuffer, StreamHub::Priority::recording);
+
+				//Estimate the memory needed from the current stream. Without a stream, FrameBuffer warns when it is full.
+				Frame latestFrame = _streamHub->latestFrame();
+				int32_t fps = _upstreamFps > 30 ? 30 : _upstreamFps;
+				size_t requiredMemory = (size_t)preMotionBuffer * fps * latestFrame.capacity();
+				size_t share = GD::framePool->bufferShare();
+				if(requiredMemory > share) GD::out.printWarning("Warning: PRE_MOTION_BUFFER of peer " + std::to_string(_peerID) + " needs about " + std::to_string(requiredMemory / 1048576) + " MiB of frame memory at the current frame rate, but only " + std::to_string(share / 1048576) + " MiB are available per camera. The buffer will hold less than " + std::to_string(preMotionBuffer) + " seconds. Consider increasing \"frameMemory\" in ipcam.conf.");
+			}
+		}
+
+		{
+			bool recordClips = false;
+			uint32_t clipMaxDuration = 300;
+			BaseLib::Systems::RpcConfigurationParameter& parameter = configCentral[0]["RECORD_CLIPS"];
+			std::vector<uint8_t> parameterData = parameter.getBinaryData();
+			if(parameter.rpcParameter) recordClips = parameter.rpcParameter->convertFromPacket(parameterData, parameter.mainRole(), false)->booleanValue;
+			BaseLib::Systems::RpcConfigurationParameter& parameter2 = configCentral[0]["CLIP_MAX_DURATION"];
+			parameterData = parameter2.getBinaryData();
+			if(parameter2.rpcParameter) clipMaxDuration = parameter2.rpcParameter->convertFromPacket(parameterData, parameter2.mainRole(), false)->integerValue;
+			if(clipMaxDuration < 10) clipMaxDuration = 10;
+			else if(clipMaxDuration > 3600) clipMaxDuration = 3600;
+
+			std::lock_guard<std::mutex> clipRecorderGuard(_clipRecorderMutex);
+			if(_clipRecorder && (!recordClips || _clipRecorder->maxDuration() != clipMaxDuration * 1000 || _streamUrlInfo.ip.empty()))
+			{
+				_clipRecorder->stop();
+				_streamHub->removeConsumer(_clipRecorder);
+				_clipRecorder.reset();
+			}
+			if(recordClips && !_clipRecorder && !_streamUrlInfo.ip.empty())
+			{
+				uint64_t peerId = _peerID;
+				_clipRecorder = std::make_shared<ClipRecorder>(_peerID, GD::recordingPath + std::to_string(_peerID) + "/clips/", clipMaxDuration * 1000, [peerId](const std::string& path, int64_t duration)
+				{
+					std::shared_ptr<IpCamCentral> central = std::dynamic_pointer_cast<IpCamCentral>(GD::family->getCentral());
+					if(!central) return;
+					std::shared_ptr<IpCamPeer> peer = central->getPeer(peerId);
+					if(peer) peer->onClipClosed(path, duration);
+				});
+			}
+		}
+
+		{
+			BaseLib::Systems::RpcConfigurationParameter& parameter = configCentral[0]["DUPLICATE_FRAME_DISTANCE"];
+			std::vector<uint8_t> parameterData = parameter.getBinaryData();
+			if(parameter.rpcParameter) _duplicateFrameDistance = parameter.rpcParameter->convertFromPacket(parameterData, parameter.mainRole(), false)->integerValue;
+			if(_duplicateFrameDistance < -1) _duplicateFrameDistance = -1;
+			else if(_duplicateFrameDistance > 32) _duplicateFrameDistance = 32;
+		}
+
+		{
+			bool recordContinuous = false;
+			uint32_t segmentDuration = 300;
+			BaseLib::Systems::RpcConfigurationParameter& parameter = configCentral[0]["RECORD_CONTINUOUS"];
+			std::vector<uint8_t> parameterData = parameter.getBinaryData();
+			if(parameter.rpcParameter) recordContinuous = parameter.rpcParameter->convertFromPacket(parameterData, parameter.mainRole(), false)->booleanValue;
+			BaseLib::Systems::RpcConfigurationParameter& parameter2 = configCentral[0]["SEGMENT_DURATION"];
+			parameterData = parameter2.getBinaryData();
+			if(parameter2.rpcParameter) segmentDuration = parameter2.rpcParameter->convertFromPacket(parameterData, parameter2.mainRole(), false)->integerValue;
+			if(segmentDuration < 10) segmentDuration = 10;
+			else if(segmentDuration > 3600) segmentDuration = 3600;
+
+			std::lock_guard<std::mutex> continuousRecorderGuard(_continuousRecorderMutex);
+			if(_continuousRecorder && (!recordContinuous || _continuousRecorder->segmentDuration() != segmentDuration * 1000 || _continuousRecorder->duplicateDistance() != _duplicateFrameDistance || _streamUrlInfo.ip.empty()))
+			{
+				_streamHub->removeConsumer(_continuousRecorder);
+				_continuousRecorder->stop();
+				_continuousRecorder.reset();
+			}
+			if(recordContinuous && !_continuousRecorder && !_streamUrlInfo.ip.empty())
+			{
+				//The recorder keeps the upstream connection open permanently.
+				_continuousRecorder = std::make_shared<ContinuousRecorder>(_peerID, GD::recordingPath + std::to_string(_peerID) + "/continuous/", segmentDuration * 1000, _duplicateFrameDistance);
+				_streamHub->addConsumer(_continuousRecorder, StreamHub::Priority::recording);
+			}
+		}
+
+		{
+			bool motionDetection = false;
+			MotionDetector::Settings settings;
+			BaseLib::Systems::RpcConfigurationParameter& parameter = configCentral[0]["MOTION_DETECTION"];
+			std::vector<uint8_t> parameterData = parameter.getBinaryData();
+			if(parameter.rpcParameter) motionDetection = parameter.rpcParameter->convertFromPacket(parameterData, parameter.mainRole(), false)->booleanValue;
+			BaseLib::Systems::RpcConfigurationParameter& parameter2 = configCentral[0]["MOTION_SAMPLE_INTERVAL"];
+			parameterData = parameter2.getBinaryData();
+			if(parameter2.rpcParameter) settings.sampleInterval = parameter2.rpcParameter->convertFromPacket(parameterData, parameter2.mainRole(), false)->integerValue;
+			if(settings.sampleInterval < 100) settings.sampleInterval = 100;
+			else if(settings.sampleInterval > 10000) settings.sampleInterval = 10000;
+			BaseLib::Systems::RpcConfigurationParameter& parameter3 = configCentral[0]["MOTION_THRESHOLD"];
+			parameterData = parameter3.getBinaryData();
+			if(parameter3.rpcParameter) settings.threshold = parameter3.rpcParameter->convertFromPacket(parameterData, parameter3.mainRole(), false)->integerValue;
+			if(settings.threshold < 1) settings.threshold = 1;
+			else if(settings.threshold > 255) settings.threshold = 255;
+			BaseLib::Systems::RpcConfigurationParameter& parameter4 = configCentral[0]["MOTION_MIN_AREA"];
+			parameterData = parameter4.getBinaryData();
+			if(parameter4.rpcParameter) settings.minArea = parameter4.rpcParameter->convertFromPacket(parameterData, parameter4.mainRole(), false)->integerValue;
+			if(settings.minArea < 1) settings.minArea = 1;
+			else if(settings.minArea > 100) settings.minArea = 100;
+			BaseLib::Systems::RpcConfigurationParameter& parameter5 = configCentral[0]["MOTION_ZONES"];
+			parameterData = parameter5.getBinaryData();
+			if(parameter5.rpcParameter) settings.zones = parameter5.rpcParameter->convertFromPacket(parameterData, parameter5.mainRole(), false)->stringValue;
+
+			std::lock_guard<std::mutex> motionDetectorGuard(_motionDetectorMutex);
+			if(_motionDetector && (!motionDetection || _motionDetector->settings() != settings || _streamUrlInfo.ip.empty()))
+			{
+				_streamHub->removeConsumer(_motionDetector);
+				_motionDetector.reset();
+			}
+			if(motionDetection && !_motionDetector && !_streamUrlInfo.ip.empty())
+			{
+				uint64_t peerId = _peerID;
+				_motionDetector = std::make_shared<MotionDetector>(settings, [peerId](const MotionDetector::Result& result)
+				{
+					if(!result.motion) return;
+					std::shared_ptr<IpCamCentral> central = std::dynamic_pointer_cast<IpCamCentral>(GD::family->getCentral());
+					if(!central) return;
+					std::shared_ptr<IpCamPeer> peer = central->getPeer(peerId);
+					if(peer) peer->onMotionDetected(result);
+				});
+				_streamHub->addConsumer(_motionDetector, StreamHub::Priority::detection);
+			}
+		}
+
+		{
+			uint32_t timelapseInterval = 0;
+			uint32_t timelapseRetention = 30;
+			BaseLib::Systems::RpcConfigurationParameter& parameter = configCentral[0]["TIMELAPSE_INTERVAL"];
+			std::vector<uint8_t> parameterData = parameter.getBinaryData();
+			if(parameter.rpcParameter) timelapseInterval = parameter.rpcParameter->convertFromPacket(parameterData, parameter.mainRole(), false)->integerValue;
+			if(timelapseInterval > 86400) timelapseInterval = 86400;
+			BaseLib::Systems::RpcConfigurationParameter& parameter2 = configCentral[0]["TIMELAPSE_RETENTION"];
+			parameterData = parameter2.getBinaryData();
+			if(parameter2.rpcParameter) timelapseRetention = parameter2.rpcParameter->convertFromPacket(parameterData, parameter2.mainRole(), false)->integerValue;
+			if(timelapseRetention > 3650) timelapseRetention = 3650;
+
+			std::lock_guard<std::mutex> timelapseGuard(_timelapseMutex);
+			if(_timelapseArchive && (timelapseInterval == 0 || _timelapseArchive->retention() != timelapseRetention || (_streamUrlInfo.ip.empty() && _snapshotUrlInfo.ip.empty())))
+			{
+				_timelapseArchive.reset();
+			}
+			if(timelapseInterval > 0 && !_timelapseArchive && (!_streamUrlInfo.ip.empty() || !_snapshotUrlInfo.ip.empty()))
+			{
+				//The archive is only accessed by the recording writer. It is closed when the last queued image is written.
+				_timelapseArchive = std::make_shared<TimelapseArchive>(GD::recordingPath + std::to_string(_peerID) + "/timelapse/", timelapseRetention);
+			}
+			_timelapseInterval = _timelapseArchive ? timelapseInterval : 0;
+		}
+
+		{
+			uint32_t slotCount = 0;
+			uint32_t slotSize = 1024;
+			BaseLib::Systems::RpcConfigurationParameter& parameter = configCentral[0]["SHARED_MEMORY_SLOTS"];
+			std::vector<uint8_t> parameterData = parameter.getBinaryData();
+			if(parameter.rpcParameter) slotCount = parameter.rpcParameter->convertFromPacket(parameterData, parameter.mainRole(), false)->integerValue;
+			if(slotCount > 64) slotCount = 64;
+			BaseLib::Systems::RpcConfigurationParameter& parameter2 = configCentral[0]["SHARED_MEMORY_SLOT_SIZE"];
+			parameterData = parameter2.getBinaryData();
+			if(parameter2.rpcParameter) slotSize = parameter2.rpcParameter->convertFromPacket(parameterData, parameter2.mainRole(), false)->integerValue;
+			if(slotSize < 64) slotSize = 64;
+			else if(slotSize > 16384) slotSize = 16384;
+
+			std::lock_guard<std::mutex> sharedFrameRingGuard(_sharedFrameRingMutex);
+			if(_sharedFrameRing && (slotCount == 0 || _sharedFrameRing->slotCount() != slotCount || _sharedFrameRing->slotSize() != slotSize * 1024 || _streamUrlInfo.ip.empty()))
+			{
+				if(_sharedFrameRingConsumer) _streamHub->removeConsumer(_sharedFrameRing);
+				_sharedFrameRingConsumer = false;
+				_sharedFrameRing.reset();
+			}
+			if(slotCount > 0 && !_sharedFrameRing && !_streamUrlInfo.ip.empty())
+			{
+				//Added to the stream hub by updateSharedFrameRing() once a reader shows up.
+				_sharedFrameRing = std::make_shared<SharedFrameRingPublisher>(_peerID, slotCount, slotSize * 1024);
+			}
+		}
+
 		if(_streamUrlInfo.ip.empty())
 		{
 			GD::out.printWarning("Warning: Can't init HTTP client of peer with id " + std::to_string(_peerID) + ": Please set STREAM_URL to a valid value.");
@@ -835,7 +1941,7 @@ PVariable IpCamPeer::putParamset(BaseLib::PRpcClientInfo clientInfo, int32_t cha
 				if(parameter.databaseId > 0) saveParameter(parameter.databaseId, value);
 				else saveParameter(0, ParameterGroup::Type::Enum::config, channel, i->first, value);
 
-				if(channel == 0 && (i->first == "STREAM_URL" || i->first == "SNAPSHOT_URL" || i->first == "CA_FILE" || i->first == "VERIFY_CERTIFICATE")) reloadHttpClient = true;
+				if(channel == 0 && (i->first == "STREAM_URL" || i->first == "SNAPSHOT_URL" || i->first == "SNAPSHOT_CACHE_TIME" || i->first == "CA_FILE" || i->first == "VERIFY_CERTIFICATE" || i->first == "PRE_MOTION_BUFFER" || i->first == "RECORD_CLIPS" || i->first == "CLIP_MAX_DURATION" || i->first == "RECORD_CONTINUOUS" || i->first == "SEGMENT_DURATION" || i->first == "DUPLICATE_FRAME_DISTANCE" || i->first == "MAX_CONNECTIONS" || i->first == "BANDWIDTH_LIMIT" || i->first == "UPSTREAM_RATE_LIMIT" || i->first == "CONNECT_TIMEOUT" || i->first == "FIRST_BYTE_TIMEOUT" || i->first == "IDLE_TIMEOUT" || i->first.compare(0, 7, "MOTION_") == 0 || i->first.compare(0, 10, "TIMELAPSE_") == 0 || i->first.compare(0, 14, "SHARED_MEMORY_") == 0)) reloadHttpClient = true;
 
 				GD::out.printInfo("Info: Parameter " + i->first + " of peer " + std::to_string(_peerID) + " and channel " + std::to_string(channel) + " was set to 0x" + BaseLib::HelperFunctions::getHexString(allParameters[list][intIndex]) + ".");
 				//Only send to device when parameter is of type config
@@ -891,11 +1997,24 @@ PVariable IpCamPeer::setValue(BaseLib::PRpcClientInfo clientInfo, uint32_t chann
 				UrlInfo info = getUrlInfo(customUrl);
 				if(customUrl.empty()) return Variable::createError(-1, "CUSTOM_URL_" + number + " is not set.");
 				else if(info.ip.empty()) return Variable::createError(-1, "Could not get IP address from custom URL.");
-				_httpClient.reset(new BaseLib::HttpClient(_bl, info.ip, info.port, false, info.ssl, _caFile, _verifyCertificate));
-				std::string getRequest = "GET " + info.path + " HTTP/1.1\r\nUser-Agent: Homegear\r\nHost: " + info.ip + ":" + std::to_string(info.port) + "\r\nConnection: " + "Close" + "\r\n\r\n";
+				if(!_circuitBreaker->allowRequest()) return Variable::createError(-4, "Camera is unreachable. Please try again later.");
+				ConnectionLimiter::PPermit permit = GD::connectionLimiter->acquire(_peerID, _customUrlAdmissionTimeout);
+				if(!permit) return Variable::createError(-3, "Too many connections to the camera. Please try again later.");
+				CameraConnection connection(info.ip, info.port, info.ssl, _caFile, _verifyCertificate, _connectionTimeouts, _connectionStats, _tlsSessionCache);
+				std::string getRequest = "GET " + info.path + " HTTP/1.1\r\nUser-Agent: Homegear\r\nHost: " + info.ip + ":" + std::to_string(info.port) + "\r\n" + (info.authorization.empty() ? "" : "Authorization: " + info.authorization + "\r\n") + "Connection: Close\r\n\r\n";
 				Http response;
-				GD::out.printInfo("Info: Calling URL: " + customUrl);
-				_httpClient->sendRequest(getRequest, response, false);
+				//The URL might contain credentials, either as user info or in the query string.
+				GD::out.printInfo("Info: Calling CUSTOM_URL_" + number + " of peer " + std::to_string(_peerID) + ": " + (info.ssl ? "https://" : "http://") + info.ip + ":" + std::to_string(info.port) + info.path.substr(0, info.path.find('?')));
+				try
+				{
+					connection.sendRequest(getRequest, response);
+				}
+				catch(const BaseLib::HttpClientException& ex)
+				{
+					if(ex.responseCode() == -1) _circuitBreaker->onFailure();
+					throw;
+				}
+				_circuitBreaker->onSuccess();
 				GD::out.printInfo("Info: HTTP result code: " + std::to_string(response.getHeader().responseCode));
 			}
 			return std::make_shared<Variable>(VariableType::tVoid);
@@ -31,7 +31,20 @@
 #define IPCAMPEER_H_
 
 #include <homegear-base/BaseLib.h>
+#include "CameraConnection.h"
+#include "CircuitBreaker.h"
+#include "ClipRecorder.h"
+#include "ContinuousRecorder.h"
+#include "FrameBuffer.h"
+#include "MotionDetector.h"
+#include "MotionEventLog.h"
+#include "SharedFrameRingPublisher.h"
+#include "SnapshotCache.h"
+#include "StreamHub.h"
+#include "TimelapseArchive.h"
 
+#include <array>
+#include <deque>
 #include <list>
 
 using namespace BaseLib;
@@ -78,6 +91,70 @@ public:
 	 */
     virtual void homegearShuttingDown();
 
+    std::shared_ptr<StreamHub> getStreamHub() { return _streamHub; }
+
+    /**
+     * Latency of all connections to the camera except the ones of the stream relay.
+     */
+    CameraConnection::PStats getConnectionStats() { return _connectionStats; }
+    std::shared_ptr<TlsSessionCache> getTlsSessionCache() { return _tlsSessionCache; }
+
+    /**
+     * Returns the pre-motion frame buffer or nullptr when PRE_MOTION_BUFFER is 0.
+     */
+    std::shared_ptr<FrameBuffer> getFrameBuffer();
+
+    /**
+     * Publishes LAST_CLIP and LAST_CLIP_DURATION. The duration is in milliseconds.
+     */
+    void onClipClosed(const std::string& path, int64_t duration);
+
+    /**
+     * Returns the cached snapshot when it is younger than SNAPSHOT_CACHE_TIME or fetches a new one from the camera.
+     *
+     * @param rejected Set to true when the camera wasn't contacted because of the connection limits or because it is
+     * unreachable.
+     * @return Returns nullptr when the snapshot could not be fetched.
+     */
+    SnapshotCache::PSnapshot getSnapshot(bool* rejected = nullptr);
+
+    /**
+     * Fetches a new snapshot from the camera even if the cached one is still fresh. Used for prefetching.
+     */
+    SnapshotCache::PSnapshot refreshSnapshot();
+
+    /**
+     * Returns true when the cached snapshot is missing or expired at "time". Always false when caching is disabled.
+     */
+    bool snapshotStaleAt(int64_t time);
+
+    /**
+     * Sets MOTION to true and restarts the reset timer.
+     *
+     * @param raiseEventWhenActive Also save MOTION and raise an event when it already is true.
+     * @param source Stored in the motion event log.
+     */
+    void triggerMotion(bool raiseEventWhenActive, MotionEventLog::Source source);
+
+    /**
+     * Called by the software motion detector. Sets MOTION, MOTION_ZONE_n and MOTION_INTENSITY.
+     */
+    void onMotionDetected(const MotionDetector::Result& result);
+
+    /**
+     * Returns true and the address to probe when a health check of the camera is due. While the circuit breaker is open,
+     * this follows the breaker's backoff. Otherwise checks run every "healthCheckInterval" seconds unless the stream is
+     * connected. Called by the central's health check thread only.
+     */
+    bool healthCheckDue(int64_t time, std::string& host, int32_t& port);
+
+    /**
+     * Reports the result of the health check to the circuit breaker, which sets UNREACH.
+     */
+    void onHealthCheckResult(bool reachable);
+
+    bool unreachable() { return _circuitBreaker->isOpen(); }
+
     // {{{ Webserver events
 		bool onGet(BaseLib::Rpc::PServerInfo& serverInfo, BaseLib::Http& httpRequest, std::shared_ptr<BaseLib::TcpSocket>& socket, std::string& path);
 	// }}}
@@ -94,25 +171,105 @@ protected:
 	struct UrlInfo
 	{
 		std::string ip;
-		int32_t port;
+		int32_t port = 80;
 		std::string path;
-		bool ssl;
+		bool ssl = false;
+		std::string authorization;
 	};
 
 	bool _shuttingDown = false;
 	std::shared_ptr<BaseLib::Rpc::RpcEncoder> _binaryEncoder;
 	std::shared_ptr<BaseLib::Rpc::RpcDecoder> _binaryDecoder;
-	std::shared_ptr<BaseLib::HttpClient> _httpClient;
 	UrlInfo _streamUrlInfo;
 	UrlInfo _snapshotUrlInfo;
 	std::string _caFile;
 	bool _verifyCertificate = false;
+	CameraConnection::Timeouts _connectionTimeouts;
+	CameraConnection::PStats _connectionStats = std::make_shared<CameraConnection::Stats>();
+	std::shared_ptr<TlsSessionCache> _tlsSessionCache = std::make_shared<TlsSessionCache>();
+	int32_t _duplicateFrameDistance = -1;
+	uint32_t _snapshotCacheTime = 1000;
+
+	/**
+	 * Maximum time in milliseconds requests wait for a free connection to the camera.
+	 */
+	static const uint32_t _snapshotAdmissionTimeout = 2000;
+	static const uint32_t _customUrlAdmissionTimeout = 2000;
+	std::mutex _snapshotFetchMutex;
+	SnapshotCache _snapshotCache;
+
+	/**
+	 * Snapshots larger than this are passed through to clients without being cached. Set while the last snapshot of the
+	 * camera exceeded it, so further requests are proxied instead of buffered.
+	 */
+	static const size_t _maxCachedSnapshotSize = 4194304;
+	std::atomic_bool _snapshotTooLarge{false};
 	std::vector<char> _httpOkHeader;
+	std::shared_ptr<StreamHub> _streamHub;
+	std::shared_ptr<CircuitBreaker> _circuitBreaker;
+
+	/**
+	 * Time in milliseconds until a failed health check is repeated.
+	 */
+	static const int64_t _healthCheckRetryInterval = 5000;
+	int64_t _lastHealthCheck = 0;
+	bool _lastHealthCheckFailed = false;
+	bool _breakerProbe = false;
+	std::mutex _frameBufferMutex;
+	std::shared_ptr<FrameBuffer> _frameBuffer;
+	std::mutex _clipRecorderMutex;
+	std::shared_ptr<ClipRecorder> _clipRecorder;
+	std::mutex _continuousRecorderMutex;
+	std::shared_ptr<ContinuousRecorder> _continuousRecorder;
+	std::mutex _motionDetectorMutex;
+	std::shared_ptr<MotionDetector> _motionDetector;
+	std::mutex _timelapseMutex;
+	std::shared_ptr<TimelapseArchive> _timelapseArchive;
+	uint32_t _timelapseInterval = 0;
+	int64_t _lastTimelapseSample = 0;
+	std::atomic_bool _timelapseSampling{false};
+	std::thread _timelapseThread;
+	std::mutex _sharedFrameRingMutex;
+	std::shared_ptr<SharedFrameRingPublisher> _sharedFrameRing;
+	bool _sharedFrameRingConsumer = false;
+
+	struct UpstreamSample
+	{
+		int64_t time = 0;
+		uint64_t bytes = 0;
+		uint64_t frames = 0;
+	};
+
+	/**
+	 * UPSTREAM_BITRATE and UPSTREAM_FPS are averaged over _upstreamStatsWindow and published every
+	 * _upstreamStatsInterval milliseconds.
+	 */
+	static const int64_t _upstreamStatsInterval = 10000;
+	static const int64_t _upstreamStatsWindow = 30000;
+	std::atomic<uint64_t> _upstreamRateLimit{0};
+	int64_t _lastUpstreamStatsTime = 0;
+	std::deque<UpstreamSample> _upstreamSamples;
+	uint64_t _relayBytesReceived = 0;
+	uint64_t _relayFrames = 0;
+	uint64_t _lastRelayBytesReceived = 0;
+	uint64_t _lastRelayFrames = 0;
+	int32_t _upstreamBitrate = 0;
+	int32_t _upstreamFps = 0;
 
 	uint32_t _resetMotionAfter = 30;
 	int64_t _motionTime = 0;
 	bool _motion = false;
 
+	std::mutex _motionZonesMutex;
+	uint32_t _motionZones = 0;
+	std::array<int64_t, MotionDetector::maxZones> _motionZoneTimes{};
+	uint32_t _motionIntensity = 0;
+	int64_t _motionIntensityTime = 0;
+
+	std::mutex _motionEventMutex;
+	MotionEventLog::Event _motionEvent{};
+	MotionEventLog::PHandle _motionEventHandle;
+
 	virtual void loadVariables(BaseLib::Systems::ICentral* central, std::shared_ptr<BaseLib::Database::DataTable>& rows);
     virtual void saveVariables();
 
@@ -121,6 +278,53 @@ protected:
 	UrlInfo getUrlInfo(std::string url);
 	virtual PParameterGroup getParameterSet(int32_t channel, ParameterGroup::Type::Enum type);
 	void initHttpClient();
+
+	/**
+	 * Fetches a snapshot and stores it in the cache. _snapshotFetchMutex must be locked. Throws HttpClientException,
+	 * ConnectionLimitException and CircuitOpenException.
+	 */
+	SnapshotCache::PSnapshot fetchSnapshot();
+	void startClipRecording();
+	void stopClipRecording();
+	void stopContinuousRecording();
+	void stopMotionDetection();
+	void stopTimelapse();
+	void stopSharedFrameRing();
+
+	/**
+	 * Adds the shared memory ring to the stream hub while local readers are active and removes it otherwise.
+	 */
+	void updateSharedFrameRing();
+
+	/**
+	 * Samples the byte and frame counters of the stream hub and the stream relay and publishes the rolling bitrate and
+	 * frame rate. Called by worker().
+	 */
+	void updateUpstreamStats();
+
+	/**
+	 * Sets UNREACH and STICKY_UNREACH. Called by the circuit breaker.
+	 */
+	void onReachabilityChanged(bool unreachable);
+
+	/**
+	 * Responds with "503 Service Unavailable" and returns true when the circuit breaker is open.
+	 */
+	bool rejectUnreachable(std::shared_ptr<BaseLib::TcpSocket>& socket);
+
+	/**
+	 * Stores the current image in the time-lapse archive. Uses the latest stream frame when the stream is running and the
+	 * snapshot otherwise. Runs in _timelapseThread.
+	 */
+	void sampleTimelapse();
+	void resetMotionZones();
+
+	/**
+	 * Starts a new entry in the motion event log or splits the running one when it exceeds the maximum event duration.
+	 */
+	void beginMotionEvent(MotionEventLog::Source source, int64_t time);
+	void endMotionEvent(int64_t time);
+	void setVariables(uint32_t channel, std::shared_ptr<std::vector<std::string>> valueKeys, std::shared_ptr<std::vector<PVariable>> values);
 };
 
 }
@@ -0,0 +1,98 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+#include "JpegDecoder.h"
+
+namespace IpCam
+{
+
+JpegDecoder::JpegDecoder()
+{
+	_decompressInfo.err = jpeg_std_error(&_errorManager.manager);
+	_errorManager.manager.error_exit = &JpegDecoder::errorExit;
+	//Warnings about corrupt data are common with cheap cameras. Don't print them to stderr.
+	_errorManager.manager.output_message = [](j_common_ptr) {};
+	jpeg_create_decompress(&_decompressInfo);
+}
+
+JpegDecoder::~JpegDecoder()
+{
+	jpeg_destroy_decompress(&_decompressInfo);
+}
+
+void JpegDecoder::errorExit(j_common_ptr info)
+{
+	ErrorManager* errorManager = (ErrorManager*)info->err;
+	longjmp(errorManager->jumpBuffer, 1);
+}
+
+bool JpegDecoder::decode(const char* data, size_t size, bool grayscale, uint32_t minWidth, Image& image)
+{
+	//No objects with destructors may be created between setjmp() and the end of this method.
+	if(setjmp(_errorManager.jumpBuffer))
+	{
+		char message[JMSG_LENGTH_MAX];
+		_errorManager.manager.format_message((j_common_ptr)&_decompressInfo, message);
+		_error.assign(message);
+		jpeg_abort_decompress(&_decompressInfo);
+		return false;
+	}
+
+	jpeg_mem_src(&_decompressInfo, (unsigned char*)data, size);
+	if(jpeg_read_header(&_decompressInfo, TRUE) != JPEG_HEADER_OK)
+	{
+		_error.assign("Invalid JPEG header.");
+		jpeg_abort_decompress(&_decompressInfo);
+		return false;
+	}
+
+	_decompressInfo.out_color_space = grayscale ? JCS_GRAYSCALE : JCS_RGB;
+	_decompressInfo.dct_method = JDCT_IFAST;
+	_decompressInfo.do_fancy_upsampling = FALSE;
+	_decompressInfo.do_block_smoothing = FALSE;
+	_decompressInfo.scale_num = 1;
+	_decompressInfo.scale_denom = 8;
+	while(_decompressInfo.scale_denom > 1 && _decompressInfo.image_width / _decompressInfo.scale_denom < minWidth) _decompressInfo.scale_denom /= 2;
+
+	jpeg_start_decompress(&_decompressInfo);
+	image.width = _decompressInfo.output_width;
+	image.height = _decompressInfo.output_height;
+	image.components = _decompressInfo.output_components;
+	size_t stride = (size_t)image.width * image.components;
+	if(image.pixels.size() != stride * image.height) image.pixels.resize(stride * image.height);
+	while(_decompressInfo.output_scanline < _decompressInfo.output_height)
+	{
+		JSAMPROW row = image.pixels.data() + (size_t)_decompressInfo.output_scanline * stride;
+		jpeg_read_scanlines(&_decompressInfo, &row, 1);
+	}
+	jpeg_finish_decompress(&_decompressInfo);
+	return true;
+}
+
+}
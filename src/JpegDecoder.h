@@ -0,0 +1,85 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+#ifndef JPEGDECODER_H_
+#define JPEGDECODER_H_
+
+#include <csetjmp>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include <jpeglib.h>
+
+namespace IpCam
+{
+
+/**
+ * Decodes JPEG images with libjpeg at reduced DCT scale. At scale 1/8 only the DC coefficients are used, which is an order
+ * of magnitude faster than a full decode. Not thread safe, use one instance per thread.
+ */
+class JpegDecoder
+{
+public:
+	struct Image
+	{
+		uint32_t width = 0;
+		uint32_t height = 0;
+		uint32_t components = 0;
+		std::vector<uint8_t> pixels;
+	};
+
+	JpegDecoder();
+	virtual ~JpegDecoder();
+
+	/**
+	 * Decodes an image at the smallest scale (1/8, 1/4, 1/2 or 1) where the image is at least "minWidth" pixels wide.
+	 *
+	 * @param grayscale Only decode the luma channel. Otherwise the image is decoded to RGB.
+	 * @return Returns false when the image could not be decoded. See getError().
+	 */
+	bool decode(const char* data, size_t size, bool grayscale, uint32_t minWidth, Image& image);
+	const std::string& getError() { return _error; }
+protected:
+	struct ErrorManager
+	{
+		struct jpeg_error_mgr manager;
+		jmp_buf jumpBuffer;
+	};
+
+	struct jpeg_decompress_struct _decompressInfo;
+	ErrorManager _errorManager;
+	std::string _error;
+
+	static void errorExit(j_common_ptr info);
+};
+
+}
+
+#endif
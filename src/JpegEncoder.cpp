@@ -0,0 +1,122 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+#include "JpegEncoder.h"
+
+namespace IpCam
+{
+
+JpegEncoder::JpegEncoder()
+{
+	_compressInfo.err = jpeg_std_error(&_errorManager.manager);
+	_errorManager.manager.error_exit = &JpegEncoder::errorExit;
+	_errorManager.manager.output_message = [](j_common_ptr) {};
+	jpeg_create_compress(&_compressInfo);
+
+	_destination.manager.init_destination = &JpegEncoder::initDestination;
+	_destination.manager.empty_output_buffer = &JpegEncoder::emptyOutputBuffer;
+	_destination.manager.term_destination = &JpegEncoder::termDestination;
+	_compressInfo.dest = &_destination.manager;
+}
+
+JpegEncoder::~JpegEncoder()
+{
+	jpeg_destroy_compress(&_compressInfo);
+}
+
+void JpegEncoder::errorExit(j_common_ptr info)
+{
+	ErrorManager* errorManager = (ErrorManager*)info->err;
+	longjmp(errorManager->jumpBuffer, 1);
+}
+
+// {{{ Destination writing directly into the output vector
+void JpegEncoder::initDestination(j_compress_ptr info)
+{
+	Destination* destination = (Destination*)info->dest;
+	std::vector<char>& output = *destination->output;
+	if(output.size() < 65536) output.resize(65536);
+	destination->manager.next_output_byte = (JOCTET*)output.data();
+	destination->manager.free_in_buffer = output.size();
+}
+
+boolean JpegEncoder::emptyOutputBuffer(j_compress_ptr info)
+{
+	//Called when the buffer is full. Per the libjpeg API the whole buffer is considered used here.
+	Destination* destination = (Destination*)info->dest;
+	std::vector<char>& output = *destination->output;
+	size_t used = output.size();
+	output.resize(used * 2);
+	destination->manager.next_output_byte = (JOCTET*)output.data() + used;
+	destination->manager.free_in_buffer = output.size() - used;
+	return TRUE;
+}
+
+void JpegEncoder::termDestination(j_compress_ptr info)
+{
+	Destination* destination = (Destination*)info->dest;
+	destination->output->resize(destination->output->size() - destination->manager.free_in_buffer);
+}
+// }}}
+
+bool JpegEncoder::encode(const JpegDecoder::Image& image, int32_t quality, std::vector<char>& output)
+{
+	//No objects with destructors may be created between setjmp() and the end of this method.
+	if(setjmp(_errorManager.jumpBuffer))
+	{
+		char message[JMSG_LENGTH_MAX];
+		_errorManager.manager.format_message((j_common_ptr)&_compressInfo, message);
+		_error.assign(message);
+		jpeg_abort_compress(&_compressInfo);
+		return false;
+	}
+
+	//Grow the buffer back to its capacity, termDestination() shrinks it to the image size.
+	output.resize(output.capacity());
+	_destination.output = &output;
+	_compressInfo.image_width = image.width;
+	_compressInfo.image_height = image.height;
+	_compressInfo.input_components = image.components;
+	_compressInfo.in_color_space = image.components == 1 ? JCS_GRAYSCALE : JCS_RGB;
+	jpeg_set_defaults(&_compressInfo);
+	jpeg_set_quality(&_compressInfo, quality, TRUE);
+	_compressInfo.dct_method = JDCT_IFAST;
+
+	jpeg_start_compress(&_compressInfo, TRUE);
+	size_t stride = (size_t)image.width * image.components;
+	while(_compressInfo.next_scanline < _compressInfo.image_height)
+	{
+		JSAMPROW row = (JSAMPROW)image.pixels.data() + (size_t)_compressInfo.next_scanline * stride;
+		jpeg_write_scanlines(&_compressInfo, &row, 1);
+	}
+	jpeg_finish_compress(&_compressInfo);
+	return true;
+}
+
+}
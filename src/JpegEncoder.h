@@ -0,0 +1,87 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+#ifndef JPEGENCODER_H_
+#define JPEGENCODER_H_
+
+#include "JpegDecoder.h"
+
+#include <csetjmp>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include <jpeglib.h>
+
+namespace IpCam
+{
+
+/**
+ * Encodes RGB or grayscale images with libjpeg. Not thread safe, use one instance per thread.
+ */
+class JpegEncoder
+{
+public:
+	JpegEncoder();
+	virtual ~JpegEncoder();
+
+	/**
+	 * @param quality JPEG quality from 1 to 100.
+	 * @param output Receives the encoded image. The buffer is reused, so pass the same vector for every frame.
+	 * @return Returns false when the image could not be encoded. See getError().
+	 */
+	bool encode(const JpegDecoder::Image& image, int32_t quality, std::vector<char>& output);
+	const std::string& getError() { return _error; }
+protected:
+	struct ErrorManager
+	{
+		struct jpeg_error_mgr manager;
+		jmp_buf jumpBuffer;
+	};
+
+	struct Destination
+	{
+		struct jpeg_destination_mgr manager;
+		std::vector<char>* output = nullptr;
+	};
+
+	struct jpeg_compress_struct _compressInfo;
+	ErrorManager _errorManager;
+	Destination _destination;
+	std::string _error;
+
+	static void errorExit(j_common_ptr info);
+	static void initDestination(j_compress_ptr info);
+	static boolean emptyOutputBuffer(j_compress_ptr info);
+	static void termDestination(j_compress_ptr info);
+};
+
+}
+
+#endif
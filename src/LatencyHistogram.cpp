@@ -0,0 +1,81 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+#include "LatencyHistogram.h"
+
+namespace IpCam
+{
+
+const std::array<int64_t, LatencyHistogram::bucketCount - 1>& LatencyHistogram::bounds()
+{
+	static const std::array<int64_t, bucketCount - 1> bounds{ { 1, 2, 5, 10, 20, 50, 100, 200, 500, 1000, 2000, 5000, 10000, 20000, 30000 } };
+	return bounds;
+}
+
+void LatencyHistogram::record(int64_t milliseconds)
+{
+	if(milliseconds < 0) milliseconds = 0;
+	const std::array<int64_t, bucketCount - 1>& upperBounds = bounds();
+	size_t bucket = 0;
+	while(bucket < upperBounds.size() && milliseconds > upperBounds[bucket]) bucket++;
+	_counts[bucket]++;
+	_sum += milliseconds;
+	int64_t max = _max;
+	while(milliseconds > max && !_max.compare_exchange_weak(max, milliseconds));
+}
+
+LatencyHistogram::Snapshot LatencyHistogram::snapshot() const
+{
+	Snapshot snapshot;
+	for(size_t i = 0; i < bucketCount; i++)
+	{
+		snapshot.counts[i] = _counts[i];
+		snapshot.count += snapshot.counts[i];
+	}
+	snapshot.timeouts = _timeouts;
+	snapshot.sum = _sum;
+	snapshot.max = _max;
+	return snapshot;
+}
+
+int64_t LatencyHistogram::Snapshot::percentile(double percentile) const
+{
+	if(count == 0) return 0;
+	uint64_t rank = (uint64_t)(percentile * count + 0.5);
+	if(rank < 1) rank = 1;
+	uint64_t seen = 0;
+	for(size_t i = 0; i < bucketCount - 1; i++)
+	{
+		seen += counts[i];
+		if(seen >= rank) return bounds()[i] < max ? bounds()[i] : max;
+	}
+	return max;
+}
+
+}
@@ -0,0 +1,86 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+#ifndef LATENCYHISTOGRAM_H_
+#define LATENCYHISTOGRAM_H_
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace IpCam
+{
+
+/**
+ * Lock-free latency histogram with fixed buckets from 1 ms to 30 s. Timeouts are counted separately, so they don't distort
+ * the percentiles.
+ */
+class LatencyHistogram
+{
+public:
+	static const size_t bucketCount = 16;
+
+	struct Snapshot
+	{
+		std::array<uint64_t, bucketCount> counts{};
+		uint64_t count = 0;
+		uint64_t timeouts = 0;
+		int64_t sum = 0;
+		int64_t max = 0;
+
+		/**
+		 * Returns the upper bound of the bucket containing the given percentile (between 0 and 1) in milliseconds or the
+		 * maximum for the last bucket. Returns 0 when nothing was recorded.
+		 */
+		int64_t percentile(double percentile) const;
+		int64_t average() const { return count > 0 ? sum / (int64_t)count : 0; }
+	};
+
+	LatencyHistogram() {}
+	virtual ~LatencyHistogram() {}
+
+	/**
+	 * Upper bounds of the buckets in milliseconds. The last bucket is unbounded.
+	 */
+	static const std::array<int64_t, bucketCount - 1>& bounds();
+
+	void record(int64_t milliseconds);
+	void recordTimeout() { _timeouts++; }
+	Snapshot snapshot() const;
+protected:
+	std::array<std::atomic<uint64_t>, bucketCount> _counts{};
+	std::atomic<uint64_t> _timeouts{0};
+	std::atomic<int64_t> _sum{0};
+	std::atomic<int64_t> _max{0};
+};
+
+}
+
+#endif
@@ -0,0 +1,221 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+#include "MjpegParser.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace IpCam
+{
+
+MjpegParser::MjpegParser(size_t maxFrameSize) : _maxFrameSize(maxFrameSize)
+{
+}
+
+void MjpegParser::reset()
+{
+	_state = State::header;
+	_buffer.clear();
+	_position = 0;
+	_scanPosition = 0;
+	_contentLength = 0;
+	_responseCode = 0;
+	_delimiter.clear();
+	_bodyDelimiter.clear();
+	_error.clear();
+}
+
+size_t MjpegParser::find(const std::string& pattern, size_t start)
+{
+	if(start >= _buffer.size()) return std::string::npos;
+	std::vector<char>::iterator result = std::search(_buffer.begin() + start, _buffer.end(), pattern.begin(), pattern.end());
+	if(result == _buffer.end()) return std::string::npos;
+	return result - _buffer.begin();
+}
+
+std::string MjpegParser::getHeaderField(const std::string& header, const std::string& name)
+{
+	std::string::size_type lineStart = 0;
+	while(lineStart < header.size())
+	{
+		std::string::size_type lineEnd = header.find("\r\n", lineStart);
+		if(lineEnd == std::string::npos) lineEnd = header.size();
+		std::string::size_type colon = header.find(':', lineStart);
+		if(colon != std::string::npos && colon < lineEnd && colon - lineStart == name.size())
+		{
+			bool match = true;
+			for(size_t i = 0; i < name.size(); i++)
+			{
+				if(std::tolower(header[lineStart + i]) != name[i])
+				{
+					match = false;
+					break;
+				}
+			}
+			if(match)
+			{
+				std::string value = header.substr(colon + 1, lineEnd - colon - 1);
+				value.erase(0, value.find_first_not_of(" \t"));
+				value.erase(value.find_last_not_of(" \t") + 1);
+				return value;
+			}
+		}
+		lineStart = lineEnd + 2;
+	}
+	return "";
+}
+
+bool MjpegParser::processHeader(const std::string& header)
+{
+	if(header.compare(0, 5, "HTTP/") != 0)
+	{
+		_error = "Response is no HTTP response.";
+		return false;
+	}
+	std::string::size_type space = header.find(' ');
+	if(space != std::string::npos) _responseCode = std::strtol(header.c_str() + space + 1, nullptr, 10);
+	if(_responseCode != 200)
+	{
+		_error = "Camera responded with code " + std::to_string(_responseCode) + ".";
+		return false;
+	}
+
+	std::string contentType = getHeaderField(header, "content-type");
+	std::string lowerContentType(contentType);
+	std::transform(lowerContentType.begin(), lowerContentType.end(), lowerContentType.begin(), ::tolower);
+	std::string::size_type boundaryPosition = lowerContentType.find("boundary=");
+	if(lowerContentType.compare(0, 10, "multipart/") != 0 || boundaryPosition == std::string::npos)
+	{
+		_error = "Response is no multipart stream (content type is \"" + contentType + "\").";
+		return false;
+	}
+	std::string boundary = contentType.substr(boundaryPosition + 9);
+	boundary = boundary.substr(0, boundary.find(';'));
+	boundary.erase(0, boundary.find_first_not_of(" \t\""));
+	boundary.erase(boundary.find_last_not_of(" \t\"") + 1);
+	if(boundary.compare(0, 2, "--") == 0) boundary = boundary.substr(2);
+	if(boundary.empty())
+	{
+		_error = "Multipart boundary is empty.";
+		return false;
+	}
+	_delimiter = "--" + boundary;
+	_bodyDelimiter = "\r\n" + _delimiter;
+	return true;
+}
+
+bool MjpegParser::process(const char* data, size_t size, const FrameCallback& callback)
+{
+	if(!_error.empty()) return false;
+	if(_position > 0 && _position >= _buffer.size() / 2)
+	{
+		_buffer.erase(_buffer.begin(), _buffer.begin() + _position);
+		_scanPosition = _scanPosition > _position ? _scanPosition - _position : 0;
+		_position = 0;
+	}
+	_buffer.insert(_buffer.end(), data, data + size);
+
+	while(true)
+	{
+		if(_state == State::header)
+		{
+			size_t headerEnd = find("\r\n\r\n", _position);
+			if(headerEnd == std::string::npos)
+			{
+				if(_buffer.size() - _position > 16384)
+				{
+					_error = "HTTP header is too large.";
+					return false;
+				}
+				return true;
+			}
+			if(!processHeader(std::string(_buffer.data() + _position, headerEnd - _position))) return false;
+			_position = headerEnd + 4;
+			_state = State::partHeader;
+		}
+		else if(_state == State::partHeader)
+		{
+			size_t delimiterPosition = find(_delimiter, _position);
+			if(delimiterPosition == std::string::npos)
+			{
+				if(_buffer.size() > _position + _delimiter.size()) _position = _buffer.size() - _delimiter.size();
+				return true;
+			}
+			size_t headerEnd = find("\r\n\r\n", delimiterPosition);
+			if(headerEnd == std::string::npos)
+			{
+				if(_buffer.size() - delimiterPosition > 4096)
+				{
+					_error = "Multipart header is too large.";
+					return false;
+				}
+				return true;
+			}
+			std::string partHeader(_buffer.data() + delimiterPosition, headerEnd - delimiterPosition + 2);
+			std::string contentLength = getHeaderField(partHeader.substr(partHeader.find("\r\n") + 2), "content-length");
+			_contentLength = contentLength.empty() ? 0 : std::strtoull(contentLength.c_str(), nullptr, 10);
+			_position = headerEnd + 4;
+			_scanPosition = _position;
+			if(_contentLength > _maxFrameSize)
+			{
+				_error = "Frame is too large.";
+				return false;
+			}
+			_state = _contentLength > 0 ? State::body : State::bodyScan;
+		}
+		else if(_state == State::body)
+		{
+			if(_buffer.size() - _position < _contentLength) return true;
+			if(_contentLength > 2 && (uint8_t)_buffer[_position] == 0xFF && (uint8_t)_buffer[_position + 1] == 0xD8) callback(_buffer.data() + _position, _contentLength);
+			_position += _contentLength;
+			_state = State::partHeader;
+		}
+		else if(_state == State::bodyScan)
+		{
+			size_t bodyEnd = find(_bodyDelimiter, _scanPosition);
+			if(bodyEnd == std::string::npos)
+			{
+				if(_buffer.size() - _position > _maxFrameSize)
+				{
+					_error = "Frame is too large.";
+					return false;
+				}
+				if(_buffer.size() > _position + _bodyDelimiter.size()) _scanPosition = _buffer.size() - _bodyDelimiter.size();
+				return true;
+			}
+			size_t frameSize = bodyEnd - _position;
+			if(frameSize > 2 && (uint8_t)_buffer[_position] == 0xFF && (uint8_t)_buffer[_position + 1] == 0xD8) callback(_buffer.data() + _position, frameSize);
+			_position = bodyEnd + 2;
+			_state = State::partHeader;
+		}
+	}
+}
+
+}
@@ -0,0 +1,91 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+#ifndef MJPEGPARSER_H_
+#define MJPEGPARSER_H_
+
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace IpCam
+{
+
+/**
+ * Incremental parser for "multipart/x-mixed-replace" camera responses. It consumes the raw HTTP response including the
+ * header and calls the frame callback once for every complete JPEG part. The callback data is only valid during the call.
+ */
+class MjpegParser
+{
+public:
+	typedef std::function<void(const char* data, size_t size)> FrameCallback;
+
+	MjpegParser(size_t maxFrameSize = 8388608);
+	virtual ~MjpegParser() {}
+
+	void reset();
+
+	/**
+	 * Processes received bytes.
+	 *
+	 * @return Returns false on protocol errors. The reason can be retrieved with getError().
+	 */
+	bool process(const char* data, size_t size, const FrameCallback& callback);
+
+	bool headerProcessed() { return _state != State::header; }
+	int32_t responseCode() { return _responseCode; }
+	const std::string& getError() { return _error; }
+protected:
+	enum class State
+	{
+		header,
+		partHeader,
+		body,
+		bodyScan
+	};
+
+	size_t _maxFrameSize = 0;
+	State _state = State::header;
+	std::vector<char> _buffer;
+	size_t _position = 0;
+	size_t _scanPosition = 0;
+	size_t _contentLength = 0;
+	int32_t _responseCode = 0;
+	std::string _delimiter;
+	std::string _bodyDelimiter;
+	std::string _error;
+
+	size_t find(const std::string& pattern, size_t start);
+	bool processHeader(const std::string& header);
+	static std::string getHeaderField(const std::string& header, const std::string& name);
+};
+
+}
+
+#endif
@@ -0,0 +1,251 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+#include "Mosaic.h"
+#include "GD.h"
+#include "JpegEncoder.h"
+
+#include <cstring>
+
+namespace IpCam
+{
+
+std::string Mosaic::Definition::key() const
+{
+	std::string key = std::to_string(columns) + 'x' + std::to_string(rows) + ':' + std::to_string(width) + 'x' + std::to_string(height) + '@' + std::to_string(fps) + ':';
+	for(std::vector<uint64_t>::const_iterator i = peerIds.begin(); i != peerIds.end(); ++i)
+	{
+		key += std::to_string(*i) + ',';
+	}
+	return key;
+}
+
+Mosaic::Mosaic(const Definition& definition, const std::vector<std::shared_ptr<StreamHub>>& hubs) : _definition(definition)
+{
+	if(_definition.columns == 0) _definition.columns = 1;
+	if(_definition.rows == 0) _definition.rows = 1;
+	if(_definition.fps == 0) _definition.fps = 1;
+	_canvas.width = _definition.width;
+	_canvas.height = _definition.height;
+	_canvas.components = 3;
+	_canvas.pixels.resize((size_t)_canvas.width * _canvas.height * 3, 0);
+
+	uint32_t tileWidth = _definition.width / _definition.columns;
+	uint32_t tileHeight = _definition.height / _definition.rows;
+	for(size_t i = 0; i < hubs.size() && i < (size_t)_definition.columns * _definition.rows; i++)
+	{
+		if(!hubs[i]) continue;
+		Tile tile;
+		tile.hub = hubs[i];
+		tile.queue = std::make_shared<FrameQueue>(1);
+		tile.x = (i % _definition.columns) * tileWidth;
+		tile.y = (i / _definition.columns) * tileHeight;
+		tile.width = tileWidth;
+		tile.height = tileHeight;
+		tile.hub->addConsumer(tile.queue, StreamHub::Priority::decimated, 1000 / _definition.fps);
+		_tiles.push_back(tile);
+	}
+
+	GD::bl->threadManager.start(_workerThread, false, &Mosaic::worker, this);
+}
+
+Mosaic::~Mosaic()
+{
+	{
+		std::lock_guard<std::mutex> stopGuard(_stopMutex);
+		_stopWorkerThread = true;
+	}
+	_stopConditionVariable.notify_all();
+	GD::bl->threadManager.join(_workerThread);
+	for(std::vector<Tile>::iterator i = _tiles.begin(); i != _tiles.end(); ++i)
+	{
+		i->hub->removeConsumer(i->queue);
+	}
+}
+
+void Mosaic::addConsumer(const StreamHub::PConsumer& consumer)
+{
+	std::lock_guard<std::mutex> consumersGuard(_consumersMutex);
+	_consumers.push_back(consumer);
+}
+
+void Mosaic::removeConsumer(const StreamHub::PConsumer& consumer)
+{
+	std::lock_guard<std::mutex> consumersGuard(_consumersMutex);
+	for(std::vector<StreamHub::PConsumer>::iterator i = _consumers.begin(); i != _consumers.end(); ++i)
+	{
+		if(*i == consumer)
+		{
+			_consumers.erase(i);
+			return;
+		}
+	}
+}
+
+void Mosaic::publish(const Frame& frame)
+{
+	std::lock_guard<std::mutex> consumersGuard(_consumersMutex);
+	for(std::vector<StreamHub::PConsumer>::iterator i = _consumers.begin(); i != _consumers.end(); ++i)
+	{
+		(*i)->onFrame(frame);
+	}
+}
+
+void Mosaic::clearTile(const Tile& tile)
+{
+	size_t stride = (size_t)_canvas.width * 3;
+	for(uint32_t y = tile.y; y < tile.y + tile.height; y++)
+	{
+		std::memset(_canvas.pixels.data() + y * stride + (size_t)tile.x * 3, 0, (size_t)tile.width * 3);
+	}
+}
+
+void Mosaic::drawTile(const Tile& tile, const JpegDecoder::Image& image)
+{
+	if(image.width == 0 || image.height == 0) return;
+	uint32_t width = tile.width;
+	uint32_t height = (uint64_t)image.height * tile.width / image.width;
+	if(height > tile.height)
+	{
+		height = tile.height;
+		width = (uint64_t)image.width * tile.height / image.height;
+	}
+	uint32_t offsetX = tile.x + (tile.width - width) / 2;
+	uint32_t offsetY = tile.y + (tile.height - height) / 2;
+	if(width != tile.width || height != tile.height) clearTile(tile);
+
+	//The image was decoded at a DCT scale close to the tile size, so nearest neighbor sampling is good enough.
+	std::vector<uint32_t> sourceX(width);
+	for(uint32_t x = 0; x < width; x++)
+	{
+		sourceX[x] = ((uint64_t)x * image.width / width) * image.components;
+	}
+	size_t stride = (size_t)_canvas.width * 3;
+	size_t sourceStride = (size_t)image.width * image.components;
+	for(uint32_t y = 0; y < height; y++)
+	{
+		const uint8_t* source = image.pixels.data() + ((uint64_t)y * image.height / height) * sourceStride;
+		uint8_t* target = _canvas.pixels.data() + (offsetY + y) * stride + (size_t)offsetX * 3;
+		if(image.components == 3)
+		{
+			for(uint32_t x = 0; x < width; x++, target += 3)
+			{
+				const uint8_t* pixel = source + sourceX[x];
+				target[0] = pixel[0];
+				target[1] = pixel[1];
+				target[2] = pixel[2];
+			}
+		}
+		else
+		{
+			for(uint32_t x = 0; x < width; x++, target += 3)
+			{
+				target[0] = target[1] = target[2] = source[sourceX[x]];
+			}
+		}
+	}
+}
+
+void Mosaic::worker()
+{
+	JpegDecoder decoder;
+	JpegDecoder::Image image;
+	JpegEncoder encoder;
+	std::vector<char> jpeg;
+	Frame lastFrame;
+	bool changed = true;
+	int64_t interval = 1000 / _definition.fps;
+	int64_t nextTick = BaseLib::HelperFunctions::getTime();
+	while(true)
+	{
+		try
+		{
+			{
+				std::unique_lock<std::mutex> stopGuard(_stopMutex);
+				int64_t sleepTime = nextTick - BaseLib::HelperFunctions::getTime();
+				if(sleepTime > 0) _stopConditionVariable.wait_for(stopGuard, std::chrono::milliseconds(sleepTime), [&] { return _stopWorkerThread; });
+				if(_stopWorkerThread) return;
+			}
+			int64_t time = BaseLib::HelperFunctions::getTime();
+			nextTick += interval;
+			//Don't try to catch up after a stall.
+			if(nextTick < time) nextTick = time + interval;
+
+			for(std::vector<Tile>::iterator i = _tiles.begin(); i != _tiles.end(); ++i)
+			{
+				Frame frame = i->queue->pop(0);
+				if(frame)
+				{
+					if(!decoder.decode(frame.data(), frame.size(), false, i->width, image))
+					{
+						if(GD::bl->debugLevel >= 5) GD::out.printDebug("Debug: Mosaic could not decode frame: " + decoder.getError());
+						continue;
+					}
+					drawTile(*i, image);
+					i->frameTime = time;
+					changed = true;
+				}
+				else if(i->frameTime != 0 && time - i->frameTime >= 10000)
+				{
+					//Camera stopped sending
+					clearTile(*i);
+					i->frameTime = 0;
+					changed = true;
+				}
+			}
+
+			//Unchanged mosaics are sent every 5 seconds, so viewers don't time out.
+			if(!changed && lastFrame && time - lastFrame.time() < 5000) continue;
+			if(changed)
+			{
+				if(!encoder.encode(_canvas, _quality, jpeg))
+				{
+					GD::out.printError("Error: Could not encode mosaic: " + encoder.getError());
+					continue;
+				}
+				changed = false;
+			}
+			Frame frame = GD::framePool->allocate(jpeg.size(), time, ++_sequence);
+			if(!frame)
+			{
+				if(GD::bl->debugLevel >= 5) GD::out.printDebug("Debug: Dropping mosaic frame: Frame pool is exhausted.");
+				continue;
+			}
+			std::memcpy(frame.writableData(), jpeg.data(), jpeg.size());
+			lastFrame = frame;
+			publish(frame);
+		}
+		catch(const std::exception& ex)
+		{
+			GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+		}
+	}
+}
+
+}
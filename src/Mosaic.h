@@ -0,0 +1,118 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+#ifndef MOSAIC_H_
+#define MOSAIC_H_
+
+#include "JpegDecoder.h"
+#include "StreamHub.h"
+
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace IpCam
+{
+
+/**
+ * Composes the latest frames of several cameras into one grid image at a fixed rate. The camera frames are decoded at
+ * reduced DCT scale and only when a new frame arrived. The grid is encoded once per tick for all viewers, which register
+ * like consumers of a StreamHub. The mosaic runs as long as the object exists.
+ */
+class Mosaic
+{
+public:
+	struct Definition
+	{
+		/**
+		 * Peer IDs in row-major order. 0 leaves a cell empty.
+		 */
+		std::vector<uint64_t> peerIds;
+		uint32_t columns = 1;
+		uint32_t rows = 1;
+		uint32_t width = 1280;
+		uint32_t height = 720;
+		uint32_t fps = 2;
+
+		/**
+		 * Viewers requesting the same key share one mosaic.
+		 */
+		std::string key() const;
+	};
+
+	/**
+	 * @param hubs The stream hubs of the cameras in the order of Definition::peerIds. Empty cells have no hub.
+	 */
+	Mosaic(const Definition& definition, const std::vector<std::shared_ptr<StreamHub>>& hubs);
+	virtual ~Mosaic();
+
+	void addConsumer(const StreamHub::PConsumer& consumer);
+	void removeConsumer(const StreamHub::PConsumer& consumer);
+protected:
+	struct Tile
+	{
+		std::shared_ptr<StreamHub> hub;
+		std::shared_ptr<FrameQueue> queue;
+		uint32_t x = 0;
+		uint32_t y = 0;
+		uint32_t width = 0;
+		uint32_t height = 0;
+		int64_t frameTime = 0;
+	};
+
+	static const int32_t _quality = 75;
+
+	Definition _definition;
+	std::vector<Tile> _tiles;
+	JpegDecoder::Image _canvas;
+	uint64_t _sequence = 0;
+
+	std::mutex _consumersMutex;
+	std::vector<StreamHub::PConsumer> _consumers;
+
+	std::mutex _stopMutex;
+	std::condition_variable _stopConditionVariable;
+	bool _stopWorkerThread = false;
+	std::thread _workerThread;
+
+	void worker();
+	void publish(const Frame& frame);
+
+	/**
+	 * Scales "image" into the tile keeping the aspect ratio. The rest of the tile is black.
+	 */
+	void drawTile(const Tile& tile, const JpegDecoder::Image& image);
+	void clearTile(const Tile& tile);
+};
+
+}
+
+#endif
@@ -0,0 +1,345 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+#include "MotionDetector.h"
+#include "GD.h"
+#include "MotionDetectorPool.h"
+
+#include <cstdlib>
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+namespace IpCam
+{
+
+namespace
+{
+
+/**
+ * Adds the sums of absolute differences of one row to the sums of the 8 pixel wide blocks it crosses. "width" must be a
+ * multiple of 8.
+ */
+void addRowDifferences(const uint8_t* image, const uint8_t* background, uint32_t width, uint32_t* blockSums)
+{
+	uint32_t x = 0;
+#if defined(__SSE2__)
+	//_mm_sad_epu8 returns the sums of both 8 byte halves, which are exactly two blocks.
+	for(; x + 16 <= width; x += 16)
+	{
+		__m128i sums = _mm_sad_epu8(_mm_loadu_si128((const __m128i*)(image + x)), _mm_loadu_si128((const __m128i*)(background + x)));
+		blockSums[x / 8] += _mm_cvtsi128_si32(sums);
+		blockSums[x / 8 + 1] += _mm_extract_epi16(sums, 4);
+	}
+#elif defined(__ARM_NEON)
+	for(; x + 16 <= width; x += 16)
+	{
+		uint8x16_t differences = vabdq_u8(vld1q_u8(image + x), vld1q_u8(background + x));
+		uint64x2_t sums = vpaddlq_u32(vpaddlq_u16(vpaddlq_u8(differences)));
+		blockSums[x / 8] += (uint32_t)vgetq_lane_u64(sums, 0);
+		blockSums[x / 8 + 1] += (uint32_t)vgetq_lane_u64(sums, 1);
+	}
+#endif
+	for(; x < width; x++)
+	{
+		blockSums[x / 8] += std::abs((int32_t)image[x] - (int32_t)background[x]);
+	}
+}
+
+/**
+ * Moves the background towards the image by 1/8 of the difference using three rounding averages.
+ */
+void updateBackground(const uint8_t* image, uint8_t* background, size_t size)
+{
+	size_t i = 0;
+#if defined(__SSE2__)
+	for(; i + 16 <= size; i += 16)
+	{
+		__m128i pixels = _mm_loadu_si128((const __m128i*)(image + i));
+		__m128i backgroundPixels = _mm_loadu_si128((const __m128i*)(background + i));
+		__m128i average = _mm_avg_epu8(backgroundPixels, _mm_avg_epu8(backgroundPixels, _mm_avg_epu8(backgroundPixels, pixels)));
+		_mm_storeu_si128((__m128i*)(background + i), average);
+	}
+#elif defined(__ARM_NEON)
+	for(; i + 16 <= size; i += 16)
+	{
+		uint8x16_t pixels = vld1q_u8(image + i);
+		uint8x16_t backgroundPixels = vld1q_u8(background + i);
+		vst1q_u8(background + i, vrhaddq_u8(backgroundPixels, vrhaddq_u8(backgroundPixels, vrhaddq_u8(backgroundPixels, pixels))));
+	}
+#endif
+	for(; i < size; i++)
+	{
+		uint32_t average = (background[i] + image[i] + 1) >> 1;
+		average = (background[i] + average + 1) >> 1;
+		background[i] = (background[i] + average + 1) >> 1;
+	}
+}
+
+/**
+ * Counts the blocks which are set in "changedBlocks" (0 or 1) and "mask" (0 or 0xFF).
+ */
+uint32_t countMaskedBlocks(const uint8_t* changedBlocks, const uint8_t* mask, size_t size)
+{
+	size_t i = 0;
+	uint32_t count = 0;
+#if defined(__SSE2__)
+	__m128i sums = _mm_setzero_si128();
+	for(; i + 16 <= size; i += 16)
+	{
+		__m128i blocks = _mm_and_si128(_mm_loadu_si128((const __m128i*)(changedBlocks + i)), _mm_loadu_si128((const __m128i*)(mask + i)));
+		sums = _mm_add_epi64(sums, _mm_sad_epu8(blocks, _mm_setzero_si128()));
+	}
+	count = _mm_cvtsi128_si32(sums) + _mm_cvtsi128_si32(_mm_srli_si128(sums, 8));
+#elif defined(__ARM_NEON)
+	uint64x2_t sums = vdupq_n_u64(0);
+	for(; i + 16 <= size; i += 16)
+	{
+		uint8x16_t blocks = vandq_u8(vld1q_u8(changedBlocks + i), vld1q_u8(mask + i));
+		sums = vaddq_u64(sums, vpaddlq_u32(vpaddlq_u16(vpaddlq_u8(blocks))));
+	}
+	count = (uint32_t)(vgetq_lane_u64(sums, 0) + vgetq_lane_u64(sums, 1));
+#endif
+	for(; i < size; i++)
+	{
+		count += changedBlocks[i] & mask[i];
+	}
+	return count;
+}
+
+}
+
+MotionDetector::MotionDetector(const Settings& settings, const ResultCallback& callback) : _settings(settings), _callback(callback)
+{
+	_zones = parseZones(settings.zones);
+}
+
+std::vector<MotionDetector::Zone> MotionDetector::parseZones(const std::string& zones)
+{
+	std::vector<Zone> result;
+	std::vector<std::string> elements = BaseLib::HelperFunctions::splitAll(zones, ';');
+	for(std::vector<std::string>::iterator i = elements.begin(); i != elements.end(); ++i)
+	{
+		std::string element = BaseLib::HelperFunctions::trim(*i);
+		if(element.empty()) continue;
+		if(result.size() == maxZones)
+		{
+			GD::out.printWarning("Warning: Only " + std::to_string(maxZones) + " motion zones are supported.");
+			break;
+		}
+
+		Zone zone;
+		std::string::size_type colon = element.find(':');
+		if(colon != std::string::npos)
+		{
+			std::pair<std::string, std::string> size = BaseLib::HelperFunctions::splitFirst(element.substr(0, colon), 'x');
+			zone.bitmap = true;
+			zone.columns = BaseLib::Math::getNumber(size.first);
+			zone.rows = BaseLib::Math::getNumber(size.second);
+			std::string hex = element.substr(colon + 1);
+			if(zone.columns == 0 || zone.rows == 0 || zone.columns > 1024 || zone.rows > 1024 || hex.size() * 4 < zone.columns * zone.rows)
+			{
+				GD::out.printWarning("Warning: Invalid motion zone \"" + element + "\". Expected \"COLUMNSxROWS:HEX\" with enough hexadecimal digits.");
+				continue;
+			}
+			zone.cells.resize(zone.columns * zone.rows);
+			for(uint32_t cell = 0; cell < zone.cells.size(); cell++)
+			{
+				int32_t nibble = BaseLib::Math::getNumber(std::string(1, hex.at(cell / 4)), true);
+				zone.cells[cell] = nibble & (8 >> (cell % 4));
+			}
+		}
+		else
+		{
+			std::vector<std::string> values = BaseLib::HelperFunctions::splitAll(element, ',');
+			if(values.size() != 4)
+			{
+				GD::out.printWarning("Warning: Invalid motion zone \"" + element + "\". Expected \"X,Y,WIDTH,HEIGHT\" in percent.");
+				continue;
+			}
+			zone.x = BaseLib::Math::getDouble(values.at(0));
+			zone.y = BaseLib::Math::getDouble(values.at(1));
+			zone.width = BaseLib::Math::getDouble(values.at(2));
+			zone.height = BaseLib::Math::getDouble(values.at(3));
+		}
+		result.push_back(std::move(zone));
+	}
+	return result;
+}
+
+void MotionDetector::createZoneMasks(uint32_t columns, uint32_t rows)
+{
+	_zoneMasks.clear();
+	_zoneBlockCounts.clear();
+	if(_zones.empty()) return;
+	_zoneMasks.resize(_zones.size() + 1, std::vector<uint8_t>(columns * rows, 0));
+	_zoneBlockCounts.resize(_zones.size() + 1, 0);
+	std::vector<uint8_t>& unionMask = _zoneMasks.back();
+	for(size_t i = 0; i < _zones.size(); i++)
+	{
+		Zone& zone = _zones[i];
+		std::vector<uint8_t>& mask = _zoneMasks[i];
+		for(uint32_t row = 0; row < rows; row++)
+		{
+			for(uint32_t column = 0; column < columns; column++)
+			{
+				bool inZone = false;
+				if(zone.bitmap) inZone = zone.cells.at((row * zone.rows / rows) * zone.columns + (column * zone.columns / columns));
+				else
+				{
+					//Use the center of the block
+					double x = (column + 0.5) * 100.0 / columns;
+					double y = (row + 0.5) * 100.0 / rows;
+					inZone = x >= zone.x && x < zone.x + zone.width && y >= zone.y && y < zone.y + zone.height;
+				}
+				if(!inZone) continue;
+				mask[row * columns + column] = 0xFF;
+				unionMask[row * columns + column] = 0xFF;
+				_zoneBlockCounts[i]++;
+			}
+		}
+		if(_zoneBlockCounts[i] == 0) GD::out.printWarning("Warning: Motion zone " + std::to_string(i + 1) + " does not contain any blocks.");
+	}
+	for(std::vector<uint8_t>::iterator i = unionMask.begin(); i != unionMask.end(); ++i)
+	{
+		if(*i) _zoneBlockCounts.back()++;
+	}
+}
+
+void MotionDetector::onFrame(const Frame& frame)
+{
+	try
+	{
+		if(frame.time() - _lastSampleTime < _settings.sampleInterval) return;
+		_lastSampleTime = frame.time();
+
+		bool schedule = false;
+		{
+			std::lock_guard<std::mutex> pendingFrameGuard(_pendingFrameMutex);
+			_pendingFrame = frame;
+			if(!_scheduled) _scheduled = schedule = true;
+		}
+		if(schedule) GD::motionDetectorPool->enqueue(shared_from_this());
+	}
+	catch(const std::exception& ex)
+	{
+		GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+	}
+}
+
+void MotionDetector::process(JpegDecoder& decoder, JpegDecoder::Image& image)
+{
+	Frame frame;
+	{
+		std::lock_guard<std::mutex> pendingFrameGuard(_pendingFrameMutex);
+		frame = std::move(_pendingFrame);
+		_pendingFrame.reset();
+	}
+
+	if(frame)
+	{
+		if(decoder.decode(frame.data(), frame.size(), true, _minWidth, image)) analyze(image);
+		else if(GD::bl->debugLevel >= 5) GD::out.printDebug("Debug: Could not decode frame for motion detection: " + decoder.getError());
+	}
+
+	//Frames which arrived while processing are handled after the other cameras' frames.
+	bool reschedule = false;
+	{
+		std::lock_guard<std::mutex> pendingFrameGuard(_pendingFrameMutex);
+		if(_pendingFrame) reschedule = true;
+		else _scheduled = false;
+	}
+	if(reschedule) GD::motionDetectorPool->enqueue(shared_from_this());
+}
+
+void MotionDetector::analyze(const JpegDecoder::Image& image)
+{
+	if(image.width < _blockSize || image.height < _blockSize) return;
+	uint32_t columns = image.width / _blockSize;
+	uint32_t rows = image.height / _blockSize;
+	if(image.width != _width || image.height != _height)
+	{
+		//First frame or the resolution changed
+		_width = image.width;
+		_height = image.height;
+		_background = image.pixels;
+		_blockSums.resize(columns * rows);
+		_changedBlocks.resize(columns * rows);
+		createZoneMasks(columns, rows);
+		return;
+	}
+
+	std::memset(_blockSums.data(), 0, _blockSums.size() * sizeof(uint32_t));
+	for(uint32_t y = 0; y < rows * _blockSize; y++)
+	{
+		addRowDifferences(image.pixels.data() + y * _width, _background.data() + y * _width, columns * _blockSize, _blockSums.data() + (y / _blockSize) * columns);
+	}
+
+	Result result;
+	result.blockCount = _blockSums.size();
+	uint32_t threshold = _settings.threshold * _blockSize * _blockSize;
+	for(size_t i = 0; i < _blockSums.size(); i++)
+	{
+		_changedBlocks[i] = _blockSums[i] >= threshold ? 1 : 0;
+		result.changedBlocks += _changedBlocks[i];
+	}
+
+	if(result.changedBlocks * 100 >= result.blockCount * _sceneChangeArea)
+	{
+		if(GD::bl->debugLevel >= 5) GD::out.printDebug("Debug: Scene changed. Resetting motion detection background.");
+		_background = image.pixels;
+		return;
+	}
+	if(_zoneMasks.empty())
+	{
+		result.intensity = result.changedBlocks * 100 / result.blockCount;
+		result.motion = result.changedBlocks > 0 && result.changedBlocks * 100 >= result.blockCount * _settings.minArea;
+	}
+	else
+	{
+		for(size_t i = 0; i < _zoneMasks.size(); i++)
+		{
+			if(_zoneBlockCounts[i] == 0) continue;
+			uint32_t changedBlocks = countMaskedBlocks(_changedBlocks.data(), _zoneMasks[i].data(), _changedBlocks.size());
+			bool motion = changedBlocks > 0 && changedBlocks * 100 >= _zoneBlockCounts[i] * _settings.minArea;
+			if(i == _zoneMasks.size() - 1) result.intensity = changedBlocks * 100 / _zoneBlockCounts[i];
+			else if(motion) result.zones |= 1 << i;
+		}
+		result.motion = result.zones != 0;
+	}
+
+	updateBackground(image.pixels.data(), _background.data(), _background.size());
+	if(_callback) _callback(result);
+}
+
+}
@@ -0,0 +1,154 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+#ifndef MOTIONDETECTOR_H_
+#define MOTIONDETECTOR_H_
+
+#include "JpegDecoder.h"
+#include "StreamHub.h"
+
+#include <functional>
+
+namespace IpCam
+{
+
+/**
+ * Detects motion by comparing sampled frames with a running background model. Frames are decoded at reduced scale (luma
+ * only) in the shared MotionDetectorPool. The image is divided into blocks of 8x8 pixels. A block changed when the mean
+ * absolute difference of its pixels to the background exceeds the threshold.
+ *
+ * Optionally up to 8 zones can be defined. Zones are separated by ";" and are either rectangles "X,Y,WIDTH,HEIGHT" in
+ * percent of the image or bitmaps "COLUMNSxROWS:HEX" with one bit per cell, row by row, most significant bit first. Bitmaps
+ * are scaled to the block grid. When zones are defined, only changes within zones are considered.
+ */
+class MotionDetector : public StreamHub::IConsumer, public std::enable_shared_from_this<MotionDetector>
+{
+public:
+	struct Settings
+	{
+		uint32_t sampleInterval = 500;
+		uint32_t threshold = 15;
+		uint32_t minArea = 2;
+		std::string zones;
+
+		bool operator==(const Settings& other) const { return sampleInterval == other.sampleInterval && threshold == other.threshold && minArea == other.minArea && zones == other.zones; }
+		bool operator!=(const Settings& other) const { return !(*this == other); }
+	};
+
+	struct Result
+	{
+		bool motion = false;
+		uint32_t changedBlocks = 0;
+		uint32_t blockCount = 0;
+
+		/**
+		 * Percentage of changed blocks within the zones or the whole image when no zones are defined.
+		 */
+		uint32_t intensity = 0;
+
+		/**
+		 * Bit n is set when motion was detected in zone n + 1.
+		 */
+		uint32_t zones = 0;
+	};
+
+	static const uint32_t maxZones = 8;
+
+	/**
+	 * Called from a pool thread for every analyzed frame.
+	 */
+	typedef std::function<void(const Result& result)> ResultCallback;
+
+	MotionDetector(const Settings& settings, const ResultCallback& callback);
+	virtual ~MotionDetector() {}
+
+	virtual void onFrame(const Frame& frame);
+
+	const Settings& settings() { return _settings; }
+	size_t zoneCount() { return _zones.size(); }
+
+	/**
+	 * Analyzes the pending frame. Called by the pool.
+	 */
+	void process(JpegDecoder& decoder, JpegDecoder::Image& image);
+protected:
+	static const uint32_t _blockSize = 8;
+
+	/**
+	 * Decode frames at the smallest scale with at least this width.
+	 */
+	static const uint32_t _minWidth = 160;
+
+	/**
+	 * When more than this percentage of blocks changed, the scene changed (e. g. lights were switched on or the camera
+	 * switched to night mode) and the background is reset.
+	 */
+	static const uint32_t _sceneChangeArea = 80;
+
+	struct Zone
+	{
+		bool bitmap = false;
+		double x = 0;
+		double y = 0;
+		double width = 0;
+		double height = 0;
+		uint32_t columns = 0;
+		uint32_t rows = 0;
+		std::vector<bool> cells;
+	};
+
+	Settings _settings;
+	std::vector<Zone> _zones;
+	ResultCallback _callback;
+
+	std::mutex _pendingFrameMutex;
+	Frame _pendingFrame;
+	int64_t _lastSampleTime = 0;
+	bool _scheduled = false;
+
+	uint32_t _width = 0;
+	uint32_t _height = 0;
+	std::vector<uint8_t> _background;
+	std::vector<uint32_t> _blockSums;
+	std::vector<uint8_t> _changedBlocks;
+
+	/**
+	 * One mask per zone with 0xFF for every block within the zone. The last mask is the union of all zones.
+	 */
+	std::vector<std::vector<uint8_t>> _zoneMasks;
+	std::vector<uint32_t> _zoneBlockCounts;
+
+	static std::vector<Zone> parseZones(const std::string& zones);
+	void createZoneMasks(uint32_t columns, uint32_t rows);
+	void analyze(const JpegDecoder::Image& image);
+};
+
+}
+
+#endif
@@ -0,0 +1,105 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+#include "MotionDetectorPool.h"
+#include "GD.h"
+#include "MotionDetector.h"
+
+namespace IpCam
+{
+
+MotionDetectorPool::MotionDetectorPool(uint32_t threadCount) : _threadCount(threadCount > 0 ? threadCount : 1)
+{
+}
+
+MotionDetectorPool::~MotionDetectorPool()
+{
+	stop();
+}
+
+void MotionDetectorPool::enqueue(const std::shared_ptr<MotionDetector>& detector)
+{
+	{
+		std::lock_guard<std::mutex> queueGuard(_queueMutex);
+		if(_stopThreads) return;
+		_queue.push_back(detector);
+		//Only start the threads when software motion detection is used
+		if(_threads.empty())
+		{
+			_threads.resize(_threadCount);
+			for(std::vector<std::thread>::iterator i = _threads.begin(); i != _threads.end(); ++i)
+			{
+				GD::bl->threadManager.start(*i, false, &MotionDetectorPool::worker, this);
+			}
+		}
+	}
+	_queueConditionVariable.notify_one();
+}
+
+void MotionDetectorPool::stop()
+{
+	{
+		std::lock_guard<std::mutex> queueGuard(_queueMutex);
+		_stopThreads = true;
+		_queue.clear();
+	}
+	_queueConditionVariable.notify_all();
+	for(std::vector<std::thread>::iterator i = _threads.begin(); i != _threads.end(); ++i)
+	{
+		GD::bl->threadManager.join(*i);
+	}
+}
+
+void MotionDetectorPool::worker()
+{
+	JpegDecoder decoder;
+	JpegDecoder::Image image;
+	while(true)
+	{
+		std::shared_ptr<MotionDetector> detector;
+		{
+			std::unique_lock<std::mutex> queueGuard(_queueMutex);
+			_queueConditionVariable.wait(queueGuard, [&] { return !_queue.empty() || _stopThreads; });
+			if(_stopThreads) return;
+			detector = std::move(_queue.front());
+			_queue.pop_front();
+		}
+
+		try
+		{
+			detector->process(decoder, image);
+		}
+		catch(const std::exception& ex)
+		{
+			GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+		}
+	}
+}
+
+}
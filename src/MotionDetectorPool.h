@@ -0,0 +1,69 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+#ifndef MOTIONDETECTORPOOL_H_
+#define MOTIONDETECTORPOOL_H_
+
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace IpCam
+{
+class MotionDetector;
+
+/**
+ * Threads shared by the motion detectors of all cameras. Each detector is queued at most once, so the queue length is
+ * bounded by the number of cameras and a slow pool only reduces the sample rate.
+ */
+class MotionDetectorPool
+{
+public:
+	MotionDetectorPool(uint32_t threadCount);
+	virtual ~MotionDetectorPool();
+
+	void enqueue(const std::shared_ptr<MotionDetector>& detector);
+	void stop();
+protected:
+	std::mutex _queueMutex;
+	std::condition_variable _queueConditionVariable;
+	std::deque<std::shared_ptr<MotionDetector>> _queue;
+	uint32_t _threadCount = 1;
+	std::vector<std::thread> _threads;
+	bool _stopThreads = false;
+
+	void worker();
+};
+
+}
+
+#endif
@@ -0,0 +1,144 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+#include "MotionEventLog.h"
+#include "GD.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace IpCam
+{
+
+static_assert(sizeof(MotionEventLog::Event) == 32, "Motion event records must be 32 bytes.");
+
+MotionEventLog::MotionEventLog(const std::string& path) : _path(path)
+{
+}
+
+MotionEventLog::~MotionEventLog()
+{
+	if(_descriptor != -1) ::close(_descriptor);
+}
+
+bool MotionEventLog::open()
+{
+	if(_descriptor != -1) return true;
+	if(_error) return false;
+	std::string::size_type slash = _path.rfind('/');
+	if(slash != std::string::npos && !Segment::createDirectory(_path.substr(0, slash)))
+	{
+		_error = true;
+		return false;
+	}
+	_descriptor = ::open(_path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, S_IRUSR | S_IWUSR | S_IRGRP);
+	if(_descriptor == -1)
+	{
+		GD::out.printError("Error: Could not open " + _path + ": " + strerror(errno));
+		_error = true;
+		return false;
+	}
+	struct stat fileInfo;
+	if(fstat(_descriptor, &fileInfo) == 0)
+	{
+		//Cut off an incomplete record from a crash.
+		off_t validSize = fileInfo.st_size - fileInfo.st_size % sizeof(Event);
+		if(validSize != fileInfo.st_size && ftruncate(_descriptor, validSize) == -1) GD::out.printWarning("Warning: Could not repair " + _path + ": " + strerror(errno));
+		_count = validSize / sizeof(Event);
+	}
+	return true;
+}
+
+void MotionEventLog::write(int64_t index, const Event& event)
+{
+	if(index < 0 || !open()) return;
+	if(pwrite(_descriptor, &event, sizeof(Event), index * sizeof(Event)) != sizeof(Event))
+	{
+		GD::out.printError("Error: Could not write to " + _path + ": " + strerror(errno));
+	}
+}
+
+MotionEventLog::PHandle MotionEventLog::add(const Event& event)
+{
+	PHandle handle = std::make_shared<int64_t>(-1);
+	std::shared_ptr<MotionEventLog> log = shared_from_this();
+	GD::recordingWriter->post([log, handle, event]()
+	{
+		if(!log->open()) return;
+		*handle = log->_count;
+		log->write(*handle, event);
+		log->_count++;
+	});
+	return handle;
+}
+
+void MotionEventLog::update(const PHandle& handle, const Event& event)
+{
+	if(!handle) return;
+	//Runs after the task of add(), so the record number is known.
+	std::shared_ptr<MotionEventLog> log = shared_from_this();
+	GD::recordingWriter->post([log, handle, event]() { log->write(*handle, event); });
+}
+
+std::vector<MotionEventLog::Event> MotionEventLog::query(uint64_t peerId, int64_t from, int64_t to, size_t limit)
+{
+	std::vector<Event> events;
+	int descriptor = ::open(_path.c_str(), O_RDONLY | O_CLOEXEC);
+	if(descriptor == -1) return events;
+	struct stat fileInfo;
+	size_t size = 0;
+	void* memory = MAP_FAILED;
+	if(fstat(descriptor, &fileInfo) == 0)
+	{
+		size = fileInfo.st_size - fileInfo.st_size % sizeof(Event);
+		if(size > 0) memory = mmap(nullptr, size, PROT_READ, MAP_SHARED, descriptor, 0);
+	}
+	::close(descriptor);
+	if(memory == MAP_FAILED) return events;
+
+	const Event* begin = (const Event*)memory;
+	const Event* end = begin + size / sizeof(Event);
+	//Events of different cameras might be added slightly out of order, so look back one second more.
+	int64_t lookBack = from - maxEventDuration - maxResetTime - 1000;
+	for(const Event* event = std::lower_bound(begin, end, lookBack, [](const Event& event, int64_t time) { return event.start < time; }); event != end && events.size() < limit; ++event)
+	{
+		if(event->start > to + 1000) break;
+		if((peerId != 0 && event->peerId != peerId) || event->start > to || (event->end != 0 && event->end < from)) continue;
+		events.push_back(*event);
+	}
+	munmap(memory, size);
+	return events;
+}
+
+}
@@ -0,0 +1,113 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+#ifndef MOTIONEVENTLOG_H_
+#define MOTIONEVENTLOG_H_
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace IpCam
+{
+
+/**
+ * Append-only log of the motion events of all cameras. Events are stored as fixed-size records in the order they start, so
+ * time ranges are found by binary search. Queries read the file through a temporary memory mapping, memory usage does not
+ * depend on the number of events. All writes are done by the recording writer.
+ *
+ * Events are split by the first trigger after maxEventDuration. An event ends when RESET_MOTION_AFTER passed without
+ * a trigger, so it can last up to maxEventDuration plus maxResetTime. Queries look back that far.
+ */
+class MotionEventLog : public std::enable_shared_from_this<MotionEventLog>
+{
+public:
+	enum class Source : uint8_t
+	{
+		camera = 0,
+		detector = 1
+	};
+
+	struct Event
+	{
+		uint64_t peerId;
+		int64_t start;
+
+		/**
+		 * 0 while the event is in progress.
+		 */
+		int64_t end;
+		uint8_t source;
+
+		/**
+		 * Maximum MOTION_INTENSITY during the event (software motion detection only).
+		 */
+		uint8_t intensity;
+		uint8_t reserved[6];
+	};
+
+	/**
+	 * Identifies an event for update(). The record number is assigned by the recording writer.
+	 */
+	typedef std::shared_ptr<int64_t> PHandle;
+
+	static const int64_t maxEventDuration = 3600000;
+
+	/**
+	 * The maximum value of RESET_MOTION_AFTER in milliseconds.
+	 */
+	static const int64_t maxResetTime = 3600000;
+
+	MotionEventLog(const std::string& path);
+	virtual ~MotionEventLog();
+
+	PHandle add(const Event& event);
+	void update(const PHandle& handle, const Event& event);
+
+	/**
+	 * Returns the events overlapping the time range, ordered by start time.
+	 *
+	 * @param peerId Only return events of this peer. 0 returns the events of all peers.
+	 */
+	std::vector<Event> query(uint64_t peerId, int64_t from, int64_t to, size_t limit);
+	uint64_t count() { return _count; }
+protected:
+	std::string _path;
+	int _descriptor = -1;
+	bool _error = false;
+	std::atomic<uint64_t> _count{0};
+
+	bool open();
+	void write(int64_t index, const Event& event);
+};
+
+}
+
+#endif
@@ -0,0 +1,266 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+#include "RecordingCatalogue.h"
+#include "GD.h"
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sstream>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace IpCam
+{
+
+RecordingCatalogue::RecordingCatalogue(const std::string& directory, uint64_t quota, int64_t retention) : _directory(directory), _quota(quota), _retention(retention)
+{
+	_cataloguePath = _directory + "catalogue";
+}
+
+uint64_t RecordingCatalogue::totalSize()
+{
+	std::lock_guard<std::mutex> entriesGuard(_entriesMutex);
+	return _totalSize;
+}
+
+size_t RecordingCatalogue::segmentCount()
+{
+	std::lock_guard<std::mutex> entriesGuard(_entriesMutex);
+	return _entries.size();
+}
+
+std::vector<std::string> RecordingCatalogue::getDirectoryEntries(const std::string& directory, bool directories)
+{
+	std::vector<std::string> entries;
+	DIR* directoryHandle = opendir(directory.c_str());
+	if(!directoryHandle) return entries;
+	struct dirent* entry = nullptr;
+	while((entry = readdir(directoryHandle)) != nullptr)
+	{
+		std::string name(entry->d_name);
+		if(name == "." || name == "..") continue;
+		bool isDirectory = entry->d_type == DT_DIR;
+		if(entry->d_type == DT_UNKNOWN)
+		{
+			struct stat fileInfo;
+			isDirectory = stat((directory + name).c_str(), &fileInfo) == 0 && S_ISDIR(fileInfo.st_mode);
+		}
+		if(isDirectory == directories) entries.push_back(name);
+	}
+	closedir(directoryHandle);
+	return entries;
+}
+
+void RecordingCatalogue::scan(const std::string& directory, uint64_t peerId, const std::set<std::string>& knownPaths)
+{
+	std::vector<std::string> files = getDirectoryEntries(_directory + directory, false);
+	for(std::vector<std::string>::iterator i = files.begin(); i != files.end(); ++i)
+	{
+		if(i->size() <= 4 || i->compare(i->size() - 4, 4, ".idx") != 0) continue;
+		Entry entry;
+		entry.path = directory + i->substr(0, i->size() - 4);
+		if(knownPaths.find(entry.path) != knownPaths.end()) continue;
+
+		std::vector<Segment::IndexEntry> indexEntries;
+		if(!Segment::readIndex(_directory + entry.path, indexEntries) || indexEntries.empty()) continue;
+		struct stat fileInfo;
+		if(stat((_directory + entry.path + ".mjpeg").c_str(), &fileInfo) == -1) continue;
+		entry.peerId = peerId;
+		entry.startTime = indexEntries.front().time;
+		entry.endTime = indexEntries.back().time;
+		entry.size = fileInfo.st_size + indexEntries.size() * sizeof(Segment::IndexEntry);
+		_totalSize += entry.size;
+		_entries.emplace(entry.startTime, std::move(entry));
+	}
+}
+
+void RecordingCatalogue::load()
+{
+	try
+	{
+		std::lock_guard<std::mutex> entriesGuard(_entriesMutex);
+		_entries.clear();
+		_totalSize = 0;
+		std::set<std::string> knownPaths;
+		bool modified = false;
+
+		if(BaseLib::Io::fileExists(_cataloguePath))
+		{
+			std::istringstream stream(BaseLib::Io::getFileContent(_cataloguePath));
+			std::string line;
+			while(std::getline(stream, line))
+			{
+				Entry entry;
+				std::istringstream lineStream(line);
+				if(!(lineStream >> entry.peerId >> entry.startTime >> entry.endTime >> entry.size >> entry.path) || !knownPaths.insert(entry.path).second || !BaseLib::Io::fileExists(_directory + entry.path + ".idx"))
+				{
+					modified = true;
+					continue;
+				}
+				_totalSize += entry.size;
+				_entries.emplace(entry.startTime, std::move(entry));
+			}
+		}
+
+		//Add segments which were not closed properly (e. g. after a crash) or recorded before the catalogue existed
+		size_t entryCount = _entries.size();
+		std::vector<std::string> peerDirectories = getDirectoryEntries(_directory, true);
+		for(std::vector<std::string>::iterator i = peerDirectories.begin(); i != peerDirectories.end(); ++i)
+		{
+			uint64_t peerId = std::strtoull(i->c_str(), nullptr, 10);
+			if(peerId == 0) continue;
+			std::vector<std::string> directories = getDirectoryEntries(_directory + *i + "/", true);
+			for(std::vector<std::string>::iterator j = directories.begin(); j != directories.end(); ++j)
+			{
+				scan(*i + "/" + *j + "/", peerId, knownPaths);
+			}
+		}
+		if(_entries.size() != entryCount) modified = true;
+		if(modified) save();
+
+		GD::out.printInfo("Info: Recording catalogue contains " + std::to_string(_entries.size()) + " segments with a total size of " + std::to_string(_totalSize / 1048576) + " MiB.");
+	}
+	catch(const std::exception& ex)
+	{
+		GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+	}
+	enforceLimits();
+}
+
+void RecordingCatalogue::append(const Entry& entry)
+{
+	std::string line = std::to_string(entry.peerId) + ' ' + std::to_string(entry.startTime) + ' ' + std::to_string(entry.endTime) + ' ' + std::to_string(entry.size) + ' ' + entry.path + '\n';
+	int descriptor = ::open(_cataloguePath.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, S_IRUSR | S_IWUSR | S_IRGRP);
+	if(descriptor == -1)
+	{
+		GD::out.printError("Error: Could not open " + _cataloguePath + ": " + strerror(errno));
+		return;
+	}
+	if(write(descriptor, line.data(), line.size()) != (ssize_t)line.size()) GD::out.printError("Error: Could not write to " + _cataloguePath + ": " + strerror(errno));
+	::close(descriptor);
+}
+
+void RecordingCatalogue::save()
+{
+	std::string content;
+	content.reserve(_entries.size() * 80);
+	for(std::multimap<int64_t, Entry>::iterator i = _entries.begin(); i != _entries.end(); ++i)
+	{
+		content.append(std::to_string(i->second.peerId) + ' ' + std::to_string(i->second.startTime) + ' ' + std::to_string(i->second.endTime) + ' ' + std::to_string(i->second.size) + ' ' + i->second.path + '\n');
+	}
+
+	//Write to a temporary file first, so the catalogue is never truncated
+	std::string tempPath = _cataloguePath + ".tmp";
+	int descriptor = ::open(tempPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, S_IRUSR | S_IWUSR | S_IRGRP);
+	if(descriptor == -1)
+	{
+		GD::out.printError("Error: Could not open " + tempPath + ": " + strerror(errno));
+		return;
+	}
+	bool success = write(descriptor, content.data(), content.size()) == (ssize_t)content.size();
+	::close(descriptor);
+	if(!success || rename(tempPath.c_str(), _cataloguePath.c_str()) == -1)
+	{
+		GD::out.printError("Error: Could not write " + _cataloguePath + ": " + strerror(errno));
+		unlink(tempPath.c_str());
+	}
+}
+
+void RecordingCatalogue::add(uint64_t peerId, Segment& segment)
+{
+	try
+	{
+		if(segment.frameCount() == 0) return;
+		Entry entry;
+		entry.peerId = peerId;
+		entry.startTime = segment.startTime();
+		entry.endTime = segment.endTime();
+		entry.size = segment.size() + segment.frameCount() * sizeof(Segment::IndexEntry);
+		entry.path = segment.path();
+		if(entry.path.compare(0, _directory.size(), _directory) != 0)
+		{
+			GD::out.printWarning("Warning: Segment " + entry.path + " is not located in the recording directory and is not added to the catalogue.");
+			return;
+		}
+		entry.path = entry.path.substr(_directory.size());
+
+		{
+			std::lock_guard<std::mutex> entriesGuard(_entriesMutex);
+			append(entry);
+			_totalSize += entry.size;
+			_entries.emplace(entry.startTime, std::move(entry));
+		}
+		enforceLimits();
+	}
+	catch(const std::exception& ex)
+	{
+		GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+	}
+}
+
+void RecordingCatalogue::enforceLimits()
+{
+	try
+	{
+		if(_quota == 0 && _retention == 0) return;
+		std::vector<Entry> evictedEntries;
+		{
+			std::lock_guard<std::mutex> entriesGuard(_entriesMutex);
+			int64_t minTime = BaseLib::HelperFunctions::getTime() - _retention;
+			while(!_entries.empty())
+			{
+				std::multimap<int64_t, Entry>::iterator oldestEntry = _entries.begin();
+				if((_retention == 0 || oldestEntry->second.endTime >= minTime) && (_quota == 0 || _totalSize <= _quota)) break;
+				_totalSize -= oldestEntry->second.size;
+				evictedEntries.push_back(std::move(oldestEntry->second));
+				_entries.erase(oldestEntry);
+			}
+			if(evictedEntries.empty()) return;
+			save();
+		}
+
+		for(std::vector<Entry>::iterator i = evictedEntries.begin(); i != evictedEntries.end(); ++i)
+		{
+			if(GD::bl->debugLevel >= 4) GD::out.printInfo("Info: Deleting recording " + _directory + i->path + ".");
+			if(unlink((_directory + i->path + ".mjpeg").c_str()) == -1 && errno != ENOENT) GD::out.printError("Error: Could not delete " + _directory + i->path + ".mjpeg: " + strerror(errno));
+			if(unlink((_directory + i->path + ".idx").c_str()) == -1 && errno != ENOENT) GD::out.printError("Error: Could not delete " + _directory + i->path + ".idx: " + strerror(errno));
+		}
+		_evictedSegments += evictedEntries.size();
+	}
+	catch(const std::exception& ex)
+	{
+		GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+	}
+}
+
+}
@@ -0,0 +1,98 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+#ifndef RECORDINGCATALOGUE_H_
+#define RECORDINGCATALOGUE_H_
+
+#include "Segment.h"
+
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <set>
+
+namespace IpCam
+{
+
+/**
+ * Keeps track of all closed segments (clips and continuous recordings) of all cameras and deletes the oldest ones when the
+ * disk quota or the retention time is exceeded. The catalogue is stored in the file "catalogue" in the recording directory,
+ * one line per segment.
+ */
+class RecordingCatalogue
+{
+public:
+	struct Entry
+	{
+		uint64_t peerId = 0;
+		int64_t startTime = 0;
+		int64_t endTime = 0;
+		uint64_t size = 0;
+		std::string path;
+	};
+
+	/**
+	 * @param directory The recording directory.
+	 * @param quota The maximum size of all segments in bytes or 0 for no limit.
+	 * @param retention The maximum age of segments in milliseconds or 0 for no limit.
+	 */
+	RecordingCatalogue(const std::string& directory, uint64_t quota, int64_t retention);
+	virtual ~RecordingCatalogue() {}
+
+	/**
+	 * Loads the catalogue file and adds segments found on disk which are missing in the catalogue.
+	 */
+	void load();
+	void add(uint64_t peerId, Segment& segment);
+	void enforceLimits();
+
+	uint64_t quota() { return _quota; }
+	int64_t retention() { return _retention; }
+	uint64_t totalSize();
+	size_t segmentCount();
+	uint64_t evictedSegments() { return _evictedSegments; }
+protected:
+	std::mutex _entriesMutex;
+	std::string _directory;
+	std::string _cataloguePath;
+	uint64_t _quota = 0;
+	int64_t _retention = 0;
+	std::multimap<int64_t, Entry> _entries;
+	uint64_t _totalSize = 0;
+	std::atomic<uint64_t> _evictedSegments{0};
+
+	void append(const Entry& entry);
+	void save();
+	void scan(const std::string& directory, uint64_t peerId, const std::set<std::string>& knownPaths);
+	static std::vector<std::string> getDirectoryEntries(const std::string& directory, bool directories);
+};
+
+}
+
+#endif
@@ -0,0 +1,206 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+#include "RecordingWriter.h"
+#include "GD.h"
+
+namespace IpCam
+{
+
+RecordingWriter::RecordingWriter(size_t maxQueueSize, size_t maxQueueBytes) : _maxQueueSize(maxQueueSize), _maxQueueBytes(maxQueueBytes)
+{
+	//Reserve additional space for close requests
+	_queue.resize(maxQueueSize + 64);
+}
+
+RecordingWriter::~RecordingWriter()
+{
+	stop();
+}
+
+bool RecordingWriter::push(Job& job)
+{
+	{
+		std::lock_guard<std::mutex> queueGuard(_queueMutex);
+		if(_stopWorkerThread) return false;
+		if(!job.close && !job.task && (_count >= _maxQueueSize || _queueBytes + job.frame.capacity() > _maxQueueBytes)) return false;
+		_queueBytes += job.frame.capacity();
+		if(_count == _queue.size())
+		{
+			std::vector<Job> queue(_queue.size() + 64);
+			for(size_t i = 0; i < _count; i++)
+			{
+				queue[i] = std::move(_queue[(_head + i) % _queue.size()]);
+			}
+			_queue.swap(queue);
+			_head = 0;
+		}
+		_queue[(_head + _count) % _queue.size()] = std::move(job);
+		_count++;
+		if(_count > _peakQueueSize) _peakQueueSize = _count;
+		if(!_running)
+		{
+			_running = true;
+			GD::bl->threadManager.start(_workerThread, false, &RecordingWriter::worker, this);
+		}
+	}
+	_queueConditionVariable.notify_one();
+	return true;
+}
+
+bool RecordingWriter::write(const std::shared_ptr<Segment>& segment, const Frame& frame)
+{
+	try
+	{
+		Job job;
+		job.segment = segment;
+		job.frame = frame;
+		if(push(job)) return true;
+		_droppedFrames++;
+		if(GD::bl->debugLevel >= 5) GD::out.printDebug("Debug: Recording queue is full. Dropping frame for " + segment->path() + ".");
+	}
+	catch(const std::exception& ex)
+	{
+		GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+	}
+	return false;
+}
+
+void RecordingWriter::close(const std::shared_ptr<Segment>& segment, const CloseCallback& callback)
+{
+	try
+	{
+		Job job;
+		job.segment = segment;
+		job.callback = callback;
+		job.close = true;
+		push(job);
+	}
+	catch(const std::exception& ex)
+	{
+		GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+	}
+}
+
+void RecordingWriter::post(const Task& task)
+{
+	try
+	{
+		Job job;
+		job.task = task;
+		push(job);
+	}
+	catch(const std::exception& ex)
+	{
+		GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+	}
+}
+
+size_t RecordingWriter::queueSize()
+{
+	std::lock_guard<std::mutex> queueGuard(_queueMutex);
+	return _count;
+}
+
+uint64_t RecordingWriter::throughput()
+{
+	//No writes for more than two seconds
+	if(BaseLib::HelperFunctions::getTime() - _throughputWindowStart >= 2000) return 0;
+	return _throughput;
+}
+
+void RecordingWriter::updateThroughput(int64_t bytes)
+{
+	int64_t time = BaseLib::HelperFunctions::getTime();
+	_throughputWindowBytes += bytes;
+	int64_t elapsedTime = time - _throughputWindowStart;
+	if(elapsedTime >= 1000)
+	{
+		_throughput = _throughputWindowBytes * 1000 / elapsedTime;
+		_throughputWindowStart = time;
+		_throughputWindowBytes = 0;
+	}
+}
+
+void RecordingWriter::stop()
+{
+	{
+		std::lock_guard<std::mutex> queueGuard(_queueMutex);
+		_stopWorkerThread = true;
+	}
+	_queueConditionVariable.notify_one();
+	GD::bl->threadManager.join(_workerThread);
+}
+
+void RecordingWriter::worker()
+{
+	while(true)
+	{
+		Job job;
+		{
+			std::unique_lock<std::mutex> queueGuard(_queueMutex);
+			_queueConditionVariable.wait(queueGuard, [&] { return _count > 0 || _stopWorkerThread; });
+			if(_count == 0) break;
+			job = std::move(_queue[_head]);
+			_head = (_head + 1) % _queue.size();
+			_count--;
+		}
+
+		try
+		{
+			if(job.task) job.task();
+			else if(job.close)
+			{
+				job.segment->close();
+				if(job.callback) job.callback(job.segment);
+			}
+			else
+			{
+				int64_t bytesWritten = job.segment->append(job.frame);
+				if(bytesWritten > 0)
+				{
+					_bytesWritten += bytesWritten;
+					_framesWritten++;
+					updateThroughput(bytesWritten);
+				}
+			}
+		}
+		catch(const std::exception& ex)
+		{
+			GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+		}
+		//The frame's pool block is free once the job is gone.
+		_queueBytes -= job.frame.capacity();
+		job.frame.reset();
+	}
+	std::lock_guard<std::mutex> queueGuard(_queueMutex);
+	_running = false;
+}
+
+}
@@ -0,0 +1,138 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+#ifndef RECORDINGWRITER_H_
+#define RECORDINGWRITER_H_
+
+#include "Segment.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace IpCam
+{
+
+/**
+ * Writes frames to segments in a background thread, so slow disks never block the stream hubs. The number of queued
+ * frames and the frame pool memory they occupy are bounded. When the queue is full, frames are dropped.
+ */
+class RecordingWriter
+{
+public:
+	typedef std::function<void(const std::shared_ptr<Segment>& segment)> CloseCallback;
+	typedef std::function<void()> Task;
+
+	/**
+	 * @param maxQueueSize The maximum number of queued frames.
+	 * @param maxQueueBytes The maximum size of the pool blocks of all queued frames.
+	 */
+	RecordingWriter(size_t maxQueueSize, size_t maxQueueBytes);
+	virtual ~RecordingWriter();
+
+	/**
+	 * Queues a frame.
+	 *
+	 * @return Returns false when the frame was dropped.
+	 */
+	bool write(const std::shared_ptr<Segment>& segment, const Frame& frame);
+
+	/**
+	 * Queues closing of a segment. Close requests are never dropped. The callback is executed in the writer thread after
+	 * all previously queued frames of the segment have been written.
+	 */
+	void close(const std::shared_ptr<Segment>& segment, const CloseCallback& callback);
+
+	/**
+	 * Queues a task to execute in the writer thread, e. g. deleting old recordings. Tasks are never dropped.
+	 */
+	void post(const Task& task);
+
+	/**
+	 * Writes all queued frames and stops the writer thread.
+	 */
+	void stop();
+
+	// {{{ Statistics
+	size_t queueSize();
+	size_t maxQueueSize() { return _maxQueueSize; }
+	size_t peakQueueSize() { return _peakQueueSize; }
+	size_t queueBytes() { return _queueBytes; }
+	size_t maxQueueBytes() { return _maxQueueBytes; }
+	uint64_t bytesWritten() { return _bytesWritten; }
+	uint64_t framesWritten() { return _framesWritten; }
+	uint64_t droppedFrames() { return _droppedFrames; }
+
+	/**
+	 * Returns the number of bytes written per second during the last second of activity.
+	 */
+	uint64_t throughput();
+	// }}}
+protected:
+	struct Job
+	{
+		std::shared_ptr<Segment> segment;
+		Frame frame;
+		CloseCallback callback;
+		Task task;
+		bool close = false;
+	};
+
+	std::mutex _queueMutex;
+	std::condition_variable _queueConditionVariable;
+	std::vector<Job> _queue;
+	size_t _maxQueueSize = 0;
+	size_t _maxQueueBytes = 0;
+	std::atomic<size_t> _queueBytes{0};
+	size_t _head = 0;
+	size_t _count = 0;
+	std::thread _workerThread;
+	bool _running = false;
+	bool _stopWorkerThread = false;
+
+	std::atomic<size_t> _peakQueueSize{0};
+	std::atomic<uint64_t> _bytesWritten{0};
+	std::atomic<uint64_t> _framesWritten{0};
+	std::atomic<uint64_t> _droppedFrames{0};
+	std::atomic<int64_t> _throughputWindowStart{0};
+	uint64_t _throughputWindowBytes = 0;
+	std::atomic<uint64_t> _throughput{0};
+
+	void updateThroughput(int64_t bytes);
+
+	bool push(Job& job);
+	void worker();
+};
+
+}
+
+#endif
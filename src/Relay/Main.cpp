@@ -0,0 +1,74 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+/*
+ * homegear-ipcam-relay: Relays camera streams outside of the Homegear process. The module passes the sockets of stream
+ * viewers to this process (see "relaySocket" in ipcam.conf), so the stream data doesn't pass through Homegear.
+ *
+ * Usage: homegear-ipcam-relay [SOCKET PATH]
+ *
+ * Run it as the user Homegear runs as.
+ */
+
+#include "RelayServer.h"
+#include "Log.h"
+
+#include <csignal>
+
+namespace
+{
+IpCam::Relay::RelayServer* server = nullptr;
+
+void handleSignal(int)
+{
+	if(server) server->stop();
+}
+}
+
+int main(int argc, char* argv[])
+{
+	std::string socketPath = argc > 1 ? argv[1] : "/var/run/homegear/ipcam-relay.sock";
+	if(socketPath == "-h" || socketPath == "--help")
+	{
+		IpCam::Relay::log("Usage: homegear-ipcam-relay [SOCKET PATH] (default: /var/run/homegear/ipcam-relay.sock)");
+		return 0;
+	}
+
+	IpCam::Relay::RelayServer relayServer(socketPath);
+	server = &relayServer;
+	signal(SIGPIPE, SIG_IGN);
+	struct sigaction action{};
+	action.sa_handler = handleSignal;
+	sigaction(SIGTERM, &action, nullptr);
+	sigaction(SIGINT, &action, nullptr);
+
+	bool result = relayServer.run();
+	server = nullptr;
+	return result ? 0 : 1;
+}
@@ -0,0 +1,255 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+#include "RelayServer.h"
+#include "Log.h"
+
+#include <chrono>
+#include <cstring>
+
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace IpCam
+{
+namespace Relay
+{
+
+RelayServer::RelayServer(const std::string& socketPath) : _socketPath(socketPath)
+{
+	_wakeDescriptor = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+}
+
+RelayServer::~RelayServer()
+{
+	stop();
+	if(_wakeDescriptor != -1) close(_wakeDescriptor);
+}
+
+void RelayServer::stop()
+{
+	_stop = true;
+	uint64_t value = 1;
+	if(write(_wakeDescriptor, &value, sizeof(value)) == -1) {}
+}
+
+bool RelayServer::listen()
+{
+	sockaddr_un address{};
+	address.sun_family = AF_UNIX;
+	if(_socketPath.size() >= sizeof(address.sun_path))
+	{
+		log("Error: Socket path is too long.");
+		return false;
+	}
+	std::strncpy(address.sun_path, _socketPath.c_str(), sizeof(address.sun_path) - 1);
+
+	_listenDescriptor = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	if(_listenDescriptor == -1)
+	{
+		log(std::string("Error: Could not create socket: ") + strerror(errno));
+		return false;
+	}
+	unlink(_socketPath.c_str());
+	if(bind(_listenDescriptor, (sockaddr*)&address, sizeof(address)) == -1 || ::listen(_listenDescriptor, 16) == -1)
+	{
+		log("Error: Could not listen on " + _socketPath + ": " + strerror(errno));
+		close(_listenDescriptor);
+		_listenDescriptor = -1;
+		return false;
+	}
+	//Only Homegear (same user or group) may pass sockets.
+	chmod(_socketPath.c_str(), S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP);
+	log("Info: Listening on " + _socketPath + ".");
+	return true;
+}
+
+bool RelayServer::run()
+{
+	if(!listen()) return false;
+
+	std::vector<pollfd> pollDescriptors;
+	std::vector<uint64_t> pollConnections;
+	auto lastStatsTime = std::chrono::steady_clock::now();
+	while(!_stop)
+	{
+		pollDescriptors.clear();
+		pollConnections.clear();
+		pollDescriptors.push_back(pollfd{ _wakeDescriptor, POLLIN, 0 });
+		pollDescriptors.push_back(pollfd{ _listenDescriptor, POLLIN, 0 });
+		{
+			std::lock_guard<std::mutex> connectionsGuard(_connectionsMutex);
+			for(auto& connection : _connections)
+			{
+				pollDescriptors.push_back(pollfd{ connection.second, POLLIN, 0 });
+				pollConnections.push_back(connection.first);
+			}
+		}
+
+		if(poll(pollDescriptors.data(), pollDescriptors.size(), 1000) == -1 && errno != EINTR)
+		{
+			log(std::string("Error: poll failed: ") + strerror(errno));
+			break;
+		}
+		if(_stop) break;
+		if(pollDescriptors.at(0).revents & POLLIN)
+		{
+			uint64_t value = 0;
+			if(read(_wakeDescriptor, &value, sizeof(value)) == -1) {}
+		}
+		if(pollDescriptors.at(1).revents & POLLIN) accept();
+		for(size_t i = 0; i < pollConnections.size(); i++)
+		{
+			short events = pollDescriptors.at(i + 2).revents;
+			if(events == 0) continue;
+			if(!(events & POLLIN) || !handleMessage(pollConnections.at(i), pollDescriptors.at(i + 2).fd)) closeConnection(pollConnections.at(i));
+		}
+
+		if(std::chrono::steady_clock::now() - lastStatsTime >= std::chrono::seconds(10))
+		{
+			lastStatsTime = std::chrono::steady_clock::now();
+			sendStats();
+			for(auto i = _upstreams.begin(); i != _upstreams.end();)
+			{
+				if(i->second->idle()) i = _upstreams.erase(i);
+				else ++i;
+			}
+		}
+	}
+
+	log("Info: Shutting down.");
+	for(auto& upstream : _upstreams) upstream.second->stop();
+	_upstreams.clear();
+	{
+		std::lock_guard<std::mutex> connectionsGuard(_connectionsMutex);
+		for(auto& connection : _connections) close(connection.second);
+		_connections.clear();
+	}
+	close(_listenDescriptor);
+	_listenDescriptor = -1;
+	unlink(_socketPath.c_str());
+	return true;
+}
+
+void RelayServer::accept()
+{
+	int descriptor = accept4(_listenDescriptor, nullptr, nullptr, SOCK_CLOEXEC);
+	if(descriptor == -1) return;
+	std::lock_guard<std::mutex> connectionsGuard(_connectionsMutex);
+	_connections.emplace(++_currentConnectionId, descriptor);
+	log("Info: Module connected (connection " + std::to_string(_currentConnectionId) + ").");
+}
+
+void RelayServer::closeConnection(uint64_t connectionId)
+{
+	{
+		std::lock_guard<std::mutex> connectionsGuard(_connectionsMutex);
+		auto connectionIterator = _connections.find(connectionId);
+		if(connectionIterator == _connections.end()) return;
+		close(connectionIterator->second);
+		_connections.erase(connectionIterator);
+	}
+	log("Info: Module disconnected (connection " + std::to_string(connectionId) + "). Closing its clients.");
+	for(auto& upstream : _upstreams) upstream.second->removeClient(connectionId, 0);
+}
+
+bool RelayServer::handleMessage(uint64_t connectionId, int descriptor)
+{
+	RelayProtocol::MessageHeader header;
+	std::vector<char> payload;
+	int clientDescriptor = -1;
+	int result = RelayProtocol::receiveMessage(descriptor, header, payload, clientDescriptor);
+	if(result <= 0)
+	{
+		if(result == -1 && errno == EPROTO)
+		{
+			log("Warning: Received invalid message. Please make sure the relay and the module have the same version.");
+			return false;
+		}
+		return result == -1 && (errno == EAGAIN || errno == EWOULDBLOCK);
+	}
+
+	if(header.type == (uint32_t)RelayProtocol::MessageType::stream)
+	{
+		RelayProtocol::StreamRequest request;
+		if(clientDescriptor == -1 || !request.deserialize(payload))
+		{
+			log("Warning: Received invalid stream request for peer " + std::to_string(header.peerId) + ".");
+			if(clientDescriptor != -1) close(clientDescriptor);
+			onClientClosed(connectionId, header.clientId, 0, 0);
+			return true;
+		}
+		std::shared_ptr<RelayUpstream>& upstream = _upstreams[header.peerId];
+		if(!upstream) upstream = std::make_shared<RelayUpstream>(header.peerId, std::bind(&RelayServer::onClientClosed, this, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3, std::placeholders::_4));
+		upstream->setUpstream(request);
+		upstream->addClient(connectionId, header.clientId, clientDescriptor, request.minFrameInterval);
+	}
+	else
+	{
+		if(clientDescriptor != -1) close(clientDescriptor);
+		if(header.type == (uint32_t)RelayProtocol::MessageType::closeClient)
+		{
+			auto upstreamIterator = _upstreams.find(header.peerId);
+			if(upstreamIterator != _upstreams.end()) upstreamIterator->second->removeClient(connectionId, header.clientId);
+		}
+	}
+	return true;
+}
+
+void RelayServer::onClientClosed(uint64_t connectionId, uint64_t clientId, uint64_t bytesSent, uint64_t framesSent)
+{
+	std::lock_guard<std::mutex> connectionsGuard(_connectionsMutex);
+	auto connectionIterator = _connections.find(connectionId);
+	if(connectionIterator == _connections.end()) return;
+	uint64_t counters[2] = { bytesSent, framesSent };
+	RelayProtocol::sendMessage(connectionIterator->second, RelayProtocol::MessageType::clientClosed, clientId, 0, (const char*)counters, sizeof(counters));
+}
+
+void RelayServer::sendStats()
+{
+	std::vector<RelayProtocol::PeerStats> stats;
+	stats.reserve(_upstreams.size());
+	for(auto& upstream : _upstreams)
+	{
+		if(stats.size() >= RelayProtocol::maxMessageSize / sizeof(RelayProtocol::PeerStats)) break;
+		stats.push_back(upstream.second->getStats());
+	}
+	std::lock_guard<std::mutex> connectionsGuard(_connectionsMutex);
+	for(auto& connection : _connections)
+	{
+		RelayProtocol::sendMessage(connection.second, RelayProtocol::MessageType::stats, 0, 0, (const char*)stats.data(), stats.size() * sizeof(RelayProtocol::PeerStats));
+	}
+}
+
+}
+}
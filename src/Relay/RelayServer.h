@@ -0,0 +1,92 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+#ifndef RELAYSERVER_H_
+#define RELAYSERVER_H_
+
+#include "RelayUpstream.h"
+
+#include <map>
+
+namespace IpCam
+{
+namespace Relay
+{
+
+/**
+ * Accepts control connections from the module on a Unix domain socket. Client sockets received over them are handed to
+ * the RelayUpstream of the camera. Every 10 seconds the statistics of all cameras are sent to all control connections.
+ * When a control connection is closed (e. g. because Homegear restarts), all of its clients are closed as well.
+ */
+class RelayServer
+{
+public:
+	RelayServer(const std::string& socketPath);
+	virtual ~RelayServer();
+
+	/**
+	 * Runs until stop() is called.
+	 *
+	 * @return Returns false when the socket could not be opened.
+	 */
+	bool run();
+
+	/**
+	 * Async-signal-safe.
+	 */
+	void stop();
+protected:
+	std::string _socketPath;
+	int _listenDescriptor = -1;
+	int _wakeDescriptor = -1;
+	std::atomic_bool _stop{false};
+
+	std::mutex _connectionsMutex;
+	std::map<uint64_t, int> _connections;
+	uint64_t _currentConnectionId = 0;
+
+	//Only accessed by the thread executing run().
+	std::map<uint64_t, std::shared_ptr<RelayUpstream>> _upstreams;
+
+	bool listen();
+	void accept();
+	void closeConnection(uint64_t connectionId);
+
+	/**
+	 * @return Returns false when the connection should be closed.
+	 */
+	bool handleMessage(uint64_t connectionId, int descriptor);
+	void onClientClosed(uint64_t connectionId, uint64_t clientId, uint64_t bytesSent, uint64_t framesSent);
+	void sendStats();
+};
+
+}
+}
+
+#endif
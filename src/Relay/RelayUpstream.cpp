@@ -0,0 +1,512 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+#include "RelayUpstream.h"
+#include "Log.h"
+
+#include <chrono>
+#include <cstring>
+
+#include <fcntl.h>
+#include <netdb.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace IpCam
+{
+namespace Relay
+{
+
+namespace
+{
+
+int64_t getTime()
+{
+	return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+std::shared_ptr<const std::vector<char>> getMultipartHeader()
+{
+	//Same response as StreamHub::getMultipartHeader() in the module.
+	static const std::string header("HTTP/1.1 200 OK\r\nContent-Type: multipart/x-mixed-replace; boundary=ipcamframe\r\nCache-Control: no-cache, no-store\r\nPragma: no-cache\r\nConnection: close\r\n\r\n");
+	static const std::shared_ptr<const std::vector<char>> buffer = std::make_shared<const std::vector<char>>(header.begin(), header.end());
+	return buffer;
+}
+
+}
+
+RelayUpstream::RelayUpstream(uint64_t peerId, ClientClosedCallback clientClosedCallback) : _peerId(peerId), _clientClosedCallback(clientClosedCallback)
+{
+	_wakeDescriptor = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+}
+
+RelayUpstream::~RelayUpstream()
+{
+	stop();
+	if(_wakeDescriptor != -1) close(_wakeDescriptor);
+}
+
+void RelayUpstream::setUpstream(const RelayProtocol::StreamRequest& request)
+{
+	std::lock_guard<std::mutex> guard(_mutex);
+	_request = request;
+	_upstreamBandwidth.setRate(request.maxRate);
+}
+
+void RelayUpstream::addClient(uint64_t connectionId, uint64_t clientId, int descriptor, int64_t minFrameInterval)
+{
+	fcntl(descriptor, F_SETFL, fcntl(descriptor, F_GETFL) | O_NONBLOCK);
+	Client client;
+	client.connectionId = connectionId;
+	client.id = clientId;
+	client.descriptor = descriptor;
+	client.minFrameInterval = minFrameInterval;
+	client.addedTime = getTime();
+	client.lastProgressTime = client.addedTime;
+	client.current = getMultipartHeader();
+
+	std::lock_guard<std::mutex> guard(_mutex);
+	if(_stop)
+	{
+		close(descriptor);
+		return;
+	}
+	_newClients.push_back(std::move(client));
+	if(_running)
+	{
+		wake();
+		return;
+	}
+	//The thread doesn't lock the mutex anymore after setting _running to false.
+	if(_thread.joinable()) _thread.join();
+	_running = true;
+	_thread = std::thread(&RelayUpstream::worker, this);
+}
+
+void RelayUpstream::removeClient(uint64_t connectionId, uint64_t clientId)
+{
+	std::lock_guard<std::mutex> guard(_mutex);
+	_removedClients.emplace_back(connectionId, clientId);
+	wake();
+}
+
+bool RelayUpstream::idle()
+{
+	std::lock_guard<std::mutex> guard(_mutex);
+	return !_running && _newClients.empty();
+}
+
+RelayProtocol::PeerStats RelayUpstream::getStats()
+{
+	RelayProtocol::PeerStats stats;
+	stats.peerId = _peerId;
+	stats.clients = _clientCount;
+	stats.upstreamConnected = _upstreamConnected;
+	stats.frames = _frames;
+	stats.droppedFrames = _droppedFrames;
+	stats.bytesReceived = _bytesReceived;
+	stats.bytesSent = _bytesSent;
+	return stats;
+}
+
+void RelayUpstream::stop()
+{
+	std::list<Client> newClients;
+	{
+		std::lock_guard<std::mutex> guard(_mutex);
+		_stop = true;
+		wake();
+	}
+	if(_thread.joinable()) _thread.join();
+	{
+		std::lock_guard<std::mutex> guard(_mutex);
+		_running = false;
+		newClients.swap(_newClients);
+	}
+	for(auto& client : newClients)
+	{
+		close(client.descriptor);
+		if(_clientClosedCallback) _clientClosedCallback(client.connectionId, client.id, 0, 0);
+	}
+}
+
+void RelayUpstream::wake()
+{
+	uint64_t value = 1;
+	if(write(_wakeDescriptor, &value, sizeof(value)) == -1) {}
+}
+
+void RelayUpstream::worker()
+{
+	std::vector<pollfd> pollDescriptors;
+	std::vector<Client*> pollClients;
+	std::vector<char> discardBuffer(1024);
+	bool noClients = false;
+	_lastClientTime = getTime();
+	while(!_stop)
+	{
+		if(!applyChanges())
+		{
+			noClients = true;
+			break;
+		}
+
+		int64_t time = getTime();
+		if(_upstream == -1 && time >= _nextConnectTime && !_clients.empty() && !connect()) disconnect();
+
+		pollDescriptors.clear();
+		pollClients.clear();
+		int32_t timeout = 1000;
+		pollDescriptors.push_back(pollfd{ _wakeDescriptor, POLLIN, 0 });
+		if(_upstream != -1)
+		{
+			//Don't read while the rate limit is exceeded. Errors are still reported.
+			int64_t delay = _upstreamBandwidth.delay(time);
+			if(delay > 0 && delay < timeout) timeout = delay;
+			pollDescriptors.push_back(pollfd{ _upstream, (short)(delay > 0 ? 0 : POLLIN), 0 });
+		}
+		for(auto& client : _clients)
+		{
+			pollDescriptors.push_back(pollfd{ client.descriptor, (short)(client.current ? POLLIN | POLLOUT : POLLIN), 0 });
+			pollClients.push_back(&client);
+		}
+		if(poll(pollDescriptors.data(), pollDescriptors.size(), timeout) == -1 && errno != EINTR)
+		{
+			log("Error: poll failed for peer " + std::to_string(_peerId) + ": " + strerror(errno));
+			break;
+		}
+
+		size_t index = 0;
+		if(pollDescriptors.at(index++).revents & POLLIN)
+		{
+			uint64_t value = 0;
+			if(read(_wakeDescriptor, &value, sizeof(value)) == -1) {}
+		}
+		if(_upstream != -1 && pollDescriptors.at(index++).revents && _upstreamBandwidth.delay(getTime()) == 0) readUpstream();
+		for(auto client : pollClients)
+		{
+			short events = pollDescriptors.at(index++).revents;
+			if(client->closed || events == 0) continue;
+			if(events & (POLLERR | POLLHUP | POLLNVAL))
+			{
+				closeClient(*client);
+				continue;
+			}
+			if(events & POLLIN)
+			{
+				//Clients don't send anything after the request. Reading detects closed connections.
+				ssize_t result = recv(client->descriptor, discardBuffer.data(), discardBuffer.size(), MSG_DONTWAIT);
+				if(result == 0 || (result == -1 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR))
+				{
+					closeClient(*client);
+					continue;
+				}
+			}
+			if(events & POLLOUT) flush(*client);
+		}
+
+		time = getTime();
+		if(_upstream != -1 && time - _lastDataTime >= 30000)
+		{
+			log("Warning: No data received from camera of peer " + std::to_string(_peerId) + " for 30 seconds. Reconnecting.");
+			disconnect();
+		}
+		for(auto& client : _clients)
+		{
+			if(client.closed) continue;
+			if(client.current && time - client.lastProgressTime >= 30000)
+			{
+				log("Info: Client " + std::to_string(client.id) + " of peer " + std::to_string(_peerId) + " didn't receive any data for 30 seconds. Closing it.");
+				closeClient(client);
+			}
+			else if(time - std::max(_lastFrameTime, client.addedTime) >= 30000)
+			{
+				log("Warning: No frames received from camera of peer " + std::to_string(_peerId) + " for 30 seconds. Closing client " + std::to_string(client.id) + ".");
+				closeClient(client);
+			}
+		}
+	}
+
+	if(!noClients)
+	{
+		//Stopped or failed: Close all clients including the ones added in the meantime.
+		{
+			std::lock_guard<std::mutex> guard(_mutex);
+			for(auto& client : _newClients) _clients.push_back(std::move(client));
+			_newClients.clear();
+			_removedClients.clear();
+			_running = false;
+		}
+		for(auto& client : _clients)
+		{
+			closeClient(client);
+			if(_clientClosedCallback) _clientClosedCallback(client.connectionId, client.id, client.bytesSent, client.framesSent);
+		}
+		_clients.clear();
+		_clientCount = 0;
+	}
+	disconnect();
+	_retryDelay = 1000;
+	_nextConnectTime = 0;
+}
+
+bool RelayUpstream::applyChanges()
+{
+	{
+		std::lock_guard<std::mutex> guard(_mutex);
+		for(auto& client : _newClients) _clients.push_back(std::move(client));
+		_newClients.clear();
+		for(auto& removedClient : _removedClients)
+		{
+			for(auto& client : _clients)
+			{
+				if(client.connectionId == removedClient.first && (removedClient.second == 0 || client.id == removedClient.second)) closeClient(client);
+			}
+		}
+		_removedClients.clear();
+	}
+
+	//The callback is called without holding the mutex, as it locks the mutex of the server.
+	for(std::list<Client>::iterator i = _clients.begin(); i != _clients.end();)
+	{
+		if(!i->closed)
+		{
+			++i;
+			continue;
+		}
+		if(_clientClosedCallback) _clientClosedCallback(i->connectionId, i->id, i->bytesSent, i->framesSent);
+		i = _clients.erase(i);
+	}
+	_clientCount = _clients.size();
+
+	int64_t time = getTime();
+	if(!_clients.empty() || _stop)
+	{
+		_lastClientTime = time;
+		return true;
+	}
+	if(time - _lastClientTime < 5000) return true;
+
+	std::lock_guard<std::mutex> guard(_mutex);
+	if(!_newClients.empty()) return true;
+	_running = false;
+	return false;
+}
+
+bool RelayUpstream::connect()
+{
+	RelayProtocol::StreamRequest request;
+	{
+		std::lock_guard<std::mutex> guard(_mutex);
+		request = _request;
+	}
+	_connectTime = getTime();
+	if(request.host.empty()) return false;
+
+	struct addrinfo hints{};
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+	struct addrinfo* addresses = nullptr;
+	int result = getaddrinfo(request.host.c_str(), std::to_string(request.port).c_str(), &hints, &addresses);
+	if(result != 0)
+	{
+		log("Warning: Could not resolve " + request.host + " (peer " + std::to_string(_peerId) + "): " + gai_strerror(result));
+		return false;
+	}
+
+	int descriptor = -1;
+	std::string error;
+	for(struct addrinfo* address = addresses; address; address = address->ai_next)
+	{
+		descriptor = socket(address->ai_family, address->ai_socktype | SOCK_NONBLOCK | SOCK_CLOEXEC, address->ai_protocol);
+		if(descriptor == -1) continue;
+		if(::connect(descriptor, address->ai_addr, address->ai_addrlen) == 0) break;
+		if(errno == EINPROGRESS)
+		{
+			pollfd pollDescriptor{ descriptor, POLLOUT, 0 };
+			int socketError = ETIMEDOUT;
+			socklen_t length = sizeof(socketError);
+			if(poll(&pollDescriptor, 1, 5000) == 1) getsockopt(descriptor, SOL_SOCKET, SO_ERROR, &socketError, &length);
+			if(socketError == 0) break;
+			error = strerror(socketError);
+		}
+		else error = strerror(errno);
+		close(descriptor);
+		descriptor = -1;
+	}
+	freeaddrinfo(addresses);
+	if(descriptor == -1)
+	{
+		log("Warning: Could not connect to camera of peer " + std::to_string(_peerId) + " (" + request.host + ":" + std::to_string(request.port) + "): " + error);
+		return false;
+	}
+
+	std::string port = std::to_string(request.port);
+	std::string header = "GET " + request.path + " HTTP/1.1\r\nUser-Agent: Homegear\r\nHost: " + request.host + ":" + port + "\r\nConnection: Close\r\n";
+	if(!request.authorization.empty()) header += "Authorization: " + request.authorization + "\r\n";
+	header += "\r\n";
+	size_t offset = 0;
+	while(offset < header.size())
+	{
+		ssize_t sent = send(descriptor, header.data() + offset, header.size() - offset, MSG_NOSIGNAL);
+		if(sent > 0)
+		{
+			offset += sent;
+			continue;
+		}
+		pollfd pollDescriptor{ descriptor, POLLOUT, 0 };
+		if(sent == -1 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) && poll(&pollDescriptor, 1, 5000) == 1) continue;
+		log("Warning: Could not send request to camera of peer " + std::to_string(_peerId) + ".");
+		close(descriptor);
+		return false;
+	}
+
+	_upstream = descriptor;
+	_upstreamConnected = 1;
+	_parser.reset();
+	_lastDataTime = getTime();
+	return true;
+}
+
+void RelayUpstream::disconnect()
+{
+	if(_upstream != -1)
+	{
+		close(_upstream);
+		_upstream = -1;
+		_upstreamConnected = 0;
+	}
+	int64_t time = getTime();
+	if(time - _connectTime > 10000) _retryDelay = 1000;
+	_nextConnectTime = time + _retryDelay;
+	_retryDelay = _retryDelay >= 15000 ? 30000 : _retryDelay * 2;
+}
+
+void RelayUpstream::readUpstream()
+{
+	MjpegParser::FrameCallback frameCallback = std::bind(&RelayUpstream::onFrame, this, std::placeholders::_1, std::placeholders::_2);
+	//Don't starve the clients when the camera sends faster than we can read.
+	for(int32_t i = 0; i < 4; i++)
+	{
+		ssize_t result = recv(_upstream, _receiveBuffer.data(), _receiveBuffer.size(), MSG_DONTWAIT);
+		if(result > 0)
+		{
+			_bytesReceived += result;
+			_lastDataTime = getTime();
+			_upstreamBandwidth.take(result, _lastDataTime);
+			if(!_parser.process(_receiveBuffer.data(), result, frameCallback))
+			{
+				log("Warning: Error reading stream of peer " + std::to_string(_peerId) + ": " + _parser.getError());
+				disconnect();
+				return;
+			}
+			if((size_t)result < _receiveBuffer.size() || _upstreamBandwidth.delay(_lastDataTime) > 0) return;
+			continue;
+		}
+		if(result == -1 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) return;
+		log("Warning: Error reading stream of peer " + std::to_string(_peerId) + ": " + (result == 0 ? std::string("Connection closed.") : std::string(strerror(errno))));
+		disconnect();
+		return;
+	}
+}
+
+void RelayUpstream::onFrame(const char* data, size_t size)
+{
+	_frames++;
+	int64_t time = getTime();
+	_lastFrameTime = time;
+
+	std::string partHeader = "--ipcamframe\r\nContent-Type: image/jpeg\r\nContent-Length: " + std::to_string(size) + "\r\n\r\n";
+	std::shared_ptr<std::vector<char>> buffer = std::make_shared<std::vector<char>>();
+	buffer->reserve(partHeader.size() + size + 2);
+	buffer->insert(buffer->end(), partHeader.begin(), partHeader.end());
+	buffer->insert(buffer->end(), data, data + size);
+	buffer->push_back('\r');
+	buffer->push_back('\n');
+	PBuffer frame(std::move(buffer));
+
+	for(auto& client : _clients)
+	{
+		if(client.closed) continue;
+		if(client.minFrameInterval > 0 && time - client.lastSentTime < client.minFrameInterval) continue;
+		client.lastSentTime = time;
+		if(client.current)
+		{
+			//Drop the frame waiting to be sent in favor of the newer one.
+			if(client.next) _droppedFrames++;
+			client.next = frame;
+			continue;
+		}
+		client.current = frame;
+		client.offset = 0;
+		client.lastProgressTime = time;
+		flush(client);
+	}
+}
+
+void RelayUpstream::flush(Client& client)
+{
+	while(client.current && !client.closed)
+	{
+		ssize_t result = send(client.descriptor, client.current->data() + client.offset, client.current->size() - client.offset, MSG_NOSIGNAL | MSG_DONTWAIT);
+		if(result == -1)
+		{
+			if(errno == EINTR) continue;
+			if(errno != EAGAIN && errno != EWOULDBLOCK) closeClient(client);
+			return;
+		}
+		client.offset += result;
+		client.bytesSent += result;
+		_bytesSent += result;
+		client.lastProgressTime = getTime();
+		if(client.offset == client.current->size())
+		{
+			//The multipart header isn't a frame.
+			if(client.current != getMultipartHeader()) client.framesSent++;
+			client.current = std::move(client.next);
+			client.next.reset();
+			client.offset = 0;
+		}
+	}
+}
+
+void RelayUpstream::closeClient(Client& client)
+{
+	if(client.closed) return;
+	client.closed = true;
+	close(client.descriptor);
+	client.descriptor = -1;
+	client.current.reset();
+	client.next.reset();
+}
+
+}
+}
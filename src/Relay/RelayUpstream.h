@@ -0,0 +1,161 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+#ifndef RELAYUPSTREAM_H_
+#define RELAYUPSTREAM_H_
+
+#include "../MjpegParser.h"
+#include "../RelayProtocol.h"
+#include "../TokenBucket.h"
+
+#include <atomic>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace IpCam
+{
+namespace Relay
+{
+
+/**
+ * Reads the MJPEG stream of one camera and sends it to all clients of this camera. One thread polls the upstream socket
+ * and all client sockets. Every frame is copied once into a buffer shared by all clients. Clients not able to keep up
+ * skip frames: Only the frame currently being sent and the newest one are kept.
+ *
+ * The upstream connection is opened when the first client is added and closed 5 seconds after the last client left.
+ */
+class RelayUpstream
+{
+public:
+	/**
+	 * Called from the upstream thread when a client was closed.
+	 */
+	typedef std::function<void(uint64_t connectionId, uint64_t clientId, uint64_t bytesSent, uint64_t framesSent)> ClientClosedCallback;
+
+	RelayUpstream(uint64_t peerId, ClientClosedCallback clientClosedCallback);
+	virtual ~RelayUpstream();
+
+	/**
+	 * Takes effect on the next (re)connect. The rate limit takes effect immediately.
+	 */
+	void setUpstream(const RelayProtocol::StreamRequest& request);
+
+	/**
+	 * Takes ownership of "descriptor".
+	 *
+	 * @param connectionId The control connection the client was received on.
+	 */
+	void addClient(uint64_t connectionId, uint64_t clientId, int descriptor, int64_t minFrameInterval);
+
+	/**
+	 * Closes a client. When "clientId" is 0, all clients of the control connection are closed.
+	 */
+	void removeClient(uint64_t connectionId, uint64_t clientId);
+
+	/**
+	 * Returns true when the thread has stopped and no clients are waiting. The object can be deleted then.
+	 */
+	bool idle();
+
+	RelayProtocol::PeerStats getStats();
+	void stop();
+protected:
+	typedef std::shared_ptr<const std::vector<char>> PBuffer;
+
+	struct Client
+	{
+		uint64_t connectionId = 0;
+		uint64_t id = 0;
+		int descriptor = -1;
+		int64_t minFrameInterval = 0;
+		int64_t addedTime = 0;
+		int64_t lastSentTime = 0;
+		int64_t lastProgressTime = 0;
+		PBuffer current;
+		size_t offset = 0;
+		PBuffer next;
+		uint64_t bytesSent = 0;
+		uint64_t framesSent = 0;
+		bool closed = false;
+	};
+
+	uint64_t _peerId = 0;
+	ClientClosedCallback _clientClosedCallback;
+	int _wakeDescriptor = -1;
+
+	std::mutex _mutex;
+	RelayProtocol::StreamRequest _request;
+	std::list<Client> _newClients;
+	std::vector<std::pair<uint64_t, uint64_t>> _removedClients;
+	bool _running = false;
+	std::atomic_bool _stop{false};
+	std::thread _thread;
+
+	//Only accessed by the upstream thread
+	std::list<Client> _clients;
+	int _upstream = -1;
+	MjpegParser _parser;
+	std::vector<char> _receiveBuffer = std::vector<char>(16384);
+	int64_t _lastDataTime = 0;
+	int64_t _lastFrameTime = 0;
+	int64_t _lastClientTime = 0;
+	int64_t _nextConnectTime = 0;
+	int64_t _connectTime = 0;
+	int32_t _retryDelay = 1000;
+	TokenBucket _upstreamBandwidth;
+
+	std::atomic<uint64_t> _clientCount{0};
+	std::atomic<uint64_t> _upstreamConnected{0};
+	std::atomic<uint64_t> _frames{0};
+	std::atomic<uint64_t> _droppedFrames{0};
+	std::atomic<uint64_t> _bytesReceived{0};
+	std::atomic<uint64_t> _bytesSent{0};
+
+	void wake();
+	void worker();
+	bool applyChanges();
+	bool connect();
+	void disconnect();
+	/**
+	 * Reads until the socket is drained or the rate limit is reached. Pausing reads lets TCP flow control slow down the
+	 * camera.
+	 */
+	void readUpstream();
+	void onFrame(const char* data, size_t size);
+	void flush(Client& client);
+	void closeClient(Client& client);
+};
+
+}
+}
+
+#endif
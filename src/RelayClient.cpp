@@ -0,0 +1,284 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+#include "RelayClient.h"
+#include "GD.h"
+
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+namespace IpCam
+{
+
+RelayClient::RelayClient(const std::string& socketPath) : _socketPath(socketPath)
+{
+}
+
+RelayClient::~RelayClient()
+{
+	stop();
+}
+
+void RelayClient::stop()
+{
+	try
+	{
+		_stop = true;
+		std::lock_guard<std::mutex> connectionGuard(_connectionMutex);
+		if(_socket != -1) shutdown(_socket, SHUT_RDWR);
+		GD::bl->threadManager.join(_readThread);
+		if(_socket != -1) close(_socket);
+		_socket = -1;
+		_connected = false;
+		closeClients();
+	}
+	catch(const std::exception& ex)
+	{
+		GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+	}
+}
+
+bool RelayClient::connect()
+{
+	try
+	{
+		if(_connected) return true;
+		int64_t time = BaseLib::HelperFunctions::getTime();
+		if(time - _lastConnectAttempt < 10000) return false;
+		_lastConnectAttempt = time;
+
+		//The read thread has exited when _connected is false.
+		GD::bl->threadManager.join(_readThread);
+		if(_socket != -1) close(_socket);
+		_socket = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+		if(_socket == -1) return false;
+		sockaddr_un address{};
+		address.sun_family = AF_UNIX;
+		std::strncpy(address.sun_path, _socketPath.c_str(), sizeof(address.sun_path) - 1);
+		if(::connect(_socket, (sockaddr*)&address, sizeof(address)) == -1)
+		{
+			if(GD::bl->debugLevel >= 5) GD::out.printDebug("Debug: Stream relay is not available at " + _socketPath + ": " + strerror(errno));
+			close(_socket);
+			_socket = -1;
+			return false;
+		}
+		//Don't let a hanging relay block viewers.
+		struct timeval timeout{ 1, 0 };
+		setsockopt(_socket, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+		GD::out.printInfo("Info: Connected to stream relay at " + _socketPath + ".");
+		_connected = true;
+		GD::bl->threadManager.start(_readThread, true, &RelayClient::readMessages, this);
+		return true;
+	}
+	catch(const std::exception& ex)
+	{
+		GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+	}
+	return false;
+}
+
+void RelayClient::readMessages()
+{
+	int32_t socketDescriptor = _socket;
+	RelayProtocol::MessageHeader header;
+	std::vector<char> payload;
+	while(!_stop)
+	{
+		pollfd pollDescriptor{ socketDescriptor, POLLIN, 0 };
+		int32_t result = poll(&pollDescriptor, 1, 1000);
+		if(result == 0 || (result == -1 && errno == EINTR)) continue;
+		int32_t descriptor = -1;
+		if(result == -1 || RelayProtocol::receiveMessage(socketDescriptor, header, payload, descriptor) != 1) break;
+		if(descriptor != -1) close(descriptor);
+
+		if(header.type == (uint32_t)RelayProtocol::MessageType::clientClosed)
+		{
+			std::lock_guard<std::mutex> clientsGuard(_clientsMutex);
+			auto clientIterator = _clients.find(header.clientId);
+			if(clientIterator == _clients.end()) continue;
+			clientIterator->second.closed = true;
+			if(payload.size() >= sizeof(uint64_t)) std::memcpy(&clientIterator->second.bytesSent, payload.data(), sizeof(uint64_t));
+			if(payload.size() >= 2 * sizeof(uint64_t)) std::memcpy(&clientIterator->second.framesSent, payload.data() + sizeof(uint64_t), sizeof(uint64_t));
+			_clientsConditionVariable.notify_all();
+		}
+		else if(header.type == (uint32_t)RelayProtocol::MessageType::stats)
+		{
+			std::lock_guard<std::mutex> statsGuard(_statsMutex);
+			_stats.resize(payload.size() / sizeof(RelayProtocol::PeerStats));
+			if(!_stats.empty()) std::memcpy(_stats.data(), payload.data(), _stats.size() * sizeof(RelayProtocol::PeerStats));
+		}
+	}
+	if(!_stop) GD::out.printWarning("Warning: Connection to stream relay was closed. Streams are relayed by Homegear until it is available again.");
+	_connected = false;
+	//The relay closes all clients of a closed connection.
+	closeClients();
+	std::lock_guard<std::mutex> statsGuard(_statsMutex);
+	_stats.clear();
+}
+
+void RelayClient::closeClients()
+{
+	std::lock_guard<std::mutex> clientsGuard(_clientsMutex);
+	for(auto& client : _clients) client.second.closed = true;
+	_clientsConditionVariable.notify_all();
+}
+
+bool RelayClient::addPeerClient(uint64_t peerId)
+{
+	{
+		std::lock_guard<std::mutex> peersGuard(_peersMutex);
+		PeerState& peer = _peers[peerId];
+		if(peer.clients > 0)
+		{
+			peer.clients++;
+			return true;
+		}
+	}
+
+	//Not locked while waiting, so clients of other peers are not delayed.
+	ConnectionLimiter::PPermit permit = GD::connectionLimiter->acquire(peerId, 5000);
+
+	std::lock_guard<std::mutex> peersGuard(_peersMutex);
+	PeerState& peer = _peers[peerId];
+	if(peer.clients > 0)
+	{
+		//Another client of the peer got a permit in the meantime. Ours is released on return.
+		peer.clients++;
+		return true;
+	}
+	if(!permit)
+	{
+		_peers.erase(peerId);
+		return false;
+	}
+	peer.permit = std::move(permit);
+	peer.clients = 1;
+	return true;
+}
+
+void RelayClient::removePeerClient(uint64_t peerId)
+{
+	std::lock_guard<std::mutex> peersGuard(_peersMutex);
+	auto peerIterator = _peers.find(peerId);
+	if(peerIterator == _peers.end()) return;
+	if(peerIterator->second.clients > 0) peerIterator->second.clients--;
+	if(peerIterator->second.clients == 0) _peers.erase(peerIterator);
+}
+
+bool RelayClient::relay(uint64_t peerId, const RelayProtocol::StreamRequest& request, int32_t descriptor, const std::function<bool()>& cancelled, bool* rejected)
+{
+	bool peerClientAdded = false;
+	try
+	{
+		if(_stop || descriptor == -1) return false;
+		if(!connected())
+		{
+			//Don't wait for a permit when the relay isn't running.
+			std::lock_guard<std::mutex> connectionGuard(_connectionMutex);
+			if(!connect()) return false;
+		}
+		if(!addPeerClient(peerId))
+		{
+			if(rejected) *rejected = true;
+			return false;
+		}
+		peerClientAdded = true;
+		uint64_t clientId = 0;
+		{
+			std::lock_guard<std::mutex> connectionGuard(_connectionMutex);
+			if(!connect())
+			{
+				removePeerClient(peerId);
+				return false;
+			}
+			{
+				std::lock_guard<std::mutex> clientsGuard(_clientsMutex);
+				clientId = ++_currentClientId;
+				_clients.emplace(clientId, ClientState());
+			}
+			std::vector<char> payload = request.serialize();
+			if(!RelayProtocol::sendMessage(_socket, RelayProtocol::MessageType::stream, clientId, peerId, payload.data(), payload.size(), descriptor))
+			{
+				GD::out.printWarning("Warning: Could not pass client to stream relay: " + std::string(strerror(errno)));
+				shutdown(_socket, SHUT_RDWR);
+				{
+					std::lock_guard<std::mutex> clientsGuard(_clientsMutex);
+					_clients.erase(clientId);
+				}
+				removePeerClient(peerId);
+				return false;
+			}
+		}
+		if(GD::bl->debugLevel >= 5) GD::out.printDebug("Debug: Passed client " + std::to_string(clientId) + " of peer " + std::to_string(peerId) + " to stream relay.");
+
+		//The web server shuts the connection down when onGet() returns, so wait until the relay is done with it.
+		std::unique_lock<std::mutex> clientsGuard(_clientsMutex);
+		while(!_clients[clientId].closed)
+		{
+			if(cancelled())
+			{
+				clientsGuard.unlock();
+				{
+					std::lock_guard<std::mutex> connectionGuard(_connectionMutex);
+					if(_connected) RelayProtocol::sendMessage(_socket, RelayProtocol::MessageType::closeClient, clientId, peerId, nullptr, 0);
+				}
+				clientsGuard.lock();
+				break;
+			}
+			_clientsConditionVariable.wait_for(clientsGuard, std::chrono::milliseconds(1000));
+		}
+		if(GD::bl->debugLevel >= 5) GD::out.printDebug("Debug: Stream relay closed client " + std::to_string(clientId) + " of peer " + std::to_string(peerId) + " after " + std::to_string(_clients[clientId].framesSent) + " frames and " + std::to_string(_clients[clientId].bytesSent) + " bytes.");
+		_clients.erase(clientId);
+		clientsGuard.unlock();
+		removePeerClient(peerId);
+		return true;
+	}
+	catch(const std::exception& ex)
+	{
+		GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+	}
+	if(peerClientAdded) removePeerClient(peerId);
+	return false;
+}
+
+std::vector<RelayProtocol::PeerStats> RelayClient::getStats()
+{
+	std::lock_guard<std::mutex> statsGuard(_statsMutex);
+	return _stats;
+}
+
+size_t RelayClient::clientCount()
+{
+	std::lock_guard<std::mutex> clientsGuard(_clientsMutex);
+	return _clients.size();
+}
+
+}
@@ -0,0 +1,140 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+#ifndef RELAYCLIENT_H_
+#define RELAYCLIENT_H_
+
+#include "ConnectionLimiter.h"
+#include "RelayProtocol.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <thread>
+
+namespace IpCam
+{
+
+/**
+ * Connection to the stream relay (homegear-ipcam-relay). Hands stream viewers over to the relay, so the stream data
+ * doesn't pass through Homegear. When the relay is not running, relay() returns false and the caller streams in-process.
+ * Reconnects are attempted at most every 10 seconds.
+ */
+class RelayClient
+{
+public:
+	RelayClient(const std::string& socketPath);
+	virtual ~RelayClient();
+
+	void stop();
+	bool connected() { return _connected; }
+
+	/**
+	 * Passes the client socket to the relay and waits until the relay closed it or "cancelled" returns true. The caller
+	 * must not use the socket anymore afterwards except for closing it. The relay opens one camera connection per peer
+	 * for all its clients, so one connection permit per peer is held from the first client until the last one is closed.
+	 *
+	 * @param rejected Set to true when no connection permit was granted for the camera.
+	 * @return Returns false when the relay is unavailable or the permit was rejected. Nothing was sent to the client in
+	 * this case.
+	 */
+	bool relay(uint64_t peerId, const RelayProtocol::StreamRequest& request, int32_t descriptor, const std::function<bool()>& cancelled, bool* rejected = nullptr);
+
+	/**
+	 * Returns the statistics last reported by the relay.
+	 */
+	std::vector<RelayProtocol::PeerStats> getStats();
+
+	/**
+	 * Number of clients currently handed over to the relay.
+	 */
+	size_t clientCount();
+protected:
+	struct ClientState
+	{
+		bool closed = false;
+		uint64_t bytesSent = 0;
+		uint64_t framesSent = 0;
+	};
+
+	std::string _socketPath;
+	std::atomic_bool _stop{false};
+
+	std::mutex _connectionMutex;
+	int32_t _socket = -1;
+	std::atomic_bool _connected{false};
+	int64_t _lastConnectAttempt = 0;
+	std::thread _readThread;
+
+	std::mutex _clientsMutex;
+	std::condition_variable _clientsConditionVariable;
+	std::map<uint64_t, ClientState> _clients;
+	uint64_t _currentClientId = 0;
+
+	struct PeerState
+	{
+		size_t clients = 0;
+		ConnectionLimiter::PPermit permit;
+	};
+
+	std::mutex _peersMutex;
+	std::map<uint64_t, PeerState> _peers;
+
+	std::mutex _statsMutex;
+	std::vector<RelayProtocol::PeerStats> _stats;
+
+	/**
+	 * _connectionMutex must be locked.
+	 */
+	bool connect();
+
+	/**
+	 * Runs in _readThread. Exits when the connection is closed.
+	 */
+	void readMessages();
+	void closeClients();
+
+	/**
+	 * Registers a client of the peer and acquires the connection permit of the peer for the first client.
+	 *
+	 * @return Returns false when no permit was granted.
+	 */
+	bool addPeerClient(uint64_t peerId);
+
+	/**
+	 * Releases the connection permit of the peer with its last client.
+	 */
+	void removePeerClient(uint64_t peerId);
+};
+
+}
+
+#endif
@@ -0,0 +1,264 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+#ifndef RELAYPROTOCOL_H_
+#define RELAYPROTOCOL_H_
+
+/*
+ * Messages exchanged between the module and the stream relay (homegear-ipcam-relay) over a Unix domain socket of type
+ * SOCK_SEQPACKET. Every message consists of a MessageHeader followed by the payload. Client sockets are passed as
+ * SCM_RIGHTS ancillary data of "stream" messages. Both sides run on the same host, so integers are sent in host byte order.
+ */
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <errno.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace IpCam
+{
+namespace RelayProtocol
+{
+
+static const uint32_t version = 3;
+static const size_t maxMessageSize = 65536;
+
+enum class MessageType : uint32_t
+{
+	/**
+	 * Module to relay: Relay the stream of "peerId" to the passed client socket. Payload: StreamRequest.
+	 */
+	stream = 1,
+
+	/**
+	 * Module to relay: Close client "clientId".
+	 */
+	closeClient = 2,
+
+	/**
+	 * Relay to module: Client "clientId" was closed. Payload: Number of bytes and number of frames sent as uint64_t.
+	 */
+	clientClosed = 3,
+
+	/**
+	 * Relay to module: Statistics of all relayed cameras. Payload: Array of PeerStats.
+	 */
+	stats = 4
+};
+
+struct MessageHeader
+{
+	uint32_t type = 0;
+	uint32_t version = RelayProtocol::version;
+	uint64_t clientId = 0;
+	uint64_t peerId = 0;
+};
+
+struct StreamRequest
+{
+	std::string host;
+	int32_t port = 80;
+	std::string path;
+	std::string authorization;
+
+	/**
+	 * Minimum time between two frames sent to the client in milliseconds. 0 sends all frames.
+	 */
+	int64_t minFrameInterval = 0;
+
+	/**
+	 * Maximum rate of the upstream connection in bytes per second. 0 disables the limit.
+	 */
+	uint64_t maxRate = 0;
+
+	std::vector<char> serialize() const
+	{
+		std::vector<char> buffer;
+		appendString(buffer, host);
+		appendInteger(buffer, (uint64_t)port);
+		appendString(buffer, path);
+		appendString(buffer, authorization);
+		appendInteger(buffer, (uint64_t)minFrameInterval);
+		appendInteger(buffer, maxRate);
+		return buffer;
+	}
+
+	bool deserialize(const std::vector<char>& buffer)
+	{
+		const char* position = buffer.data();
+		const char* end = buffer.data() + buffer.size();
+		uint64_t integer = 0;
+		if(!readString(position, end, host) || !readInteger(position, end, integer)) return false;
+		port = (int32_t)integer;
+		if(!readString(position, end, path) || !readString(position, end, authorization) || !readInteger(position, end, integer)) return false;
+		minFrameInterval = (int64_t)integer;
+		if(!readInteger(position, end, maxRate)) return false;
+		return true;
+	}
+private:
+	static void appendInteger(std::vector<char>& buffer, uint64_t value)
+	{
+		buffer.insert(buffer.end(), (const char*)&value, (const char*)&value + sizeof(value));
+	}
+
+	static void appendString(std::vector<char>& buffer, const std::string& value)
+	{
+		appendInteger(buffer, value.size());
+		buffer.insert(buffer.end(), value.begin(), value.end());
+	}
+
+	static bool readInteger(const char*& position, const char* end, uint64_t& value)
+	{
+		if((size_t)(end - position) < sizeof(value)) return false;
+		std::memcpy(&value, position, sizeof(value));
+		position += sizeof(value);
+		return true;
+	}
+
+	static bool readString(const char*& position, const char* end, std::string& value)
+	{
+		uint64_t size = 0;
+		if(!readInteger(position, end, size) || size > (uint64_t)(end - position)) return false;
+		value.assign(position, size);
+		position += size;
+		return true;
+	}
+};
+
+struct PeerStats
+{
+	uint64_t peerId = 0;
+	uint64_t clients = 0;
+	uint64_t upstreamConnected = 0;
+	uint64_t frames = 0;
+	uint64_t droppedFrames = 0;
+	uint64_t bytesReceived = 0;
+	uint64_t bytesSent = 0;
+};
+
+/**
+ * Sends one message. "descriptor" is passed to the receiver when it is not -1.
+ *
+ * @return Returns false on error. errno is set in this case.
+ */
+inline bool sendMessage(int socket, MessageType type, uint64_t clientId, uint64_t peerId, const char* payload, size_t payloadSize, int descriptor = -1)
+{
+	MessageHeader header;
+	header.type = (uint32_t)type;
+	header.clientId = clientId;
+	header.peerId = peerId;
+	struct iovec parts[2];
+	parts[0].iov_base = &header;
+	parts[0].iov_len = sizeof(header);
+	parts[1].iov_base = (void*)payload;
+	parts[1].iov_len = payloadSize;
+
+	struct msghdr message{};
+	message.msg_iov = parts;
+	message.msg_iovlen = payloadSize > 0 ? 2 : 1;
+	char control[CMSG_SPACE(sizeof(int))]{};
+	if(descriptor != -1)
+	{
+		message.msg_control = control;
+		message.msg_controllen = sizeof(control);
+		struct cmsghdr* controlHeader = CMSG_FIRSTHDR(&message);
+		controlHeader->cmsg_level = SOL_SOCKET;
+		controlHeader->cmsg_type = SCM_RIGHTS;
+		controlHeader->cmsg_len = CMSG_LEN(sizeof(int));
+		std::memcpy(CMSG_DATA(controlHeader), &descriptor, sizeof(int));
+	}
+
+	ssize_t result = 0;
+	do
+	{
+		result = sendmsg(socket, &message, MSG_NOSIGNAL);
+	} while(result == -1 && errno == EINTR);
+	return result == (ssize_t)(sizeof(header) + payloadSize);
+}
+
+/**
+ * Receives one message. A passed socket is returned in "descriptor" (-1 otherwise). The caller owns it.
+ *
+ * @return Returns 1 on success, 0 when the connection was closed and -1 on error.
+ */
+inline int receiveMessage(int socket, MessageHeader& header, std::vector<char>& payload, int& descriptor)
+{
+	descriptor = -1;
+	payload.resize(maxMessageSize);
+	struct iovec parts[2];
+	parts[0].iov_base = &header;
+	parts[0].iov_len = sizeof(header);
+	parts[1].iov_base = payload.data();
+	parts[1].iov_len = payload.size();
+
+	struct msghdr message{};
+	message.msg_iov = parts;
+	message.msg_iovlen = 2;
+	char control[CMSG_SPACE(sizeof(int))]{};
+	message.msg_control = control;
+	message.msg_controllen = sizeof(control);
+
+	ssize_t result = 0;
+	do
+	{
+		result = recvmsg(socket, &message, MSG_CMSG_CLOEXEC);
+	} while(result == -1 && errno == EINTR);
+	if(result <= 0)
+	{
+		payload.clear();
+		return result == 0 ? 0 : -1;
+	}
+
+	for(struct cmsghdr* controlHeader = CMSG_FIRSTHDR(&message); controlHeader; controlHeader = CMSG_NXTHDR(&message, controlHeader))
+	{
+		if(controlHeader->cmsg_level == SOL_SOCKET && controlHeader->cmsg_type == SCM_RIGHTS && controlHeader->cmsg_len >= CMSG_LEN(sizeof(int)))
+		{
+			std::memcpy(&descriptor, CMSG_DATA(controlHeader), sizeof(int));
+		}
+	}
+	if((size_t)result < sizeof(header) || header.version != version || (message.msg_flags & (MSG_TRUNC | MSG_CTRUNC)))
+	{
+		if(descriptor != -1) close(descriptor);
+		descriptor = -1;
+		payload.clear();
+		errno = EPROTO;
+		return -1;
+	}
+	payload.resize(result - sizeof(header));
+	return 1;
+}
+
+}
+}
+
+#endif
@@ -0,0 +1,194 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+#include "Segment.h"
+#include "GD.h"
+#include "StreamHub.h"
+
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+namespace IpCam
+{
+
+Segment::Segment(const std::string& path) : _path(path)
+{
+}
+
+Segment::~Segment()
+{
+	close();
+}
+
+bool Segment::createDirectory(const std::string& path)
+{
+	std::string::size_type position = 0;
+	while(position != std::string::npos)
+	{
+		position = path.find('/', position + 1);
+		std::string directory = path.substr(0, position);
+		if(directory.empty() || BaseLib::Io::directoryExists(directory)) continue;
+		if(mkdir(directory.c_str(), S_IRWXU | S_IRWXG) == -1 && errno != EEXIST)
+		{
+			GD::out.printError("Error: Could not create directory " + directory + ": " + strerror(errno));
+			return false;
+		}
+	}
+	return true;
+}
+
+std::string Segment::getTimeString(int64_t time)
+{
+	time_t seconds = time / 1000;
+	struct tm localTime;
+	localtime_r(&seconds, &localTime);
+	char buffer[32];
+	size_t size = strftime(buffer, sizeof(buffer), "%Y%m%d-%H%M%S", &localTime);
+	std::string milliseconds = std::to_string(time % 1000);
+	return std::string(buffer, size) + "-" + std::string(3 - milliseconds.size(), '0') + milliseconds;
+}
+
+bool Segment::open()
+{
+	std::string::size_type slash = _path.rfind('/');
+	if(slash != std::string::npos && !createDirectory(_path.substr(0, slash))) return false;
+	_dataDescriptor = ::open(dataPath().c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, S_IRUSR | S_IWUSR | S_IRGRP);
+	if(_dataDescriptor == -1)
+	{
+		GD::out.printError("Error: Could not open " + dataPath() + ": " + strerror(errno));
+		return false;
+	}
+	_indexDescriptor = ::open(indexPath().c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, S_IRUSR | S_IWUSR | S_IRGRP);
+	if(_indexDescriptor == -1)
+	{
+		GD::out.printError("Error: Could not open " + indexPath() + ": " + strerror(errno));
+		::close(_dataDescriptor);
+		_dataDescriptor = -1;
+		return false;
+	}
+	struct stat fileInfo;
+	if(fstat(_dataDescriptor, &fileInfo) == 0) _size = fileInfo.st_size;
+	return true;
+}
+
+int64_t Segment::append(const Frame& frame)
+{
+	try
+	{
+		if(_error || !frame) return -1;
+		if(_dataDescriptor == -1 && !open())
+		{
+			_error = true;
+			return -1;
+		}
+
+		std::string partHeader = StreamHub::getPartHeader(frame.size());
+		struct iovec parts[3];
+		parts[0].iov_base = (void*)partHeader.data();
+		parts[0].iov_len = partHeader.size();
+		parts[1].iov_base = (void*)frame.data();
+		parts[1].iov_len = frame.size();
+		parts[2].iov_base = (void*)"\r\n";
+		parts[2].iov_len = 2;
+
+		IndexEntry entry;
+		entry.time = frame.time();
+		entry.offset = _size;
+		entry.size = partHeader.size() + frame.size() + 2;
+		entry.headerSize = partHeader.size();
+
+		ssize_t bytesWritten = writev(_dataDescriptor, parts, 3);
+		if(bytesWritten != (ssize_t)entry.size)
+		{
+			GD::out.printError("Error: Could not write to " + dataPath() + ": " + (bytesWritten == -1 ? std::string(strerror(errno)) : std::string("Disk is full.")));
+			_error = true;
+			return -1;
+		}
+		if(write(_indexDescriptor, &entry, sizeof(IndexEntry)) != sizeof(IndexEntry))
+		{
+			GD::out.printError("Error: Could not write to " + indexPath() + ": " + strerror(errno));
+			_error = true;
+			return -1;
+		}
+
+		if(_frameCount == 0) _startTime = entry.time;
+		_endTime = entry.time;
+		_frameCount++;
+		_size += entry.size;
+		return entry.size + sizeof(IndexEntry);
+	}
+	catch(const std::exception& ex)
+	{
+		GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+	}
+	return -1;
+}
+
+void Segment::close()
+{
+	if(_dataDescriptor != -1)
+	{
+		::close(_dataDescriptor);
+		_dataDescriptor = -1;
+	}
+	if(_indexDescriptor != -1)
+	{
+		::close(_indexDescriptor);
+		_indexDescriptor = -1;
+	}
+}
+
+bool Segment::readIndex(const std::string& path, std::vector<IndexEntry>& entries)
+{
+	int descriptor = ::open((path + ".idx").c_str(), O_RDONLY | O_CLOEXEC);
+	if(descriptor == -1) return false;
+	struct stat fileInfo;
+	if(fstat(descriptor, &fileInfo) == -1)
+	{
+		::close(descriptor);
+		return false;
+	}
+	entries.resize(fileInfo.st_size / sizeof(IndexEntry));
+	size_t bytesToRead = entries.size() * sizeof(IndexEntry);
+	ssize_t bytesRead = bytesToRead > 0 ? read(descriptor, entries.data(), bytesToRead) : 0;
+	::close(descriptor);
+	if(bytesRead != (ssize_t)bytesToRead)
+	{
+		entries.clear();
+		return false;
+	}
+	return true;
+}
+
+}
@@ -0,0 +1,96 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+#ifndef SEGMENT_H_
+#define SEGMENT_H_
+
+#include "FramePool.h"
+
+#include <string>
+#include <vector>
+
+namespace IpCam
+{
+
+/**
+ * An append-only recording consisting of two files: "NAME.mjpeg" contains the frames as a multipart body (so it can be
+ * served as is) and "NAME.idx" contains one fixed-size IndexEntry per frame.
+ */
+class Segment
+{
+public:
+	struct IndexEntry
+	{
+		int64_t time;
+		uint64_t offset;
+		uint32_t size;
+		uint32_t headerSize;
+	};
+
+	/**
+	 * @param path The path of the segment without file extension.
+	 */
+	Segment(const std::string& path);
+	virtual ~Segment();
+
+	const std::string& path() { return _path; }
+	std::string dataPath() { return _path + ".mjpeg"; }
+	std::string indexPath() { return _path + ".idx"; }
+	int64_t startTime() { return _startTime; }
+	int64_t endTime() { return _endTime; }
+	uint32_t frameCount() { return _frameCount; }
+	uint64_t size() { return _size; }
+
+	/**
+	 * Appends a frame. The files are created on first call. Must only be called from one thread at a time.
+	 *
+	 * @return Returns the number of bytes written or -1 on error.
+	 */
+	int64_t append(const Frame& frame);
+	void close();
+
+	static bool createDirectory(const std::string& path);
+	static std::string getTimeString(int64_t time);
+	static bool readIndex(const std::string& path, std::vector<IndexEntry>& entries);
+protected:
+	std::string _path;
+	int _dataDescriptor = -1;
+	int _indexDescriptor = -1;
+	bool _error = false;
+	int64_t _startTime = 0;
+	int64_t _endTime = 0;
+	uint32_t _frameCount = 0;
+	uint64_t _size = 0;
+
+	bool open();
+};
+
+}
+
+#endif
@@ -0,0 +1,175 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+#include "SegmentPlayer.h"
+#include "GD.h"
+#include "HttpHelper.h"
+#include "Segment.h"
+#include "StreamHub.h"
+
+#include <algorithm>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace IpCam
+{
+
+bool SegmentPlayer::getRange(const std::string& range, uint64_t size, uint64_t& start, uint64_t& end)
+{
+	if(range.compare(0, 6, "bytes=") != 0 || range.find(',') != std::string::npos || size == 0) return false;
+	std::pair<std::string, std::string> parts = BaseLib::HelperFunctions::splitFirst(range.substr(6), '-');
+	BaseLib::HelperFunctions::trim(parts.first);
+	BaseLib::HelperFunctions::trim(parts.second);
+	if(parts.first.empty())
+	{
+		if(parts.second.empty()) return false;
+		uint64_t suffixLength = std::strtoull(parts.second.c_str(), nullptr, 10);
+		if(suffixLength == 0) return false;
+		start = suffixLength >= size ? 0 : size - suffixLength;
+		end = size;
+		return true;
+	}
+	start = std::strtoull(parts.first.c_str(), nullptr, 10);
+	end = parts.second.empty() ? size : std::strtoull(parts.second.c_str(), nullptr, 10) + 1;
+	if(end > size) end = size;
+	return start < end;
+}
+
+bool SegmentPlayer::serve(BaseLib::Rpc::PServerInfo& serverInfo, BaseLib::Http& httpRequest, std::shared_ptr<BaseLib::TcpSocket>& socket, const std::string& path, const std::function<bool()>& cancelled)
+{
+	int fileDescriptor = open((path + ".mjpeg").c_str(), O_RDONLY | O_CLOEXEC);
+	if(fileDescriptor == -1) return false;
+	try
+	{
+		struct stat fileInfo;
+		if(fstat(fileDescriptor, &fileInfo) == -1)
+		{
+			close(fileDescriptor);
+			return false;
+		}
+		uint64_t size = fileInfo.st_size;
+		std::vector<Segment::IndexEntry> index;
+		Segment::readIndex(path, index);
+
+		std::map<std::string, std::string> arguments = HttpHelper::getArguments(httpRequest.getHeader().args);
+		size_t startIndex = 0;
+		uint64_t start = 0;
+		uint64_t end = size;
+		std::map<std::string, std::string>::iterator timeArgument = arguments.find("t");
+		if(timeArgument != arguments.end() && !index.empty())
+		{
+			int64_t time = index.front().time + (int64_t)(BaseLib::Math::getDouble(timeArgument->second) * 1000);
+			startIndex = std::lower_bound(index.begin(), index.end(), time, [](const Segment::IndexEntry& entry, int64_t time) { return entry.time < time; }) - index.begin();
+			start = startIndex < index.size() ? index.at(startIndex).offset : size;
+		}
+
+		if(arguments["play"] == "1" || arguments["play"] == "true")
+		{
+			double speed = arguments["speed"].empty() ? 1.0 : BaseLib::Math::getDouble(arguments["speed"]);
+			if(speed < 0.1) speed = 0.1;
+			else if(speed > 100) speed = 100;
+			socket->proofwrite(StreamHub::getMultipartHeader());
+			int64_t playbackStartTime = BaseLib::HelperFunctions::getTime();
+			for(size_t i = startIndex; i < index.size(); i++)
+			{
+				int64_t dueTime = playbackStartTime + (int64_t)((index[i].time - index[startIndex].time) / speed);
+				int64_t waitTime = dueTime - BaseLib::HelperFunctions::getTime();
+				while(waitTime > 0 && !cancelled())
+				{
+					std::this_thread::sleep_for(std::chrono::milliseconds(waitTime > 500 ? 500 : waitTime));
+					waitTime = dueTime - BaseLib::HelperFunctions::getTime();
+				}
+				if(cancelled()) break;
+				HttpHelper::sendFile(socket, serverInfo->ssl, fileDescriptor, index[i].offset, index[i].size);
+			}
+		}
+		else
+		{
+			std::string header;
+			std::map<std::string, std::string>::iterator rangeField = httpRequest.getHeader().fields.find("range");
+			if(timeArgument == arguments.end() && rangeField != httpRequest.getHeader().fields.end())
+			{
+				if(!getRange(rangeField->second, size, start, end))
+				{
+					socket->proofwrite(HttpHelper::getResponse(416, "Range Not Satisfiable", "Content-Range: bytes */" + std::to_string(size) + "\r\n"));
+					socket->close();
+					close(fileDescriptor);
+					return true;
+				}
+				header = "HTTP/1.1 206 Partial Content\r\nContent-Range: bytes " + std::to_string(start) + "-" + std::to_string(end - 1) + "/" + std::to_string(size) + "\r\n";
+			}
+			else header = "HTTP/1.1 200 OK\r\n";
+			header += "Content-Type: multipart/x-mixed-replace; boundary=ipcamframe\r\nAccept-Ranges: bytes\r\nContent-Length: " + std::to_string(end - start) + "\r\nConnection: close\r\n\r\n";
+			socket->proofwrite(header);
+			if(httpRequest.getHeader().method != "HEAD") HttpHelper::sendFile(socket, serverInfo->ssl, fileDescriptor, start, end - start);
+		}
+		socket->close();
+	}
+	catch(const BaseLib::SocketOperationException& ex)
+	{
+		GD::out.printInfo("Info: Playback of " + path + " stopped: " + ex.what());
+	}
+	catch(const std::exception& ex)
+	{
+		GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+	}
+	close(fileDescriptor);
+	return true;
+}
+
+std::string SegmentPlayer::list(const std::string& directory)
+{
+	std::string json("[");
+	try
+	{
+		if(!BaseLib::Io::directoryExists(directory)) return "[]";
+		std::vector<std::string> files = BaseLib::Io::getFiles(directory);
+		std::sort(files.begin(), files.end());
+		for(std::vector<std::string>::iterator i = files.begin(); i != files.end(); ++i)
+		{
+			if(i->size() <= 6 || i->compare(i->size() - 6, 6, ".mjpeg") != 0) continue;
+			std::string name = i->substr(0, i->size() - 6);
+			std::vector<Segment::IndexEntry> index;
+			if(!Segment::readIndex(directory + name, index) || index.empty()) continue;
+			struct stat fileInfo;
+			if(stat((directory + *i).c_str(), &fileInfo) == -1) continue;
+			if(json.size() > 1) json.push_back(',');
+			json += "{\"name\":\"" + name + "\",\"start\":" + std::to_string(index.front().time) + ",\"duration\":" + std::to_string(index.back().time - index.front().time) + ",\"frames\":" + std::to_string(index.size()) + ",\"size\":" + std::to_string(fileInfo.st_size) + "}";
+		}
+	}
+	catch(const std::exception& ex)
+	{
+		GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+	}
+	json.push_back(']');
+	return json;
+}
+
+}
@@ -0,0 +1,72 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+#ifndef SEGMENTPLAYER_H_
+#define SEGMENTPLAYER_H_
+
+#include <homegear-base/BaseLib.h>
+
+#include <functional>
+
+namespace IpCam
+{
+
+/**
+ * Serves recorded segments over HTTP.
+ *
+ * Supported query arguments:
+ *   t=SECONDS  Start at this offset relative to the first frame.
+ *   play=1     Replay the frames as MJPEG stream paced at the original timing.
+ *   speed=X    Playback speed factor for "play" (default 1).
+ *
+ * Without "play" the file is sent as is and single byte ranges ("Range" header) are supported.
+ */
+class SegmentPlayer
+{
+public:
+	/**
+	 * @param path The path of the segment without file extension.
+	 * @param cancelled Is called regularly during playback. Playback stops when it returns true.
+	 * @return Returns false when the segment does not exist.
+	 */
+	static bool serve(BaseLib::Rpc::PServerInfo& serverInfo, BaseLib::Http& httpRequest, std::shared_ptr<BaseLib::TcpSocket>& socket, const std::string& path, const std::function<bool()>& cancelled);
+
+	/**
+	 * Returns a JSON array with information about all segments in a directory.
+	 */
+	static std::string list(const std::string& directory);
+private:
+	SegmentPlayer() = delete;
+
+	static bool getRange(const std::string& range, uint64_t size, uint64_t& start, uint64_t& end);
+};
+
+}
+
+#endif
@@ -0,0 +1,364 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+#ifndef SHAREDFRAMERING_H_
+#define SHAREDFRAMERING_H_
+
+/*
+ * Layout of the shared memory frame rings and a reader for local processes. This header has no dependencies besides the
+ * C++11 standard library and POSIX, so it can be copied into other projects. Link with "-lrt" on older glibc versions.
+ *
+ * Each camera with SHARED_MEMORY_SLOTS > 0 publishes its frames into the POSIX shared memory object
+ * "/homegear-ipcam-<peer ID>". The object starts with a Header followed by "slotCount" slots. Each slot consists of a
+ * SlotHeader and "slotSize" bytes of JPEG data. Frame n is stored in slot n % slotCount. Slots are protected by a sequence
+ * lock, so readers never block the writer and don't need to copy frames: They read the frame in place and check
+ * afterwards if it was overwritten in the meantime.
+ *
+ * The stream of a camera is only requested while readers are active. Readers signal this by updating "readerTime" (done
+ * by Reader::next()).
+ */
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace IpCam
+{
+namespace SharedFrameRing
+{
+
+static const uint32_t version = 1;
+
+struct Header
+{
+	char magic[8];
+	uint32_t version;
+	uint32_t slotCount;
+	uint32_t slotSize;
+
+	/**
+	 * Set to 1 when the writer closes the ring. Readers should reopen it.
+	 */
+	std::atomic<uint32_t> closed;
+
+	/**
+	 * Sequence number of the newest complete frame. Starts at 1, 0 means no frame was written yet.
+	 */
+	alignas(64) std::atomic<uint64_t> sequence;
+
+	/**
+	 * Time of the last read in milliseconds since the epoch. In its own cache line, so readers don't slow down the writer.
+	 */
+	alignas(64) std::atomic<int64_t> readerTime;
+	char padding[56];
+};
+
+struct SlotHeader
+{
+	/**
+	 * 2 * sequence + 1 while the slot is written, 2 * sequence when it contains frame "sequence".
+	 */
+	std::atomic<uint64_t> state;
+
+	/**
+	 * Reception time of the frame in milliseconds since the epoch.
+	 */
+	int64_t time;
+	uint32_t size;
+	char padding[44];
+};
+
+static_assert(sizeof(Header) % 64 == 0 && sizeof(SlotHeader) == 64, "Unexpected shared memory layout.");
+
+inline std::string getName(uint64_t peerId) { return "/homegear-ipcam-" + std::to_string(peerId); }
+inline size_t getSlotStride(uint32_t slotSize) { return sizeof(SlotHeader) + (((size_t)slotSize + 63) / 64) * 64; }
+inline size_t getMemorySize(uint32_t slotCount, uint32_t slotSize) { return sizeof(Header) + slotCount * getSlotStride(slotSize); }
+inline int64_t getTime() { return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count(); }
+
+/**
+ * Creates a ring and writes frames into it. There must only be one writer per ring.
+ */
+class Writer
+{
+public:
+	Writer() {}
+	virtual ~Writer() { close(); }
+
+	/**
+	 * Creates the shared memory object. An existing object with the same name is replaced.
+	 *
+	 * @return Returns false on error. See "error".
+	 */
+	bool open(const std::string& name, uint32_t slotCount, uint32_t slotSize, std::string& error)
+	{
+		close();
+		if(slotCount == 0 || slotSize == 0)
+		{
+			error = "Invalid ring size.";
+			return false;
+		}
+		//Readers still mapping an old ring keep it until they reopen.
+		shm_unlink(name.c_str());
+		int descriptor = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP);
+		if(descriptor == -1)
+		{
+			error = std::string("Could not create shared memory object: ") + strerror(errno);
+			return false;
+		}
+		size_t size = getMemorySize(slotCount, slotSize);
+		void* memory = MAP_FAILED;
+		if(ftruncate(descriptor, size) == 0) memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, descriptor, 0);
+		::close(descriptor);
+		if(memory == MAP_FAILED)
+		{
+			error = std::string("Could not map shared memory object: ") + strerror(errno);
+			shm_unlink(name.c_str());
+			return false;
+		}
+
+		//The memory is zeroed by ftruncate(), so all slots are empty.
+		_name = name;
+		_memory = memory;
+		_size = size;
+		_header = new(memory) Header();
+		std::memcpy(_header->magic, "HGIPCAM", 8);
+		_header->version = version;
+		_header->slotCount = slotCount;
+		_header->slotSize = slotSize;
+		_header->closed.store(0);
+		_header->sequence.store(0);
+		_header->readerTime.store(0);
+		_slots = (char*)memory + sizeof(Header);
+		_stride = getSlotStride(slotSize);
+		return true;
+	}
+
+	void close()
+	{
+		if(!_memory) return;
+		_header->closed.store(1, std::memory_order_release);
+		munmap(_memory, _size);
+		shm_unlink(_name.c_str());
+		_memory = nullptr;
+		_header = nullptr;
+	}
+
+	bool isOpen() { return _memory != nullptr; }
+	uint32_t slotSize() { return _header ? _header->slotSize : 0; }
+	int64_t readerTime() { return _header ? _header->readerTime.load(std::memory_order_relaxed) : 0; }
+
+	/**
+	 * @return Returns false when the frame is larger than the slot size.
+	 */
+	bool write(const char* data, uint32_t size, int64_t time)
+	{
+		if(!_header || size > _header->slotSize) return false;
+		uint64_t sequence = _header->sequence.load(std::memory_order_relaxed) + 1;
+		char* slot = _slots + (sequence % _header->slotCount) * _stride;
+		SlotHeader* slotHeader = (SlotHeader*)slot;
+		slotHeader->state.store(sequence * 2 + 1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+		std::memcpy(slot + sizeof(SlotHeader), data, size);
+		slotHeader->time = time;
+		slotHeader->size = size;
+		slotHeader->state.store(sequence * 2, std::memory_order_release);
+		_header->sequence.store(sequence, std::memory_order_release);
+		return true;
+	}
+private:
+	Writer(const Writer&) = delete;
+	Writer& operator=(const Writer&) = delete;
+
+	std::string _name;
+	void* _memory = nullptr;
+	size_t _size = 0;
+	Header* _header = nullptr;
+	char* _slots = nullptr;
+	size_t _stride = 0;
+};
+
+/**
+ * Reads frames from a ring without locks and without copying. Not thread safe, use one instance per thread.
+ *
+ * Usage:
+ *   reader.open(SharedFrameRing::getName(peerId), error);
+ *   Reader::Frame frame;
+ *   while(...)
+ *   {
+ *     if(!reader.next(frame)) { if(reader.closed()) reopen; else sleep a few milliseconds; continue; }
+ *     process(frame.data, frame.size);
+ *     if(!reader.valid(frame)) discard the result, the frame was overwritten while it was processed;
+ *   }
+ */
+class Reader
+{
+public:
+	struct Frame
+	{
+		const char* data = nullptr;
+		uint32_t size = 0;
+		int64_t time = 0;
+		uint64_t sequence = 0;
+	};
+
+	Reader() {}
+	virtual ~Reader() { close(); }
+
+	bool open(const std::string& name, std::string& error)
+	{
+		close();
+		int descriptor = shm_open(name.c_str(), O_RDWR | O_CLOEXEC, 0);
+		if(descriptor == -1)
+		{
+			error = std::string("Could not open shared memory object: ") + strerror(errno);
+			return false;
+		}
+		struct stat fileInfo;
+		void* memory = MAP_FAILED;
+		size_t size = 0;
+		if(fstat(descriptor, &fileInfo) == 0 && (size_t)fileInfo.st_size >= sizeof(Header))
+		{
+			size = fileInfo.st_size;
+			memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, descriptor, 0);
+		}
+		::close(descriptor);
+		if(memory == MAP_FAILED)
+		{
+			error = "Could not map shared memory object.";
+			return false;
+		}
+		Header* header = (Header*)memory;
+		if(std::memcmp(header->magic, "HGIPCAM", 8) != 0 || header->version != version || header->slotCount == 0 || getMemorySize(header->slotCount, header->slotSize) > size)
+		{
+			munmap(memory, size);
+			error = "Shared memory object has an unsupported format.";
+			return false;
+		}
+		_memory = memory;
+		_size = size;
+		_header = header;
+		_slots = (const char*)memory + sizeof(Header);
+		_stride = getSlotStride(header->slotSize);
+		//Start with the newest frame.
+		_lastSequence = _header->sequence.load(std::memory_order_acquire);
+		if(_lastSequence > 0) _lastSequence--;
+		_missedFrames = 0;
+		_header->readerTime.store(getTime(), std::memory_order_relaxed);
+		return true;
+	}
+
+	void close()
+	{
+		if(!_memory) return;
+		munmap(_memory, _size);
+		_memory = nullptr;
+		_header = nullptr;
+	}
+
+	bool isOpen() { return _memory != nullptr; }
+
+	/**
+	 * Returns true when the writer closed the ring (e. g. on restart of Homegear). Reopen it in this case.
+	 */
+	bool closed() { return !_header || _header->closed.load(std::memory_order_acquire) != 0; }
+
+	/**
+	 * Number of frames skipped because the reader was slower than the camera.
+	 */
+	uint64_t missedFrames() { return _missedFrames; }
+
+	/**
+	 * Gets the newest frame if there is a frame newer than the last one returned. Older frames are skipped.
+	 *
+	 * @return Returns false when there is no new frame.
+	 */
+	bool next(Frame& frame)
+	{
+		if(!_header) return false;
+		int64_t time = getTime();
+		if(time - _lastTouch >= 1000)
+		{
+			_lastTouch = time;
+			_header->readerTime.store(time, std::memory_order_relaxed);
+		}
+		for(int32_t i = 0; i < 3; i++)
+		{
+			uint64_t sequence = _header->sequence.load(std::memory_order_acquire);
+			if(sequence == _lastSequence) return false;
+			const char* slot = _slots + (sequence % _header->slotCount) * _stride;
+			const SlotHeader* slotHeader = (const SlotHeader*)slot;
+			uint64_t state = slotHeader->state.load(std::memory_order_acquire);
+			if(state != sequence * 2) continue; //Overwritten already
+			frame.data = slot + sizeof(SlotHeader);
+			frame.size = slotHeader->size;
+			frame.time = slotHeader->time;
+			frame.sequence = sequence;
+			if(frame.size > _header->slotSize || !valid(frame)) continue;
+			if(_lastSequence != 0 && sequence > _lastSequence + 1) _missedFrames += sequence - _lastSequence - 1;
+			_lastSequence = sequence;
+			return true;
+		}
+		return false;
+	}
+
+	/**
+	 * Returns true when the frame has not been overwritten since next() returned it.
+	 */
+	bool valid(const Frame& frame)
+	{
+		if(!_header || frame.sequence == 0) return false;
+		const SlotHeader* slotHeader = (const SlotHeader*)(_slots + (frame.sequence % _header->slotCount) * _stride);
+		std::atomic_thread_fence(std::memory_order_acquire);
+		return slotHeader->state.load(std::memory_order_relaxed) == frame.sequence * 2;
+	}
+private:
+	Reader(const Reader&) = delete;
+	Reader& operator=(const Reader&) = delete;
+
+	void* _memory = nullptr;
+	size_t _size = 0;
+	Header* _header = nullptr;
+	const char* _slots = nullptr;
+	size_t _stride = 0;
+	uint64_t _lastSequence = 0;
+	uint64_t _missedFrames = 0;
+	int64_t _lastTouch = 0;
+};
+
+}
+}
+
+#endif
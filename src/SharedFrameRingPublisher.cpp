@@ -0,0 +1,80 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+#include "SharedFrameRingPublisher.h"
+#include "GD.h"
+
+namespace IpCam
+{
+
+SharedFrameRingPublisher::SharedFrameRingPublisher(uint64_t peerId, uint32_t slotCount, uint32_t slotSize) : _peerId(peerId), _slotCount(slotCount), _slotSize(slotSize)
+{
+	std::string error;
+	std::string name = SharedFrameRing::getName(peerId);
+	if(_writer.open(name, slotCount, slotSize, error)) GD::out.printInfo("Info: Publishing frames of peer " + std::to_string(peerId) + " to shared memory object " + name + ".");
+	else GD::out.printError("Error: Could not create shared memory ring for peer " + std::to_string(peerId) + ": " + error);
+}
+
+SharedFrameRingPublisher::~SharedFrameRingPublisher()
+{
+	std::lock_guard<std::mutex> writerGuard(_writerMutex);
+	_writer.close();
+}
+
+bool SharedFrameRingPublisher::isOpen()
+{
+	std::lock_guard<std::mutex> writerGuard(_writerMutex);
+	return _writer.isOpen();
+}
+
+bool SharedFrameRingPublisher::readerActive()
+{
+	std::lock_guard<std::mutex> writerGuard(_writerMutex);
+	return _writer.isOpen() && BaseLib::HelperFunctions::getTime() - _writer.readerTime() < _readerTimeout;
+}
+
+void SharedFrameRingPublisher::onFrame(const Frame& frame)
+{
+	try
+	{
+		std::lock_guard<std::mutex> writerGuard(_writerMutex);
+		if(frame.sequence() <= _lastSequence) return;
+		_lastSequence = frame.sequence();
+		if(!_writer.write(frame.data(), frame.size(), frame.time()))
+		{
+			if(_skippedFrames++ == 0) GD::out.printWarning("Warning: Frame of peer " + std::to_string(_peerId) + " with " + std::to_string(frame.size()) + " bytes does not fit into the shared memory ring. Increase SHARED_MEMORY_SLOT_SIZE.");
+		}
+	}
+	catch(const std::exception& ex)
+	{
+		GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+	}
+}
+
+}
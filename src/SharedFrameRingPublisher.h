@@ -0,0 +1,77 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+#ifndef SHAREDFRAMERINGPUBLISHER_H_
+#define SHAREDFRAMERINGPUBLISHER_H_
+
+#include "SharedFrameRing.h"
+#include "StreamHub.h"
+
+namespace IpCam
+{
+
+/**
+ * Publishes the frames of a stream hub into a shared memory ring for local processes (see SharedFrameRing.h). The ring
+ * is created on construction. The peer only adds the publisher to the hub while readerActive() is true.
+ */
+class SharedFrameRingPublisher : public StreamHub::IConsumer
+{
+public:
+	/**
+	 * @param slotSize The maximum frame size in bytes. Larger frames are skipped.
+	 */
+	SharedFrameRingPublisher(uint64_t peerId, uint32_t slotCount, uint32_t slotSize);
+	virtual ~SharedFrameRingPublisher();
+
+	virtual void onFrame(const Frame& frame);
+
+	bool isOpen();
+	uint32_t slotCount() { return _slotCount; }
+	uint32_t slotSize() { return _slotSize; }
+	uint64_t skippedFrames() { return _skippedFrames; }
+
+	/**
+	 * Returns true when a reader read from the ring within the last 10 seconds.
+	 */
+	bool readerActive();
+protected:
+	static const int64_t _readerTimeout = 10000;
+
+	std::mutex _writerMutex;
+	SharedFrameRing::Writer _writer;
+	uint64_t _peerId = 0;
+	uint32_t _slotCount = 0;
+	uint32_t _slotSize = 0;
+	uint64_t _lastSequence = 0;
+	std::atomic<uint64_t> _skippedFrames{0};
+};
+
+}
+
+#endif
@@ -0,0 +1,118 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+#include "SnapshotBundle.h"
+#include "GD.h"
+#include "IpCamPeer.h"
+
+#include <set>
+
+namespace IpCam
+{
+
+namespace
+{
+	const std::string boundary("ipcamsnapshot");
+}
+
+void SnapshotBundle::fetch(std::shared_ptr<State> state, std::shared_ptr<IpCamPeer> peer)
+{
+	SnapshotCache::PSnapshot snapshot;
+	try
+	{
+		//Returns immediately when the cached snapshot is fresh.
+		snapshot = peer->getSnapshot();
+	}
+	catch(const std::exception& ex)
+	{
+		GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+	}
+	std::lock_guard<std::mutex> stateGuard(state->mutex);
+	state->finished.emplace_back(peer->getID(), snapshot);
+	state->conditionVariable.notify_one();
+}
+
+std::string SnapshotBundle::getPartHeader(uint64_t peerId, const SnapshotCache::PSnapshot& snapshot, int32_t status)
+{
+	std::string header = "--" + boundary + "\r\nX-Peer-Id: " + std::to_string(peerId) + "\r\n";
+	if(snapshot) header += "Content-Type: " + snapshot->contentType + "\r\nContent-Length: " + std::to_string(snapshot->content.size()) + "\r\nContent-Location: /ipcam/" + std::to_string(peerId) + "/snapshot.jpg\r\nETag: " + snapshot->etag + "\r\n\r\n";
+	else header += "X-Status: " + std::to_string(status) + "\r\nContent-Length: 0\r\n\r\n";
+	return header;
+}
+
+void SnapshotBundle::send(std::shared_ptr<BaseLib::TcpSocket>& socket, const std::vector<std::shared_ptr<IpCamPeer>>& peers, uint32_t timeout)
+{
+	std::shared_ptr<State> state = std::make_shared<State>();
+	std::vector<std::thread> threads(peers.size());
+	std::set<uint64_t> pending;
+	int64_t deadline = BaseLib::HelperFunctions::getTime() + timeout;
+	for(size_t i = 0; i < peers.size(); i++)
+	{
+		pending.insert(peers[i]->getID());
+		GD::bl->threadManager.start(threads[i], false, &SnapshotBundle::fetch, state, peers[i]);
+	}
+
+	try
+	{
+		socket->proofwrite("HTTP/1.1 200 OK\r\nContent-Type: multipart/mixed; boundary=" + boundary + "\r\nCache-Control: no-cache\r\nConnection: close\r\n\r\n");
+		while(!pending.empty())
+		{
+			std::pair<uint64_t, SnapshotCache::PSnapshot> result;
+			{
+				std::unique_lock<std::mutex> stateGuard(state->mutex);
+				int64_t remaining = deadline - BaseLib::HelperFunctions::getTime();
+				if(remaining <= 0 || !state->conditionVariable.wait_for(stateGuard, std::chrono::milliseconds(remaining), [&] { return !state->finished.empty(); })) break;
+				result = std::move(state->finished.front());
+				state->finished.pop_front();
+			}
+			pending.erase(result.first);
+			socket->proofwrite(getPartHeader(result.first, result.second, 502));
+			if(result.second) socket->proofwrite(result.second->content);
+			socket->proofwrite("\r\n", 2);
+		}
+		for(std::set<uint64_t>::iterator i = pending.begin(); i != pending.end(); ++i)
+		{
+			socket->proofwrite(getPartHeader(*i, SnapshotCache::PSnapshot(), 504) + "\r\n");
+		}
+		socket->proofwrite("--" + boundary + "--\r\n");
+		socket->close();
+	}
+	catch(const BaseLib::SocketOperationException& ex)
+	{
+		GD::out.printInfo("Info: " + std::string(ex.what()));
+	}
+
+	//The response is complete. Late snapshots still end up in the snapshot caches.
+	for(std::vector<std::thread>::iterator i = threads.begin(); i != threads.end(); ++i)
+	{
+		GD::bl->threadManager.join(*i);
+	}
+}
+
+}
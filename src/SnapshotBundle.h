@@ -0,0 +1,76 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+#ifndef SNAPSHOTBUNDLE_H_
+#define SNAPSHOTBUNDLE_H_
+
+#include <homegear-base/BaseLib.h>
+#include "SnapshotCache.h"
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+
+namespace IpCam
+{
+
+class IpCamPeer;
+
+/**
+ * Fetches the snapshots of several cameras in parallel and sends them as one "multipart/mixed" response in the order they
+ * arrive. Every part has the header "X-Peer-Id". Cameras that failed or didn't respond in time get an empty part with
+ * "X-Status: 502" or "X-Status: 504".
+ */
+class SnapshotBundle
+{
+public:
+	static const size_t maxPeers = 64;
+
+	/**
+	 * @param timeout Global deadline in milliseconds. The response is finished when it is reached, even if not all cameras
+	 * have responded.
+	 */
+	static void send(std::shared_ptr<BaseLib::TcpSocket>& socket, const std::vector<std::shared_ptr<IpCamPeer>>& peers, uint32_t timeout);
+private:
+	struct State
+	{
+		std::mutex mutex;
+		std::condition_variable conditionVariable;
+		std::deque<std::pair<uint64_t, SnapshotCache::PSnapshot>> finished;
+	};
+
+	SnapshotBundle() = delete;
+
+	static void fetch(std::shared_ptr<State> state, std::shared_ptr<IpCamPeer> peer);
+	static std::string getPartHeader(uint64_t peerId, const SnapshotCache::PSnapshot& snapshot, int32_t status);
+};
+
+}
+
+#endif
@@ -0,0 +1,103 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+#include "SnapshotCache.h"
+#include "FrameHash.h"
+#include "GD.h"
+
+#include <cstdio>
+
+namespace IpCam
+{
+
+SnapshotCache::PSnapshot SnapshotCache::get()
+{
+	std::lock_guard<std::mutex> snapshotGuard(_snapshotMutex);
+	return _snapshot;
+}
+
+void SnapshotCache::clear()
+{
+	std::lock_guard<std::mutex> snapshotGuard(_snapshotMutex);
+	_snapshot.reset();
+}
+
+SnapshotCache::PSnapshot SnapshotCache::set(const std::string& contentType, std::string&& content, int64_t time, int32_t duplicateDistance)
+{
+	std::shared_ptr<Snapshot> snapshot = std::make_shared<Snapshot>();
+	snapshot->contentType = contentType;
+	snapshot->time = time;
+	if(duplicateDistance >= 0) snapshot->hasPerceptualHash = FrameHash::compute(content.data(), content.size(), snapshot->perceptualHash);
+
+	std::lock_guard<std::mutex> snapshotGuard(_snapshotMutex);
+	if(_snapshot && snapshot->hasPerceptualHash && _snapshot->hasPerceptualHash && _snapshot->contentType == contentType && FrameHash::distance(_snapshot->perceptualHash, snapshot->perceptualHash) <= (uint32_t)duplicateDistance)
+	{
+		//Keep the image and ETag clients already have
+		snapshot->content = _snapshot->content;
+		snapshot->etag = _snapshot->etag;
+		snapshot->perceptualHash = _snapshot->perceptualHash;
+	}
+	else
+	{
+		snapshot->content = std::move(content);
+		snapshot->etag = getETag(snapshot->content);
+	}
+	_snapshot = snapshot;
+	return _snapshot;
+}
+
+std::string SnapshotCache::getETag(const std::string& content)
+{
+	//64 bit FNV-1a. The length is included to make collisions even less likely.
+	uint64_t hash = 14695981039346656037ULL;
+	for(std::string::const_iterator i = content.begin(); i != content.end(); ++i)
+	{
+		hash ^= (uint8_t)*i;
+		hash *= 1099511628211ULL;
+	}
+	char etag[48];
+	snprintf(etag, sizeof(etag), "\"%016llx-%zx\"", (unsigned long long)hash, content.size());
+	return std::string(etag);
+}
+
+bool SnapshotCache::matches(const std::string& ifNoneMatch, const std::string& etag)
+{
+	if(ifNoneMatch.empty() || etag.empty()) return false;
+	std::vector<std::string> tags = BaseLib::HelperFunctions::splitAll(ifNoneMatch, ',');
+	for(std::vector<std::string>::iterator i = tags.begin(); i != tags.end(); ++i)
+	{
+		std::string tag = BaseLib::HelperFunctions::trim(*i);
+		if(tag == "*") return true;
+		if(tag.compare(0, 2, "W/") == 0) tag = tag.substr(2);
+		if(tag == etag) return true;
+	}
+	return false;
+}
+
+}
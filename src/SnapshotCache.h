@@ -0,0 +1,96 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+#ifndef SNAPSHOTCACHE_H_
+#define SNAPSHOTCACHE_H_
+
+#include <memory>
+#include <mutex>
+#include <string>
+
+namespace IpCam
+{
+
+/**
+ * Holds the last snapshot of a camera together with its strong ETag (a hash of the content), so repeated requests can be
+ * answered without contacting the camera and revalidated with If-None-Match.
+ */
+class SnapshotCache
+{
+public:
+	struct Snapshot
+	{
+		std::string contentType;
+		std::string content;
+		std::string etag;
+
+		/**
+		 * The time the snapshot was fetched. When an unchanged image replaces the snapshot, only this time is updated.
+		 */
+		int64_t time = 0;
+		bool hasPerceptualHash = false;
+		uint64_t perceptualHash = 0;
+	};
+	typedef std::shared_ptr<const Snapshot> PSnapshot;
+
+	SnapshotCache() {}
+	virtual ~SnapshotCache() {}
+
+	/**
+	 * Returns the cached snapshot or nullptr. The snapshot might be stale.
+	 */
+	PSnapshot get();
+
+	/**
+	 * Caches a snapshot.
+	 *
+	 * @param duplicateDistance When the perceptual hash of the new image is within this distance of the cached image's hash,
+	 * the cached image and its ETag are kept, so clients can keep using their copy. -1 always replaces the image.
+	 * @return Returns the cached snapshot.
+	 */
+	PSnapshot set(const std::string& contentType, std::string&& content, int64_t time, int32_t duplicateDistance);
+	void clear();
+
+	/**
+	 * Returns a quoted ETag for the content.
+	 */
+	static std::string getETag(const std::string& content);
+
+	/**
+	 * Checks if an If-None-Match header value matches an ETag (weak comparison as required by RFC 7232).
+	 */
+	static bool matches(const std::string& ifNoneMatch, const std::string& etag);
+protected:
+	std::mutex _snapshotMutex;
+	PSnapshot _snapshot;
+};
+
+}
+
+#endif
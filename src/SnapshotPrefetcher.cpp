@@ -0,0 +1,200 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+#include "SnapshotPrefetcher.h"
+#include "GD.h"
+#include "IpCamCentral.h"
+
+#include <sstream>
+
+namespace IpCam
+{
+
+SnapshotPrefetcher::SnapshotPrefetcher(uint32_t concurrency) : _concurrency(concurrency > 0 ? concurrency : 1)
+{
+}
+
+SnapshotPrefetcher::~SnapshotPrefetcher()
+{
+	stop();
+}
+
+void SnapshotPrefetcher::stop()
+{
+	{
+		std::lock_guard<std::mutex> guard(_mutex);
+		_stopThreads = true;
+		_queue.clear();
+	}
+	_conditionVariable.notify_all();
+	for(std::vector<std::thread>::iterator i = _threads.begin(); i != _threads.end(); ++i)
+	{
+		GD::bl->threadManager.join(*i);
+	}
+}
+
+void SnapshotPrefetcher::onRequest(uint64_t peerId)
+{
+	int64_t time = BaseLib::HelperFunctions::getTime();
+	std::lock_guard<std::mutex> guard(_mutex);
+	Demand& demand = _demand[peerId];
+	int64_t interval = time - demand.lastRequest;
+	if(demand.requests > 0 && interval < _minInterval) return;
+	if(demand.requests == 0 || interval > _maxInterval) demand.requests = 1;
+	else
+	{
+		demand.interval = demand.requests == 1 ? interval : (demand.interval * 3 + interval) / 4;
+		demand.requests++;
+	}
+	demand.lastRequest = time;
+}
+
+void SnapshotPrefetcher::removePeer(uint64_t peerId)
+{
+	std::lock_guard<std::mutex> guard(_mutex);
+	_demand.erase(peerId);
+}
+
+void SnapshotPrefetcher::schedule()
+{
+	int64_t time = BaseLib::HelperFunctions::getTime();
+	std::vector<std::pair<uint64_t, int64_t>> candidates;
+	{
+		std::lock_guard<std::mutex> guard(_mutex);
+		if(_stopThreads || time - _lastSchedule < 50) return;
+		_lastSchedule = time;
+		for(std::map<uint64_t, Demand>::iterator i = _demand.begin(); i != _demand.end();)
+		{
+			Demand& demand = i->second;
+			if(time - demand.lastRequest > _maxInterval)
+			{
+				i = _demand.erase(i);
+				continue;
+			}
+			int64_t expectedRequest = demand.lastRequest + demand.interval;
+			//Nobody polls this camera anymore (or not regularly enough), back off until the next request.
+			bool idle = demand.requests < _minRequests || time > expectedRequest + demand.interval;
+			if(!idle && !demand.queued && demand.handledRequest != demand.lastRequest && time >= expectedRequest - (demand.latency * 3) / 2 - 100)
+			{
+				demand.handledRequest = demand.lastRequest;
+				candidates.emplace_back(i->first, expectedRequest);
+			}
+			++i;
+		}
+	}
+	if(candidates.empty()) return;
+
+	std::shared_ptr<IpCamCentral> central = std::dynamic_pointer_cast<IpCamCentral>(GD::family->getCentral());
+	if(!central) return;
+	for(std::vector<std::pair<uint64_t, int64_t>>::iterator i = candidates.begin(); i != candidates.end(); ++i)
+	{
+		//No need to prefetch when the cached snapshot is still fresh at the expected request.
+		std::shared_ptr<IpCamPeer> peer = central->getPeer(i->first);
+		if(!peer || !peer->snapshotStaleAt(i->second)) continue;
+
+		std::lock_guard<std::mutex> guard(_mutex);
+		if(_stopThreads) return;
+		std::map<uint64_t, Demand>::iterator demandIterator = _demand.find(i->first);
+		if(demandIterator == _demand.end()) continue;
+		demandIterator->second.queued = true;
+		_queue.push_back(i->first);
+		//Only start the threads when snapshots are polled
+		if(_threads.empty())
+		{
+			_threads.resize(_concurrency);
+			for(std::vector<std::thread>::iterator j = _threads.begin(); j != _threads.end(); ++j)
+			{
+				GD::bl->threadManager.start(*j, false, &SnapshotPrefetcher::worker, this);
+			}
+		}
+		_conditionVariable.notify_one();
+	}
+}
+
+void SnapshotPrefetcher::worker()
+{
+	while(true)
+	{
+		uint64_t peerId = 0;
+		{
+			std::unique_lock<std::mutex> guard(_mutex);
+			_conditionVariable.wait(guard, [&] { return !_queue.empty() || _stopThreads; });
+			if(_stopThreads) return;
+			peerId = _queue.front();
+			_queue.pop_front();
+		}
+
+		int64_t startTime = BaseLib::HelperFunctions::getTime();
+		bool success = false;
+		try
+		{
+			std::shared_ptr<IpCamCentral> central = std::dynamic_pointer_cast<IpCamCentral>(GD::family->getCentral());
+			std::shared_ptr<IpCamPeer> peer = central ? central->getPeer(peerId) : std::shared_ptr<IpCamPeer>();
+			if(peer && !peer->deleting)
+			{
+				if(GD::bl->debugLevel >= 5) GD::out.printDebug("Debug: Prefetching snapshot of peer " + std::to_string(peerId) + ".");
+				success = (bool)peer->refreshSnapshot();
+			}
+		}
+		catch(const std::exception& ex)
+		{
+			GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+		}
+
+		std::lock_guard<std::mutex> guard(_mutex);
+		std::map<uint64_t, Demand>::iterator demandIterator = _demand.find(peerId);
+		if(demandIterator == _demand.end()) continue;
+		demandIterator->second.queued = false;
+		if(success)
+		{
+			demandIterator->second.latency = (demandIterator->second.latency * 3 + (BaseLib::HelperFunctions::getTime() - startTime)) / 4;
+			demandIterator->second.prefetches++;
+		}
+	}
+}
+
+std::string SnapshotPrefetcher::getStats()
+{
+	std::ostringstream stringStream;
+	int64_t time = BaseLib::HelperFunctions::getTime();
+	std::lock_guard<std::mutex> guard(_mutex);
+	stringStream << "Concurrency:\t" << _concurrency << std::endl;
+	stringStream << "Queued:\t\t" << _queue.size() << std::endl;
+	if(_demand.empty()) return stringStream.str();
+	stringStream << std::endl << "Peer ID\tRequests\tInterval (ms)\tLatency (ms)\tPrefetches\tActive" << std::endl;
+	for(std::map<uint64_t, Demand>::iterator i = _demand.begin(); i != _demand.end(); ++i)
+	{
+		const Demand& demand = i->second;
+		bool active = demand.requests >= _minRequests && time <= demand.lastRequest + demand.interval * 2;
+		stringStream << i->first << "\t" << demand.requests << "\t\t" << demand.interval << "\t\t" << demand.latency << "\t\t" << demand.prefetches << "\t\t" << (active ? "yes" : "no") << std::endl;
+	}
+	return stringStream.str();
+}
+
+}
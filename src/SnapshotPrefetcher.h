@@ -0,0 +1,111 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+#ifndef SNAPSHOTPREFETCHER_H_
+#define SNAPSHOTPREFETCHER_H_
+
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace IpCam
+{
+
+/**
+ * Learns how often the snapshot of each camera is requested and refreshes the snapshot cache shortly before the next request
+ * is expected, so clients polling a camera don't wait for the camera. Cameras nobody polls are not prefetched. At most
+ * "concurrency" snapshots are fetched at the same time for all cameras.
+ */
+class SnapshotPrefetcher
+{
+public:
+	SnapshotPrefetcher(uint32_t concurrency);
+	virtual ~SnapshotPrefetcher();
+
+	/**
+	 * Called for every client request of a snapshot.
+	 */
+	void onRequest(uint64_t peerId);
+	void removePeer(uint64_t peerId);
+
+	/**
+	 * Queues the refresh of all snapshots that are about to be requested. Called regularly by the central's worker.
+	 */
+	void schedule();
+	void stop();
+
+	std::string getStats();
+protected:
+	struct Demand
+	{
+		uint32_t requests = 0;
+		int64_t lastRequest = 0;
+
+		/**
+		 * Moving average of the time between requests in milliseconds.
+		 */
+		int64_t interval = 0;
+
+		/**
+		 * Moving average of the prefetch duration in milliseconds.
+		 */
+		int64_t latency = 1000;
+
+		/**
+		 * "lastRequest" when the cache was last refreshed or checked, so it is refreshed only once per request.
+		 */
+		int64_t handledRequest = 0;
+		bool queued = false;
+		uint64_t prefetches = 0;
+	};
+
+	//Requests in shorter succession (e. g. from several browser tabs) don't count as separate requests.
+	static const int64_t _minInterval = 100;
+	static const int64_t _maxInterval = 600000;
+	static const uint32_t _minRequests = 3;
+
+	std::mutex _mutex;
+	std::condition_variable _conditionVariable;
+	std::map<uint64_t, Demand> _demand;
+	std::deque<uint64_t> _queue;
+	int64_t _lastSchedule = 0;
+	uint32_t _concurrency = 1;
+	std::vector<std::thread> _threads;
+	bool _stopThreads = false;
+
+	void worker();
+};
+
+}
+
+#endif
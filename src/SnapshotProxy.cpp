@@ -0,0 +1,245 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+#include "SnapshotProxy.h"
+#include "GD.h"
+
+namespace IpCam
+{
+
+namespace
+{
+
+/**
+ * Incremental decoder for chunked transfer encoding. The encoded data is forwarded unchanged, the decoder is only needed to
+ * find the end of the body and to collect the content.
+ */
+class ChunkedDecoder
+{
+public:
+	/**
+	 * @return Returns false on invalid data.
+	 */
+	bool process(const char* data, size_t size, std::string* content)
+	{
+		for(size_t i = 0; i < size && _state != State::finished;)
+		{
+			char c = data[i];
+			switch(_state)
+			{
+			case State::size:
+				if(c == '\n')
+				{
+					if(_line.empty() || _line.size() > 16) return false;
+					_remaining = std::strtoull(_line.c_str(), nullptr, 16);
+					_line.clear();
+					_state = _remaining == 0 ? State::trailer : State::data;
+				}
+				else if(c == ';') _state = State::extension;
+				else if(c != '\r' && c != ' ') _line.push_back(c);
+				i++;
+				break;
+			case State::extension:
+				if(c == '\n')
+				{
+					if(_line.empty() || _line.size() > 16) return false;
+					_remaining = std::strtoull(_line.c_str(), nullptr, 16);
+					_line.clear();
+					_state = _remaining == 0 ? State::trailer : State::data;
+				}
+				i++;
+				break;
+			case State::data:
+			{
+				size_t bytes = size - i < _remaining ? size - i : _remaining;
+				if(content) content->append(data + i, bytes);
+				_remaining -= bytes;
+				i += bytes;
+				if(_remaining == 0) _state = State::dataEnd;
+				break;
+			}
+			case State::dataEnd:
+				if(c == '\n') _state = State::size;
+				else if(c != '\r') return false;
+				i++;
+				break;
+			case State::trailer:
+				//Trailer lines end with an empty line
+				if(c == '\n')
+				{
+					if(_line.empty()) _state = State::finished;
+					_line.clear();
+				}
+				else if(c != '\r') _line.push_back(c);
+				i++;
+				break;
+			case State::finished:
+				break;
+			}
+		}
+		return true;
+	}
+
+	bool finished() { return _state == State::finished; }
+private:
+	enum class State { size, extension, data, dataEnd, trailer, finished };
+
+	State _state = State::size;
+	std::string _line;
+	uint64_t _remaining = 0;
+};
+
+}
+
+SnapshotProxy::Result SnapshotProxy::forward(const Upstream& upstream, std::shared_ptr<BaseLib::TcpSocket>& client, size_t maxContentSize)
+{
+	Result result;
+	CameraConnection camera(upstream.host, upstream.port, upstream.ssl, upstream.caFile, upstream.verifyCertificate, upstream.timeouts, upstream.stats, upstream.tlsSessionCache);
+
+	std::vector<char> buffer(_chunkSize);
+
+	// {{{ Header
+	std::string header;
+	std::string::size_type headerEnd = std::string::npos;
+	try
+	{
+		camera.open();
+		camera.write("GET " + upstream.path + " HTTP/1.1\r\nUser-Agent: Homegear\r\nHost: " + upstream.host + ":" + std::to_string(upstream.port) + "\r\n" + (upstream.authorization.empty() ? "" : "Authorization: " + upstream.authorization + "\r\n") + "Connection: Close\r\n\r\n");
+		while(headerEnd == std::string::npos)
+		{
+			if(header.size() > _maxHeaderSize)
+			{
+				GD::out.printWarning("Warning: Snapshot response header of " + upstream.host + " is too large.");
+				return result;
+			}
+			size_t bytesRead = camera.read(buffer.data(), buffer.size());
+			header.append(buffer.data(), bytesRead);
+			headerEnd = header.find("\r\n\r\n");
+		}
+	}
+	catch(const BaseLib::SocketOperationException& ex)
+	{
+		//Nothing was sent to the client yet, so the caller can still respond with an error.
+		GD::out.printWarning("Warning: Could not get snapshot from " + upstream.host + ": " + std::string(ex.what()));
+		return result;
+	}
+	std::string body = header.substr(headerEnd + 4);
+	header.resize(headerEnd + 2);
+
+	std::vector<std::string> lines = BaseLib::HelperFunctions::splitAll(header, '\n');
+	if(lines.empty() || lines.front().compare(0, 5, "HTTP/") != 0) return result;
+	std::string::size_type space = lines.front().find(' ');
+	if(space == std::string::npos) return result;
+	result.responseCode = BaseLib::Math::getNumber(lines.front().substr(space + 1, 3));
+
+	//Forward all headers except hop-by-hop headers. The connection to the client is always closed.
+	std::string forwardedHeader = BaseLib::HelperFunctions::trim(lines.front()) + "\r\n";
+	int64_t contentLength = -1;
+	bool chunked = false;
+	for(std::vector<std::string>::iterator i = lines.begin() + 1; i != lines.end(); ++i)
+	{
+		std::string line = BaseLib::HelperFunctions::trim(*i);
+		if(line.empty()) continue;
+		std::pair<std::string, std::string> field = BaseLib::HelperFunctions::splitFirst(line, ':');
+		std::string name = BaseLib::HelperFunctions::toLower(BaseLib::HelperFunctions::trim(field.first));
+		std::string value = BaseLib::HelperFunctions::trim(field.second);
+		if(name == "connection" || name == "keep-alive") continue;
+		if(name == "content-length") contentLength = BaseLib::Math::getNumber64(value);
+		else if(name == "content-type") result.contentType = value;
+		else if(name == "transfer-encoding" && BaseLib::HelperFunctions::toLower(value).find("chunked") != std::string::npos) chunked = true;
+		forwardedHeader += line + "\r\n";
+	}
+	forwardedHeader += "Connection: close\r\n\r\n";
+	client->proofwrite(forwardedHeader);
+	// }}}
+
+	// {{{ Body
+	std::string* content = (maxContentSize > 0 && result.responseCode == 200) ? &result.content : nullptr;
+	ChunkedDecoder chunkedDecoder;
+	bool finished = (!chunked && contentLength == 0) || result.responseCode == 204 || result.responseCode == 304;
+	const char* data = body.data();
+	size_t size = body.size();
+	while(!finished)
+	{
+		if(size > 0)
+		{
+			if(chunked)
+			{
+				if(!chunkedDecoder.process(data, size, content))
+				{
+					GD::out.printWarning("Warning: Invalid chunked encoding in snapshot response of " + upstream.host + ".");
+					return result;
+				}
+				finished = chunkedDecoder.finished();
+			}
+			else
+			{
+				if(contentLength >= 0 && result.bodySize + size > (uint64_t)contentLength) size = contentLength - result.bodySize;
+				if(content) content->append(data, size);
+				finished = contentLength >= 0 && result.bodySize + size == (uint64_t)contentLength;
+			}
+			client->proofwrite(data, size);
+			result.bodySize += size;
+			if(content && content->size() > maxContentSize)
+			{
+				//Too large to cache. Continue forwarding only.
+				content->clear();
+				content->shrink_to_fit();
+				content = nullptr;
+			}
+			if(finished) break;
+		}
+
+		size_t bytesRead = 0;
+		try
+		{
+			bytesRead = camera.read(buffer.data(), buffer.size());
+		}
+		catch(const BaseLib::SocketClosedException&)
+		{
+			bytesRead = 0;
+		}
+		if(bytesRead == 0)
+		{
+			//Without length, the body ends when the camera closes the connection.
+			finished = !chunked && contentLength < 0;
+			break;
+		}
+		data = buffer.data();
+		size = bytesRead;
+	}
+	camera.close();
+	// }}}
+
+	result.contentComplete = finished && content != nullptr;
+	if(!result.contentComplete) result.content.clear();
+	return result;
+}
+
+}
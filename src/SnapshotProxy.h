@@ -0,0 +1,95 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+#ifndef SNAPSHOTPROXY_H_
+#define SNAPSHOTPROXY_H_
+
+#include "CameraConnection.h"
+
+#include <homegear-base/BaseLib.h>
+
+#include <string>
+
+namespace IpCam
+{
+
+/**
+ * Forwards a camera response to a client while it is received. The header is forwarded as soon as it is complete and the
+ * body in fixed-size chunks, so memory usage doesn't depend on the image size. Bodies with Content-Length, chunked
+ * transfer encoding or without length (until the camera closes the connection) are supported.
+ */
+class SnapshotProxy
+{
+public:
+	struct Upstream
+	{
+		std::string host;
+		int32_t port = 80;
+		std::string path;
+		bool ssl = false;
+		std::string caFile;
+		bool verifyCertificate = true;
+		std::string authorization;
+		CameraConnection::Timeouts timeouts;
+		CameraConnection::PStats stats;
+		std::shared_ptr<TlsSessionCache> tlsSessionCache;
+	};
+
+	struct Result
+	{
+		/**
+		 * The response code of the camera or -1 when no valid header was received. Nothing is written to the client in this
+		 * case.
+		 */
+		int32_t responseCode = -1;
+		std::string contentType;
+
+		/**
+		 * The decoded body. Only filled when requested, the response code is 200 and the body is not larger than the limit.
+		 */
+		std::string content;
+		bool contentComplete = false;
+		uint64_t bodySize = 0;
+	};
+
+	/**
+	 * @param maxContentSize Collect the body of successful responses in Result::content up to this size. 0 disables
+	 * collection.
+	 */
+	static Result forward(const Upstream& upstream, std::shared_ptr<BaseLib::TcpSocket>& client, size_t maxContentSize);
+private:
+	static const size_t _maxHeaderSize = 16384;
+	static const size_t _chunkSize = 16384;
+
+	SnapshotProxy() = delete;
+};
+
+}
+
+#endif
@@ -0,0 +1,459 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+#include "StreamHub.h"
+#include "GD.h"
+#include "MjpegParser.h"
+
+#include <cstring>
+
+namespace IpCam
+{
+
+const std::array<double, StreamHub::priorityCount> StreamHub::_reserves{{0, 0.1, 0.25, 0.5}};
+
+StreamHub::StreamHub()
+{
+	_stopWorkerThread = false;
+}
+
+StreamHub::~StreamHub()
+{
+	stop();
+}
+
+void StreamHub::setUpstream(const std::string& host, int32_t port, const std::string& path, bool ssl, const std::string& caFile, bool verifyCertificate, const std::string& authorization)
+{
+	std::lock_guard<std::mutex> upstreamGuard(_upstreamMutex);
+	_host = host;
+	_port = port;
+	_path = path;
+	_ssl = ssl;
+	_caFile = caFile;
+	_verifyCertificate = verifyCertificate;
+	_authorization = authorization;
+}
+
+void StreamHub::setConnectionOptions(const CameraConnection::Timeouts& timeouts, const CameraConnection::PStats& stats, const std::shared_ptr<TlsSessionCache>& tlsSessionCache)
+{
+	std::lock_guard<std::mutex> upstreamGuard(_upstreamMutex);
+	_timeouts = timeouts;
+	_connectionStats = stats;
+	_tlsSessionCache = tlsSessionCache;
+}
+
+const std::string& StreamHub::getMultipartHeader()
+{
+	static const std::string header("HTTP/1.1 200 OK\r\nContent-Type: multipart/x-mixed-replace; boundary=ipcamframe\r\nCache-Control: no-cache, no-store\r\nPragma: no-cache\r\nConnection: close\r\n\r\n");
+	return header;
+}
+
+std::string StreamHub::getPartHeader(uint32_t frameSize)
+{
+	return "--ipcamframe\r\nContent-Type: image/jpeg\r\nContent-Length: " + std::to_string(frameSize) + "\r\n\r\n";
+}
+
+std::string StreamHub::getPriorityName(Priority priority)
+{
+	switch(priority)
+	{
+		case Priority::recording: return "recording";
+		case Priority::detection: return "detection";
+		case Priority::live: return "live";
+		case Priority::decimated: return "decimated";
+	}
+	return "";
+}
+
+void StreamHub::insertConsumer(ConsumerInfo& info)
+{
+	std::vector<ConsumerInfo>::iterator i = _consumers.begin();
+	while(i != _consumers.end() && i->priority <= info.priority) ++i;
+	_consumers.insert(i, std::move(info));
+}
+
+void StreamHub::addConsumer(const PConsumer& consumer, Priority priority, int64_t minFrameInterval)
+{
+	try
+	{
+		std::lock_guard<std::mutex> consumersGuard(_consumersMutex);
+		ConsumerInfo info;
+		for(std::vector<ConsumerInfo>::iterator i = _consumers.begin(); i != _consumers.end(); ++i)
+		{
+			if(i->consumer == consumer)
+			{
+				//Already registered: Only update the priority and keep the statistics.
+				info = std::move(*i);
+				_consumers.erase(i);
+				break;
+			}
+		}
+		info.consumer = consumer;
+		info.priority = priority;
+		info.minFrameInterval = minFrameInterval;
+		int64_t time = BaseLib::HelperFunctions::getTime();
+		if(info.addedTime == 0) info.addedTime = time;
+		insertConsumer(info);
+		_lastConsumerTime = time;
+		if(_running || _stopWorkerThread) return;
+		GD::bl->threadManager.join(_workerThread);
+		_running = true;
+		GD::bl->threadManager.start(_workerThread, true, &StreamHub::worker, this);
+	}
+	catch(const std::exception& ex)
+	{
+		GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+	}
+}
+
+void StreamHub::updateConsumer(const PConsumer& consumer, Priority priority, int64_t minFrameInterval)
+{
+	try
+	{
+		std::lock_guard<std::mutex> consumersGuard(_consumersMutex);
+		for(std::vector<ConsumerInfo>::iterator i = _consumers.begin(); i != _consumers.end(); ++i)
+		{
+			if(i->consumer == consumer)
+			{
+				ConsumerInfo info = std::move(*i);
+				_consumers.erase(i);
+				info.priority = priority;
+				info.minFrameInterval = minFrameInterval;
+				insertConsumer(info);
+				break;
+			}
+		}
+	}
+	catch(const std::exception& ex)
+	{
+		GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+	}
+}
+
+void StreamHub::removeConsumer(const PConsumer& consumer)
+{
+	try
+	{
+		std::lock_guard<std::mutex> consumersGuard(_consumersMutex);
+		for(std::vector<ConsumerInfo>::iterator i = _consumers.begin(); i != _consumers.end(); ++i)
+		{
+			if(i->consumer == consumer)
+			{
+				_consumers.erase(i);
+				_lastConsumerTime = BaseLib::HelperFunctions::getTime();
+				break;
+			}
+		}
+	}
+	catch(const std::exception& ex)
+	{
+		GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+	}
+}
+
+std::array<StreamHub::PriorityStats, StreamHub::priorityCount> StreamHub::getPriorityStats()
+{
+	std::lock_guard<std::mutex> consumersGuard(_consumersMutex);
+	std::array<PriorityStats, priorityCount> stats = _priorityStats;
+	for(std::vector<ConsumerInfo>::iterator i = _consumers.begin(); i != _consumers.end(); ++i)
+	{
+		stats[(int32_t)i->priority].consumers++;
+	}
+	return stats;
+}
+
+std::vector<StreamHub::ConsumerStats> StreamHub::getConsumerStats()
+{
+	std::lock_guard<std::mutex> consumersGuard(_consumersMutex);
+	std::vector<ConsumerStats> stats;
+	stats.reserve(_consumers.size());
+	for(std::vector<ConsumerInfo>::iterator i = _consumers.begin(); i != _consumers.end(); ++i)
+	{
+		ConsumerStats consumerStats;
+		consumerStats.priority = i->priority;
+		consumerStats.minFrameInterval = i->minFrameInterval;
+		consumerStats.addedTime = i->addedTime;
+		consumerStats.frames = i->frames;
+		consumerStats.bytes = i->bytes;
+		consumerStats.droppedFrames = i->droppedFrames;
+		stats.push_back(consumerStats);
+	}
+	return stats;
+}
+
+StreamHub::UpstreamStats StreamHub::getUpstreamStats()
+{
+	UpstreamStats stats;
+	stats.connected = _upstreamConnected;
+	stats.frames = _upstreamFrames;
+	stats.bytesReceived = _bytesReceived;
+	return stats;
+}
+
+Frame StreamHub::latestFrame()
+{
+	std::lock_guard<std::mutex> latestFrameGuard(_latestFrameMutex);
+	return _latestFrame;
+}
+
+void StreamHub::stop()
+{
+	try
+	{
+		_stopWorkerThread = true;
+		GD::bl->threadManager.join(_workerThread);
+		std::lock_guard<std::mutex> latestFrameGuard(_latestFrameMutex);
+		_latestFrame.reset();
+	}
+	catch(const std::exception& ex)
+	{
+		GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+	}
+}
+
+bool StreamHub::hasConsumers()
+{
+	std::lock_guard<std::mutex> consumersGuard(_consumersMutex);
+	int64_t time = BaseLib::HelperFunctions::getTime();
+	if(!_consumers.empty())
+	{
+		_lastConsumerTime = time;
+		return true;
+	}
+	return time - _lastConsumerTime < 5000;
+}
+
+void StreamHub::worker()
+{
+	int32_t retryDelay = 1000;
+	while(!_stopWorkerThread)
+	{
+		{
+			std::lock_guard<std::mutex> consumersGuard(_consumersMutex);
+			if(_consumers.empty() && BaseLib::HelperFunctions::getTime() - _lastConsumerTime >= 5000)
+			{
+				_running = false;
+				return;
+			}
+		}
+
+		int64_t startTime = BaseLib::HelperFunctions::getTime();
+		try
+		{
+			readStream();
+		}
+		catch(const BaseLib::SocketOperationException& ex)
+		{
+			GD::out.printWarning("Warning: Error reading stream of peer " + std::to_string(_peerId) + ": " + ex.what());
+		}
+		catch(const std::exception& ex)
+		{
+			GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+		}
+		_upstreamConnected = false;
+
+		//Connections refused by the circuit breaker or the connection limiter didn't reach the camera, so retry soon.
+		if(BaseLib::HelperFunctions::getTime() - startTime > 10000 || _lastRejectionTime >= startTime) retryDelay = 1000;
+		for(int32_t i = 0; i < retryDelay / 100 && !_stopWorkerThread && hasConsumers(); i++)
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(100));
+		}
+		retryDelay = retryDelay >= 15000 ? 30000 : retryDelay * 2;
+	}
+	std::lock_guard<std::mutex> consumersGuard(_consumersMutex);
+	_running = false;
+}
+
+void StreamHub::readStream()
+{
+	std::string host;
+	std::string port;
+	std::string request;
+	std::unique_ptr<CameraConnection> connection;
+	if(_circuitBreaker && !_circuitBreaker->allowRequest())
+	{
+		_lastRejectionTime = BaseLib::HelperFunctions::getTime();
+		if(GD::bl->debugLevel >= 5) GD::out.printDebug("Debug: Not opening stream of peer " + std::to_string(_peerId) + ": Camera is unreachable.");
+		return;
+	}
+	//Held while the stream is open.
+	ConnectionLimiter::PPermit permit = GD::connectionLimiter->acquire(_peerId, 5000);
+	if(!permit)
+	{
+		_lastRejectionTime = BaseLib::HelperFunctions::getTime();
+		GD::out.printInfo("Info: Can't open stream of peer " + std::to_string(_peerId) + ": Too many connections to the camera.");
+		return;
+	}
+	{
+		std::lock_guard<std::mutex> upstreamGuard(_upstreamMutex);
+		if(_host.empty()) return;
+		host = _host;
+		port = std::to_string(_port);
+		request = "GET " + _path + " HTTP/1.1\r\nUser-Agent: Homegear\r\nHost: " + _host + ":" + port + "\r\nConnection: Close\r\n";
+		if(!_authorization.empty()) request += "Authorization: " + _authorization + "\r\n";
+		request += "\r\n";
+		connection.reset(new CameraConnection(host, _port, _ssl, _caFile, _verifyCertificate, _timeouts, _connectionStats, _tlsSessionCache));
+	}
+
+	try
+	{
+		connection->open();
+		connection->write(request);
+	}
+	catch(const BaseLib::SocketOperationException& ex)
+	{
+		if(_circuitBreaker) _circuitBreaker->onFailure();
+		throw;
+	}
+	_upstreamConnected = true;
+	bool dataReceived = false;
+
+	MjpegParser parser(FramePool::maxFrameSize);
+	MjpegParser::FrameCallback frameCallback = std::bind(&StreamHub::publish, this, std::placeholders::_1, std::placeholders::_2);
+	std::vector<char> buffer(16384);
+	while(!_stopWorkerThread && hasConsumers())
+	{
+		size_t receivedBytes = 0;
+		try
+		{
+			//Wake up regularly to check for consumers. The connection throws when its first-byte or idle timeout elapsed.
+			receivedBytes = connection->read(buffer.data(), buffer.size(), 1000);
+		}
+		catch(const BaseLib::SocketTimeOutException& ex)
+		{
+			if(_circuitBreaker && !dataReceived) _circuitBreaker->onFailure();
+			throw;
+		}
+		if(receivedBytes == 0) continue;
+		if(!dataReceived)
+		{
+			dataReceived = true;
+			if(_circuitBreaker) _circuitBreaker->onSuccess();
+		}
+		_bytesReceived += receivedBytes;
+		if(!parser.process(buffer.data(), receivedBytes, frameCallback))
+		{
+			GD::out.printWarning("Warning: Error reading stream of peer " + std::to_string(_peerId) + ": " + parser.getError());
+			break;
+		}
+
+		//Pausing reads fills the socket's receive buffer, so the camera has to slow down.
+		int64_t time = BaseLib::HelperFunctions::getTime();
+		_upstreamBandwidth.take(receivedBytes, time);
+		for(int64_t delay = _upstreamBandwidth.delay(time); delay > 0 && !_stopWorkerThread; delay = _upstreamBandwidth.delay(BaseLib::HelperFunctions::getTime()))
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(delay < 100 ? delay : 100));
+		}
+	}
+	connection->close();
+}
+
+void StreamHub::publish(const char* data, size_t size)
+{
+	_upstreamFrames++;
+	Frame frame = GD::framePool->allocate(size, BaseLib::HelperFunctions::getTime(), ++_sequence);
+	if(!frame)
+	{
+		int64_t time = BaseLib::HelperFunctions::getTime();
+		if(time - _lastDropWarningTime >= 60000)
+		{
+			_lastDropWarningTime = time;
+			if(size > FramePool::maxFrameSize) GD::out.printWarning("Warning: Dropping frame of peer " + std::to_string(_peerId) + ": Frame size of " + std::to_string(size) + " bytes exceeds the maximum of " + std::to_string(FramePool::maxFrameSize) + " bytes.");
+			else GD::out.printWarning("Warning: Dropping frame of peer " + std::to_string(_peerId) + ": Frame pool is exhausted. Consider increasing \"frameMemory\" in ipcam.conf.");
+		}
+		return;
+	}
+	std::memcpy(frame.writableData(), data, size);
+
+	{
+		std::lock_guard<std::mutex> latestFrameGuard(_latestFrameMutex);
+		_latestFrame = frame;
+	}
+
+	int64_t time = frame.time();
+	bool limited = _bandwidth.limited() || GD::bandwidthBudget->limited();
+	std::lock_guard<std::mutex> consumersGuard(_consumersMutex);
+	for(std::vector<ConsumerInfo>::iterator i = _consumers.begin(); i != _consumers.end(); ++i)
+	{
+		if(i->minFrameInterval > 0 && time - i->lastDeliveryTime < i->minFrameInterval) continue;
+		PriorityStats& stats = _priorityStats[(int32_t)i->priority];
+		if(limited)
+		{
+			double reserve = _reserves[(int32_t)i->priority];
+			if(!_bandwidth.available(reserve, time) || !GD::bandwidthBudget->available(reserve, time))
+			{
+				stats.droppedFrames++;
+				i->droppedFrames++;
+				continue;
+			}
+			_bandwidth.take(size, time);
+			GD::bandwidthBudget->take(size, time);
+		}
+		i->lastDeliveryTime = time;
+		stats.frames++;
+		stats.bytes += size;
+		i->frames++;
+		i->bytes += size;
+		i->consumer->onFrame(frame);
+	}
+}
+
+FrameQueue::FrameQueue(size_t maxSize)
+{
+	_frames.resize(maxSize > 0 ? maxSize : 1);
+}
+
+void FrameQueue::onFrame(const Frame& frame)
+{
+	{
+		std::lock_guard<std::mutex> queueGuard(_queueMutex);
+		if(_count == _frames.size())
+		{
+			_frames[_head].reset();
+			_head = (_head + 1) % _frames.size();
+			_count--;
+			_droppedFrames++;
+		}
+		_frames[(_head + _count) % _frames.size()] = frame;
+		_count++;
+	}
+	_queueConditionVariable.notify_one();
+}
+
+Frame FrameQueue::pop(int32_t timeout)
+{
+	std::unique_lock<std::mutex> queueGuard(_queueMutex);
+	if(!_queueConditionVariable.wait_for(queueGuard, std::chrono::milliseconds(timeout), [&] { return _count > 0; })) return Frame();
+	Frame frame(std::move(_frames[_head]));
+	_head = (_head + 1) % _frames.size();
+	_count--;
+	return frame;
+}
+
+}
@@ -0,0 +1,253 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+#ifndef STREAMHUB_H_
+#define STREAMHUB_H_
+
+#include "CameraConnection.h"
+#include "CircuitBreaker.h"
+#include "FramePool.h"
+#include "TokenBucket.h"
+
+#include <array>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace IpCam
+{
+
+/**
+ * Maintains one upstream MJPEG connection per camera and distributes the received frames to all registered consumers.
+ * The connection is opened when the first consumer is added and closed a few seconds after the last one is removed.
+ *
+ * When a bandwidth limit is set for the camera or globally, every delivered frame is charged to both budgets. Consumers
+ * are served in the order of their priority and lower priorities stop receiving frames earlier while a budget drains,
+ * so recorders keep their frames when viewers saturate the link.
+ */
+class StreamHub
+{
+public:
+	enum class Priority : int32_t
+	{
+		recording = 0,
+		detection = 1,
+		live = 2,
+		decimated = 3
+	};
+	static const size_t priorityCount = 4;
+
+	struct PriorityStats
+	{
+		uint32_t consumers = 0;
+		uint64_t frames = 0;
+		uint64_t bytes = 0;
+		uint64_t droppedFrames = 0;
+	};
+
+	struct ConsumerStats
+	{
+		Priority priority = Priority::live;
+		int64_t minFrameInterval = 0;
+		int64_t addedTime = 0;
+		uint64_t frames = 0;
+		uint64_t bytes = 0;
+		uint64_t droppedFrames = 0;
+	};
+
+	struct UpstreamStats
+	{
+		bool connected = false;
+		uint64_t frames = 0;
+		uint64_t bytesReceived = 0;
+	};
+
+	class IConsumer
+	{
+	public:
+		virtual ~IConsumer() {}
+
+		/**
+		 * Called from the hub's thread for every received frame. Implementations must not block.
+		 */
+		virtual void onFrame(const Frame& frame) = 0;
+	};
+	typedef std::shared_ptr<IConsumer> PConsumer;
+
+	StreamHub();
+	virtual ~StreamHub();
+
+	void setPeerId(uint64_t peerId) { _peerId = peerId; }
+
+	/**
+	 * No connection is opened while the breaker is open. Connection results are reported to it.
+	 */
+	void setCircuitBreaker(const std::shared_ptr<CircuitBreaker>& circuitBreaker) { _circuitBreaker = circuitBreaker; }
+	void setUpstream(const std::string& host, int32_t port, const std::string& path, bool ssl, const std::string& caFile, bool verifyCertificate, const std::string& authorization);
+
+	/**
+	 * Timeouts, latency statistics and TLS state of the upstream connection. Used from the next connection on. The stream is
+	 * reconnected when no data arrives within the idle timeout.
+	 */
+	void setConnectionOptions(const CameraConnection::Timeouts& timeouts, const CameraConnection::PStats& stats, const std::shared_ptr<TlsSessionCache>& tlsSessionCache);
+
+	/**
+	 * @param minFrameInterval Frames arriving less than this many milliseconds after the last delivered one are not
+	 * delivered to (nor charged for) the consumer.
+	 * Adding a registered consumer again only updates its priority and frame interval.
+	 */
+	void addConsumer(const PConsumer& consumer, Priority priority = Priority::live, int64_t minFrameInterval = 0);
+	void updateConsumer(const PConsumer& consumer, Priority priority, int64_t minFrameInterval);
+	void removeConsumer(const PConsumer& consumer);
+
+	/**
+	 * Sets the outbound budget of this camera in bytes per second. 0 disables the limit.
+	 */
+	void setBandwidthLimit(uint64_t rate) { _bandwidth.setRate(rate); }
+
+	/**
+	 * Limits the upstream connection to "rate" bytes per second by pausing reads, so TCP flow control slows down the
+	 * camera. 0 disables the limit.
+	 */
+	void setUpstreamRateLimit(uint64_t rate) { _upstreamBandwidth.setRate(rate); }
+	std::array<PriorityStats, priorityCount> getPriorityStats();
+	std::vector<ConsumerStats> getConsumerStats();
+
+	/**
+	 * The counters are never reset.
+	 */
+	UpstreamStats getUpstreamStats();
+	static std::string getPriorityName(Priority priority);
+
+	/**
+	 * Time the upstream connection was last refused by the connection limiter or the circuit breaker or 0.
+	 */
+	int64_t lastRejectionTime() { return _lastRejectionTime; }
+	Frame latestFrame();
+	void stop();
+
+	static const std::string& getMultipartHeader();
+	static std::string getPartHeader(uint32_t frameSize);
+protected:
+	uint64_t _peerId = 0;
+	std::shared_ptr<CircuitBreaker> _circuitBreaker;
+
+	std::mutex _upstreamMutex;
+	std::string _host;
+	int32_t _port = 80;
+	std::string _path;
+	bool _ssl = false;
+	std::string _caFile;
+	bool _verifyCertificate = false;
+	std::string _authorization;
+	CameraConnection::Timeouts _timeouts;
+	CameraConnection::PStats _connectionStats;
+	std::shared_ptr<TlsSessionCache> _tlsSessionCache;
+
+	struct ConsumerInfo
+	{
+		PConsumer consumer;
+		Priority priority = Priority::live;
+		int64_t minFrameInterval = 0;
+		int64_t lastDeliveryTime = 0;
+		int64_t addedTime = 0;
+		uint64_t frames = 0;
+		uint64_t bytes = 0;
+		uint64_t droppedFrames = 0;
+	};
+
+	/**
+	 * Part of the bucket size each priority leaves for higher ones.
+	 */
+	static const std::array<double, priorityCount> _reserves;
+
+	std::mutex _consumersMutex;
+	//Sorted by priority.
+	std::vector<ConsumerInfo> _consumers;
+	std::array<PriorityStats, priorityCount> _priorityStats;
+	TokenBucket _bandwidth;
+	TokenBucket _upstreamBandwidth;
+	std::atomic_bool _upstreamConnected{false};
+	std::atomic<uint64_t> _upstreamFrames{0};
+	std::atomic<uint64_t> _bytesReceived{0};
+	std::thread _workerThread;
+	bool _running = false;
+	std::atomic_bool _stopWorkerThread;
+	int64_t _lastConsumerTime = 0;
+	std::atomic<int64_t> _lastRejectionTime{0};
+	int64_t _lastDropWarningTime = 0;
+
+	std::mutex _latestFrameMutex;
+	Frame _latestFrame;
+	uint64_t _sequence = 0;
+
+	void worker();
+	bool hasConsumers();
+
+	/**
+	 * Inserts the consumer after all consumers of the same or a higher priority. _consumersMutex must be locked.
+	 */
+	void insertConsumer(ConsumerInfo& info);
+	void readStream();
+	void publish(const char* data, size_t size);
+};
+
+/**
+ * Consumer keeping the newest frames for a client thread. When the client is too slow, the oldest frames are dropped.
+ */
+class FrameQueue : public StreamHub::IConsumer
+{
+public:
+	FrameQueue(size_t maxSize = 2);
+	virtual ~FrameQueue() {}
+
+	virtual void onFrame(const Frame& frame);
+
+	/**
+	 * Waits for the next frame.
+	 *
+	 * @param timeout The maximum time to wait in milliseconds.
+	 * @return Returns an empty frame on timeout.
+	 */
+	Frame pop(int32_t timeout);
+	uint64_t droppedFrames() { return _droppedFrames; }
+protected:
+	std::mutex _queueMutex;
+	std::condition_variable _queueConditionVariable;
+	std::vector<Frame> _frames;
+	size_t _head = 0;
+	size_t _count = 0;
+	std::atomic<uint64_t> _droppedFrames{0};
+};
+
+}
+
+#endif
@@ -0,0 +1,322 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+#include "TimelapseArchive.h"
+#include "FrameHash.h"
+#include "GD.h"
+#include "Segment.h"
+#include "StreamHub.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace IpCam
+{
+
+namespace
+{
+	uint64_t getContentHash(const char* data, size_t size)
+	{
+		//FNV-1a
+		uint64_t hash = 14695981039346656037ULL;
+		for(size_t i = 0; i < size; i++)
+		{
+			hash ^= (uint8_t)data[i];
+			hash *= 1099511628211ULL;
+		}
+		return hash;
+	}
+}
+
+// {{{ View
+TimelapseArchive::View::~View()
+{
+	if(_entries) munmap((void*)_entries, _indexSize);
+	if(_data) munmap((void*)_data, _dataSize);
+}
+
+bool TimelapseArchive::View::open(const std::string& path)
+{
+	for(int32_t i = 0; i < 2; i++)
+	{
+		std::string filename = path + (i == 0 ? ".tli" : ".jpgs");
+		int descriptor = ::open(filename.c_str(), O_RDONLY | O_CLOEXEC);
+		if(descriptor == -1) return false;
+		struct stat fileInfo;
+		void* memory = MAP_FAILED;
+		size_t size = 0;
+		if(fstat(descriptor, &fileInfo) == 0 && fileInfo.st_size > 0)
+		{
+			//The archive might be appended to while it is mapped. Only the part written so far is used.
+			size = fileInfo.st_size;
+			if(i == 0) size -= size % sizeof(IndexEntry);
+			if(size > 0) memory = mmap(nullptr, size, PROT_READ, MAP_SHARED, descriptor, 0);
+		}
+		::close(descriptor);
+		if(memory == MAP_FAILED) return false;
+		if(i == 0)
+		{
+			madvise(memory, size, MADV_RANDOM);
+			_entries = (const IndexEntry*)memory;
+			_indexSize = size;
+			_count = size / sizeof(IndexEntry);
+		}
+		else
+		{
+			madvise(memory, size, MADV_SEQUENTIAL);
+			_data = (const char*)memory;
+			_dataSize = size;
+		}
+	}
+	return true;
+}
+
+const char* TimelapseArchive::View::data(const IndexEntry& entry) const
+{
+	if(entry.offset + entry.size > _dataSize) return nullptr;
+	return _data + entry.offset;
+}
+
+size_t TimelapseArchive::View::find(int64_t time) const
+{
+	return std::lower_bound(_entries, _entries + _count, time, [](const IndexEntry& entry, int64_t time) { return entry.time < time; }) - _entries;
+}
+// }}}
+
+TimelapseArchive::TimelapseArchive(const std::string& directory, uint32_t retention) : _directory(directory), _retention(retention)
+{
+	std::memset(&_previous, 0, sizeof(IndexEntry));
+}
+
+TimelapseArchive::~TimelapseArchive()
+{
+	close();
+}
+
+std::string TimelapseArchive::getDay(int64_t time)
+{
+	time_t seconds = time / 1000;
+	struct tm localTime;
+	localtime_r(&seconds, &localTime);
+	char buffer[16];
+	size_t size = strftime(buffer, sizeof(buffer), "%Y%m%d", &localTime);
+	return std::string(buffer, size);
+}
+
+bool TimelapseArchive::open(const std::string& day)
+{
+	close();
+	if(!Segment::createDirectory(_directory)) return false;
+	std::string path = _directory + day;
+	_dataDescriptor = ::open((path + ".jpgs").c_str(), O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, S_IRUSR | S_IWUSR | S_IRGRP);
+	_indexDescriptor = ::open((path + ".tli").c_str(), O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, S_IRUSR | S_IWUSR | S_IRGRP);
+	if(_dataDescriptor == -1 || _indexDescriptor == -1)
+	{
+		GD::out.printError("Error: Could not open time-lapse archive " + path + ": " + strerror(errno));
+		close();
+		return false;
+	}
+	_day = day;
+
+	struct stat fileInfo;
+	if(fstat(_dataDescriptor, &fileInfo) == 0) _dataSize = fileInfo.st_size;
+	//Continue deduplication with the last image written before a restart. Incomplete entries from a crash are cut off.
+	_hasPrevious = false;
+	_previousHasPerceptualHash = false;
+	if(fstat(_indexDescriptor, &fileInfo) == 0)
+	{
+		off_t validSize = fileInfo.st_size - fileInfo.st_size % sizeof(IndexEntry);
+		if(validSize != fileInfo.st_size && ftruncate(_indexDescriptor, validSize) == -1) GD::out.printWarning("Warning: Could not repair " + path + ".tli: " + strerror(errno));
+		if(validSize > 0 && pread(_indexDescriptor, &_previous, sizeof(IndexEntry), validSize - sizeof(IndexEntry)) == sizeof(IndexEntry) && _previous.offset + _previous.size <= _dataSize) _hasPrevious = true;
+	}
+	return true;
+}
+
+void TimelapseArchive::close()
+{
+	if(_dataDescriptor != -1)
+	{
+		::close(_dataDescriptor);
+		_dataDescriptor = -1;
+	}
+	if(_indexDescriptor != -1)
+	{
+		::close(_indexDescriptor);
+		_indexDescriptor = -1;
+	}
+	_day.clear();
+	_dataSize = 0;
+}
+
+void TimelapseArchive::deleteOldArchives(int64_t time)
+{
+	if(_retention == 0) return;
+	std::string oldestDay = getDay(time - (int64_t)_retention * 86400000);
+	DIR* directory = opendir(_directory.c_str());
+	if(!directory) return;
+	struct dirent* entry = nullptr;
+	while((entry = readdir(directory)) != nullptr)
+	{
+		std::string name(entry->d_name);
+		std::string::size_type dot = name.find('.');
+		if(dot != 8 || (name.compare(dot, std::string::npos, ".jpgs") != 0 && name.compare(dot, std::string::npos, ".tli") != 0)) continue;
+		//Day strings compare chronologically.
+		if(name.compare(0, 8, oldestDay) >= 0) continue;
+		if(GD::bl->debugLevel >= 4) GD::out.printInfo("Info: Deleting time-lapse archive " + _directory + name);
+		if(unlink((_directory + name).c_str()) == -1) GD::out.printWarning("Warning: Could not delete " + _directory + name + ": " + strerror(errno));
+	}
+	closedir(directory);
+}
+
+bool TimelapseArchive::append(int64_t time, const char* data, uint32_t size, int32_t duplicateDistance)
+{
+	try
+	{
+		if(!data || size == 0) return false;
+		std::string day = getDay(time);
+		if(day != _day)
+		{
+			if(!open(day)) return false;
+			deleteOldArchives(time);
+		}
+
+		IndexEntry entry;
+		//The index must stay sorted. Stream frames and snapshots might be slightly out of order.
+		entry.time = _hasPrevious && time < _previous.time ? _previous.time : time;
+		entry.reserved = 0;
+		entry.hash = getContentHash(data, size);
+		bool duplicate = _hasPrevious && _previous.hash == entry.hash && _previous.size == size;
+		uint64_t perceptualHash = 0;
+		bool hasPerceptualHash = duplicateDistance >= 0 && FrameHash::compute(data, size, perceptualHash);
+		if(!duplicate && _hasPrevious && hasPerceptualHash && _previousHasPerceptualHash) duplicate = FrameHash::distance(perceptualHash, _previousPerceptualHash) <= (uint32_t)duplicateDistance;
+
+		if(duplicate)
+		{
+			//Keep the hashes of the stored image, so slow changes still lead to a new image eventually.
+			entry.offset = _previous.offset;
+			entry.size = _previous.size;
+			entry.hash = _previous.hash;
+		}
+		else
+		{
+			entry.offset = _dataSize;
+			entry.size = size;
+			ssize_t bytesWritten = write(_dataDescriptor, data, size);
+			if(bytesWritten != (ssize_t)size)
+			{
+				GD::out.printError("Error: Could not write to time-lapse archive " + _directory + _day + ".jpgs: " + (bytesWritten == -1 ? std::string(strerror(errno)) : std::string("Disk is full.")));
+				//Don't leave a partial image behind the last valid one.
+				if(bytesWritten > 0 && ftruncate(_dataDescriptor, _dataSize) == -1) close();
+				return false;
+			}
+			_dataSize += size;
+			_previousHasPerceptualHash = hasPerceptualHash;
+			_previousPerceptualHash = perceptualHash;
+		}
+
+		if(write(_indexDescriptor, &entry, sizeof(IndexEntry)) != sizeof(IndexEntry))
+		{
+			GD::out.printError("Error: Could not write to time-lapse archive " + _directory + _day + ".tli: " + strerror(errno));
+			close();
+			return false;
+		}
+		_previous = entry;
+		_hasPrevious = true;
+		return true;
+	}
+	catch(const std::exception& ex)
+	{
+		GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+	}
+	return false;
+}
+
+void TimelapseArchive::play(std::shared_ptr<BaseLib::TcpSocket>& socket, const std::string& directory, int64_t from, int64_t to, double speed, const std::function<bool()>& cancelled)
+{
+	//Step from noon to noon, so daylight saving time changes don't skip a day.
+	std::vector<std::string> days;
+	{
+		time_t seconds = from / 1000;
+		struct tm localTime;
+		localtime_r(&seconds, &localTime);
+		localTime.tm_hour = 12;
+		localTime.tm_min = 0;
+		localTime.tm_sec = 0;
+		localTime.tm_isdst = -1;
+		int64_t noon = (int64_t)mktime(&localTime) * 1000;
+		for(int64_t time = noon; days.empty() || getDay(time) <= getDay(to); time += 86400000)
+		{
+			std::string day = getDay(time);
+			if(days.empty() || days.back() != day) days.push_back(day);
+		}
+	}
+
+	socket->proofwrite(StreamHub::getMultipartHeader());
+	int64_t playbackStartTime = BaseLib::HelperFunctions::getTime();
+	int64_t firstFrameTime = -1;
+	int64_t lastDueTime = 0;
+	for(std::vector<std::string>::iterator i = days.begin(); i != days.end() && !cancelled(); ++i)
+	{
+		View view;
+		if(!view.open(directory + *i)) continue;
+		for(size_t j = view.find(from); j < view.count(); j++)
+		{
+			const IndexEntry& entry = view.entry(j);
+			if(entry.time > to) break;
+			const char* data = view.data(entry);
+			if(!data) break;
+			if(firstFrameTime == -1) firstFrameTime = entry.time;
+
+			int64_t dueTime = playbackStartTime + (int64_t)((entry.time - firstFrameTime) / speed);
+			if(lastDueTime != 0 && dueTime - lastDueTime < _minFrameInterval) continue;
+			lastDueTime = dueTime;
+			int64_t waitTime = dueTime - BaseLib::HelperFunctions::getTime();
+			while(waitTime > 0 && !cancelled())
+			{
+				std::this_thread::sleep_for(std::chrono::milliseconds(waitTime > 500 ? 500 : waitTime));
+				waitTime = dueTime - BaseLib::HelperFunctions::getTime();
+			}
+			if(cancelled()) break;
+			//Written directly from the mapped file.
+			socket->proofwrite(StreamHub::getPartHeader(entry.size));
+			socket->proofwrite(data, entry.size);
+			socket->proofwrite("\r\n", 2);
+		}
+	}
+	socket->close();
+}
+
+}
@@ -0,0 +1,142 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+#ifndef TIMELAPSEARCHIVE_H_
+#define TIMELAPSEARCHIVE_H_
+
+#include <homegear-base/BaseLib.h>
+
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace IpCam
+{
+
+/**
+ * Append-only store for time-lapse images. There is one archive per day consisting of "YYYYMMDD.jpgs" with the JPEG images
+ * and "YYYYMMDD.tli" with one fixed-size IndexEntry per image. An image identical (or, with a duplicate distance, similar)
+ * to the previous one is not stored again, its index entry points to the stored image instead. Archives are read through
+ * read-only memory mappings.
+ */
+class TimelapseArchive
+{
+public:
+	struct IndexEntry
+	{
+		int64_t time;
+		uint64_t offset;
+		uint32_t size;
+		uint32_t reserved;
+		uint64_t hash;
+	};
+
+	/**
+	 * Memory mapping of the archive of one day.
+	 */
+	class View
+	{
+	public:
+		View() {}
+		virtual ~View();
+
+		bool open(const std::string& path);
+		size_t count() const { return _count; }
+		const IndexEntry& entry(size_t index) const { return _entries[index]; }
+
+		/**
+		 * Returns the image data of an entry or nullptr when the entry points outside of the data file.
+		 */
+		const char* data(const IndexEntry& entry) const;
+
+		/**
+		 * Returns the index of the first entry not older than "time".
+		 */
+		size_t find(int64_t time) const;
+	private:
+		View(const View&) = delete;
+		View& operator=(const View&) = delete;
+
+		const IndexEntry* _entries = nullptr;
+		size_t _count = 0;
+		size_t _indexSize = 0;
+		const char* _data = nullptr;
+		size_t _dataSize = 0;
+	};
+
+	/**
+	 * @param retention Delete archives older than this number of days. 0 keeps all archives.
+	 */
+	TimelapseArchive(const std::string& directory, uint32_t retention);
+	virtual ~TimelapseArchive();
+
+	const std::string& directory() { return _directory; }
+	uint32_t retention() { return _retention; }
+
+	/**
+	 * Appends an image. Must only be called from one thread at a time (the recording writer).
+	 *
+	 * @param duplicateDistance Maximum perceptual distance to the previous image to not store the image again. -1 only
+	 * skips identical images.
+	 * @return Returns false on error.
+	 */
+	bool append(int64_t time, const char* data, uint32_t size, int32_t duplicateDistance);
+	void close();
+
+	/**
+	 * Streams all images between "from" and "to" (in milliseconds) as MJPEG. "speed" is the ratio of recorded time to
+	 * playback time. At most 25 frames per second are sent, images in between are skipped.
+	 */
+	static void play(std::shared_ptr<BaseLib::TcpSocket>& socket, const std::string& directory, int64_t from, int64_t to, double speed, const std::function<bool()>& cancelled);
+protected:
+	static const int64_t _minFrameInterval = 40;
+
+	std::string _directory;
+	uint32_t _retention = 0;
+	std::string _day;
+	int _dataDescriptor = -1;
+	int _indexDescriptor = -1;
+	uint64_t _dataSize = 0;
+	bool _hasPrevious = false;
+	IndexEntry _previous;
+	bool _previousHasPerceptualHash = false;
+	uint64_t _previousPerceptualHash = 0;
+
+	bool open(const std::string& day);
+	void deleteOldArchives(int64_t time);
+
+	/**
+	 * Returns the local date as "YYYYMMDD".
+	 */
+	static std::string getDay(int64_t time);
+};
+
+}
+
+#endif
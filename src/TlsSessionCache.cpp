@@ -0,0 +1,147 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+#include "TlsSessionCache.h"
+#include "GD.h"
+
+namespace IpCam
+{
+
+TlsSessionCache::PCredentials TlsSessionCache::getCredentials(const std::string& caFile, bool verifyCertificate, gnutls_certificate_verify_function* verifyFunction)
+{
+	std::lock_guard<std::mutex> cacheGuard(_mutex);
+	if(_credentials && caFile == _caFile && verifyCertificate == _verifyCertificate) return _credentials;
+
+	//New trust settings: Nothing established with the old ones can be reused.
+	_credentials.reset();
+	_sessions.clear();
+	_verifiedCertificates.clear();
+	_caFile = caFile;
+	_verifyCertificate = verifyCertificate;
+
+	gnutls_certificate_credentials_t credentials = nullptr;
+	if(gnutls_certificate_allocate_credentials(&credentials) != GNUTLS_E_SUCCESS) throw BaseLib::SocketOperationException("Could not allocate TLS credentials.");
+	PCredentials sharedCredentials(credentials, gnutls_certificate_free_credentials);
+	if(!caFile.empty())
+	{
+		if(gnutls_certificate_set_x509_trust_file(credentials, caFile.c_str(), GNUTLS_X509_FMT_PEM) < 0) throw BaseLib::SocketOperationException("Could not load CA file " + caFile + ".");
+	}
+	else if(verifyCertificate) gnutls_certificate_set_x509_system_trust(credentials);
+	if(verifyCertificate) gnutls_certificate_set_verify_function(credentials, verifyFunction);
+	_credentials = sharedCredentials;
+	return _credentials;
+}
+
+void TlsSessionCache::restoreSession(const std::string& key, gnutls_session_t session)
+{
+	std::lock_guard<std::mutex> cacheGuard(_mutex);
+	std::map<std::string, Session>::iterator sessionIterator = _sessions.find(key);
+	if(sessionIterator == _sessions.end()) return;
+	if(BaseLib::HelperFunctions::getTime() - sessionIterator->second.time >= _sessionTtl)
+	{
+		_sessions.erase(sessionIterator);
+		return;
+	}
+	gnutls_session_set_data(session, sessionIterator->second.data.data(), sessionIterator->second.data.size());
+}
+
+void TlsSessionCache::saveSession(const std::string& key, gnutls_session_t session)
+{
+	gnutls_datum_t data{ nullptr, 0 };
+	if(gnutls_session_get_data2(session, &data) != GNUTLS_E_SUCCESS) return;
+	std::string sessionData((char*)data.data, data.size);
+	gnutls_free(data.data);
+
+	std::lock_guard<std::mutex> cacheGuard(_mutex);
+	int64_t time = BaseLib::HelperFunctions::getTime();
+	if(_sessions.size() >= _maxSessions && _sessions.find(key) == _sessions.end())
+	{
+		std::map<std::string, Session>::iterator oldest = _sessions.begin();
+		for(std::map<std::string, Session>::iterator i = _sessions.begin(); i != _sessions.end(); ++i)
+		{
+			if(i->second.time < oldest->second.time) oldest = i;
+		}
+		_sessions.erase(oldest);
+	}
+	Session& entry = _sessions[key];
+	entry.data = std::move(sessionData);
+	entry.time = time;
+}
+
+void TlsSessionCache::removeSession(const std::string& key)
+{
+	std::lock_guard<std::mutex> cacheGuard(_mutex);
+	_sessions.erase(key);
+}
+
+void TlsSessionCache::onHandshake(bool resumed)
+{
+	if(resumed) _resumedHandshakes++;
+	else _fullHandshakes++;
+}
+
+bool TlsSessionCache::isVerified(const std::string& fingerprint, int64_t time)
+{
+	std::lock_guard<std::mutex> cacheGuard(_mutex);
+	std::map<std::string, int64_t>::iterator certificateIterator = _verifiedCertificates.find(fingerprint);
+	if(certificateIterator != _verifiedCertificates.end())
+	{
+		if(time < certificateIterator->second)
+		{
+			_verificationCacheHits++;
+			return true;
+		}
+		_verifiedCertificates.erase(certificateIterator);
+	}
+	_verifications++;
+	return false;
+}
+
+void TlsSessionCache::setVerified(const std::string& fingerprint, int64_t notAfter, int64_t time)
+{
+	std::lock_guard<std::mutex> cacheGuard(_mutex);
+	//A camera only has a few certificates, more mean that certificates change often. Start over.
+	if(_verifiedCertificates.size() >= _maxSessions) _verifiedCertificates.clear();
+	_verifiedCertificates[fingerprint] = notAfter < time + _verificationTtl ? notAfter : time + _verificationTtl;
+}
+
+TlsSessionCache::Stats TlsSessionCache::getStats()
+{
+	Stats stats;
+	stats.fullHandshakes = _fullHandshakes;
+	stats.resumedHandshakes = _resumedHandshakes;
+	stats.verifications = _verifications;
+	stats.verificationCacheHits = _verificationCacheHits;
+	std::lock_guard<std::mutex> cacheGuard(_mutex);
+	stats.sessions = _sessions.size();
+	stats.certificates = _verifiedCertificates.size();
+	return stats;
+}
+
+}
@@ -0,0 +1,129 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+#ifndef TLSSESSIONCACHE_H_
+#define TLSSESSIONCACHE_H_
+
+#include <gnutls/gnutls.h>
+
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+namespace IpCam
+{
+
+/**
+ * TLS state of one camera shared by all of its connections: The credentials (so the CA file is only loaded once), the
+ * session data of the last connection to each host and port for session resumption and the certificate chains that
+ * were verified recently, so a full handshake with an unchanged chain doesn't validate it again.
+ *
+ * Changing the trust settings clears everything.
+ */
+class TlsSessionCache
+{
+public:
+	typedef std::shared_ptr<gnutls_certificate_credentials_st> PCredentials;
+
+	struct Stats
+	{
+		uint64_t fullHandshakes = 0;
+		uint64_t resumedHandshakes = 0;
+		uint64_t verifications = 0;
+		uint64_t verificationCacheHits = 0;
+		size_t sessions = 0;
+		size_t certificates = 0;
+	};
+
+	TlsSessionCache() {}
+	virtual ~TlsSessionCache() {}
+
+	/**
+	 * Returns the credentials for the given trust settings. When "verifyCertificate" is true, "verifyFunction" is called
+	 * for every full handshake.
+	 *
+	 * @throws SocketOperationException when the credentials can't be created.
+	 */
+	PCredentials getCredentials(const std::string& caFile, bool verifyCertificate, gnutls_certificate_verify_function* verifyFunction);
+
+	/**
+	 * Sets the stored session data of "key" (host and port) on "session", so the handshake tries to resume it.
+	 */
+	void restoreSession(const std::string& key, gnutls_session_t session);
+
+	/**
+	 * Stores the session data of "session". With TLS 1.3, the data is only complete after the first record was received.
+	 */
+	void saveSession(const std::string& key, gnutls_session_t session);
+	void removeSession(const std::string& key);
+	void onHandshake(bool resumed);
+
+	/**
+	 * Returns true when the certificate chain with this fingerprint was verified for the host before and the result hasn't
+	 * expired yet.
+	 */
+	bool isVerified(const std::string& fingerprint, int64_t time);
+
+	/**
+	 * @param notAfter Expiration time of the chain. The result is kept until then, but not longer than an hour.
+	 */
+	void setVerified(const std::string& fingerprint, int64_t notAfter, int64_t time);
+	Stats getStats();
+protected:
+	static const size_t _maxSessions = 16;
+
+	/**
+	 * Time in milliseconds session data is used.
+	 */
+	static const int64_t _sessionTtl = 3600000;
+	static const int64_t _verificationTtl = 3600000;
+
+	struct Session
+	{
+		std::string data;
+		int64_t time = 0;
+	};
+
+	std::mutex _mutex;
+	std::string _caFile;
+	bool _verifyCertificate = false;
+	PCredentials _credentials;
+	std::map<std::string, Session> _sessions;
+	std::map<std::string, int64_t> _verifiedCertificates;
+	std::atomic<uint64_t> _fullHandshakes{0};
+	std::atomic<uint64_t> _resumedHandshakes{0};
+	std::atomic<uint64_t> _verifications{0};
+	std::atomic<uint64_t> _verificationCacheHits{0};
+};
+
+}
+
+#endif
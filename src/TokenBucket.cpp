@@ -0,0 +1,81 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+#include "TokenBucket.h"
+
+namespace IpCam
+{
+
+void TokenBucket::setRate(uint64_t rate)
+{
+	std::lock_guard<std::mutex> bucketGuard(_mutex);
+	if(rate == _rate) return;
+	_rate = rate;
+	_tokens = rate;
+	_lastRefill = 0;
+}
+
+void TokenBucket::refill(int64_t time)
+{
+	if(_lastRefill != 0 && time > _lastRefill)
+	{
+		_tokens += (double)_rate * (time - _lastRefill) / 1000.0;
+		if(_tokens > (double)_rate) _tokens = _rate;
+	}
+	if(time > _lastRefill) _lastRefill = time;
+}
+
+bool TokenBucket::available(double reserve, int64_t time)
+{
+	std::lock_guard<std::mutex> bucketGuard(_mutex);
+	if(_rate == 0) return true;
+	refill(time);
+	return _tokens > reserve * _rate;
+}
+
+void TokenBucket::take(uint64_t bytes, int64_t time)
+{
+	std::lock_guard<std::mutex> bucketGuard(_mutex);
+	if(_rate == 0) return;
+	refill(time);
+	_tokens -= bytes;
+	//Limit the debt to one second, so a burst of huge frames doesn't block the bucket for long.
+	if(_tokens < -(double)_rate) _tokens = -(double)_rate;
+}
+
+int64_t TokenBucket::delay(int64_t time)
+{
+	std::lock_guard<std::mutex> bucketGuard(_mutex);
+	if(_rate == 0) return 0;
+	refill(time);
+	if(_tokens > 0) return 0;
+	return (int64_t)(-_tokens * 1000.0 / _rate) + 1;
+}
+
+}
@@ -0,0 +1,82 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+#ifndef TOKENBUCKET_H_
+#define TOKENBUCKET_H_
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+
+namespace IpCam
+{
+
+/**
+ * Byte budget refilled at a fixed rate. The bucket holds at most one second of the rate. A take is allowed while the
+ * bucket is above the caller's reserve and may overdraw it by one frame, so frames larger than the bucket still pass
+ * and the average rate is kept by the debt.
+ */
+class TokenBucket
+{
+public:
+	TokenBucket() {}
+	virtual ~TokenBucket() {}
+
+	/**
+	 * @param rate Bytes per second. 0 disables the limit.
+	 */
+	void setRate(uint64_t rate);
+	uint64_t getRate() { return _rate; }
+	bool limited() { return _rate > 0; }
+
+	/**
+	 * Returns true when the bucket holds more than "reserve" (a fraction of the bucket size between 0 and 1).
+	 */
+	bool available(double reserve, int64_t time);
+	void take(uint64_t bytes, int64_t time);
+
+	/**
+	 * Returns the time in milliseconds until the bucket is not empty anymore.
+	 */
+	int64_t delay(int64_t time);
+protected:
+	std::mutex _mutex;
+	std::atomic<uint64_t> _rate{0};
+	double _tokens = 0;
+	int64_t _lastRefill = 0;
+
+	/**
+	 * _mutex must be locked.
+	 */
+	void refill(int64_t time);
+};
+
+}
+
+#endif
@@ -0,0 +1,293 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+#include "WebSocketStream.h"
+#include "GD.h"
+#include "HttpHelper.h"
+
+#include <gcrypt.h>
+#include <poll.h>
+#include <sys/socket.h>
+
+namespace IpCam
+{
+
+WebSocketStream::WebSocketStream(uint64_t peerId, std::shared_ptr<BaseLib::TcpSocket>& socket, bool ssl) : _peerId(peerId), _socket(socket), _ssl(ssl)
+{
+#ifndef LINUXSYSTEM
+	_ssl = true;
+#endif
+	BaseLib::PFileDescriptor fileDescriptor = _socket->getFileDescriptor();
+	if(fileDescriptor) _descriptor = fileDescriptor->descriptor;
+}
+
+bool WebSocketStream::isUpgradeRequest(BaseLib::Http& request)
+{
+	std::map<std::string, std::string>& fields = request.getHeader().fields;
+	std::map<std::string, std::string>::iterator upgradeIterator = fields.find("upgrade");
+	if(upgradeIterator == fields.end()) return false;
+	std::string upgrade = upgradeIterator->second;
+	return BaseLib::HelperFunctions::toLower(BaseLib::HelperFunctions::trim(upgrade)) == "websocket";
+}
+
+std::string WebSocketStream::getAcceptKey(const std::string& key)
+{
+	std::string input = key + "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+	std::vector<char> digest(20);
+	gcry_md_hash_buffer(GCRY_MD_SHA1, digest.data(), input.data(), input.size());
+	std::string acceptKey;
+	BaseLib::Base64::encode(digest, acceptKey);
+	return acceptKey;
+}
+
+bool WebSocketStream::handshake(BaseLib::Http& request)
+{
+	std::map<std::string, std::string>& fields = request.getHeader().fields;
+	std::string key = fields["sec-websocket-key"];
+	BaseLib::HelperFunctions::trim(key);
+	if(!isUpgradeRequest(request) || key.empty() || fields["sec-websocket-version"] != "13" || _descriptor == -1)
+	{
+		_socket->proofwrite(HttpHelper::getResponse(400, "Bad Request", "Sec-WebSocket-Version: 13\r\n"));
+		_socket->close();
+		return false;
+	}
+	_socket->proofwrite("HTTP/1.1 101 Switching Protocols\r\nUpgrade: websocket\r\nConnection: Upgrade\r\nSec-WebSocket-Accept: " + getAcceptKey(key) + "\r\n\r\n");
+	return true;
+}
+
+void WebSocketStream::setFps(double fps)
+{
+	if(fps < 0) fps = 0;
+	else if(fps > 60) fps = 60;
+	_minFrameInterval = fps > 0 ? 1000.0 / fps : 0;
+	if(GD::bl->debugLevel >= 5) GD::out.printDebug("Debug: WebSocket client of peer " + std::to_string(_peerId) + " requested " + std::to_string(fps) + " frames per second.");
+}
+
+void WebSocketStream::run(const std::shared_ptr<StreamHub>& hub, double fps, const std::function<bool()>& cancelled)
+{
+	setFps(fps);
+	_socket->setReadTimeout(100000);
+
+	//Holds only the newest frame. Older ones are dropped while the client is busy.
+	std::shared_ptr<FrameQueue> frameQueue = std::make_shared<FrameQueue>(1);
+	int64_t consumerInterval = _minFrameInterval;
+	hub->addConsumer(frameQueue, consumerInterval > 0 ? StreamHub::Priority::decimated : StreamHub::Priority::live, consumerInterval);
+	try
+	{
+		int64_t startTime = BaseLib::HelperFunctions::getTime();
+		int64_t lastFrameTime = startTime;
+		int64_t lastSentTime = 0;
+		//Status code 1000 (normal closure), 1001 (going away) or 1013 (try again later)
+		uint16_t statusCode = 1001;
+		while(!cancelled() && !_closeReceived)
+		{
+			receive();
+			if(_closeReceived) break;
+			if(_minFrameInterval != consumerInterval)
+			{
+				consumerInterval = _minFrameInterval;
+				hub->updateConsumer(frameQueue, consumerInterval > 0 ? StreamHub::Priority::decimated : StreamHub::Priority::live, consumerInterval);
+			}
+
+			Frame frame = frameQueue->pop(100);
+			if(!frame)
+			{
+				if(lastSentTime == 0 && hub->lastRejectionTime() >= startTime)
+				{
+					GD::out.printInfo("Info: Closing WebSocket of peer " + std::to_string(_peerId) + ": Too many connections to the camera.");
+					statusCode = 1013;
+					break;
+				}
+				if(BaseLib::HelperFunctions::getTime() - lastFrameTime >= 30000)
+				{
+					GD::out.printWarning("Warning: No frames received from camera of peer " + std::to_string(_peerId) + " for 30 seconds. Closing WebSocket.");
+					break;
+				}
+				continue;
+			}
+			lastFrameTime = BaseLib::HelperFunctions::getTime();
+			if(_minFrameInterval > 0 && frame.time() - lastSentTime < _minFrameInterval) continue;
+			lastSentTime = frame.time();
+			send(Opcode::binary, frame.data(), frame.size());
+		}
+
+		if(_closeReceived) statusCode = 1000;
+		char status[2] = { (char)(statusCode >> 8), (char)(statusCode & 0xFF) };
+		send(Opcode::close, status, sizeof(status));
+	}
+	catch(...)
+	{
+		hub->removeConsumer(frameQueue);
+		throw;
+	}
+	hub->removeConsumer(frameQueue);
+	_socket->close();
+}
+
+void WebSocketStream::send(Opcode opcode, const char* data, size_t size)
+{
+	char header[10];
+	size_t headerSize = 2;
+	header[0] = (char)(0x80 | (uint8_t)opcode);
+	if(size < 126) header[1] = (char)size;
+	else if(size < 65536)
+	{
+		header[1] = 126;
+		header[2] = (char)(size >> 8);
+		header[3] = (char)size;
+		headerSize = 4;
+	}
+	else
+	{
+		header[1] = 127;
+		for(int32_t i = 0; i < 8; i++) header[2 + i] = (char)((uint64_t)size >> (56 - i * 8));
+		headerSize = 10;
+	}
+
+	if(_ssl)
+	{
+		_socket->proofwrite(header, headerSize);
+		if(size > 0) _socket->proofwrite(data, size);
+		return;
+	}
+
+	//Header and frame in one system call, the frame straight from the frame pool.
+	struct iovec parts[2];
+	parts[0].iov_base = header;
+	parts[0].iov_len = headerSize;
+	parts[1].iov_base = (void*)data;
+	parts[1].iov_len = size;
+	struct msghdr message{};
+	message.msg_iov = parts;
+	message.msg_iovlen = size > 0 ? 2 : 1;
+	int64_t lastProgressTime = BaseLib::HelperFunctions::getTime();
+	while(message.msg_iovlen > 0)
+	{
+		ssize_t result = sendmsg(_descriptor, &message, MSG_NOSIGNAL | MSG_DONTWAIT);
+		if(result == -1)
+		{
+			if(errno == EINTR) continue;
+			if(errno != EAGAIN && errno != EWOULDBLOCK) throw BaseLib::SocketClosedException(std::string("Could not write to WebSocket: ") + strerror(errno));
+			//The socket buffer is full. The frame queue keeps collecting the newest frame in the meantime.
+			struct pollfd pollInfo{ _descriptor, POLLOUT, 0 };
+			int pollResult = poll(&pollInfo, 1, 1000);
+			if(pollResult == -1 && errno != EINTR) throw BaseLib::SocketOperationException(std::string("Could not poll socket: ") + strerror(errno));
+			if(pollResult == 0 && BaseLib::HelperFunctions::getTime() - lastProgressTime >= 30000) throw BaseLib::SocketTimeOutException("Writing to WebSocket timed out.");
+			continue;
+		}
+		lastProgressTime = BaseLib::HelperFunctions::getTime();
+		size_t written = result;
+		while(message.msg_iovlen > 0 && written >= message.msg_iov[0].iov_len)
+		{
+			written -= message.msg_iov[0].iov_len;
+			message.msg_iov++;
+			message.msg_iovlen--;
+		}
+		if(message.msg_iovlen > 0)
+		{
+			message.msg_iov[0].iov_base = (char*)message.msg_iov[0].iov_base + written;
+			message.msg_iov[0].iov_len -= written;
+		}
+	}
+}
+
+void WebSocketStream::receive()
+{
+	struct pollfd pollInfo{ _descriptor, POLLIN, 0 };
+	if(poll(&pollInfo, 1, 0) != 1) return;
+	if(pollInfo.revents & (POLLERR | POLLHUP | POLLNVAL)) throw BaseLib::SocketClosedException("WebSocket was closed.");
+
+	char buffer[1024];
+	int32_t bytesRead = 0;
+	try
+	{
+		bytesRead = _socket->proofread(buffer, sizeof(buffer));
+	}
+	catch(const BaseLib::SocketTimeOutException& ex)
+	{
+		return;
+	}
+	if(bytesRead <= 0) throw BaseLib::SocketClosedException("WebSocket was closed.");
+	if(_receiveBuffer.size() + bytesRead > _maxMessageSize + 14) throw BaseLib::SocketDataLimitException("WebSocket message is too large.");
+	_receiveBuffer.insert(_receiveBuffer.end(), buffer, buffer + bytesRead);
+	processMessages();
+}
+
+void WebSocketStream::processMessages()
+{
+	size_t position = 0;
+	while(_receiveBuffer.size() - position >= 2)
+	{
+		const uint8_t* header = (const uint8_t*)_receiveBuffer.data() + position;
+		size_t available = _receiveBuffer.size() - position;
+		Opcode opcode = (Opcode)(header[0] & 0x0F);
+		bool masked = header[1] & 0x80;
+		uint64_t size = header[1] & 0x7F;
+		size_t headerSize = 2;
+		if(size == 126)
+		{
+			if(available < 4) break;
+			size = ((uint64_t)header[2] << 8) | header[3];
+			headerSize = 4;
+		}
+		else if(size == 127)
+		{
+			if(available < 10) break;
+			size = 0;
+			for(int32_t i = 0; i < 8; i++) size = (size << 8) | header[2 + i];
+			headerSize = 10;
+		}
+		if(size > _maxMessageSize) throw BaseLib::SocketDataLimitException("WebSocket message is too large.");
+		if(!masked) throw BaseLib::SocketOperationException("Received unmasked WebSocket message.");
+		if(available < headerSize + 4 + size) break;
+
+		const uint8_t* mask = header + headerSize;
+		std::string payload((const char*)mask + 4, size);
+		for(size_t i = 0; i < payload.size(); i++) payload[i] ^= mask[i % 4];
+		position += headerSize + 4 + size;
+
+		if(opcode == Opcode::close)
+		{
+			_closeReceived = true;
+			break;
+		}
+		else if(opcode == Opcode::ping) send(Opcode::pong, payload.data(), payload.size());
+		else if(opcode == Opcode::text)
+		{
+			std::string::size_type separator = payload.find_last_of("=:");
+			std::string value = separator == std::string::npos ? payload : payload.substr(separator + 1);
+			BaseLib::HelperFunctions::trim(value);
+			if(!value.empty() && value.back() == '}') value.pop_back();
+			setFps(BaseLib::Math::getDouble(value));
+		}
+	}
+	_receiveBuffer.erase(_receiveBuffer.begin(), _receiveBuffer.begin() + position);
+}
+
+}
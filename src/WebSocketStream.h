@@ -0,0 +1,118 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+#ifndef WEBSOCKETSTREAM_H_
+#define WEBSOCKETSTREAM_H_
+
+#include "StreamHub.h"
+
+#include <homegear-base/BaseLib.h>
+
+namespace IpCam
+{
+
+/**
+ * Pushes the frames of a stream hub to a WebSocket client. Every JPEG frame is sent as one binary message. On plain TCP
+ * connections the frame is written directly from the frame pool, so it is never copied. While a frame is being written,
+ * newer frames replace each other, so slow clients get the newest frame next.
+ *
+ * Clients can change the frame rate by sending a text message containing the frames per second (e. g. "5" or
+ * "fps=5"; 0 = unlimited).
+ */
+class WebSocketStream
+{
+public:
+	/**
+	 * @param ssl Set to true for TLS connections. Frames are written with proofwrite() then.
+	 */
+	WebSocketStream(uint64_t peerId, std::shared_ptr<BaseLib::TcpSocket>& socket, bool ssl);
+	virtual ~WebSocketStream() {}
+
+	/**
+	 * Returns true when the request asks for an upgrade to WebSocket.
+	 */
+	static bool isUpgradeRequest(BaseLib::Http& request);
+
+	/**
+	 * Returns the value of "Sec-WebSocket-Accept" for "Sec-WebSocket-Key".
+	 */
+	static std::string getAcceptKey(const std::string& key);
+
+	/**
+	 * Answers the upgrade request. Responds with 400 and returns false when the request is invalid.
+	 */
+	bool handshake(BaseLib::Http& request);
+
+	/**
+	 * Sends frames until the client closes the connection or "cancelled" returns true. Throws SocketOperationException.
+	 *
+	 * @param fps Initial maximum frame rate. 0 sends all frames.
+	 */
+	void run(const std::shared_ptr<StreamHub>& hub, double fps, const std::function<bool()>& cancelled);
+protected:
+	enum class Opcode : uint8_t
+	{
+		continuation = 0,
+		text = 1,
+		binary = 2,
+		close = 8,
+		ping = 9,
+		pong = 10
+	};
+
+	/**
+	 * Maximum size of messages from the client. Clients only send short control and text messages.
+	 */
+	static const size_t _maxMessageSize = 4096;
+
+	uint64_t _peerId = 0;
+	std::shared_ptr<BaseLib::TcpSocket> _socket;
+	int32_t _descriptor = -1;
+	bool _ssl = false;
+	int64_t _minFrameInterval = 0;
+	bool _closeReceived = false;
+	std::vector<char> _receiveBuffer;
+
+	void setFps(double fps);
+
+	/**
+	 * Writes one message. Waits while the socket buffer is full.
+	 */
+	void send(Opcode opcode, const char* data, size_t size);
+
+	/**
+	 * Reads and processes available messages of the client without blocking.
+	 */
+	void receive();
+	void processMessages();
+};
+
+}
+
+#endif